@@ -0,0 +1,134 @@
+#include "AlignmentPrefetcher.h"
+
+
+AlignmentPrefetcher::AlignmentPrefetcher(BAMREADER& r,
+                                         int bufferedAlignments,
+                                         int minMQ,
+                                         bool useDups)
+    : reader(r)
+    , minMappingQuality(minMQ)
+    , useDuplicateReads(useDups)
+    , regionRefID(-1)
+    , regionLeft(0)
+    , regionRight(0)
+    , currentIndex(0)
+    , finished(false)
+    , stopping(false)
+    , decoding(false)
+    , filteredDuplicates(0)
+    , filteredMappingQuality(0)
+    , filteredOutsideRegion(0)
+{
+    // keep a handful of batches in flight, so that neither side waits on a
+    // single large hand-off
+    batchSize = max(1, min(1024, bufferedAlignments / 4));
+    maxBatches = max(1, bufferedAlignments / batchSize);
+}
+
+AlignmentPrefetcher::~AlignmentPrefetcher(void) {
+    stop();
+}
+
+void AlignmentPrefetcher::start(int refid, long int left, long int right) {
+    stop();
+    regionRefID = refid;
+    regionLeft = left;
+    regionRight = right;
+    finished = false;
+    stopping = false;
+    decoding = true;
+    decoder = thread(&AlignmentPrefetcher::decode, this);
+}
+
+void AlignmentPrefetcher::stop(void) {
+    if (decoding) {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            stopping = true;
+        }
+        batchTaken.notify_all();
+        decoder.join();
+        decoding = false;
+    }
+    batches.clear();
+    current.clear();
+    currentIndex = 0;
+}
+
+bool AlignmentPrefetcher::getNext(BAMALIGN& alignment) {
+    if (currentIndex == current.size()) {
+        unique_lock<mutex> lock(queueMutex);
+        while (batches.empty() && !finished) {
+            batchReady.wait(lock);
+        }
+        if (batches.empty()) {
+            // finished, and everything has been consumed
+            current.clear();
+            currentIndex = 0;
+            return false;
+        }
+        current.swap(batches.front());
+        batches.pop_front();
+        currentIndex = 0;
+        lock.unlock();
+        batchTaken.notify_one();
+    }
+    swap(alignment, current[currentIndex++]);
+    return true;
+}
+
+void AlignmentPrefetcher::decode(void) {
+
+    vector<BAMALIGN> batch;
+    batch.reserve(batchSize);
+    BAMALIGN alignment;
+    bool more = true;
+
+    while (more) {
+
+        // fill a batch, dropping reads the parser will never use
+        while (batch.size() < batchSize && (more = GETNEXT(reader, alignment))) {
+            if (alignment.ISDUPLICATE && !useDuplicateReads) {
+                ++filteredDuplicates;
+                continue;
+            }
+            // unmapped reads are passed through, as they are used to
+            // track position when reading an entire file
+            if (alignment.ISMAPPED) {
+                if (alignment.MAPPINGQUALITY < minMappingQuality) {
+                    ++filteredMappingQuality;
+                    continue;
+                }
+                if (regionRefID >= 0
+                    && (alignment.REFID != regionRefID
+                        || alignment.ENDPOSITION < regionLeft
+                        || alignment.POSITION > regionRight)) {
+                    ++filteredOutsideRegion;
+                    continue;
+                }
+            }
+            batch.push_back(alignment);
+        }
+
+        // hand the batch over, waiting for room in the queue
+        unique_lock<mutex> lock(queueMutex);
+        while (batches.size() >= maxBatches && !stopping) {
+            batchTaken.wait(lock);
+        }
+        if (stopping) {
+            break;
+        }
+        if (!batch.empty()) {
+            batches.push_back(vector<BAMALIGN>());
+            batches.back().swap(batch);
+            batch.reserve(batchSize);
+        }
+        if (!more) {
+            finished = true;
+        }
+        lock.unlock();
+        batchReady.notify_one();
+
+    }
+
+}
@@ -0,0 +1,79 @@
+#ifndef _ALIGNMENT_PREFETCHER_H
+#define _ALIGNMENT_PREFETCHER_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "LeftAlign.h"
+
+using namespace std;
+
+// Decodes alignments from a BAM reader on a separate thread, so that
+// decompression and record decoding overlap with calling.
+//
+// Decoded alignments are handed to the consumer in batches through a bounded
+// single-producer, single-consumer queue.  Reads which the parser would
+// always discard (duplicates, unless they are being used, reads below the
+// minimum mapping quality, and reads outside of the region being decoded)
+// are dropped on the decoding thread.  Ordering of the remaining alignments
+// is unchanged.
+//
+// The reader must not be touched by the caller while decoding is running;
+// call stop() before seeking the reader (e.g. SetRegion) and start() after.
+
+class AlignmentPrefetcher {
+
+public:
+
+    AlignmentPrefetcher(BAMREADER& r,
+                        int bufferedAlignments,
+                        int minMappingQuality,
+                        bool useDuplicateReads);
+    ~AlignmentPrefetcher(void);
+
+    // begin decoding from the current position of the reader
+    // if refid >= 0, alignments which do not overlap refid:[left, right] are dropped
+    void start(int refid = -1, long int left = 0, long int right = 0);
+    // halt decoding and discard any buffered alignments
+    void stop(void);
+    bool running(void) { return decoding; }
+
+    // fetch the next alignment, returns false when the reader is exhausted
+    bool getNext(BAMALIGN& alignment);
+
+    // tallies of reads dropped on the decoding thread
+    long unsigned int filteredDuplicates;
+    long unsigned int filteredMappingQuality;
+    long unsigned int filteredOutsideRegion;
+
+private:
+
+    void decode(void);
+
+    BAMREADER& reader;
+    int minMappingQuality;
+    bool useDuplicateReads;
+    int regionRefID;
+    long int regionLeft;
+    long int regionRight;
+
+    // batches are moved across the queue whole to amortize locking
+    int batchSize;
+    int maxBatches;
+    deque<vector<BAMALIGN> > batches;
+    vector<BAMALIGN> current;  // batch being consumed
+    int currentIndex;
+
+    mutex queueMutex;
+    condition_variable batchReady;  // signalled by the decoder
+    condition_variable batchTaken;  // signalled by the consumer
+    bool finished;  // decoder reached the end of the reader
+    bool stopping;  // consumer requested a halt
+    bool decoding;  // decoding thread is live
+    thread decoder;
+
+};
+
+#endif
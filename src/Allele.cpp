@@ -12,7 +12,7 @@ int Allele::referenceOffset(void) const {
 
 void Allele::setQuality(void) {
     quality = currentQuality();
-    lnquality = phred2ln(quality);
+    lnquality = phred2lnTabulated(quality);
 }
 
 int Allele::bpLeft(void) {
@@ -52,8 +52,8 @@ const int Allele::subquality(int startpos, int len) const {
 }
 
 // quality of subsequence of allele
-const long double Allele::lnsubquality(int startpos, int len) const {
-    return phred2ln(subquality(startpos, len));
+const Real Allele::lnsubquality(int startpos, int len) const {
+    return phred2lnTabulated(subquality(startpos, len));
 }
 
 const int Allele::subquality(const Allele &a) const {
@@ -126,8 +126,8 @@ const int Allele::subquality(const Allele &a) const {
     return sum * (l / L);
 }
 
-const long double Allele::lnsubquality(const Allele& a) const {
-    return phred2ln(subquality(a));
+const Real Allele::lnsubquality(const Allele& a) const {
+    return phred2lnTabulated(subquality(a));
 }
 
 void updateAllelesCachedData(vector<Allele*>& alleles) {
@@ -183,8 +183,8 @@ const short Allele::currentQuality(void) const {
     return 0;
 }
 
-const long double Allele::lncurrentQuality(void) const {
-    return phred2ln(currentQuality());
+const Real Allele::lncurrentQuality(void) const {
+    return phred2lnTabulated(currentQuality());
 }
 
 string Allele::typeStr(void) const {
@@ -395,6 +395,14 @@ ostream &operator<<(ostream &out, vector<Allele> &alleles) {
     return out;
 }
 
+ostream &operator<<(ostream &out, AlignmentAlleles &alleles) {
+    AlignmentAlleles::iterator a = alleles.begin();
+    out << *a++;
+    while (a != alleles.end())
+        out << "|" << *a++;
+    return out;
+}
+
 ostream &operator<<(ostream &out, list<Allele*> &alleles) {
     list<Allele*>::iterator a = alleles.begin();
     out << **a++;
@@ -980,7 +988,7 @@ baseCount(vector<Allele*>& alleles, string refbase, string altbase) {
 
 string Allele::readSeq(void) {
     string r;
-    for (vector<Allele>::iterator a = alignmentAlleles->begin(); a != alignmentAlleles->end(); ++a) {
+    for (AlignmentAlleles::iterator a = alignmentAlleles->begin(); a != alignmentAlleles->end(); ++a) {
         r.append(a->alternateSequence);
     }
     return r;
@@ -988,7 +996,7 @@ string Allele::readSeq(void) {
 
 string Allele::read5p(void) {
     string r;
-    vector<Allele>::const_reverse_iterator a = alignmentAlleles->rbegin();
+    AlignmentAlleles::const_reverse_iterator a = alignmentAlleles->rbegin();
     while (&*a != this) {
         ++a;
     }
@@ -1003,7 +1011,7 @@ string Allele::read5p(void) {
 
 string Allele::read3p(void) {
     string r = alternateSequence;
-    vector<Allele>::const_iterator a = alignmentAlleles->begin();
+    AlignmentAlleles::const_iterator a = alignmentAlleles->begin();
     while (&*a != this) {
         ++a;
     }
@@ -1017,7 +1025,7 @@ string Allele::read3p(void) {
 
 string Allele::read5pNonNull(void) {
     string r = alternateSequence;
-    vector<Allele>::const_reverse_iterator a = alignmentAlleles->rbegin();
+    AlignmentAlleles::const_reverse_iterator a = alignmentAlleles->rbegin();
     while (&*a != this) {
         ++a;
     }
@@ -1032,7 +1040,7 @@ string Allele::read5pNonNull(void) {
 
 string Allele::read3pNonNull(void) {
     string r = alternateSequence;
-    vector<Allele>::const_iterator a = alignmentAlleles->begin();
+    AlignmentAlleles::const_iterator a = alignmentAlleles->begin();
     while (&*a != this) {
         ++a;
     }
@@ -1047,7 +1055,7 @@ string Allele::read3pNonNull(void) {
 
 int Allele::read5pNonNullBases(void) {
     int bp = 0;
-    vector<Allele>::const_reverse_iterator a = alignmentAlleles->rbegin();
+    AlignmentAlleles::const_reverse_iterator a = alignmentAlleles->rbegin();
     while (&*a != this) {
         ++a;
     }
@@ -1063,7 +1071,7 @@ int Allele::read5pNonNullBases(void) {
 
 int Allele::read3pNonNullBases(void) {
     int bp = 0;
-    vector<Allele>::const_iterator a = alignmentAlleles->begin();
+    AlignmentAlleles::const_iterator a = alignmentAlleles->begin();
     while (&*a != this) {
         ++a;
     }
@@ -1457,7 +1465,7 @@ void Allele::mergeAllele(const Allele& newAllele, AlleleType newType) {
     baseQualities.insert(baseQualities.end(), newAllele.baseQualities.begin(), newAllele.baseQualities.end());
     currentBase = base();
     quality = averageQuality(baseQualities);
-    lnquality = phred2ln(quality);
+    lnquality = phred2lnTabulated(quality);
     basesRight += newAllele.referenceLength;
     if (newAllele.type != ALLELE_REFERENCE) {
         repeatRightBoundary = newAllele.repeatRightBoundary;
@@ -12,6 +12,8 @@
 #include <sstream>
 #include <assert.h>
 #include "Utility.h"
+#include "QualityBatch.h"
+#include "WindowArena.h"
 #include "convert.h"
 
 //#ifdef HAVE_BAMTOOLS
@@ -23,36 +25,8 @@ using namespace std;
 
 class Allele;
 
-// Allele recycling allocator
-// without we spend 30% of our runtime deleting Allele instances
-
-class AlleleFreeList {
-
-public:
-    AlleleFreeList()
-        : _p(NULL)
-        , _size(0)
-        , _allocs(0)
-        , _min_size(0)
-        , _max_size(0)
-        , _tick_allocs(1000000)  // attempt realloc every million allocs
-    { }
-
-    ~AlleleFreeList();
-    void Purge();
-    void Resize(int new_size);
-    void* NewAllele();
-    void Recycle(void* mem);
-
-private:
-    Allele* _p;
-    int _size;    // number of alleles on list
-    int _allocs;  // allocation counter
-    int _min_size; // min size within some previous number of calls to new
-    int _max_size;
-    int _tick_allocs; // GC cycle length
-
-};
+// the alleles decomposed from one read, held in the parser's window arena
+typedef vector<Allele, WindowAllocator<Allele> > AlignmentAlleles;
 
 
 // a structure describing an allele
@@ -80,8 +54,6 @@ typedef long int Position;
 
 class Allele {
 
-    friend class AlleleFreeList;
-
     friend string stringForAllele(const Allele &a);
     friend string stringForAlleles(vector<Allele> &av);
 
@@ -90,6 +62,7 @@ class Allele {
     friend bool operator!=(const Allele &a, const Allele &b);
 
     friend ostream &operator<<(ostream &out, vector<Allele> &a);
+    friend ostream &operator<<(ostream &out, AlignmentAlleles &a);
     friend ostream &operator<<(ostream &out, vector<Allele*> &a);
     friend ostream &operator<<(ostream &out, list<Allele*> &a);
 
@@ -122,11 +95,11 @@ public:
     string readGroupID;     // read group membership
     string readID;          // id of the read which the allele is drawn from
     vector<short> baseQualities;
-    long double quality;          // base quality score associated with this allele, updated every position in the case of reference alleles
-    long double lnquality;  // log version of above
+    QualityReal quality;   // base quality score associated with this allele, updated every position in the case of reference alleles
+    QualityReal lnquality;  // log version of above
     string currentBase;       // current base, meant to be updated every position
     short mapQuality;       // map quality for the originating read
-    long double lnmapQuality;       // map quality for the originating read
+    QualityReal lnmapQuality;       // map quality for the originating read
     double readMismatchRate; // per-base mismatch rate for the read
     double readIndelRate;  // only considering gaps
     double readSNPRate;    // only considering snps/mnps
@@ -136,7 +109,7 @@ public:
     bool genotypeAllele;    // if this is an abstract 'genotype' allele
     bool processed; // flag to mark if we've presented this allele for analysis
     string cigar; // a cigar representation of the allele
-    vector<Allele>* alignmentAlleles;
+    AlignmentAlleles* alignmentAlleles;
     long int alignmentStart;
     long int alignmentEnd;
 
@@ -156,14 +129,14 @@ public:
            string& readgroupid,
            string& sqtech,
            bool strnd, 
-           long double qual,
+           Real qual,
            string qstr, 
            short mapqual,
            bool ispair,
            bool ismm,
            bool isproppair,
            string cigarstr,
-           vector<Allele>* ra,
+           AlignmentAlleles* ra,
            long int bas,
            long int bae)
         : type(t)
@@ -183,9 +156,9 @@ public:
         , sequencingTechnology(sqtech)
         , strand(strnd ? STRAND_FORWARD : STRAND_REVERSE)
         , quality((qual == -1) ? averageQuality(qstr) : qual) // passing -1 as quality triggers this calculation
-        , lnquality(phred2ln((qual == -1) ? averageQuality(qstr) : qual))
+        , lnquality(phred2lnTabulated(quality))
         , mapQuality(mapqual) 
-        , lnmapQuality(phred2ln(mapqual))
+        , lnmapQuality(phred2lnTabulated(mapqual))
         , isProperPair(isproppair)
         , isPaired(ispair)
         , isMateMapped(ismm)
@@ -201,7 +174,7 @@ public:
     {
 
         baseQualities.resize(qstr.size()); // cache qualities
-        transform(qstr.begin(), qstr.end(), baseQualities.begin(), qualityChar2ShortInt);
+        qualityDecode(qstr.data(), qstr.size(), baseQualities.data());
         referenceLength = referenceLengthFromCigar();
 
     }
@@ -247,11 +220,11 @@ public:
     bool isNull(void) const; // true if type == ALLELE_NULL
     int referenceOffset(void) const;
     const short currentQuality(void) const;  // for getting the quality of a given position in multi-bp alleles
-    const long double lncurrentQuality(void) const;
+    const Real lncurrentQuality(void) const;
     const int subquality(int startpos, int len) const;
-    const long double lnsubquality(int startpos, int len) const;
+    const Real lnsubquality(int startpos, int len) const;
     const int subquality(const Allele &a) const;
-    const long double lnsubquality(const Allele &a) const;
+    const Real lnsubquality(const Allele &a) const;
     //const int basesLeft(void) const; // returns the bases left within the read of the current position within the allele
     //const int basesRight(void) const; // returns the bases right within the read of the current position within the allele
     bool sameSample(Allele &other);  // if the other allele has the same sample as this one
@@ -391,6 +364,4 @@ bool isUnflankedIndel(const Allele& allele);
 
 int referenceLengthFromCigar(string& cigar);
 
-//AlleleFreeList Allele::_freeList;
-
 #endif
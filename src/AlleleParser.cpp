@@ -1,9 +1,12 @@
 #include "AlleleParser.h"
+#include "ObservationFile.h"
 #include "multichoose.h" // includes generic functions, so it must be included here
                          // otherwise we will get a linker error
                          // see: http://stackoverflow.com/questions/36039/templates-spread-across-multiple-files
                          // http://www.cplusplus.com/doc/tutorial/templates/ "Templates and Multi-file projects"
 #include "multipermute.h"
+#include <sys/stat.h>
+#include <unistd.h>
 
 // local helper debugging macros to improve code readability
 #define DEBUG(msg) \
@@ -86,12 +89,32 @@ void AlleleParser::openBams(void) {
     }
 
 #else 
+    // bound the number of alignment files we hold open, leaving some headroom
+    // for the reference, index, VCF and output files
+    int openFileLimit = parameters.maxOpenFiles;
+    if (openFileLimit == 0) {
+        struct rlimit limit;
+        if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY) {
+            openFileLimit = max(1, (int) limit.rlim_cur - 64);
+        }
+    }
+    bamMultiReader.SetOpenFileLimit(openFileLimit);
+    if (openFileLimit > 0) {
+        DEBUG("holding at most " << openFileLimit << " alignment files open, using ~"
+              << BGZF_DECODE_BUFFER_BYTES / 1024 << "KiB of decode buffers per open file");
+    }
+
     if (parameters.useStdin) {
         if (!bamMultiReader.Open("-")) {
             ERROR("Could not read BAM data from stdin");
             exit(1);
         }
     } else {
+      BamHeaderCache* headerCache = NULL;
+      if (!parameters.headerCacheFile.empty()) {
+          headerCache = new BamHeaderCache(parameters.headerCacheFile);
+          bamMultiReader.SetHeaderCache(headerCache);
+      }
       for (std::vector<std::string>::const_iterator i = parameters.bams.begin();
            i != parameters.bams.end(); ++i) 
         if (!bamMultiReader.Open(*i)) {
@@ -112,6 +135,15 @@ void AlleleParser::openBams(void) {
                 }
 		}*/
         }
+      if (headerCache) {
+          DEBUG("BAM header cache " << parameters.headerCacheFile << ": " << headerCache->hits
+                << " hits, " << headerCache->misses << " misses");
+          if (!headerCache->save()) {
+              WARNING("could not write BAM header cache " << parameters.headerCacheFile);
+          }
+          bamMultiReader.SetHeaderCache(NULL);
+          delete headerCache;
+      }
         /*if (!bamMultiReader.SetExplicitMergeOrder(bamMultiReader.MergeByCoordinate)) {
             ERROR("could not set sort order to coordinate");
             cerr << bamMultiReader.GetErrorString() << endl;
@@ -147,16 +179,45 @@ void AlleleParser::openBams(void) {
 }
 
 void AlleleParser::openOutputFile(void) {
-    if (parameters.outputFile != "") {
-        outputFile.open(parameters.outputFile.c_str(), ios::out);
-        DEBUG("Opening output file: " << parameters.outputFile << " ...");
-        if (!outputFile) {
-            ERROR(" unable to open output file: " << parameters.outputFile);
+    if (parameters.outputFile == "") {
+        output = &cout;
+        return;
+    }
+    // written bgzip-compressed if named as such
+    const string& path = parameters.outputFile;
+    bgzipOutput = path.size() > 3 && path.compare(path.size() - 3, 3, ".gz") == 0;
+    long long appendAt = -1;
+    if (resuming) {
+        // drop whatever was written after the checkpoint, and append from
+        // there; compressed output is cut at the block the checkpoint ended
+        appendAt = resumeFrom.outputOffset;
+        if (bgzipOutput) {
+            if (!bgzfBlockAligned(appendAt)) {
+                ERROR("checkpoint " << parameters.checkpointFile << " does not record the end of a BGZF block");
+                exit(1);
+            }
+            appendAt = bgzfBlockAddress(appendAt);
+        }
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0
+            || info.st_size < appendAt
+            || truncate(path.c_str(), appendAt) != 0) {
+            ERROR("output file " << path << " is missing or shorter than when checkpoint "
+                  << parameters.checkpointFile << " was written");
             exit(1);
         }
-        output = &outputFile;
+    }
+    DEBUG("Opening output file: " << path << " ...");
+    if (bgzipOutput) {
+        bgzfOutputFile.open(path, appendAt);
+        output = &bgzfOutputFile;
     } else {
-        output = &cout;
+        outputFile.open(path.c_str(), resuming ? ios::out | ios::app : ios::out);
+        output = &outputFile;
+    }
+    if (!*output) {
+        ERROR(" unable to open output file: " << path);
+        exit(1);
     }
 }
 
@@ -641,22 +702,30 @@ bool AlleleParser::hasMoreInputVariants(void) {
     return next.first != -1;
 }
 
-bool AlleleParser::loadNextPositionWithAlignmentOrInputVariant(BAMALIGN& alignment) {
+bool AlleleParser::loadNextPositionWithAlignmentOrInputVariant(void) {
 
+    int refid = nextAlignmentRefID();
+    long int position = nextAlignmentPosition();
     pair<int, long> next = nextInputVariantPosition();
     if (next.first != -1) {
         int varRefID = next.first;
-        if (!hasMoreAlignments || varRefID < alignment.REFID || (varRefID == alignment.REFID && next.second < alignment.POSITION)) {
+        if (!hasMoreAlignments || varRefID < refid || (varRefID == refid && next.second < position)) {
 	  return loadNextPositionWithInputVariant();
-        } else {
-	  loadReferenceSequence(alignment);
         }
-    } else {
-      loadReferenceSequence(alignment);
     }
+    loadReferenceSequence(referenceIDToName[refid]);
+    currentPosition = position;
     return true;
 }
 
+int AlleleParser::nextAlignmentRefID(void) {
+    return observationInput ? observationInput->refid() : currentAlignment.REFID;
+}
+
+long int AlleleParser::nextAlignmentPosition(void) {
+    return observationInput ? observationInput->start() : currentAlignment.POSITION;
+}
+
 bool AlleleParser::loadNextPositionWithInputVariant(void) {
   pair<int, long> next = nextInputVariantPosition();
   if (next.first != -1) {
@@ -679,6 +748,10 @@ void AlleleParser::loadReferenceSequence(BAMALIGN& alignment) {
 void AlleleParser::loadReferenceSequence(string& seqname) {
     if (currentSequenceName != seqname) {
         currentSequenceName = seqname;
+        // the phases running as we cross onto the sequence are charged to it
+        if (profiler.enabled) {
+            profiler.setContig(currentSequenceName);
+        }
         currentSequenceStart = 0;
         currentRefID = bamMultiReader.GETREFID(currentSequenceName);
         currentSequence = uppercase(reference.getRawSequence(currentSequenceName));
@@ -796,6 +869,7 @@ void AlleleParser::loadTargets(void) {
     }
 
     bedReader.buildIntervals(); // set up interval tree in the bedreader
+    targetCursor.build(targets);
 
     DEBUG("Number of target regions: " << targets.size());
 
@@ -816,6 +890,95 @@ void AlleleParser::loadTargetsFromBams(void) {
     }
 }
 
+void AlleleParser::loadCheckpoint(void) {
+    if (parameters.checkpointFile.empty()) {
+        if (parameters.resume) {
+            ERROR("--resume needs the --checkpoint file to resume from");
+            exit(1);
+        }
+        return;
+    }
+    if (parameters.outputFile.empty()) {
+        ERROR("--checkpoint needs the output written to a file with --vcf");
+        exit(1);
+    }
+    if (parameters.useStdin) {
+        ERROR("--checkpoint can't be used when reading alignments from stdin");
+        exit(1);
+    }
+    if (!parameters.observationsOutput.empty() || !parameters.observationsInput.empty()) {
+        ERROR("--checkpoint can't be used with --dump-observations or --from-observations");
+        exit(1);
+    }
+    // without a checkpoint yet, this is the first run
+    if (!parameters.resume || !resumeFrom.read(parameters.checkpointFile)) {
+        return;
+    }
+    if (resumeFrom.commandline != checkpointCommandLine(parameters.commandline)) {
+        ERROR("checkpoint " << parameters.checkpointFile << " was written by a run with other arguments:" << endl
+              << resumeFrom.commandline);
+        exit(1);
+    }
+    resuming = true;
+}
+
+// starts the run again at the checkpoint
+void AlleleParser::resumeTargets(void) {
+    if (targets.empty()) {
+        // seek to the checkpoint, then read the following sequences in turn
+        int refid = 0;
+        while (refid < (int) referenceSequences.size()
+               && referenceSequences[refid].REFNAME != resumeFrom.sequence) {
+            ++refid;
+        }
+        if (refid == (int) referenceSequences.size()) {
+            ERROR("sequence " << resumeFrom.sequence << " in checkpoint " << parameters.checkpointFile
+                  << " is not in the input BAM files");
+            exit(1);
+        }
+        if (!setAlignmentRegion(refid, resumeFrom.position, referenceSequences[refid].REFLEN - 1)) {
+            exit(1);
+        }
+        for (int i = refid + 1; i < (int) referenceSequences.size(); ++i) {
+            resumeSequences.push_back(i);
+        }
+        resumePosition = resumeFrom.position;
+    } else {
+        int t = resumeFrom.target;
+        if (t < 0 || t >= (int) targets.size()
+            || targets[t].seq != resumeFrom.sequence
+            || resumeFrom.position < targets[t].left
+            || resumeFrom.position > targets[t].right) {
+            ERROR("checkpoint " << parameters.checkpointFile << " does not match the targets");
+            exit(1);
+        }
+        targets.erase(targets.begin(), targets.begin() + t);
+        targets.front().left = resumeFrom.position;
+        skippedTargets = t;
+    }
+    DEBUG("resuming from " << resumeFrom.sequence << ":" << resumeFrom.position + 1);
+}
+
+bool AlleleParser::writeCheckpoint(NonCalls& nonCalls) {
+    if (!registeredAlignments.empty() || currentSequenceName.empty()) {
+        return false;
+    }
+    output->flush();
+    Checkpoint checkpoint;
+    checkpoint.outputOffset = bgzipOutput ? bgzfOutputFile.flushBlock() : (long long) outputFile.tellp();
+    checkpoint.commandline = checkpointCommandLine(parameters.commandline);
+    checkpoint.sequence = currentSequenceName;
+    checkpoint.position = currentPosition;
+    checkpoint.target = targets.empty() ? -1 : skippedTargets + (currentTarget - &targets.front());
+    checkpoint.nonCalls = nonCalls;
+    if (!*output || !checkpoint.write(parameters.checkpointFile)) {
+        WARNING("could not write checkpoint " << parameters.checkpointFile);
+    } else {
+        DEBUG("wrote checkpoint at " << currentSequenceName << ":" << currentPosition + 1);
+    }
+    return true;
+}
+
 void AlleleParser::loadSampleCNVMap(void) {
     // set default ploidy
     sampleCNV.setDefaultPloidy(parameters.ploidy);
@@ -841,7 +1004,21 @@ void AlleleParser::loadSampleCNVMap(void) {
 }
 
 int AlleleParser::currentSamplePloidy(string const& sample) {
-    return sampleCNV.ploidy(sample, currentSequenceName, currentPosition);
+    if (currentSequenceName != ploidyCacheSequence
+        || currentPosition < ploidyCacheStart
+        || (ploidyCacheEnd != -1 && currentPosition >= ploidyCacheEnd)) {
+        ploidyCacheSequence = currentSequenceName;
+        ploidyCacheStart = currentPosition;
+        ploidyCacheEnd = sampleCNV.nextBreakpoint(currentSequenceName, currentPosition);
+        cachedSamplePloidies.clear();
+    }
+    map<string, int>::iterator p = cachedSamplePloidies.find(sample);
+    if (p != cachedSamplePloidies.end()) {
+        return p->second;
+    }
+    int ploidy = sampleCNV.ploidy(sample, currentSequenceName, currentPosition);
+    cachedSamplePloidies[sample] = ploidy;
+    return ploidy;
 }
 
 int AlleleParser::copiesOfLocus(Samples& samples) {
@@ -873,13 +1050,7 @@ bool AlleleParser::inTarget(void) {
     if (targets.empty()) {
         return true;  // everything is in target if we don't have targets
     } else {
-        // expects 0-based, fully-closed, and we're only checking a single
-        // base, so start == end.
-        if (bedReader.targetsOverlap(currentSequenceName, currentPosition, currentPosition)) {
-            return true;
-        } else {
-            return false;
-        }
+        return targetCursor.contains(currentSequenceName, currentPosition);
     }
 }
 
@@ -903,17 +1074,61 @@ AlleleParser::AlleleParser(int argc, char** argv) : parameters(Parameters(argc,
     rightmostInputAllelePosition = 0;
     nullSample = new Sample();
     referenceSampleName = "reference_sample";
+    alignmentPrefetcher = NULL;
+    observationOutput = NULL;
+    observationInput = NULL;
+    resuming = false;
+    bgzipOutput = false;
+    resumePosition = -1;
+    skippedTargets = 0;
+    ploidyCacheStart = 0;
+    ploidyCacheEnd = 0;
 
     // initialization
+    loadCheckpoint();
     openOutputFile();
 
     loadFastaReference();
     // when we open the bam files we can use the number of targets to decide if
     // we should load the indexes
     openBams();
+    if (parameters.readAhead > 0 && parameters.observationsInput.empty()) {
+        alignmentPrefetcher = new AlignmentPrefetcher(bamMultiReader,
+                                                      parameters.readAhead,
+                                                      parameters.MQL0,
+                                                      parameters.useDuplicateReads);
+    }
     loadBamReferenceSequenceNames();
+    if (!parameters.observationsInput.empty() || !parameters.observationsOutput.empty()) {
+        vector<pair<string, long int> > sequences;
+        for (REFVEC::iterator r = referenceSequences.begin(); r != referenceSequences.end(); ++r) {
+            sequences.push_back(make_pair(r->REFNAME, (long int) r->REFLEN));
+        }
+        if (!parameters.observationsInput.empty()) {
+            observationInput = new ObservationReader;
+            if (!observationInput->open(parameters.observationsInput)) {
+                ERROR("could not open observation file " << parameters.observationsInput);
+                exit(1);
+            }
+            if (!observationInput->checkSequences(sequences)) {
+                ERROR("observation file " << parameters.observationsInput
+                      << " was written against other reference sequences than the input BAM files");
+                exit(1);
+            }
+        }
+        if (!parameters.observationsOutput.empty()) {
+            observationOutput = new ObservationWriter;
+            if (!observationOutput->open(parameters.observationsOutput, sequences)) {
+                ERROR("could not open observation file " << parameters.observationsOutput << " for writing");
+                exit(1);
+            }
+        }
+    }
     // check how many targets we have specified
     loadTargets();
+    if (resuming) {
+        resumeTargets();
+    }
     getSampleNames();
     getPopulations();
     getSequencingTechnologies();
@@ -921,6 +1136,13 @@ AlleleParser::AlleleParser(int argc, char** argv) : parameters(Parameters(argc,
     // sample CNV
     loadSampleCNVMap();
 
+    downsampler.defaultCap = parameters.maxCoverage;
+    if (!parameters.sampleMaxCoverageFile.empty()
+        && !downsampler.loadSampleCaps(parameters.sampleMaxCoverageFile)) {
+        ERROR("could not load per-sample coverage limits from " << parameters.sampleMaxCoverageFile);
+        exit(1);
+    }
+
     // output
     setupVCFOutput();
 
@@ -936,6 +1158,24 @@ AlleleParser::~AlleleParser(void) {
 
     delete nullSample;
 
+    // stops the decoding thread
+    if (alignmentPrefetcher) delete alignmentPrefetcher;
+
+    if (observationOutput) {
+        if (!observationOutput->close()) {
+            ERROR("could not write observation file " << parameters.observationsOutput);
+            exit(1);
+        }
+        delete observationOutput;
+    }
+    if (observationInput) delete observationInput;
+
+    // ends the compressed output with the BGZF end-of-file marker
+    if (bgzipOutput && !bgzfOutputFile.close()) {
+        ERROR("could not write output file " << parameters.outputFile);
+        exit(1);
+    }
+
     // close trace file?  seems to get closed properly on object deletion...
     if (currentReferenceAllele) delete currentReferenceAllele;
 
@@ -1063,7 +1303,7 @@ void RegisteredAlignment::clumpAlleles(bool mergeComplex, int maxComplexGap, boo
             newAlleles.push_back(alleles[i]);
         }
     }
-    alleles = newAlleles;
+    alleles.assign(newAlleles.begin(), newAlleles.end());
     newAlleles.clear();
     alleles.erase(remove_if(alleles.begin(), alleles.end(), isEmptyAllele), alleles.end());
     // maintain flanking bases
@@ -1185,7 +1425,7 @@ Allele AlleleParser::makeAllele(RegisteredAlignment& ra,
                                 string& sampleName,
                                 BAMALIGN& alignment,
                                 string& sequencingTech,
-                                long double qual,
+                                Real qual,
                                 string& qualstr
     ) {
 
@@ -1322,7 +1562,7 @@ Allele AlleleParser::makeAllele(RegisteredAlignment& ra,
                   ra.readgroup,
                   sequencingTech,
                   !alignment.ISREVERSESTRAND,
-                  max(qual, (long double) 0), // ensure qual is at least 0
+                  max(qual, (Real) 0), // ensure qual is at least 0
                   qualstr,
                   alignment.MAPPINGQUALITY,
                   alignment.ISPAIRED,
@@ -1335,8 +1575,109 @@ Allele AlleleParser::makeAllele(RegisteredAlignment& ra,
 
 }
 
+// Applies the per-read mismatch, snp and indel limits before we pay for allele
+// construction in registerAlignment.  The counting mirrors registerAlignment:
+// mismatches (and snps) are aligned bases which differ from the reference, or
+// which are aligned to an N, with quality >= BQL2; every I or D op is one indel.
+// We walk the cigar and the read directly, without copying the sequence,
+// qualities or cigar, and bail out as soon as any limit is exceeded.
+// Returns false (and tallies the responsible filter) if the read should be dropped.
+// Also estimates how many alleles the read will yield, one per cigar op and
+// two more per differing base, so their storage is sized once.
+bool AlleleParser::passesReadMismatchFilters(BAMALIGN& alignment, int& alleleEstimate) {
+
+    int readLength = alignment.SEQLEN;
+
+    int mismatches = 0;
+    int differences = 0;  // mismatches of any quality
+    int indels = 0;
+    int rp = 0;  // read position
+    int csp = currentSequencePosition(alignment);  // position in currentSequence
+    int refLength = currentSequence.size();
+    bool checkBases = true;  // cleared if we run off the cached reference
+
+#ifdef HAVE_BAMTOOLS
+    const string& rDna = alignment.QueryBases;
+    const string& rQual = alignment.Qualities;
+    const vector<CigarOp>& cigar = alignment.CigarData;
+    int cigarLength = cigar.size();
+#else
+    const bam1_t* b = alignment.raw();
+    const uint32_t* cigar = bam_get_cigar(b);
+    const uint8_t* rDna = bam_get_seq(b);
+    const uint8_t* rQual = bam_get_qual(b);
+    int cigarLength = b->core.n_cigar;
+#endif
+
+    for (int c = 0; c < cigarLength; ++c) {
+#ifdef HAVE_BAMTOOLS
+        char t = cigar[c].Type;
+        int l = cigar[c].Length;
+#else
+        char t = bam_cigar_opchr(cigar[c]);
+        int l = bam_cigar_oplen(cigar[c]);
+#endif
+        if (t == 'M' || t == 'X' || t == '=') {
+            if (checkBases && (csp < 0 || csp + l > refLength || rp + l > readLength)) {
+                checkBases = false;
+            }
+            if (checkBases) {
+                for (int i = 0; i < l; ++i) {
+#ifdef HAVE_BAMTOOLS
+                    char base = rDna[rp + i];
+                    int qual = qualityChar2ShortInt(rQual[rp + i]);
+#else
+                    char base = seq_nt16_str[bam_seqi(rDna, rp + i)];
+                    int qual = (rQual[rp + i] == 0xff) ? 0 : rQual[rp + i];
+#endif
+                    char sb = currentSequence[csp + i];
+                    if (base != sb || sb == 'N') {
+                        ++differences;
+                        if (qual >= parameters.BQL2) {
+                            ++mismatches;
+                        }
+                    }
+                }
+            }
+            rp += l;
+            csp += l;
+        } else if (t == 'D') {
+            ++indels;
+            csp += l;
+        } else if (t == 'I') {
+            ++indels;
+            rp += l;
+        } else if (t == 'S') {
+            rp += l;
+        } else if (t == 'N') {
+            csp += l;
+        }
+
+        // every count is monotonic, so we can stop at the first limit exceeded
+        if (((float) mismatches / (float) readLength) > parameters.readMaxMismatchFraction) {
+            ++readFilterCounts.mismatchFraction;
+            return false;
+        } else if (mismatches > parameters.RMU) {
+            ++readFilterCounts.mismatchCount;
+            return false;
+        } else if (mismatches > parameters.readSnpLimit) {
+            ++readFilterCounts.snpCount;
+            return false;
+        } else if (indels > parameters.readIndelLimit) {
+            ++readFilterCounts.indelCount;
+            return false;
+        }
+    }
+
+    alleleEstimate = cigarLength + 2 * differences;
+    return true;
+
+}
+
 RegisteredAlignment& AlleleParser::registerAlignment(BAMALIGN& alignment, RegisteredAlignment& ra, string& sampleName, string& sequencingTech) {
 
+    ProfileTimer timer(PROFILE_REGISTER_ALIGNMENT);
+
     string rDna = alignment.QUERYBASES;
     string rQual = alignment.QUALITIES;
     int rp = 0;  // read position, 0-based relative to read
@@ -1447,7 +1788,7 @@ RegisteredAlignment& AlleleParser::registerAlignment(BAMALIGN& alignment, Regist
                 }
 
                 // convert base quality value into short int
-                long double qual = qualityChar2LongDouble(rQual.at(rp));
+                Real qual = qualityChar2LongDouble(rQual.at(rp));
 
                 // get reference allele
                 string sb;
@@ -1511,7 +1852,7 @@ RegisteredAlignment& AlleleParser::registerAlignment(BAMALIGN& alignment, Regist
                     string readSequence = rDna.substr(rp - length, length);
                     string qualstr = rQual.substr(rp - length, length);
                     for (int j = 0; j < length; ++j) {
-                        long double lqual = qualityChar2LongDouble(qualstr.at(j));
+                        Real lqual = qualityChar2LongDouble(qualstr.at(j));
                         string qualp = qualstr.substr(j, 1);
                         string rs = readSequence.substr(j, 1);
                         if (allATGC(rs)) {
@@ -1561,7 +1902,7 @@ RegisteredAlignment& AlleleParser::registerAlignment(BAMALIGN& alignment, Regist
                 string readSequence = rDna.substr(rp - length, length);
                 string qualstr = rQual.substr(rp - length, length);
                 for (int j = 0; j < length; ++j) {
-                    long double lqual = qualityChar2LongDouble(qualstr.at(j));
+                    Real lqual = qualityChar2LongDouble(qualstr.at(j));
                     string qualp = qualstr.substr(j, 1);
                     string rs = readSequence.substr(j, 1);
                     if (allATGC(rs)) {
@@ -1652,7 +1993,7 @@ RegisteredAlignment& AlleleParser::registerAlignment(BAMALIGN& alignment, Regist
 
             string qualstr = rQual.substr(spanstart, L);
 
-            long double qual;
+            Real qual;
             if (parameters.useMinIndelQuality) {
                 qual = minQuality(qualstr);
                 //qual = averageQuality(qualstr);
@@ -1665,8 +2006,8 @@ RegisteredAlignment& AlleleParser::registerAlignment(BAMALIGN& alignment, Regist
                 // the quality string X a scaling constant derived from the ratio
                 // between the length of the quality string and the length of the
                 // allele
-                //qual += ln2phred(log((long double) l / (long double) L));
-                qual += ln2phred(log((long double) L / (long double) l));
+                //qual += ln2phred(log((Real) l / (Real) L));
+                qual += ln2phred(log((Real) L / (Real) l));
                 qual /= harmonicSum(l);
             }
 
@@ -1727,7 +2068,7 @@ RegisteredAlignment& AlleleParser::registerAlignment(BAMALIGN& alignment, Regist
 
             string qualstr = rQual.substr(spanstart, L);
 
-            long double qual;
+            Real qual;
             if (parameters.useMinIndelQuality) {
                 qual = minQuality(qualstr);
                 //qual = averageQuality(qualstr); // does not work as well as the min
@@ -1740,8 +2081,8 @@ RegisteredAlignment& AlleleParser::registerAlignment(BAMALIGN& alignment, Regist
                 // the quality string X a scaling constant derived from the ratio
                 // between the length of the quality string and the length of the
                 // allele
-                //qual += ln2phred(log((long double) l / (long double) L));
-                qual += ln2phred(log((long double) L / (long double) l));
+                //qual += ln2phred(log((Real) l / (Real) L));
+                qual += ln2phred(log((Real) L / (Real) l));
                 qual /= harmonicSum(l);
             }
 
@@ -1840,7 +2181,7 @@ RegisteredAlignment& AlleleParser::registerAlignment(BAMALIGN& alignment, Regist
     double indelCount = 0;
 
     // tally mismatches in two categories, gaps and mismatched bases
-    for (vector<Allele>::iterator a = ra.alleles.begin(); a != ra.alleles.end(); ++a) {
+    for (AlignmentAlleles::iterator a = ra.alleles.begin(); a != ra.alleles.end(); ++a) {
         Allele& allele = *a;
         switch (allele.type) {
         case ALLELE_REFERENCE:
@@ -1869,7 +2210,7 @@ RegisteredAlignment& AlleleParser::registerAlignment(BAMALIGN& alignment, Regist
     // store mismatch information about the alignment in the alleles
     // for each allele, normalize the mismatch rates by ignoring that allele,
     // this allows us to relate the mismatch rate without reference to called alleles
-    for (vector<Allele>::iterator a = ra.alleles.begin(); a != ra.alleles.end(); ++a) {
+    for (AlignmentAlleles::iterator a = ra.alleles.begin(); a != ra.alleles.end(); ++a) {
         Allele& allele = *a;
         allele.readMismatchRate = mismatchRate;
         allele.readSNPRate = snpRate;
@@ -1920,7 +2261,7 @@ RegisteredAlignment& AlleleParser::registerAlignment(BAMALIGN& alignment, Regist
 
     /*
       cerr << "ra.alleles.size() = " << ra.alleles.size() << endl;
-      for (vector<Allele>::iterator a = ra.alleles.begin(); a != ra.alleles.end(); ++a) {
+      for (AlignmentAlleles::iterator a = ra.alleles.begin(); a != ra.alleles.end(); ++a) {
       cerr << *a << endl;
       }
     */
@@ -1934,6 +2275,8 @@ void AlleleParser::updateAlignmentQueue(long int position,
                                         vector<Allele*>& newAlleles,
                                         bool gettingPartials) {
 
+    ProfileTimer timer(PROFILE_UPDATE_ALIGNMENT_QUEUE);
+
     DEBUG2("updating alignment queue");
     DEBUG2("currentPosition = " << position
            << "; currentSequenceStart = " << currentSequenceStart
@@ -1952,9 +2295,31 @@ void AlleleParser::updateAlignmentQueue(long int position,
            << " .. + currentSequence.size() == " << currentSequenceStart + currentSequence.size()
         );
 
+    // replaying --from-observations, the alignments are already filtered and
+    // decomposed into alleles
+    if (observationInput) {
+        while (hasMoreAlignments
+               && observationInput->start() <= position
+               && observationInput->refid() == currentRefID) {
+            deque<RegisteredAlignment>& rq = registeredAlignments[observationInput->end()];
+            rq.push_front(RegisteredAlignment(&alignmentArena, observationInput->end()));
+            RegisteredAlignment& ra = rq.front();
+            observationInput->read(ra, &currentPosition, &currentReferenceBase);
+            for (AlignmentAlleles::iterator allele = ra.alleles.begin(); allele != ra.alleles.end(); ++allele) {
+                newAlleles.push_back(&*allele);
+            }
+            hasMoreAlignments = observationInput->peek();
+        }
+        DEBUG2("... finished pushing new alignments");
+        return;
+    }
+
     if (hasMoreAlignments
         && currentAlignment.POSITION <= position
         && currentAlignment.REFID == currentRefID) {
+        if (downsampler.active()) {
+            downsampler.start(position);
+        }
         do {
             DEBUG2("top of alignment parsing loop");
             DEBUG("alignment: " << currentAlignment.QNAME);
@@ -2029,57 +2394,108 @@ void AlleleParser::updateAlignmentQueue(long int position,
 
             // initially skip reads with low mapping quality (what happens if MapQuality is not in the file)
             if (currentAlignment.MAPPINGQUALITY >= parameters.MQL0) {
-                // extend our cached reference sequence to allow processing of this alignment
-                //extendReferenceSequence(currentAlignment);
-                // left realign indels
-                if (parameters.leftAlignIndels) {
-                    int length = currentAlignment.ENDPOSITION - currentAlignment.POSITION + 1;
-                    stablyLeftAlign(currentAlignment,
-                                    currentSequence.substr(currentSequencePosition(currentAlignment), length));
-                }
-                // get sample name
-                string sampleName = readGroupToSampleNames[readGroup];
-                string sequencingTech;
-                map<string, string>::iterator t = readGroupToTechnology.find(readGroup);
-                if (t != readGroupToTechnology.end()) {
-                    sequencingTech = t->second;
-                }
-                // limit base quality if cap set
-                if (parameters.baseQualityCap != 0) {
-                    capBaseQuality(currentAlignment, parameters.baseQualityCap);
-                }
-                // decomposes alignment into a set of alleles
-                // here we get the deque of alignments ending at this alignment's end position
-                deque<RegisteredAlignment>& rq = registeredAlignments[currentAlignment.ENDPOSITION];
-
-                // and insert the registered alignment into that deque
-                rq.push_front(RegisteredAlignment(currentAlignment, parameters));
-                RegisteredAlignment& ra = rq.front();
-                registerAlignment(currentAlignment, ra, sampleName, sequencingTech);
-                // backtracking if we have too many mismatches
-                // or if there are no recorded alleles
-                if (ra.alleles.empty()
-                    || ((float) ra.mismatches / (float) currentAlignment.SEQLEN) > parameters.readMaxMismatchFraction
-                    || ra.mismatches > parameters.RMU
-                    || ra.snpCount > parameters.readSnpLimit
-                    || ra.indelCount > parameters.readIndelLimit) {
-                    rq.pop_front(); // backtrack
+                // with --max-coverage, reads are held until we know which to keep,
+                // those failing the mismatch and gap limits never taking a slot
+                int alleleEstimate;
+                if (!prepareAlignment(currentAlignment, alleleEstimate)) {
+                    continue;
+                } else if (downsampler.active()) {
+                    downsampler.offer(readGroupToSampleNames[readGroup], readGroup, alleleEstimate, currentAlignment);
                 } else {
-                    // push the alleles into our new alleles vector
-                    for (vector<Allele>::iterator allele = ra.alleles.begin(); allele != ra.alleles.end(); ++allele) {
-                        newAlleles.push_back(&*allele);
-                    }
+                    registerFilteredAlignment(currentAlignment, readGroup, alleleEstimate, newAlleles);
                 }
 	      }
-	    } while ((hasMoreAlignments = GETNEXT(bamMultiReader, currentAlignment))
+	    } while ((hasMoreAlignments = getNextAlignment(currentAlignment))
                  && currentAlignment.POSITION <= position
                  && currentAlignment.REFID == currentRefID);
+
+        if (downsampler.active()) {
+            vector<Downsampler::Candidate> kept;
+            downsampler.take(kept);
+            for (vector<Downsampler::Candidate>::iterator k = kept.begin(); k != kept.end(); ++k) {
+                if (registerFilteredAlignment(k->alignment, k->readGroup, k->alleleEstimate, newAlleles)) {
+                    downsampler.registered(k->sample, k->alignment.ENDPOSITION);
+                }
+            }
+        }
     }
 
     DEBUG2("... finished pushing new alignments");
 
 }
 
+// left realigns and caps the qualities of an alignment which passed the read
+// filters; false if it fails the mismatch and gap limits
+bool AlleleParser::prepareAlignment(BAMALIGN& alignment, int& alleleEstimate) {
+    // extend our cached reference sequence to allow processing of this alignment
+    //extendReferenceSequence(alignment);
+    // left realign indels
+    if (parameters.leftAlignIndels) {
+        int length = alignment.ENDPOSITION - alignment.POSITION + 1;
+        int csp = currentSequencePosition(alignment);
+        if (csp >= 0 && csp <= (int) currentSequence.size()) {
+            stablyLeftAlign(alignment,
+                            currentSequence.data() + csp,
+                            min(length, (int) currentSequence.size() - csp),
+                            leftAlignWorkspace);
+        }
+    }
+    // limit base quality if cap set
+    if (parameters.baseQualityCap != 0) {
+        capBaseQuality(alignment, parameters.baseQualityCap);
+    }
+    // drop reads which would fail the mismatch and gap limits
+    // before we construct their alleles
+    if (!passesReadMismatchFilters(alignment, alleleEstimate)) {
+        DEBUG("skipping alignment " << alignment.QNAME << " because it exceeds the read mismatch or gap limits");
+        return false;
+    }
+    return true;
+}
+
+// registers a prepared alignment, decomposing it into alleles; false if it
+// has no alleles
+bool AlleleParser::registerFilteredAlignment(BAMALIGN& alignment, const string& readGroup, int alleleEstimate, vector<Allele*>& newAlleles) {
+    // get sample name
+    string sampleName = readGroupToSampleNames[readGroup];
+    string sequencingTech;
+    map<string, string>::iterator t = readGroupToTechnology.find(readGroup);
+    if (t != readGroupToTechnology.end()) {
+        sequencingTech = t->second;
+    }
+    // decomposes alignment into a set of alleles
+    // here we get the deque of alignments ending at this alignment's end position
+    deque<RegisteredAlignment>& rq = registeredAlignments[alignment.ENDPOSITION];
+
+    // and insert the registered alignment into that deque
+    rq.push_front(RegisteredAlignment(alignment, &alignmentArena));
+    RegisteredAlignment& ra = rq.front();
+    ra.alleles.reserve(alleleEstimate);
+    registerAlignment(alignment, ra, sampleName, sequencingTech);
+    // backtracking if there are no recorded alleles
+    // (the mismatch and gap limits are applied by passesReadMismatchFilters,
+    // but we keep them here as a guard against the two counts diverging)
+    if (ra.alleles.empty()
+        || ((float) ra.mismatches / (float) alignment.SEQLEN) > parameters.readMaxMismatchFraction
+        || ra.mismatches > parameters.RMU
+        || ra.snpCount > parameters.readSnpLimit
+        || ra.indelCount > parameters.readIndelLimit) {
+        if (ra.alleles.empty()) {
+            ++readFilterCounts.noAlleles;
+        }
+        rq.pop_front(); // backtrack
+        return false;
+    }
+    if (observationOutput) {
+        observationOutput->write(ra);
+    }
+    // push the alleles into our new alleles vector
+    for (AlignmentAlleles::iterator allele = ra.alleles.begin(); allele != ra.alleles.end(); ++allele) {
+        newAlleles.push_back(&*allele);
+    }
+    return true;
+}
+
 void AlleleParser::addToRegisteredAlleles(vector<Allele*>& alleles) {
     registeredAlleles.insert(registeredAlleles.end(),
                              alleles.begin(),
@@ -2399,7 +2815,7 @@ void AlleleParser::addCurrentGenotypeLikelihoods(map<int, vector<Genotype> >& ge
     // check if there are any genotype likelihoods at the current position
     if (inputGenotypeLikelihoods.find(currentPosition) != inputGenotypeLikelihoods.end()) {
 
-        map<string, map<string, long double> >& inputLikelihoodsBySample = inputGenotypeLikelihoods[currentPosition];
+        map<string, map<string, Real> >& inputLikelihoodsBySample = inputGenotypeLikelihoods[currentPosition];
 
         vector<Genotype*> genotypePtrs;
         for (map<int, vector<Genotype> >::iterator gp = genotypesByPloidy.begin(); gp != genotypesByPloidy.end(); ++gp) {
@@ -2409,14 +2825,14 @@ void AlleleParser::addCurrentGenotypeLikelihoods(map<int, vector<Genotype> >& ge
             }
         }
         // if there are, add them to the sample data likelihoods
-        for (map<string, map<string, long double> >::iterator gls = inputLikelihoodsBySample.begin();
+        for (map<string, map<string, Real> >::iterator gls = inputLikelihoodsBySample.begin();
                 gls != inputLikelihoodsBySample.end(); ++gls) {
             const string& sampleName = gls->first;
-            map<string, long double>& likelihoods = gls->second;
-            map<Genotype*, long double> likelihoodsPtr;
-            for (map<string, long double>::iterator gl = likelihoods.begin(); gl != likelihoods.end(); ++gl) {
+            map<string, Real>& likelihoods = gls->second;
+            map<Genotype*, Real> likelihoodsPtr;
+            for (map<string, Real>::iterator gl = likelihoods.begin(); gl != likelihoods.end(); ++gl) {
                 const string& genotype = gl->first;
-                long double l = gl->second;
+                Real l = gl->second;
                 for (vector<Genotype*>::iterator g = genotypePtrs.begin(); g != genotypePtrs.end(); ++g) {
                     if (convert(**g) == genotype) {
                         likelihoodsPtr[*g] = l;
@@ -2428,7 +2844,7 @@ void AlleleParser::addCurrentGenotypeLikelihoods(map<int, vector<Genotype> >& ge
             sampleData.name = sampleName;
             // TODO add null sample object to sampleData
             // do you need to????
-            for (map<Genotype*, long double>::iterator p = likelihoodsPtr.begin(); p != likelihoodsPtr.end(); ++p) {
+            for (map<Genotype*, Real>::iterator p = likelihoodsPtr.begin(); p != likelihoodsPtr.end(); ++p) {
                 sampleData.push_back(SampleDataLikelihood(sampleName, nullSample, p->first, p->second, 0));
             }
             sortSampleDataLikelihoods(sampleData);
@@ -2557,20 +2973,30 @@ bool AlleleParser::toNextTarget(void) {
     if (!parameters.useStdin && !targets.empty()) {
 
         bool ok = false;
+        bool empty = false; // currentTarget was loaded and had no alignments
 
         // try to load the first target if we need to
         if (!currentTarget) {
             ok = loadTarget(&targets.front()) && getFirstAlignment();
+            empty = !ok;
         }
 
         // step through targets until we get to one with alignments
         while (!ok && currentTarget != &targets.back()) {
-            if (!loadTarget(++currentTarget)) {
+            if (empty) {
+                // the last target is still loaded, for any input variants it holds
+                currentTarget = min(nextTargetWithAlignments(currentTarget), &targets.back());
+            } else {
+                ++currentTarget;
+            }
+            empty = false;
+            if (!loadTarget(currentTarget)) {
                 continue;
             }
             if ((ok = getFirstAlignment())) {
                 break;
             }
+            empty = true;
         }
 
         if (!ok) {
@@ -2589,7 +3015,14 @@ bool AlleleParser::toNextTarget(void) {
             ERROR("Could not get first alignment from target");
             return false;
         }
-        loadNextPositionWithAlignmentOrInputVariant(currentAlignment);
+        loadNextPositionWithAlignmentOrInputVariant();
+        // a resumed run restarts at the checkpoint, which may precede the first alignment
+        if (resumePosition != -1) {
+            if (currentSequenceName == resumeFrom.sequence && currentPosition > resumePosition) {
+                currentPosition = resumePosition;
+            }
+            resumePosition = -1;
+        }
         //loadReferenceSequence(currentAlignment); // this seeds us with new reference sequence
         // however, if we have a target list of variants and we should also respect them
     // we've reached the end of file, or stdin
@@ -2626,18 +3059,18 @@ bool AlleleParser::loadTarget(BedTarget* target) {
     currentPosition = currentTarget->left;
     rightmostHaplotypeBasisAllelePosition = currentTarget->left;
 
-#ifdef HAVE_BAMTOOLS
-    if (!bamMultiReader.SetRegion(currentRefID, currentTarget->left, currentRefID, currentTarget->right + 1)) { // bamtools expects 0-based, half-open
-        ERROR("Could not SetRegion to " << currentTarget->seq << ":" << currentTarget->left << ".." << currentTarget->right + 1);
-        cerr << bamMultiReader.GetErrorString() << endl;
-        return false;
+    if (observationOutput && !observationOutput->startRegion(currentRefID, currentTarget->left)) {
+        ERROR("--dump-observations needs targets sorted by position within each sequence, "
+              << currentTarget->seq << ":" << currentTarget->left << ".." << currentTarget->right + 1
+              << " is out of order");
+        exit(1);
     }
-#else
-    if (!bamMultiReader.SetRegion(SeqLib::GenomicRegion(currentRefID, currentTarget->left, currentTarget->right + 1))) { // bamtools expects 0-based, half-open
-        ERROR("Could not SetRegion to " << currentTarget->seq << ":" << currentTarget->left << ".." << currentTarget->right + 1);
+
+    if (observationInput) {
+        observationInput->setRegion(currentRefID, currentTarget->left, currentTarget->right);
+    } else if (!setAlignmentRegion(currentRefID, currentTarget->left, currentTarget->right)) {
         return false;
     }
-#endif
 
     if (variantCallInputFile.is_open()) {
         stringstream r;
@@ -2665,14 +3098,139 @@ bool AlleleParser::loadTarget(BedTarget* target) {
 
 }
 
+// Called when the target has no alignments, returns the next target that might.
+// One region query from the end of the target to the end of its sequence
+// finds the next mapped alignment, and the following targets which end
+// before it are skipped without seeking to each.
+BedTarget* AlleleParser::nextTargetWithAlignments(BedTarget* empty) {
+
+    BedTarget* next = empty + 1;
+    if (next > &targets.back() || next->seq != empty->seq || next->left <= empty->right
+        || observationInput) {
+        return next;
+    }
+
+    if (alignmentPrefetcher) {
+        alignmentPrefetcher->stop();
+    }
+
+    long int probeStart = empty->right + 1;
+    int refid = bamMultiReader.GETREFID(empty->seq);
+    long int sequenceLength = reference.sequenceLength(empty->seq);
+#ifdef HAVE_BAMTOOLS
+    if (!bamMultiReader.SetRegion(refid, probeStart, refid, sequenceLength)) {
+        return next;
+    }
+#else
+    if (!bamMultiReader.SetRegion(SeqLib::GenomicRegion(refid, probeStart, sequenceLength))) {
+        return next;
+    }
+#endif
+
+    BAMALIGN alignment;
+    bool found = false;
+    while (GETNEXT(bamMultiReader, alignment)) {
+        if (alignment.ISMAPPED) {
+            found = true;
+            break;
+        }
+    }
+    if (!found) {
+        checkAlignmentReader();
+    }
+
+    while (next <= &targets.back()
+           && next->seq == empty->seq
+           && next->left >= probeStart
+           && (!found || next->right < alignment.POSITION)) {
+        DEBUG("skipping target " << next->seq << ":" << next->left << ".." << next->right + 1
+              << " which has no alignments");
+        ++next;
+    }
+
+    return next;
+
+}
+
+bool AlleleParser::setAlignmentRegion(int refid, long int left, long int right) {
+
+    // the decoding thread owns the reader while it runs
+    if (alignmentPrefetcher) {
+        alignmentPrefetcher->stop();
+    }
+
+#ifdef HAVE_BAMTOOLS
+    if (!bamMultiReader.SetRegion(refid, left, refid, right + 1)) { // bamtools expects 0-based, half-open
+        ERROR("Could not SetRegion to " << referenceIDToName[refid] << ":" << left << ".." << right + 1);
+        cerr << bamMultiReader.GetErrorString() << endl;
+        return false;
+    }
+#else
+    if (!bamMultiReader.SetRegion(SeqLib::GenomicRegion(refid, left, right + 1))) { // bamtools expects 0-based, half-open
+        ERROR("Could not SetRegion to " << referenceIDToName[refid] << ":" << left << ".." << right + 1);
+        return false;
+    }
+    DEBUG("alignment decode buffers: " << bamMultiReader.bufferedBytes() << " bytes in "
+          << bamMultiReader.openFiles << " open files, "
+          << bamMultiReader.heldBytes() << " bytes of them in alignments held for the merge");
+#endif
+
+    if (alignmentPrefetcher) {
+        alignmentPrefetcher->start(refid, left, right);
+    }
+
+    return true;
+
+}
+
+void AlleleParser::checkAlignmentReader(void) {
+#ifndef HAVE_BAMTOOLS
+    // the merge stops on a file it can't open or seek in
+    if (!bamMultiReader.GetErrorString().empty()) {
+        ERROR(bamMultiReader.GetErrorString());
+        exit(1);
+    }
+#endif
+}
+
+// reads the next alignment, from the decoding thread if one is in use
+bool AlleleParser::getNextAlignment(BAMALIGN& alignment) {
+    ProfileTimer timer(PROFILE_READ_DECODE);
+    while (true) {
+        bool found;
+        if (alignmentPrefetcher) {
+            if (!alignmentPrefetcher->running()) {
+                alignmentPrefetcher->start();
+            }
+            found = alignmentPrefetcher->getNext(alignment);
+        } else {
+            found = GETNEXT(bamMultiReader, alignment);
+        }
+        if (!found) {
+            checkAlignmentReader();
+        }
+        if (found || resumeSequences.empty()) {
+            return found;
+        }
+        // a resumed run without targets reads the rest of the sequences in turn
+        int refid = resumeSequences.front();
+        resumeSequences.pop_front();
+        if (!setAlignmentRegion(refid, 0, referenceSequences[refid].REFLEN - 1)) {
+            exit(1);
+        }
+    }
+}
+
 bool AlleleParser::getFirstAlignment(void) {
 
     bool hasAlignments = true;
-    if (!GETNEXT(bamMultiReader, currentAlignment)) {
+    if (observationInput) {
+        hasAlignments = observationInput->peek();
+    } else if (!getNextAlignment(currentAlignment)) {
       hasAlignments = false;
     } else {
       while (!currentAlignment.ISMAPPED) {
-	if (!GETNEXT(bamMultiReader, currentAlignment)) { 
+	if (!getNextAlignment(currentAlignment)) { 
 	  hasAlignments = false;
 	  break;
 	}
@@ -2719,6 +3277,8 @@ void AlleleParser::clearRegisteredAlignments(void) {
     DEBUG2("clearing registered alignments and alleles");
     registeredAlignments.clear();
     registeredAlleles.clear();
+    alignmentArena.clear();
+    downsampler.clear();
 }
 
 // TODO
@@ -2759,8 +3319,8 @@ bool AlleleParser::toNextPosition(void) {
     if (parameters.useStdin || targets.empty()) {
         // here we loop over unaligned reads at the beginning of a target
         // we need to get to a mapped read to figure out where we are
-        while (hasMoreAlignments && !currentAlignment.ISMAPPED) {
-            hasMoreAlignments = GETNEXT(bamMultiReader, currentAlignment);
+        while (hasMoreAlignments && !observationInput && !currentAlignment.ISMAPPED) {
+            hasMoreAlignments = getNextAlignment(currentAlignment);
         }
         // determine if we have more alignments or not
         if (!hasMoreAlignments) {
@@ -2786,10 +3346,10 @@ bool AlleleParser::toNextPosition(void) {
             // if the current position of this alignment is outside of the reference sequence length
             // we need to switch references
             if (currentPosition >= reference.sequenceLength(currentSequenceName)
-                || (registeredAlignments.empty() && currentRefID != currentAlignment.REFID)) {
+                || (registeredAlignments.empty() && currentRefID != nextAlignmentRefID())) {
                 DEBUG("at end of sequence");
                 clearRegisteredAlignments();
-                loadNextPositionWithAlignmentOrInputVariant(currentAlignment);
+                loadNextPositionWithAlignmentOrInputVariant();
                 justSwitchedTargets = true;
             }
         }
@@ -2844,7 +3404,7 @@ bool AlleleParser::toNextPosition(void) {
     while (f != registeredAlignments.end()
            && f->first < currentPosition - lastHaplotypeLength) {
         for (deque<RegisteredAlignment>::iterator d = f->second.begin(); d != f->second.end(); ++d) {
-            for (vector<Allele>::iterator a = d->alleles.begin(); a != d->alleles.end(); ++a) {
+            for (AlignmentAlleles::iterator a = d->alleles.begin(); a != d->alleles.end(); ++a) {
                 allelesToErase.insert(&*a);
             }
         }
@@ -2860,6 +3420,7 @@ bool AlleleParser::toNextPosition(void) {
     for (set<long unsigned int>::iterator p = positionsToErase.begin(); p != positionsToErase.end(); ++p) {
         registeredAlignments.erase(*p);
     }
+    alignmentArena.release(currentPosition - lastHaplotypeLength);
 
     // and do the same for the variants from the input VCF
     DEBUG2("erasing old input variant alleles");
@@ -2899,7 +3460,7 @@ bool AlleleParser::dummyProcessNextTarget(void) {
         return false;
     }
 
-    while (GETNEXT(bamMultiReader, currentAlignment)) { }
+    while (getNextAlignment(currentAlignment)) { }
 
     return true;
 }
@@ -2954,11 +3515,15 @@ bool RegisteredAlignment::fitHaplotype(int haplotypeStart, int haplotypeLength,
     */
 
     // save and bail out if we can't construct a haplotype allele
-    vector<Allele> savedAlleles = alleles;
+    // (partial fits are kept, so only save when we might restore)
+    vector<Allele> savedAlleles;
+    if (!allowPartials) {
+        savedAlleles.assign(alleles.begin(), alleles.end());
+    }
 
     if ((allowPartials && (start <= haplotypeEnd || end >= haplotypeStart))
         || (start <= haplotypeStart && end >= haplotypeEnd)) {
-        vector<Allele>::iterator a = alleles.begin();
+        AlignmentAlleles::iterator a = alleles.begin();
         //cerr << "trying to find overlapping haplotype alleles for the range " << haplotypeStart << " to " << haplotypeEnd << endl;
         //cerr << alleles << endl;
         while (a+1 != alleles.end()) {
@@ -2970,7 +3535,7 @@ bool RegisteredAlignment::fitHaplotype(int haplotypeStart, int haplotypeLength,
         if (!(a->position <= haplotypeStart && a->position + a->referenceLength > haplotypeStart)) {
             return false;
         }
-        vector<Allele>::iterator b = alleles.begin();
+        AlignmentAlleles::iterator b = alleles.begin();
         while (b + 1 != alleles.end()) {
             if (b->position < haplotypeEnd && b->position + b->referenceLength >= haplotypeEnd) {
                 break;
@@ -2983,7 +3548,7 @@ bool RegisteredAlignment::fitHaplotype(int haplotypeStart, int haplotypeLength,
 
         // do not attempt to build haplotype alleles where there are non-contiguous reads
         /*
-        for (vector<Allele>::iterator p = alleles.begin(); p != alleles.end(); ++p) {
+        for (AlignmentAlleles::iterator p = alleles.begin(); p != alleles.end(); ++p) {
             if (p != alleles.begin()) {
                 if (p->position != (p - 1)->position + (p - 1)->referenceLength) {
                     cerr << "non-contiguous reads, cannot construct haplotype allele" << endl;
@@ -3009,7 +3574,7 @@ bool RegisteredAlignment::fitHaplotype(int haplotypeStart, int haplotypeLength,
         //cerr << "block end overlaps: " << *b << endl;
         //cerr << "haplotype start: " << haplotypeStart << endl;
 
-        for (vector<Allele>::iterator p = a; p != (b+1); ++p) {
+        for (AlignmentAlleles::iterator p = a; p != (b+1); ++p) {
             if (p->isNull()) return false; // can't assemble across NULL alleles
         }
 
@@ -3044,7 +3609,7 @@ bool RegisteredAlignment::fitHaplotype(int haplotypeStart, int haplotypeLength,
         // now, for everything between a and b, merge them into one allele
         while (a != b) {
             vector<pair<int, string> > cigarV = splitCigar(a->cigar);
-            vector<Allele>::iterator p = a + 1;
+            AlignmentAlleles::iterator p = a + 1;
             // update the quality of the merged allele in the same way as we do
             // for complex events
             if (!a->isReference() && !a->isNull())  {
@@ -3071,7 +3636,7 @@ bool RegisteredAlignment::fitHaplotype(int haplotypeStart, int haplotypeLength,
         //cerr << "registered alignment alleles, after haplotype construction," << endl << alleles << endl;
         bool hasHaplotypeAllele = false;
         bool dividedIndel = false;
-        for (vector<Allele>::iterator p = alleles.begin(); p != alleles.end(); ++p) {
+        for (AlignmentAlleles::iterator p = alleles.begin(); p != alleles.end(); ++p) {
             // fix the "base"
             if (!p->isReference()) {
                 p->update(haplotypeLength);
@@ -3094,7 +3659,7 @@ bool RegisteredAlignment::fitHaplotype(int haplotypeStart, int haplotypeLength,
             return true;
         } else {
             if (!allowPartials) {
-                alleles = savedAlleles; // reset alleles
+                alleles.assign(savedAlleles.begin(), savedAlleles.end()); // reset alleles
             }
             //cerr << "registered alignment alleles after (fail)," << endl << alleles << endl;
             return false;
@@ -3117,6 +3682,7 @@ void AlleleParser::buildHaplotypeAlleles(
     map<Allele*, set<Allele*> >& partialObservationSupport,
     int allowedAlleleTypes) {
 
+    ProfileTimer timer(PROFILE_HAPLOTYPE_ALLELES);
     int haplotypeLength = 1;
     for (vector<Allele>::iterator a = alleles.begin(); a != alleles.end(); ++a) {
         Allele& allele = *a;
@@ -3152,28 +3718,67 @@ void AlleleParser::buildHaplotypeAlleles(
         // boundary of the repeat.  We build the haplotype to the
         // maximal boundary indicated by the present alleles.
 
+        // The alignments which start or end inside the window are fit to it.
+        // The window only grows, so we find them once, ordered by end (the
+        // order of registeredAlignments) and by start, and on each pass pick
+        // up only those the growth has brought in.  Every one found so far is
+        // refit to the longer window, as its haplotype allele changes with it.
+        vector<RegisteredAlignment*> candidates;
+        long int maxAlignmentEnd = registeredAlignments.rbegin()->first;
+        for (map<long unsigned int, deque<RegisteredAlignment> >::iterator ras = registeredAlignments.upper_bound(currentPosition);
+             ras != registeredAlignments.end() && (long int) ras->first < maxAlignmentEnd; ++ras) {
+            for (deque<RegisteredAlignment>::iterator r = ras->second.begin(); r != ras->second.end(); ++r) {
+                candidates.push_back(&*r);
+            }
+        }
+        vector<pair<long int, int> > candidatesByStart;
+        for (int i = 0; i < candidates.size(); ++i) {
+            if (candidates[i]->start > currentPosition) {
+                candidatesByStart.push_back(make_pair((long int) candidates[i]->start, i));
+            }
+        }
+        sort(candidatesByStart.begin(), candidatesByStart.end());
+        vector<bool> overlapping(candidates.size(), false);
+        vector<int> overlappingCandidates;  // in the order of candidates
+        int nextByEnd = 0;
+        int nextByStart = 0;
+
         int oldHaplotypeLength = haplotypeLength;
         do {
             oldHaplotypeLength = haplotypeLength;
+            profiler.countHaplotypeIteration();
+
+            long int windowEnd = currentPosition + haplotypeLength;
+            size_t previouslyOverlapping = overlappingCandidates.size();
+            for (; nextByEnd < candidates.size() && (long int) candidates[nextByEnd]->end < windowEnd; ++nextByEnd) {
+                if (!overlapping[nextByEnd]) {
+                    overlapping[nextByEnd] = true;
+                    overlappingCandidates.push_back(nextByEnd);
+                }
+            }
+            for (; nextByStart < candidatesByStart.size() && candidatesByStart[nextByStart].first < windowEnd; ++nextByStart) {
+                int i = candidatesByStart[nextByStart].second;
+                if (!overlapping[i]) {
+                    overlapping[i] = true;
+                    overlappingCandidates.push_back(i);
+                }
+            }
+            sort(overlappingCandidates.begin() + previouslyOverlapping, overlappingCandidates.end());
+            inplace_merge(overlappingCandidates.begin(),
+                          overlappingCandidates.begin() + previouslyOverlapping,
+                          overlappingCandidates.end());
 
             // rebuild everything...
             registeredAlleles.clear();
             samples.clear();
 
-            long int maxAlignmentEnd = registeredAlignments.rbegin()->first;
-            for (long int i = currentPosition+1; i < maxAlignmentEnd; ++i) {
-                deque<RegisteredAlignment>& ras = registeredAlignments[i];
-                for (deque<RegisteredAlignment>::iterator r = ras.begin(); r != ras.end(); ++r) {
-                    RegisteredAlignment& ra = *r;
-                    if ((ra.start > currentPosition && ra.start < currentPosition + haplotypeLength)
-			 || (ra.end > currentPosition && ra.end < currentPosition + haplotypeLength)) {
-                        Allele* aptr;
-                        bool allowPartials = true;
-                        ra.fitHaplotype(currentPosition, haplotypeLength, aptr, allowPartials);
-                        for (vector<Allele>::iterator a = ra.alleles.begin(); a != ra.alleles.end(); ++a) {
-                            registeredAlleles.push_back(&*a);
-                        }
-                    }
+            for (vector<int>::iterator i = overlappingCandidates.begin(); i != overlappingCandidates.end(); ++i) {
+                RegisteredAlignment& ra = *candidates[*i];
+                Allele* aptr;
+                bool allowPartials = true;
+                ra.fitHaplotype(currentPosition, haplotypeLength, aptr, allowPartials);
+                for (AlignmentAlleles::iterator a = ra.alleles.begin(); a != ra.alleles.end(); ++a) {
+                    registeredAlleles.push_back(&*a);
                 }
             }
 
@@ -3437,7 +4042,7 @@ void AlleleParser::buildHaplotypeAlleles(
             deque<RegisteredAlignment>& rq = ras->second;
             for (deque<RegisteredAlignment>::iterator rai = rq.begin(); rai != rq.end(); ++rai) {
                 RegisteredAlignment& ra = *rai;
-                for (vector<Allele>::iterator a = ra.alleles.begin(); a != ra.alleles.end(); ++a) {
+                for (AlignmentAlleles::iterator a = ra.alleles.begin(); a != ra.alleles.end(); ++a) {
                     registeredAlleles.push_back(&*a);
                 }
             }
@@ -3454,9 +4059,6 @@ void AlleleParser::buildHaplotypeAlleles(
 
     }
 
-    // hack......... TODO unhack this and set in Sample class
-    samples.setSupportedAlleles();
-
     // processed flag..
     //unsetAllProcessedFlags();
 
@@ -3479,7 +4081,7 @@ void AlleleParser::getCompleteObservationsOfHaplotype(Samples& samples, int hapl
             //cerr << ra.start << " <= " << currentPosition << " && " << ra.end << " >= " << currentPosition + haplotypeLength << endl;
             if (ra.start <= currentPosition && ra.end >= currentPosition + haplotypeLength) {
                 if (ra.fitHaplotype(currentPosition, haplotypeLength, aptr)) {
-                    for (vector<Allele>::iterator a = ra.alleles.begin(); a != ra.alleles.end(); ++a) {
+                    for (AlignmentAlleles::iterator a = ra.alleles.begin(); a != ra.alleles.end(); ++a) {
                         //cerr << a->position << " == " << currentPosition << " && " << a->referenceLength << " == " << haplotypeLength << endl;
                         if (a->position == currentPosition && a->referenceLength == haplotypeLength) {
                             haplotypeObservations.push_back(&*a);
@@ -3488,7 +4090,7 @@ void AlleleParser::getCompleteObservationsOfHaplotype(Samples& samples, int hapl
                 } /*else {
                     DEBUG("could not fit observation " << ra.name << " with alleles " << ra.alleles);
                     // the alleles have (possibly) been changed in fithaplotype, so add them to the registered alleles again
-                    for (vector<Allele>::iterator a = ra.alleles.begin(); a != ra.alleles.end(); ++a) {
+                    for (AlignmentAlleles::iterator a = ra.alleles.begin(); a != ra.alleles.end(); ++a) {
                         registeredAlleles.push_back(&*a);
                     }
                     }*/
@@ -3504,7 +4106,7 @@ void AlleleParser::unsetAllProcessedFlags(void) {
         for (deque<RegisteredAlignment>::iterator rai = rq.begin(); rai != rq.end(); ++rai) {
             RegisteredAlignment& ra = *rai;
             Allele* aptr;
-            for (vector<Allele>::iterator a = ra.alleles.begin(); a != ra.alleles.end(); ++a) {
+            for (AlignmentAlleles::iterator a = ra.alleles.begin(); a != ra.alleles.end(); ++a) {
                 a->processed = false; // re-trigger use of all alleles
             }
         }
@@ -3527,17 +4129,17 @@ void AlleleParser::getPartialObservationsOfHaplotype(Samples& samples, int haplo
     // now get the partial obs
     // get the max alignment end position, iterate to there
     long int maxAlignmentEnd = registeredAlignments.rbegin()->first;
-    for (long int i = currentPosition+1; i < maxAlignmentEnd; ++i) {
-        DEBUG("getting partial observations of haplotype @" << i);
-        deque<RegisteredAlignment>& ras = registeredAlignments[i];
-        for (deque<RegisteredAlignment>::iterator r = ras.begin(); r != ras.end(); ++r) {
+    for (map<long unsigned int, deque<RegisteredAlignment> >::iterator ras = registeredAlignments.upper_bound(currentPosition);
+         ras != registeredAlignments.end() && (long int) ras->first < maxAlignmentEnd; ++ras) {
+        DEBUG("getting partial observations of haplotype @" << ras->first);
+        for (deque<RegisteredAlignment>::iterator r = ras->second.begin(); r != ras->second.end(); ++r) {
             RegisteredAlignment& ra = *r;
             if ((ra.start > currentPosition && ra.start < currentPosition + haplotypeLength)
 		 || (ra.end > currentPosition && ra.end < currentPosition + haplotypeLength)) {
                 Allele* aptr;
                 bool allowPartials = true;
                 ra.fitHaplotype(currentPosition, haplotypeLength, aptr, allowPartials);
-                for (vector<Allele>::iterator a = ra.alleles.begin(); a != ra.alleles.end(); ++a) {
+                for (AlignmentAlleles::iterator a = ra.alleles.begin(); a != ra.alleles.end(); ++a) {
                     if (a->position >= currentPosition
                         && a->position < currentPosition+haplotypeLength
                         && !a->isNull()) {
@@ -3549,7 +4151,7 @@ void AlleleParser::getPartialObservationsOfHaplotype(Samples& samples, int haplo
                     }
                 }
             } else {
-                for (vector<Allele>::iterator a = ra.alleles.begin(); a != ra.alleles.end(); ++a) {
+                for (AlignmentAlleles::iterator a = ra.alleles.begin(); a != ra.alleles.end(); ++a) {
                     //a->processed = false;
                     otherObs.push_back(&*a);
                 }
@@ -3561,6 +4163,9 @@ void AlleleParser::getPartialObservationsOfHaplotype(Samples& samples, int haplo
 }
 
 bool AlleleParser::getNextAlleles(Samples& samples, int allowedAlleleTypes) {
+    ProfileTimer timer(PROFILE_GET_NEXT_ALLELES);
+    // partial support belongs to the haplotype alleles of the last site
+    samples.clearPartialObservations();
     long int nextPosition = currentPosition + lastHaplotypeLength;
     while (currentPosition < nextPosition) {
         if (!toNextPosition()) {
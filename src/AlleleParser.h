@@ -13,6 +13,7 @@
 #include <assert.h>
 #include <ctype.h>
 #include <cmath>
+#include <sys/resource.h>
 #include "split.h"
 #include "join.h"
 
@@ -28,6 +29,11 @@
 #include "CNV.h"
 #include "Result.h"
 #include "LeftAlign.h"
+#include "AlignmentPrefetcher.h"
+#include "Profiler.h"
+#include "Checkpoint.h"
+#include "BgzfOutput.h"
+#include "Downsampler.h"
 #include "Variant.h"
 #include "version_git.h"
 
@@ -40,6 +46,9 @@
 
 using namespace std;
 
+class ObservationWriter;
+class ObservationReader;
+
 // a structure holding information about our parameters
 
 // structure to encapsulate registered reads and alleles
@@ -52,28 +61,40 @@ public:
     int refid;
     string name;
     string readgroup;
-    vector<Allele> alleles;
+    AlignmentAlleles alleles;
     int mismatches;
     int snpCount;
     int indelCount;
     int alleleTypes;
-    Parameters parameters;
 
-    RegisteredAlignment(BAMALIGN& alignment, Parameters parameters)
+    // the alleles are allocated from arena, or the heap without one
+    RegisteredAlignment(BAMALIGN& alignment, WindowArena* arena = NULL)
         //: alignment(alignment)
         : start(alignment.POSITION)
         , end(alignment.ENDPOSITION)
         , refid(alignment.REFID)
         , name(alignment.QNAME)
+        , alleles(WindowAllocator<Allele>(arena, alignment.ENDPOSITION))
         , mismatches(0)
         , snpCount(0)
         , indelCount(0)
         , alleleTypes(0)
-        , parameters(parameters)
     {
       FILLREADGROUP(readgroup, alignment);
     }
 
+    // filled in by ObservationReader::read, for a read ending at e
+    RegisteredAlignment(WindowArena* arena = NULL, long int e = 0)
+        : start(0)
+        , end(0)
+        , refid(-1)
+        , alleles(WindowAllocator<Allele>(arena, e))
+        , mismatches(0)
+        , snpCount(0)
+        , indelCount(0)
+        , alleleTypes(0)
+    { }
+
     void addAllele(Allele allele, bool mergeComplex = true,
                    int maxComplexGap = 0, bool boundIndels = false);
     bool fitHaplotype(int pos, int haplotypeLength, Allele*& aptr, bool allowPartials = false);
@@ -123,6 +144,23 @@ bool operator<(const AllelicPrimitive& a, const AllelicPrimitive& b);
 
 void capBaseQuality(BAMALIGN& alignment, int baseQualityCap);
 
+// tallies of reads dropped by the per-read mismatch and gap filters
+class ReadFilterCounts {
+public:
+    long unsigned int mismatchFraction; // --read-max-mismatch-fraction
+    long unsigned int mismatchCount;    // --read-mismatch-limit
+    long unsigned int snpCount;         // --read-snp-limit
+    long unsigned int indelCount;       // --read-indel-limit
+    long unsigned int noAlleles;        // registered, but produced no alleles
+    ReadFilterCounts(void)
+        : mismatchFraction(0)
+        , mismatchCount(0)
+        , snpCount(0)
+        , indelCount(0)
+        , noAlleles(0)
+    { }
+};
+
 class AlleleParser {
 
 public:
@@ -142,6 +180,12 @@ public:
     vector<string> sequencingTechnologies;  // a list of the present technologies
 
     CNVMap sampleCNV;
+    // sample ploidies are constant between CNV breakpoints, so we keep them
+    // for the interval [ploidyCacheStart, ploidyCacheEnd) of the sequence
+    string ploidyCacheSequence;
+    long int ploidyCacheStart;
+    long int ploidyCacheEnd;  // -1 to the end of the sequence
+    map<string, int> cachedSamplePloidies;
 
     // reference
     FastaReference reference;
@@ -154,9 +198,36 @@ public:
     // returns true if we are within a target
     // useful for controlling output when we are reading from stdin
     bool inTarget(void);
+    TargetCursor targetCursor;
 
     // bamreader
     BAMREADER bamMultiReader;
+    // decodes from bamMultiReader on a separate thread, NULL if --read-ahead 0
+    AlignmentPrefetcher* alignmentPrefetcher;
+    bool getNextAlignment(BAMALIGN& alignment);
+
+    // --dump-observations and --from-observations, NULL if not used; when
+    // replaying, the BAM files are only read for their headers
+    ObservationWriter* observationOutput;
+    ObservationReader* observationInput;
+    // the refid and position of the next alignment, from either source
+    int nextAlignmentRefID(void);
+    long int nextAlignmentPosition(void);
+    // seeks the alignment input to refid:[left, right]
+    bool setAlignmentRegion(int refid, long int left, long int right);
+    // exits if reading alignments stopped on an error rather than their end
+    void checkAlignmentReader(void);
+
+    // --checkpoint and --resume
+    bool resuming;           // resumeFrom was loaded
+    Checkpoint resumeFrom;
+    long int resumePosition; // where a run without targets restarts, -1 once there
+    deque<int> resumeSequences;  // and the refids read after that sequence
+    int skippedTargets;      // targets before the checkpoint, dropped on resume
+    void loadCheckpoint(void);
+    void resumeTargets(void);
+    // false if alignments overlap the current position, so we can't resume from it
+    bool writeCheckpoint(NonCalls& nonCalls);
 
     // bed reader
     BedReader bedReader;
@@ -188,23 +259,25 @@ public:
 		      string& sampleName,
 		      BAMALIGN& alignment,
 		      string& sequencingTech,
-		      long double qual,
+		      Real qual,
 		      string& qualstr);
 
 
 
     vector<Allele*> registeredAlleles;
+    // holds the alleles of the registered alignments, so must outlive them
+    WindowArena alignmentArena;
     map<long unsigned int, deque<RegisteredAlignment> > registeredAlignments;
     map<int, map<long int, vector<Allele> > > inputVariantAlleles; // all variants present in the input VCF, as 'genotype' alleles
     pair<int, long int> nextInputVariantPosition(void);
     void getInputVariantsInRegion(string& seq, long start = 0, long end = 0);
     void getAllInputVariants(void);
     //  position         sample     genotype  likelihood
-    map<string, map<long int, map<string, map<string, long double> > > > inputGenotypeLikelihoods; // drawn from input VCF
+    map<string, map<long int, map<string, map<string, Real> > > > inputGenotypeLikelihoods; // drawn from input VCF
     map<string, map<long int, map<Allele, int> > > inputAlleleCounts; // drawn from input VCF
     Sample* nullSample;
 
-    bool loadNextPositionWithAlignmentOrInputVariant(BAMALIGN& currentAlignment);
+    bool loadNextPositionWithAlignmentOrInputVariant(void);
     bool loadNextPositionWithInputVariant(void);
     bool hasMoreInputVariants(void);
 
@@ -242,6 +315,14 @@ public:
     void loadTargetsFromBams(void);
     void initializeOutputFiles(void);
     RegisteredAlignment& registerAlignment(BAMALIGN& alignment, RegisteredAlignment& ra, string& sampleName, string& sequencingTech);
+    bool prepareAlignment(BAMALIGN& alignment, int& alleleEstimate);
+    bool registerFilteredAlignment(BAMALIGN& alignment, const string& readGroup, int alleleEstimate, vector<Allele*>& newAlleles);
+    // --max-coverage, applied as reads are registered
+    Downsampler downsampler;
+    // cheap pre-pass which applies the mismatch and gap limits without building alleles
+    bool passesReadMismatchFilters(BAMALIGN& alignment, int& alleleEstimate);
+    ReadFilterCounts readFilterCounts;
+    LeftAlignWorkspace leftAlignWorkspace;  // reused for every alignment
     void clearRegisteredAlignments(void);
     void updateAlignmentQueue(long int position, vector<Allele*>& newAlleles, bool gettingPartials = false);
     void updateInputVariants(long int pos, int referenceLength);
@@ -260,6 +341,7 @@ public:
     vector<BedTarget>* targetsInCurrentRefSeq(void);
     bool toNextRefID(void);
     bool loadTarget(BedTarget*);
+    BedTarget* nextTargetWithAlignments(BedTarget* empty);
     bool toFirstTargetPosition(void);
     bool toNextPosition(void);
     void getCompleteObservationsOfHaplotype(Samples& samples, int haplotypeLength, vector<Allele*>& haplotypeObservations);
@@ -320,6 +402,8 @@ public:
 
     // output files
     ofstream logFile, outputFile;
+    BgzfOutputFile bgzfOutputFile;  // used instead of outputFile for .gz
+    bool bgzipOutput;
     ostream* output;
 
     // utility
@@ -0,0 +1,159 @@
+#include "BamHeaderCache.h"
+#include <climits>
+#include <cstdlib>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/file.h>
+#include "split.h"
+#include "convert.h"
+
+
+static const char* cacheVersion = "# freebayes BAM header cache v2";
+
+// files modified this recently aren't cached
+static const long long racySeconds = 2;
+
+// the absolute path with links resolved, or the path as given if it can't be
+static string canonicalPath(const string& path) {
+    char resolved[PATH_MAX];
+    if (realpath(path.c_str(), resolved) == NULL) {
+        return path;
+    }
+    return resolved;
+}
+
+BamHeaderCache::BamHeaderCache(const string& file)
+    : cacheFile(file)
+    , hits(0)
+    , misses(0)
+{
+    if (!load(entries)) {
+        entries.clear();
+    }
+}
+
+bool BamHeaderCache::load(map<string, Entry>& loaded) {
+    ifstream in(cacheFile.c_str());
+    if (!in.is_open()) {
+        // no cache yet, it will be written by save()
+        return false;
+    }
+    string line;
+    if (!getline(in, line) || line != cacheVersion) {
+        // an older format, which is rewritten
+        return false;
+    }
+    while (getline(in, line)) {
+        vector<string> fields = split(line, '\t');
+        Entry entry;
+        int lines;
+        if (fields.size() != 6
+            || !convert(fields[1], entry.device)
+            || !convert(fields[2], entry.inode)
+            || !convert(fields[3], entry.size)
+            || !convert(fields[4], entry.mtime)
+            || !convert(fields[5], lines)) {
+            cerr << "WARNING(freebayes): ignoring malformed BAM header cache " << cacheFile << endl;
+            return false;
+        }
+        for (int i = 0; i < lines && getline(in, line); ++i) {
+            entry.text += line + "\n";
+        }
+        loaded[fields[0]] = entry;
+    }
+    return true;
+}
+
+bool BamHeaderCache::stamp(const string& path, Entry& entry) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        return false;
+    }
+    entry.device = info.st_dev;
+    entry.inode = info.st_ino;
+    entry.size = info.st_size;
+#ifdef __APPLE__
+    entry.mtime = info.st_mtimespec.tv_sec * 1000000000LL + info.st_mtimespec.tv_nsec;
+#else
+    entry.mtime = info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec;
+#endif
+    return true;
+}
+
+bool BamHeaderCache::lookup(const string& path, string& headerText) {
+    string key = canonicalPath(path);
+    Entry current;
+    map<string, Entry>::iterator e = entries.find(key);
+    if (e != entries.end() && stamp(key, current) && e->second == current) {
+        headerText = e->second.text;
+        ++hits;
+        return true;
+    }
+    ++misses;
+    return false;
+}
+
+void BamHeaderCache::store(const string& path, const string& headerText) {
+    string key = canonicalPath(path);
+    Entry entry;
+    if (!stamp(key, entry)
+        || entry.mtime / 1000000000LL > (long long) time(NULL) - racySeconds) {
+        return;
+    }
+    entry.text = headerText;
+    if (!entry.text.empty() && entry.text[entry.text.size() - 1] != '\n') {
+        entry.text += "\n";
+    }
+    entries[key] = entry;
+    added[key] = entry;
+}
+
+bool BamHeaderCache::save(void) {
+    if (added.empty()) {
+        return true;
+    }
+    string lockFile = cacheFile + ".lock";
+    int lock = open(lockFile.c_str(), O_RDWR | O_CREAT, 0666);
+    if (lock < 0) {
+        return false;
+    }
+    if (flock(lock, LOCK_EX) != 0) {
+        close(lock);
+        return false;
+    }
+
+    // other jobs may have saved since we loaded
+    map<string, Entry> merged;
+    load(merged);
+    for (map<string, Entry>::iterator a = added.begin(); a != added.end(); ++a) {
+        merged[a->first] = a->second;
+    }
+
+    // write beside the cache and rename, so readers never see a partial file
+    stringstream tmp;
+    tmp << cacheFile << ".tmp." << getpid();
+    ofstream out(tmp.str().c_str());
+    bool ok = out.is_open();
+    if (ok) {
+        out << cacheVersion << endl;
+        for (map<string, Entry>::iterator e = merged.begin(); e != merged.end(); ++e) {
+            Entry& entry = e->second;
+            int lines = count(entry.text.begin(), entry.text.end(), '\n');
+            out << e->first << "\t" << entry.device << "\t" << entry.inode << "\t"
+                << entry.size << "\t" << entry.mtime << "\t" << lines << endl
+                << entry.text;
+        }
+        out.close();
+        ok = out && rename(tmp.str().c_str(), cacheFile.c_str()) == 0;
+        if (!ok) {
+            remove(tmp.str().c_str());
+        }
+    }
+
+    flock(lock, LOCK_UN);
+    close(lock);
+    if (ok) {
+        added.clear();
+    }
+    return ok;
+}
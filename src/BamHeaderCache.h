@@ -0,0 +1,75 @@
+#ifndef _BAM_HEADER_CACHE_H
+#define _BAM_HEADER_CACHE_H
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Persists BAM header texts keyed by the canonical path of each file.  An
+// entry is only used while the file's device, inode, size and nanosecond
+// mtime are unchanged, which lets repeated runs over the same inputs, such as
+// the region jobs of a scatter, skip opening every file just to read its
+// header.  Files modified within the last few seconds aren't stored, as on
+// filesystems with coarse timestamps a rewrite could keep the same stamp.
+//
+// Many jobs may share one cache.  save() holds an exclusive lock on
+// <cache>.lock while it rereads the cache, merges in the entries this
+// process added and renames the result into place, so no job loses
+// another's entries and readers never see a partial file.
+//
+// The cache is a text file of records, after a version line:
+//
+//     path <tab> device <tab> inode <tab> size <tab> mtime ns <tab> number of lines
+//     header line
+//     ...
+
+class BamHeaderCache {
+
+public:
+
+    BamHeaderCache(const string& file);
+
+    // true, and the cached header text, if we have a current entry for path
+    bool lookup(const string& path, string& headerText);
+    void store(const string& path, const string& headerText);
+    // merges the entries added or replaced into the cache file
+    bool save(void);
+
+    int hits;
+    int misses;
+
+private:
+
+    class Entry {
+    public:
+        long long device;
+        long long inode;
+        long long size;
+        long long mtime;  // ns
+        string text;
+        bool operator==(const Entry& other) const {
+            return device == other.device && inode == other.inode
+                && size == other.size && mtime == other.mtime;
+        }
+    };
+
+    // false if the file is missing or malformed
+    bool load(map<string, Entry>& loaded);
+    bool stamp(const string& path, Entry& entry);
+
+    string cacheFile;
+    map<string, Entry> entries;
+    map<string, Entry> added;  // by this process, to merge in on save
+
+};
+
+#endif
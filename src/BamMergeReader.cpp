@@ -0,0 +1,340 @@
+#include "BamMergeReader.h"
+#include <algorithm>
+
+BamMergeReader::BamMergeReader(void)
+    : openFiles(0)
+    , peakOpenFiles(0)
+    , opens(0)
+    , reopens(0)
+    , seeks(0)
+    , skips(0)
+    , openFileLimit(0)
+    , headerCache(NULL)
+    , hasRegion(false)
+    , primed(false)
+{ }
+
+BamMergeReader::~BamMergeReader(void) {
+    for (int i = 0; i < files.size(); ++i) {
+        closeFile(i);
+    }
+}
+
+void BamMergeReader::SetOpenFileLimit(int limit) {
+    openFileLimit = limit;
+}
+
+void BamMergeReader::SetHeaderCache(BamHeaderCache* cache) {
+    headerCache = cache;
+}
+
+// reads the header, but the file is only held open if there is room
+bool BamMergeReader::Open(const string& path) {
+    // like SeqLib, a file given twice is only read once
+    for (vector<MergeFile>::iterator f = files.begin(); f != files.end(); ++f) {
+        if (f->path == path) {
+            return true;
+        }
+    }
+    files.push_back(MergeFile(path));
+    int i = files.size() - 1;
+    files[i].recent = recent.end();
+    bool cached = headerCache && headerCache->lookup(path, files[i].headerText);
+    if (!cached) {
+        if (!openFile(i)) {
+            files.pop_back();
+            return false;
+        }
+        files[i].headerText = files[i].reader->HeaderConcat();
+        if (headerCache) {
+            headerCache->store(path, files[i].headerText);
+        }
+    }
+    // SeqLib reports the header of the first file by name
+    if (headerPath.empty() || path < headerPath) {
+        // parsed from the text on a miss too, so it can't differ from a hit
+        header = SeqLib::BamHeader(files[i].headerText);
+        headerPath = path;
+    }
+    // rank files by name, as SeqLib does when merging
+    vector<pair<string, int> > names;
+    for (int j = 0; j < files.size(); ++j) {
+        names.push_back(make_pair(files[j].path, j));
+    }
+    sort(names.begin(), names.end());
+    ranks.resize(files.size());
+    for (int j = 0; j < names.size(); ++j) {
+        ranks[names[j].second] = j;
+    }
+    return true;
+}
+
+string BamMergeReader::HeaderConcat(void) const {
+    vector<pair<string, int> > names;
+    for (int j = 0; j < files.size(); ++j) {
+        names.push_back(make_pair(files[j].path, j));
+    }
+    sort(names.begin(), names.end());
+    string text;
+    for (vector<pair<string, int> >::iterator n = names.begin(); n != names.end(); ++n) {
+        text += files[n->second].headerText;
+    }
+    return text;
+}
+
+// no file is touched until the merge reaches where it could have alignments;
+// waiting files sort before any alignment there, in the order of their names
+bool BamMergeReader::SetRegion(const SeqLib::GenomicRegion& r) {
+    hasRegion = true;
+    primed = true;
+    region = r;
+    heap = priority_queue<MergeKey, vector<MergeKey>, greater<MergeKey> >();
+    for (int i = 0; i < files.size(); ++i) {
+        MergeFile& f = files[i];
+        f.hasNext = false;
+        f.waiting = false;
+        f.exhausted = false;
+        f.evicted = false;
+        f.lastPosition = -1;
+        f.readAtLastPosition = 0;
+        f.skipBefore = -1;
+        f.skipAtPosition = 0;
+        // a file left open by streaming can now be sought back into
+        if (f.streaming && f.reader) {
+            f.recent = recent.insert(recent.end(), i);
+        }
+        f.streaming = false;
+        f.startPosition = region.pos1;
+        if (f.emptyRefID == region.chr
+            && f.emptyFrom <= region.pos1 && region.pos1 < f.emptyTo) {
+            if (f.emptyTo >= region.pos2) {
+                f.exhausted = true;
+                ++skips;
+                continue;
+            }
+            f.startPosition = f.emptyTo;
+        }
+        f.waiting = true;
+        heap.push(MergeKey(region.chr, f.startPosition, ranks[i] - (int) files.size(), i));
+    }
+    return true;
+}
+
+bool BamMergeReader::GetNextRecord(SeqLib::BamRecord& record) {
+    // streaming whole files, load the first alignment of each
+    if (!primed) {
+        primed = true;
+        for (int i = 0; i < files.size() && errorString.empty(); ++i) {
+            MergeFile& f = files[i];
+            f.streaming = true;
+            if (f.recent != recent.end()) {
+                recent.erase(f.recent);
+                f.recent = recent.end();
+            }
+            pushNext(i);
+        }
+    }
+    while (!heap.empty()) {
+        int i = heap.top().file;
+        heap.pop();
+        if (files[i].waiting) {
+            start(i);
+            continue;
+        }
+        record = files[i].next;
+        pushNext(i);
+        return true;
+    }
+    return false;
+}
+
+// seeks a waiting file to where it could have alignments and puts its first
+// alignment in the merge, noting where it has none
+void BamMergeReader::start(int i) {
+    MergeFile& f = files[i];
+    f.waiting = false;
+    if (!seek(i, f.startPosition)) {
+        return;
+    }
+    pushNext(i);
+    if (!errorString.empty()) {
+        return;
+    }
+    int emptyTo = region.pos2;
+    if (f.hasNext) {
+        if (f.next.ChrID() != region.chr || f.next.Position() <= f.startPosition) {
+            return;
+        }
+        emptyTo = f.next.Position();
+    }
+    // extend what we know if the spans meet, otherwise replace it
+    if (f.emptyRefID == region.chr
+        && f.emptyFrom <= emptyTo && f.startPosition <= f.emptyTo) {
+        f.emptyFrom = min(f.emptyFrom, f.startPosition);
+        f.emptyTo = max(f.emptyTo, emptyTo);
+    } else {
+        f.emptyRefID = region.chr;
+        f.emptyFrom = f.startPosition;
+        f.emptyTo = emptyTo;
+    }
+}
+
+void BamMergeReader::pushNext(int i) {
+    MergeFile& f = files[i];
+    if (readNext(i)) {
+        heap.push(MergeKey(f.next.ChrID(), f.next.Position(), ranks[i], i));
+    }
+}
+
+bool BamMergeReader::readNext(int i) {
+    MergeFile& f = files[i];
+    f.hasNext = false;
+    if (f.exhausted) {
+        return false;
+    }
+    if (!f.reader) {
+        if (f.evicted) {
+            if (!reopen(i)) {
+                return false;
+            }
+        } else if (!openFile(i)) {
+            fail("could not open " + f.path);
+            return false;
+        }
+    }
+    touch(i);
+    while (f.reader->GetNextRecord(f.next)) {
+        int position = f.next.Position();
+        // drop what we read before this file was evicted
+        if (f.skipBefore >= 0) {
+            if (position < f.skipBefore) {
+                continue;
+            } else if (position == f.skipBefore && f.skipAtPosition > 0) {
+                --f.skipAtPosition;
+                continue;
+            }
+            f.skipBefore = -1;
+        }
+        if (position == f.lastPosition) {
+            ++f.readAtLastPosition;
+        } else {
+            f.lastPosition = position;
+            f.readAtLastPosition = 1;
+        }
+        f.hasNext = true;
+        return true;
+    }
+    f.exhausted = true;
+    // streaming, release the file handle and buffers as soon as we can;
+    // otherwise it's kept for the next region unless its slot is needed
+    if (f.streaming) {
+        closeFile(i);
+    }
+    return false;
+}
+
+// stops the merge; AlleleParser reports the error
+void BamMergeReader::fail(const string& message) {
+    if (errorString.empty()) {
+        errorString = message;
+    }
+    heap = priority_queue<MergeKey, vector<MergeKey>, greater<MergeKey> >();
+}
+
+bool BamMergeReader::openFile(int i) {
+    makeRoom();
+    MergeFile& f = files[i];
+    f.reader = new SeqLib::BamReader();
+    if (!f.reader->Open(f.path)) {
+        delete f.reader;
+        f.reader = NULL;
+        return false;
+    }
+    if (!f.streaming) {
+        f.recent = recent.insert(recent.begin(), i);
+    }
+    ++opens;
+    ++openFiles;
+    peakOpenFiles = max(peakOpenFiles, openFiles);
+    return true;
+}
+
+void BamMergeReader::closeFile(int i) {
+    MergeFile& f = files[i];
+    if (f.reader) {
+        delete f.reader;
+        f.reader = NULL;
+        --openFiles;
+    }
+    if (f.recent != recent.end()) {
+        recent.erase(f.recent);
+        f.recent = recent.end();
+    }
+}
+
+// moves a file to the front of the eviction order
+void BamMergeReader::touch(int i) {
+    MergeFile& f = files[i];
+    if (f.recent != recent.end() && f.recent != recent.begin()) {
+        recent.splice(recent.begin(), recent, f.recent);
+    }
+}
+
+// opens the file if it isn't, and seeks it to the region from position on
+bool BamMergeReader::seek(int i, int position) {
+    MergeFile& f = files[i];
+    if (!f.reader && !openFile(i)) {
+        fail("could not open " + f.path);
+        return false;
+    }
+    ++seeks;
+    SeqLib::GenomicRegion from(region.chr, position, region.pos2);
+    if (!f.reader->SetRegion(from)) {
+        fail("could not seek in " + f.path);
+        return false;
+    }
+    return true;
+}
+
+// seek an evicted file back to the alignment after the one we hold
+bool BamMergeReader::reopen(int i) {
+    MergeFile& f = files[i];
+    f.evicted = false;
+    ++reopens;
+    if (!seek(i, max(region.pos1, f.lastPosition))) {
+        return false;
+    }
+    f.skipBefore = f.lastPosition;
+    f.skipAtPosition = f.readAtLastPosition;
+    return true;
+}
+
+// close the least recently read files; those streamed aren't in the order, as
+// they can't be sought back into
+void BamMergeReader::makeRoom(void) {
+    if (openFileLimit <= 0) {
+        return;
+    }
+    while (openFiles >= openFileLimit && !recent.empty()) {
+        int j = recent.back();
+        MergeFile& f = files[j];
+        // a file holding an alignment for the merge has more to read, and
+        // must be sought back into
+        f.evicted = f.hasNext;
+        closeFile(j);
+    }
+}
+
+long unsigned int BamMergeReader::heldBytes(void) {
+    long unsigned int bytes = 0;
+    for (vector<MergeFile>::iterator f = files.begin(); f != files.end(); ++f) {
+        if (f->hasNext) {
+            bytes += sizeof(bam1_t) + f->next.raw()->m_data;
+        }
+    }
+    return bytes;
+}
+
+long unsigned int BamMergeReader::bufferedBytes(void) {
+    return (long unsigned int) openFiles * BGZF_DECODE_BUFFER_BYTES + heldBytes();
+}
@@ -0,0 +1,173 @@
+#ifndef _BAM_MERGE_READER_H
+#define _BAM_MERGE_READER_H
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <list>
+#include "SeqLib/BamReader.h"
+#include "BamHeaderCache.h"
+
+using namespace std;
+
+// approximate resident decode buffers for one open BGZF stream
+// (one compressed and one uncompressed block)
+#define BGZF_DECODE_BUFFER_BYTES (2 * 0x10000)
+
+// Coordinate-sorted k-way merge over many BAM/CRAM files.
+//
+// Each input file has its own reader.  Readers are opened lazily (not at all
+// at startup if the header is in the BamHeaderCache) and no more than
+// openFileLimit are held open at once.  On SetRegion each file enters the
+// merge waiting at the first position it could have alignments, and is only
+// opened, seeked and read when the merge gets there.  That position is the
+// region start, unless an earlier region showed the file has nothing there:
+// when a file is started, the span from where it was seeked to its first
+// alignment holds none of its alignments, which is remembered, so a later
+// region within that span (as when probing for the next target with
+// alignments, then loading it) waits for the file at the span's end, or
+// leaves it out if it has nothing in the region at all.
+//
+// When the limit is reached, the least recently read file is closed, keeping
+// only its next alignment in memory; when it is consumed the file is reopened
+// and its index used to seek back to where it left off.  Seeking requires an
+// index, so eviction is only done once SetRegion has been called.  When
+// streaming whole files every file with data stays open, and each is closed
+// as soon as it is exhausted.
+//
+// A file which can't be opened or seeked ends the merge: GetNextRecord
+// returns false and GetErrorString says why.
+//
+// Alignments which start before the region are all taken at its start, so
+// among them the order of the files doesn't matter and isn't kept.
+// Otherwise the merge order matches SeqLib::BamReader, with ties in position
+// broken by file name, and so does the interface, in the parts used by
+// AlleleParser.
+
+class BamMergeReader {
+
+public:
+
+    BamMergeReader(void);
+    ~BamMergeReader(void);
+
+    // 0 for no limit
+    void SetOpenFileLimit(int limit);
+    // headers found in the cache are used without opening the file
+    void SetHeaderCache(BamHeaderCache* cache);
+
+    bool Open(const string& path);
+    bool SetRegion(const SeqLib::GenomicRegion& region);
+    bool GetNextRecord(SeqLib::BamRecord& record);
+    // empty unless the merge stopped on an error
+    const string& GetErrorString(void) const { return errorString; }
+
+    const SeqLib::BamHeader& Header(void) const { return header; }
+    string HeaderConcat(void) const;
+
+    // reporting
+    int openFiles;
+    int peakOpenFiles;
+    long unsigned int opens;    // of files, reopens included
+    long unsigned int reopens;  // of evicted files, to seek back into them
+    long unsigned int seeks;    // into a region, reopens included
+    long unsigned int skips;    // of files left out of a region, known to have nothing there
+    long unsigned int heldBytes(void);  // in the alignments held for the merge
+    long unsigned int bufferedBytes(void);  // decode buffers plus held alignments
+    long unsigned int peakBufferedBytes(void) { return (long unsigned int) peakOpenFiles * BGZF_DECODE_BUFFER_BYTES; }
+
+private:
+
+    class MergeFile {
+    public:
+        string path;
+        string headerText;
+        SeqLib::BamReader* reader;
+        SeqLib::BamRecord next;  // the alignment this file contributes to the heap
+        bool hasNext;
+        bool waiting;    // in the merge at startPosition, not yet read
+        bool exhausted;
+        bool streaming;  // read from the start of the file, can't be reopened
+        bool evicted;    // closed to make room, with more to read
+        int startPosition;
+        // no alignment of the file overlaps [emptyFrom, emptyTo) on
+        // emptyRefID, as found when it was last started
+        int emptyRefID;
+        int emptyFrom;
+        int emptyTo;
+        list<int>::iterator recent;  // in BamMergeReader::recent while open
+        // where we are in the file, so we can seek back after eviction
+        int lastPosition;
+        int readAtLastPosition;
+        // alignments to discard after a reopen
+        int skipBefore;
+        int skipAtPosition;
+        MergeFile(const string& p)
+            : path(p)
+            , reader(NULL)
+            , hasNext(false)
+            , waiting(false)
+            , exhausted(false)
+            , streaming(false)
+            , evicted(false)
+            , startPosition(0)
+            , emptyRefID(-1)
+            , emptyFrom(0)
+            , emptyTo(0)
+            , lastPosition(-1)
+            , readAtLastPosition(0)
+            , skipBefore(-1)
+            , skipAtPosition(0)
+        { }
+    };
+
+    // heap entry: next alignment of a file
+    class MergeKey {
+    public:
+        int refid;
+        int position;
+        int rank;  // order of the file's name among all files, less the
+                   // number of files while the file is waiting, so it is
+                   // started before alignments at its start position
+        int file;
+        MergeKey(int r, int p, int k, int f) : refid(r), position(p), rank(k), file(f) { }
+        bool operator>(const MergeKey& other) const {
+            if (refid != other.refid) {
+                // unmapped (-1) alignments sort last
+                return (unsigned int) refid > (unsigned int) other.refid;
+            } else if (position != other.position) {
+                return position > other.position;
+            } else {
+                return rank > other.rank;
+            }
+        }
+    };
+
+    vector<MergeFile> files;
+    vector<int> ranks;  // rank by file name, indexed by file
+    priority_queue<MergeKey, vector<MergeKey>, greater<MergeKey> > heap;
+    // the files which can be evicted, most recently read first
+    list<int> recent;
+    int openFileLimit;
+    BamHeaderCache* headerCache;
+    bool hasRegion;
+    bool primed;
+    SeqLib::GenomicRegion region;
+    SeqLib::BamHeader header;
+    string headerPath;
+    string errorString;
+
+    bool openFile(int i);
+    void closeFile(int i);
+    void makeRoom(void);
+    void touch(int i);
+    bool seek(int i, int position);
+    bool reopen(int i);
+    void start(int i);
+    bool readNext(int i);
+    void pushNext(int i);
+    void fail(const string& message);
+
+};
+
+#endif
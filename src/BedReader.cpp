@@ -77,4 +77,50 @@ vector<BedTarget*> BedReader::targetsOverlapping(BedTarget& target) {
     return overlapping;
 }
 
+bool compareIntervalEnd(const pair<long, long>& interval, long position) {
+    return interval.second < position;
+}
+
+void TargetCursor::build(vector<BedTarget>& targets) {
+    bySequence.clear();
+    for (vector<BedTarget>::iterator t = targets.begin(); t != targets.end(); ++t) {
+        bySequence[t->seq].push_back(make_pair((long) t->left, (long) t->right));
+    }
+    // merge overlapping and abutting targets, so the ends are sorted too
+    for (map<string, vector<pair<long, long> > >::iterator s = bySequence.begin(); s != bySequence.end(); ++s) {
+        vector<pair<long, long> >& v = s->second;
+        sort(v.begin(), v.end());
+        vector<pair<long, long> >::iterator m = v.begin();
+        for (vector<pair<long, long> >::iterator i = v.begin() + 1; i < v.end(); ++i) {
+            if (i->first <= m->second + 1) {
+                m->second = max(m->second, i->second);
+            } else {
+                *++m = *i;
+            }
+        }
+        v.erase(m + 1, v.end());
+    }
+    intervals = &none;
+    sequence.clear();
+    next = 0;
+    lastPosition = -1;
+}
+
+bool TargetCursor::contains(const string& seq, long position) {
+    if (seq != sequence || position < lastPosition) {
+        if (seq != sequence) {
+            sequence = seq;
+            map<string, vector<pair<long, long> > >::iterator s = bySequence.find(seq);
+            intervals = (s == bySequence.end()) ? &none : &s->second;
+        }
+        next = lower_bound(intervals->begin(), intervals->end(), position, compareIntervalEnd) - intervals->begin();
+    } else {
+        while (next < intervals->size() && (*intervals)[next].second < position) {
+            ++next;
+        }
+    }
+    lastPosition = position;
+    return next < intervals->size() && (*intervals)[next].first <= position;
+}
+
 #endif
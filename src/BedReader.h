@@ -34,6 +34,29 @@ public:
 };
 
 
+// Membership of positions in a set of targets, for positions which mostly
+// increase.  Targets are sorted and merged by sequence, and a cursor into the
+// current sequence's targets advances with the position; moving backwards or
+// to another sequence restarts it with a binary search.
+class TargetCursor {
+
+public:
+    TargetCursor(void) : intervals(&none), next(0), lastPosition(-1) { }
+
+    void build(vector<BedTarget>& targets);
+    bool contains(const string& seq, long position);
+
+private:
+    map<string, vector<pair<long, long> > > bySequence;
+    vector<pair<long, long> > none;
+    vector<pair<long, long> >* intervals; // those of sequence
+    string sequence;
+    size_t next; // the first interval not ending before lastPosition
+    long lastPosition;
+
+};
+
+
 class BedReader : public ifstream {
 
 public:
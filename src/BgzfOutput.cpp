@@ -0,0 +1,40 @@
+#include "BgzfOutput.h"
+
+
+bool BgzfStreamBuf::open(const string& path, long long appendAt) {
+    close();
+    file = bgzf_open(path.c_str(), appendAt < 0 ? "w" : "a");
+    base = appendAt < 0 ? 0 : appendAt;
+    return file != NULL;
+}
+
+long long BgzfStreamBuf::flushBlock(void) {
+    if (!file || bgzf_flush(file) != 0) {
+        return -1;
+    }
+    return bgzf_tell(file) + (base << 16);
+}
+
+bool BgzfStreamBuf::close(void) {
+    if (!file) {
+        return true;
+    }
+    int status = bgzf_close(file);
+    file = NULL;
+    return status == 0;
+}
+
+int BgzfStreamBuf::overflow(int c) {
+    if (c == traits_type::eof()) {
+        return traits_type::not_eof(c);
+    }
+    char ch = c;
+    return xsputn(&ch, 1) == 1 ? c : traits_type::eof();
+}
+
+streamsize BgzfStreamBuf::xsputn(const char* s, streamsize n) {
+    if (!file || bgzf_write(file, s, n) != n) {
+        return 0;
+    }
+    return n;
+}
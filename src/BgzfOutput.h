@@ -0,0 +1,75 @@
+#ifndef _BGZF_OUTPUT_H
+#define _BGZF_OUTPUT_H
+
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include "htslib/bgzf.h"
+
+using namespace std;
+
+// Writes through htslib's BGZF, so the output is bgzip-compressed and can be
+// indexed with tabix as it is.  Flushing the stream (as endl does) leaves the
+// data in the current block; flushBlock() ends the block, so the file can
+// later be cut back to that block boundary and appended to, as --resume
+// does.
+
+class BgzfStreamBuf : public streambuf {
+
+public:
+
+    BgzfStreamBuf(void) : file(NULL), base(0) { }
+    ~BgzfStreamBuf(void) { close(); }
+
+    // appends to the first appendAt bytes of the file, which must end a
+    // block, or starts a new file if appendAt is -1
+    bool open(const string& path, long long appendAt = -1);
+    // ends the current block, returning the virtual offset of the next,
+    // or -1 on error
+    long long flushBlock(void);
+    // writes the end-of-file marker
+    bool close(void);
+
+protected:
+
+    int overflow(int c);
+    streamsize xsputn(const char* s, streamsize n);
+
+private:
+
+    BGZF* file;
+    // htslib counts block addresses from where the file was opened, which
+    // is after the resumed part
+    long long base;
+
+};
+
+class BgzfOutputFile : public ostream {
+
+public:
+
+    BgzfOutputFile(void) : ostream(NULL) { rdbuf(&buffer); }
+
+    bool open(const string& path, long long appendAt = -1) {
+        bool opened = buffer.open(path, appendAt);
+        if (!opened) setstate(ios::failbit);
+        return opened;
+    }
+    long long flushBlock(void) {
+        long long offset = buffer.flushBlock();
+        if (offset < 0) setstate(ios::badbit);
+        return offset;
+    }
+    bool close(void) { return buffer.close(); }
+
+private:
+
+    BgzfStreamBuf buffer;
+
+};
+
+// the file offset of the block a virtual offset refers to
+inline long long bgzfBlockAddress(long long virtualOffset) { return virtualOffset >> 16; }
+inline bool bgzfBlockAligned(long long virtualOffset) { return (virtualOffset & 0xFFFF) == 0; }
+
+#endif
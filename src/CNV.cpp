@@ -39,39 +39,135 @@ void CNVMap::setSamplePloidy(const string& sample, int ploidy) {
 
 void CNVMap::setPloidy(string const& sample, string const& seq, long int start, long int end, int ploidy) {
     sampleSeqCNV[sample][seq][make_pair(start, end)] = ploidy;
+    compiled = false;
+}
+
+// Flattens each sample's ranges on each sequence into non-overlapping
+// segments.  Where ranges overlap the first in (start, end) order wins, as in
+// a scan of the range map.
+void CNVMap::compile(void) {
+
+    sampleSeqSegments.clear();
+    seqBreakpoints.clear();
+    cursors.clear();
+
+    for (SampleSeqCNVMap::iterator scnv = sampleSeqCNV.begin(); scnv != sampleSeqCNV.end(); ++scnv) {
+        for (map<string, map<pair<long int, long int>, int> >::iterator c = scnv->second.begin();
+             c != scnv->second.end(); ++c) {
+
+            const string& seq = c->first;
+            vector<pair<long int, long int> > ranges;
+            vector<int> ploidies;
+            // boundary -> (range index, true if it starts here)
+            multimap<long int, pair<int, bool> > events;
+            for (map<pair<long int, long int>, int>::iterator r = c->second.begin(); r != c->second.end(); ++r) {
+                if (r->first.first >= r->first.second) {
+                    continue;  // empty
+                }
+                int index = ranges.size();
+                ranges.push_back(r->first);
+                ploidies.push_back(r->second);
+                events.insert(make_pair(r->first.first, make_pair(index, true)));
+                events.insert(make_pair(r->first.second, make_pair(index, false)));
+            }
+
+            vector<CNVSegment>& segments = sampleSeqSegments[scnv->first][seq];
+            vector<long int>& breakpoints = seqBreakpoints[seq];
+            set<int> active;  // ranges covering the current position, in map order
+            multimap<long int, pair<int, bool> >::iterator e = events.begin();
+            while (e != events.end()) {
+                long int position = e->first;
+                for (; e != events.end() && e->first == position; ++e) {
+                    if (e->second.second) {
+                        active.insert(e->second.first);
+                    } else {
+                        active.erase(e->second.first);
+                    }
+                }
+                if (e == events.end() || active.empty()) {
+                    continue;
+                }
+                int ploidy = ploidies[*active.begin()];
+                if (!segments.empty() && segments.back().end == position && segments.back().ploidy == ploidy) {
+                    segments.back().end = e->first;
+                } else {
+                    segments.push_back(CNVSegment(position, e->first, ploidy));
+                }
+            }
+            for (vector<CNVSegment>::iterator g = segments.begin(); g != segments.end(); ++g) {
+                breakpoints.push_back(g->start);
+                breakpoints.push_back(g->end);
+            }
+        }
+    }
+
+    for (map<string, vector<long int> >::iterator b = seqBreakpoints.begin(); b != seqBreakpoints.end(); ++b) {
+        vector<long int>& breakpoints = b->second;
+        sort(breakpoints.begin(), breakpoints.end());
+        breakpoints.erase(unique(breakpoints.begin(), breakpoints.end()), breakpoints.end());
+    }
+
+    compiled = true;
+
+}
+
+static bool segmentEndsBefore(const CNVSegment& segment, long int position) {
+    return segment.end <= position;
 }
 
 int CNVMap::ploidy(string const& sample, string const& seq, long int position) {
 
-    int basePloidy = (samplePloidy.find(sample) != samplePloidy.end()) ? samplePloidy[sample] : defaultPloidy;
+    map<string, int>::iterator sp = samplePloidy.find(sample);
+    int basePloidy = (sp != samplePloidy.end()) ? sp->second : defaultPloidy;
 
     if (sampleSeqCNV.empty()) {
         return basePloidy;
     }
 
-    SampleSeqCNVMap::iterator scnv = sampleSeqCNV.find(sample);
+    if (!compiled) {
+        compile();
+    }
 
-    if (scnv == sampleSeqCNV.end()) {
+    map<string, map<string, vector<CNVSegment> > >::iterator scnv = sampleSeqSegments.find(sample);
+    if (scnv == sampleSeqSegments.end()) {
         return basePloidy;
-    } else {
-        map<string, map<pair<long int, long int>, int> >::iterator c = scnv->second.find(seq);
+    }
+
+    CNVCursor& cursor = cursors[sample];
+    if (cursor.seq != seq || !cursor.segments) {
+        map<string, vector<CNVSegment> >::iterator c = scnv->second.find(seq);
         if (c == scnv->second.end()) {
             return basePloidy;
-        } else {
-            map<pair<long int, long int>, int>& cnvs = c->second;
-            for (map<pair<long int, long int>, int>::iterator i = cnvs.begin(); i != cnvs.end(); ++i) {
-                pair<long int, long int> range = i->first;
-                int copyNumber = i->second;
-                if (range.first <= position && range.second > position) {
-                    return copyNumber;
-                } else if (position > range.first && position > range.second) {
-                    // we've passed any potential matches in this sequence, and the map
-                    // is sorted by pair, so we don't have any matching ranges
-                    break;
-                }
-            }
-            return basePloidy;
         }
+        cursor.seq = seq;
+        cursor.segments = &c->second;
+        cursor.index = 0;
     }
 
+    const vector<CNVSegment>& segments = *cursor.segments;
+    if (cursor.index > 0 && segments[cursor.index - 1].end > position) {
+        // we've moved backwards, find our place again
+        cursor.index = lower_bound(segments.begin(), segments.end(), position, segmentEndsBefore) - segments.begin();
+    }
+    while (cursor.index < segments.size() && segments[cursor.index].end <= position) {
+        ++cursor.index;
+    }
+    if (cursor.index < segments.size() && segments[cursor.index].start <= position) {
+        return segments[cursor.index].ploidy;
+    } else {
+        return basePloidy;
+    }
+
+}
+
+long int CNVMap::nextBreakpoint(string const& seq, long int position) {
+    if (!compiled) {
+        compile();
+    }
+    map<string, vector<long int> >::iterator b = seqBreakpoints.find(seq);
+    if (b == seqBreakpoints.end()) {
+        return -1;
+    }
+    vector<long int>::iterator next = upper_bound(b->second.begin(), b->second.end(), position);
+    return (next == b->second.end()) ? -1 : *next;
 }
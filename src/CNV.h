@@ -7,6 +7,8 @@
 #include <fstream>
 #include <vector>
 #include <utility>
+#include <set>
+#include <algorithm>
 #include <stdlib.h>
 #include "split.h"
 
@@ -14,15 +16,37 @@ using namespace std;
 
 typedef map<string, map<string, map<pair<long int, long int>, int> > > SampleSeqCNVMap;
 
+// a run of constant copy number, 0-based, end position exclusive
+class CNVSegment {
+public:
+    long int start;
+    long int end;
+    int ploidy;
+    CNVSegment(long int s, long int e, int p) : start(s), end(e), ploidy(p) { }
+};
+
+// where the last lookup for a sample landed; as we call left to right the
+// next lookup is almost always in the same or the following segment
+class CNVCursor {
+public:
+    string seq;
+    const vector<CNVSegment>* segments;
+    size_t index;
+    CNVCursor(void) : segments(NULL), index(0) { }
+};
+
 class CNVMap {
 
 public:
-    CNVMap(void) : defaultPloidy(2) { }
+    CNVMap(void) : defaultPloidy(2), compiled(true) { }
     void setDefaultPloidy(int defploidy);
     void setSamplePloidy(const string& sample, int ploidy);
     bool load(string const& filename);
     int ploidy(string const& sample, string const& seq, long int position);
     void setPloidy(string const& sample, string const& seq, long int start, long int end, int ploidy);
+    // the first position after position at which any sample's ploidy may
+    // change, or -1 if ploidies are constant to the end of seq
+    long int nextBreakpoint(string const& seq, long int position);
 
 private:
     // note: this map is stored as 0-based, end position exclusive
@@ -30,6 +54,14 @@ private:
     int defaultPloidy;
     map<string, int> samplePloidy;
 
+    // sampleSeqCNV as sorted, non-overlapping segments per sample and
+    // sequence, rebuilt on the first lookup after any setPloidy
+    void compile(void);
+    bool compiled;
+    map<string, map<string, vector<CNVSegment> > > sampleSeqSegments;
+    map<string, vector<long int> > seqBreakpoints;  // every segment boundary, sorted
+    map<string, CNVCursor> cursors;  // by sample
+
 };
 
 #endif
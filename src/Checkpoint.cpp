@@ -0,0 +1,120 @@
+#include "Checkpoint.h"
+#include "split.h"
+#include "convert.h"
+
+
+static void malformed(const string& path) {
+    cerr << "ERROR(freebayes): checkpoint " << path << " is malformed" << endl;
+    exit(1);
+}
+
+static string hexFloat(long double x) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%La", x);
+    return buffer;
+}
+
+static bool readHexFloat(const string& s, Real& x) {
+    char* end;
+    x = strtold(s.c_str(), &end);
+    return !s.empty() && *end == '\0';
+}
+
+bool Checkpoint::write(const string& path) {
+    stringstream tmp;
+    tmp << path << ".tmp." << getpid();
+    ofstream out(tmp.str().c_str());
+    if (!out.is_open()) {
+        return false;
+    }
+    int lines = 0;
+    for (NonCalls::iterator c = nonCalls.begin(); c != nonCalls.end(); ++c) {
+        for (map<long, map<string, NonCall> >::iterator p = c->second.begin(); p != c->second.end(); ++p) {
+            lines += p->second.size();
+        }
+    }
+    out << "# freebayes checkpoint" << endl
+        << "commandline\t" << commandline << endl
+        << "position\t" << sequence << "\t" << position << "\t" << target << "\t" << outputOffset << endl
+        << "noncalls\t" << lines << endl;
+    for (NonCalls::iterator c = nonCalls.begin(); c != nonCalls.end(); ++c) {
+        for (map<long, map<string, NonCall> >::iterator p = c->second.begin(); p != c->second.end(); ++p) {
+            for (map<string, NonCall>::iterator s = p->second.begin(); s != p->second.end(); ++s) {
+                NonCall& nc = s->second;
+                out << c->first << "\t" << p->first << "\t" << s->first << "\t"
+                    << nc.refCount << "\t" << nc.altCount << "\t"
+                    << nc.minDepth << "\t" << nc.nCount << "\t"
+                    << hexFloat(nc.reflnQ) << "\t" << hexFloat(nc.altlnQ) << "\n";
+            }
+        }
+    }
+    out.close();
+    if (!out || rename(tmp.str().c_str(), path.c_str()) != 0) {
+        remove(tmp.str().c_str());
+        return false;
+    }
+    return true;
+}
+
+bool Checkpoint::read(const string& path) {
+    ifstream in(path.c_str());
+    if (!in.is_open()) {
+        return false;
+    }
+    string line;
+    vector<string> fields;
+    int lines;
+    if (!getline(in, line) || line != "# freebayes checkpoint"
+        || !getline(in, line) || line.compare(0, 12, "commandline\t") != 0) {
+        malformed(path);
+    }
+    commandline = line.substr(12);
+    if (!getline(in, line)
+        || (fields = split(line, '\t')).size() != 5
+        || fields[0] != "position"
+        || !convert(fields[2], position)
+        || !convert(fields[3], target)
+        || !convert(fields[4], outputOffset)) {
+        malformed(path);
+    }
+    sequence = fields[1];
+    if (!getline(in, line)
+        || (fields = split(line, '\t')).size() != 2
+        || fields[0] != "noncalls"
+        || !convert(fields[1], lines)) {
+        malformed(path);
+    }
+    nonCalls.clear();
+    for (int i = 0; i < lines; ++i) {
+        long pos;
+        NonCall nc;
+        if (!getline(in, line)
+            || (fields = split(line, '\t')).size() != 9
+            || !convert(fields[1], pos)
+            || !convert(fields[3], nc.refCount)
+            || !convert(fields[4], nc.altCount)
+            || !convert(fields[5], nc.minDepth)
+            || !convert(fields[6], nc.nCount)
+            || !readHexFloat(fields[7], nc.reflnQ)
+            || !readHexFloat(fields[8], nc.altlnQ)) {
+            malformed(path);
+        }
+        nonCalls[fields[0]][pos][fields[2]] = nc;
+    }
+    return true;
+}
+
+string checkpointCommandLine(const string& commandline) {
+    vector<string> args = split(commandline, ' ');
+    string result;
+    for (vector<string>::iterator a = args.begin(); a != args.end(); ++a) {
+        if (*a == "--resume") {
+            continue;
+        }
+        if (!result.empty()) {
+            result += " ";
+        }
+        result += *a;
+    }
+    return result;
+}
@@ -0,0 +1,66 @@
+#ifndef _CHECKPOINT_H
+#define _CHECKPOINT_H
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <stdio.h>
+#include <unistd.h>
+#include "NonCall.h"
+
+using namespace std;
+
+// The state needed to resume a run, taken at a position where no alignments
+// are registered, so the parser can start again there by seeking the inputs
+// and nothing it held in memory is lost.  The VCF written so far is kept up
+// to the recorded offset, and the non-calls pending for the next gVCF record
+// are carried over.
+//
+// The checkpoint is a text file:
+//
+//     # freebayes checkpoint
+//     commandline <tab> command line, without --resume
+//     position <tab> sequence <tab> position <tab> target index <tab> output offset
+//     noncalls <tab> number of lines
+//     sequence <tab> position <tab> sample <tab> refCount <tab> altCount
+//         <tab> minDepth <tab> nCount <tab> reflnQ <tab> altlnQ
+//     ...
+//
+// The output offset is a byte offset, or for bgzip-compressed output the
+// BGZF virtual offset of the block following the checkpoint, whose
+// in-block offset is 0.  The log qualities are written as hexadecimal
+// floats so they are restored exactly.
+
+class Checkpoint {
+
+public:
+
+    Checkpoint(void)
+        : position(0)
+        , target(-1)
+        , outputOffset(0)
+    { }
+
+    string commandline;
+    string sequence;
+    long int position;  // 0-based, the first position not yet processed
+    int target;         // index of the target holding position, -1 without targets
+    long long outputOffset;  // bytes, or a BGZF virtual offset
+    NonCalls nonCalls;
+
+    // written beside path and renamed, so an interrupted write leaves the
+    // previous checkpoint in place
+    bool write(const string& path);
+    // false if there is no checkpoint at path; malformed files are fatal
+    bool read(const string& path);
+
+};
+
+// the command line as recorded in checkpoints, so runs with and without
+// --resume compare equal
+string checkpointCommandLine(const string& commandline);
+
+#endif
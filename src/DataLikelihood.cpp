@@ -3,9 +3,273 @@
 #include "multipermute.h"
 
 
-long double
+void SampleObservationIndex::add(
+        Allele* obs,
+        int alleleIndex,
+        double scale,
+        vector<int>::const_iterator supportsFirst,
+        vector<int>::const_iterator supportsLast,
+        Contamination& contaminations) {
+    IndexedObservation o;
+    o.allele = obs;
+    o.alleleIndex = alleleIndex;
+    o.isReference = obs->isReference();
+    o.contamination = &contaminations.of(obs->readGroupID);
+    o.scale = scale;
+    // note that this will underflow if we have mapping quality = 0
+    // we guard against this externally, by ignoring such alignments (quality has to be > MQL0)
+    o.qual = (1.0 - exp(obs->lnquality)) * (1.0 - exp(obs->lnmapQuality));
+    // each partial obs is recorded as supporting, but with observation probability scaled by the number of possible haplotypes it supports
+    o.qual *= scale;
+    // the unique genotype alleles this observation supports
+    o.supportsBegin = supports.size();
+    o.supportsMask = 0;
+    for (vector<int>::const_iterator b = supportsFirst; b != supportsLast; ++b) {
+        supports.push_back(*b);
+        if (*b < 32) {
+            o.supportsMask |= 1u << *b;
+        }
+    }
+    o.supportsEnd = supports.size();
+    o.lnWrong = log(1-o.qual);
+    observations.push_back(o);
+}
+
+void SampleObservationIndex::build(
+        Sample& sample,
+        bool standardGLs,
+        vector<Allele>& genotypeAlleles,
+        Contamination& contaminations
+    ) {
+
+    assert(sample.indexedFor(&genotypeAlleles));
+    AlleleObservationTable& table = sample.observationTable;
+
+    baseIndexes.clear();
+    observations.clear();
+    supports.clear();
+
+    if (standardGLs) {
+        int g = 0;
+        for (Sample::iterator s = sample.begin(); s != sample.end(); ++s, ++g) {
+            baseIndexes.push_back(make_pair(table.groupAlleles[g], &s->second));
+        }
+        return;
+    }
+
+    // by base: the observations of the base, then the partial observations
+    // supporting each allele with the base
+    vector<int>::const_iterator byBase = table.allelesByBase.begin();
+    for (vector<AlleleObservationTable::BaseEntry>::iterator e = table.entries.begin();
+         e != table.entries.end(); ++e) {
+        if (e->group != -1) {
+            const vector<Allele*>& alleles = (sample.begin() + e->group)->second;
+            int alleleIndex = table.groupAlleles[e->group];
+            for (vector<Allele*>::const_iterator a = alleles.begin(); a != alleles.end(); ++a) {
+                add(*a, alleleIndex, 1, byBase + e->first, byBase + e->last, contaminations);
+            }
+        }
+        for (int k = e->first; k < e->last; ++k) {
+            int i = byBase[k];
+            for (int r = table.partialOffsets[i]; r < table.partialOffsets[i + 1]; ++r) {
+                int p = table.partials[r];
+                double supported = sample.partialSupportOffsets[p + 1] - sample.partialSupportOffsets[p];
+                add(sample.partials[p], table.partialBaseAlleles[p], (double) 1 / supported,
+                    table.partialAlleles.begin() + table.partialAlleleOffsets[p],
+                    table.partialAlleles.begin() + table.partialAlleleOffsets[p + 1],
+                    contaminations);
+            }
+        }
+    }
+
+}
+
+// The standard GLs of a genotype with Elements distinct alleles, the
+// multinomial over its alleles taken on the stack.
+template <int Elements>
+static Real standardGLKernel(
+        Sample& sample,
+        SampleObservationIndex& index,
+        Genotype& genotype,
+        double dependenceFactor,
+        bool useMapQ,
+        Bias& observationBias) {
+
+    int countOut = 0;
+    Real prodQout = 0;
+    for (vector<pair<int, vector<Allele*>*> >::iterator s = index.baseIndexes.begin();
+         s != index.baseIndexes.end(); ++s) {
+        if (s->first == -1 || !genotype.containsAllele(s->first)) {
+            vector<Allele*>& alleles = *s->second;
+            if (useMapQ) {
+                for (vector<Allele*>::iterator a = alleles.begin(); a != alleles.end(); ++a) {
+                    prodQout += max((*a)->lnquality, (*a)->lnmapQuality);
+                }
+            } else {
+                for (vector<Allele*>::iterator a = alleles.begin(); a != alleles.end(); ++a) {
+                    prodQout += (*a)->lnquality;
+                }
+            }
+            countOut += alleles.size();
+        }
+    }
+    if (countOut > 1) {
+        prodQout *= (1 + (countOut - 1) * dependenceFactor) / countOut;
+    }
+
+    int observationCounts[Elements];
+    int observations = 0;
+    for (int i = 0; i < Elements; ++i) {
+        observationCounts[i] = genotype.elementObservationCount(sample, genotype[i]);
+        observations += observationCounts[i];
+    }
+    if (observations == 0) {
+        return prodQout;
+    }
+
+    // as Genotype::alleleProbabilities
+    Real alleleProbs[Elements];
+    Real total = 0;
+    for (int i = 0; i < Elements; ++i) {
+        Allele& allele = genotype[i].allele;
+        Real bias = 1;
+        if (!allele.isReference()) {
+            int alleleLengthDifference = allele.alternateSequence.size() - allele.referenceLength;
+            bias = observationBias.bias(alleleLengthDifference);
+        }
+        alleleProbs[i] = ((Real) genotype[i].count / (Real) genotype.ploidy) * bias;
+        total += alleleProbs[i];
+    }
+    for (int i = 0; i < Elements; ++i) {
+        alleleProbs[i] /= total;
+    }
+    return prodQout + multinomialSamplingProbLn<Elements>(alleleProbs, observationCounts);
+
+}
+
+// The likelihood of the indexed observations given a genotype of Ploidy over
+// Alleles genotype alleles.  The alleles an observation supports are tested
+// against those in the genotype as bitmasks, rather than by walking its
+// supports.
+template <int Ploidy, int Alleles>
+static Real indexedKernel(
+        SampleObservationIndex& index,
+        Genotype& genotype,
+        double dependenceFactor) {
+
+    double samplingProbs[Alleles];
+    unsigned int contained = 0;
+    for (int b = 0; b < Alleles; ++b) {
+        samplingProbs[b] = (double) genotype.indexCounts[b] / (double) Ploidy;
+        if (genotype.indexCounts[b] > 0) {
+            contained |= 1u << b;
+        }
+    }
+
+    int countOut = 0;
+    Real prodQout = 0;
+    Real prodSample = 0;
+
+    for (vector<IndexedObservation>::iterator o = index.observations.begin();
+         o != index.observations.end(); ++o) {
+
+        ContaminationEstimate& contamination = *o->contamination;
+
+        Real asampl = (o->alleleIndex == -1) ? 0 : samplingProbs[o->alleleIndex];
+        unsigned int supported = o->supportsMask & contained;
+        for (int b = 0; b < Alleles; ++b) {
+            if (supported & (1u << b)) {
+                asampl = max(asampl, (Real) samplingProbs[b]);
+            }
+        }
+
+        if (asampl == 0) {
+            asampl = contamination.probRefGivenHomAlt;
+        } else if (asampl == 1) {
+            asampl = 1 - contamination.probRefGivenHomAlt;
+        } else {
+            if (o->isReference) {
+                asampl *= (contamination.probRefGivenHet / 0.5);
+            } else {
+                asampl *= ((1 - contamination.probRefGivenHet) / 0.5);
+            }
+        }
+
+        if (!supported) {
+            prodQout += o->lnWrong;
+            countOut += o->scale;
+        } else {
+            prodSample += log(asampl*o->scale);
+        }
+    }
+
+    if (countOut > 1) {
+        prodQout *= (1 + (countOut - 1) * dependenceFactor) / countOut;
+    }
+    Real probObsGivenGt = prodQout + prodSample;
+    return isinf(probObsGivenGt) ? 0 : probObsGivenGt;
+
+}
+
+template <int Ploidy>
+static bool indexedKernel(
+        SampleObservationIndex& index,
+        Genotype& genotype,
+        double dependenceFactor,
+        Real& result) {
+    switch (genotype.indexCounts.size()) {
+    case 1: result = indexedKernel<Ploidy, 1>(index, genotype, dependenceFactor); return true;
+    case 2: result = indexedKernel<Ploidy, 2>(index, genotype, dependenceFactor); return true;
+    case 3: result = indexedKernel<Ploidy, 3>(index, genotype, dependenceFactor); return true;
+    case 4: result = indexedKernel<Ploidy, 4>(index, genotype, dependenceFactor); return true;
+    default: return false;
+    }
+}
+
+Real
 probObservedAllelesGivenGenotype(
         Sample& sample,
+        SampleObservationIndex& index,
+        Genotype& genotype,
+        double dependenceFactor,
+        bool useMapQ,
+        Bias& observationBias,
+        bool standardGLs,
+        vector<Allele>& genotypeAlleles,
+        Contamination& contaminations,
+        map<string, double>& freqs
+    ) {
+
+    assert(genotype.indexedFor(genotypeAlleles));
+
+    Real result;
+    if (standardGLs) {
+        if (genotype.ploidy <= 2) {
+            switch (genotype.size()) {
+            case 1: return standardGLKernel<1>(sample, index, genotype, dependenceFactor, useMapQ, observationBias);
+            case 2: return standardGLKernel<2>(sample, index, genotype, dependenceFactor, useMapQ, observationBias);
+            }
+        }
+    } else if (genotype.ploidy == 1) {
+        if (indexedKernel<1>(index, genotype, dependenceFactor, result)) {
+            return result;
+        }
+    } else if (genotype.ploidy == 2) {
+        if (indexedKernel<2>(index, genotype, dependenceFactor, result)) {
+            return result;
+        }
+    }
+
+    return genericProbObservedAllelesGivenGenotype(
+        sample, index, genotype, dependenceFactor, useMapQ, observationBias,
+        standardGLs, genotypeAlleles, contaminations, freqs);
+
+}
+
+Real
+genericProbObservedAllelesGivenGenotype(
+        Sample& sample,
+        SampleObservationIndex& index,
         Genotype& genotype,
         double dependenceFactor,
         bool useMapQ,
@@ -18,19 +282,17 @@ probObservedAllelesGivenGenotype(
 
     //cerr << "P(" << genotype << " given" << endl <<  sample;
 
-    int observationCount = sample.observationCount();
-    vector<long double> alleleProbs = genotype.alleleProbabilities(observationBias);
-    vector<int> observationCounts = genotype.alleleObservationCounts(sample);
+    assert(genotype.indexedFor(genotypeAlleles));
+
     int countOut = 0;
-    double countIn = 0;
-    long double prodQout = 0;  // the probability that the reads not in the genotype are all wrong
-    long double prodSample = 0;
+    Real prodQout = 0;  // the probability that the reads not in the genotype are all wrong
+    Real prodSample = 0;
     
     if (standardGLs) {
-        for (Sample::iterator s = sample.begin(); s != sample.end(); ++s) {
-            const string& base = s->first;
-            if (!genotype.containsAllele(base)) {
-                vector<Allele*>& alleles = s->second;
+        for (vector<pair<int, vector<Allele*>*> >::iterator s = index.baseIndexes.begin();
+             s != index.baseIndexes.end(); ++s) {
+            if (s->first == -1 || !genotype.containsAllele(s->first)) {
+                vector<Allele*>& alleles = *s->second;
                 if (useMapQ) {
                     for (vector<Allele*>::iterator a = alleles.begin(); a != alleles.end(); ++a) {
                         // take the lesser of mapping quality and base quality (in log space)
@@ -45,100 +307,48 @@ probObservedAllelesGivenGenotype(
             }
         }
     } else {
-        vector<Allele*> emptyA;
-        vector<Allele*> emptyB;
-        for (set<string>::iterator c = sample.supportedAlleles.begin();
-             c != sample.supportedAlleles.end(); ++c) {
-
-            vector<Allele*>* alleles = &emptyA;
-            Sample::iterator si = sample.find(*c);
-            if (si != sample.end()) alleles = &si->second;
-
-            vector<Allele*>* partials = &emptyB;
-            map<string, vector<Allele*> >::iterator pi = sample.partialSupport.find(*c);
-            if (pi != sample.partialSupport.end()) partials = &pi->second;
-
-            bool onPartials = false;
-            vector<Allele*>::iterator a = alleles->begin();
-            bool hasPartials = !partials->empty();
-            for ( ; (!hasPartials && a != alleles->end()) || a != partials->end(); ++a) {
-                if (a == alleles->end()) {
-                    if (hasPartials) {
-                        a = partials->begin();
-                        onPartials = true;
-                    } else {
-                        break;
-                    }
-                }
-                Allele& obs = **a;
-                //cerr << "observation: " << obs << endl;
-                long double probi = 0;
-                ContaminationEstimate& contamination = contaminations.of(obs.readGroupID);
-                double scale = 1;
-                // note that this will underflow if we have mapping quality = 0
-                // we guard against this externally, by ignoring such alignments (quality has to be > MQL0)
-                long double qual = (1.0 - exp(obs.lnquality)) * (1.0 - exp(obs.lnmapQuality));
-                
-                if (onPartials) {
-                    map<Allele*, set<Allele*> >::iterator r = sample.reversePartials.find(*a);
-                    if (r != sample.reversePartials.end()) {
-                        if (sample.reversePartials[*a].empty()) {
-                            cerr << "partial " << *a << " has empty reverse" << endl;
-                            exit(1);
-                        }
-                        //cerr << "partial " << *a << " supports potentially " << sample.reversePartials[*a].size() << " alleles : " << endl;
-                        //for (set<Allele*>::iterator m = sample.reversePartials[*a].begin();
-                        //m != sample.reversePartials[*a].end(); ++m) cerr << **m << " ";
-                        //cerr << endl;
-                        scale = (double)1/(double)sample.reversePartials[*a].size();
-                        qual *= scale;
-                    }
-                }
+        for (vector<IndexedObservation>::iterator o = index.observations.begin();
+             o != index.observations.end(); ++o) {
 
-                // TODO add partial obs, now that we have them recorded
-                // how does this work?
-                // each partial obs is recorded as supporting, but with observation probability scaled by the number of possible haplotypes it supports
-                bool isInGenotype = false;
-                long double asampl = genotype.alleleSamplingProb(obs);
-
-                // for each of the unique genotype alleles
-                for (vector<Allele>::iterator b = genotypeAlleles.begin(); b != genotypeAlleles.end(); ++b) {
-                    Allele& allele = *b;
-                    const string& base = allele.currentBase;
-                    if (genotype.containsAllele(base)
-                        && (obs.currentBase == base
-                            || (onPartials && sample.observationSupports(*a, &*b)))) {
-                        isInGenotype = true;
-                        // use the matched allele to estimate the asampl
-                        asampl = max(asampl, (long double)genotype.alleleSamplingProb(allele));
-                    }
-                }
+            ContaminationEstimate& contamination = *o->contamination;
 
-                if (asampl == 0) {
-                    // scale by frequency of (this) possibly contaminating allele
-                    asampl = contamination.probRefGivenHomAlt;
-                } else if (asampl == 1) {
-                    // scale by frequency of (other) possibly contaminating alleles
-                    asampl = 1 - contamination.probRefGivenHomAlt;
-                } else { //if (genotype.ploidy == 2) {
-                    // to deal with polyploids
-                    // note that this reduces to 1 for diploid heterozygotes
-                    // this term captures reference bias
-                    if (obs.isReference()) {
-                        asampl *= (contamination.probRefGivenHet / 0.5);
-                    } else {
-                        asampl *= ((1 - contamination.probRefGivenHet) / 0.5);
-                    }
+            bool isInGenotype = false;
+            Real asampl = (o->alleleIndex == -1) ? 0 : genotype.alleleSamplingProb(o->alleleIndex);
+
+            // for each of the unique genotype alleles the observation supports
+            for (int i = o->supportsBegin; i != o->supportsEnd; ++i) {
+                int b = index.supports[i];
+                if (genotype.containsAllele(b)) {
+                    isInGenotype = true;
+                    // use the matched allele to estimate the asampl
+                    asampl = max(asampl, (Real)genotype.alleleSamplingProb(b));
                 }
+            }
 
-                // distribute observation support across haplotypes
-                if (!isInGenotype) {
-                    prodQout += log(1-qual);
-                    countOut += scale;
+            if (asampl == 0) {
+                // scale by frequency of (this) possibly contaminating allele
+                asampl = contamination.probRefGivenHomAlt;
+            } else if (asampl == 1) {
+                // scale by frequency of (other) possibly contaminating alleles
+                asampl = 1 - contamination.probRefGivenHomAlt;
+            } else { //if (genotype.ploidy == 2) {
+                // to deal with polyploids
+                // note that this reduces to 1 for diploid heterozygotes
+                // this term captures reference bias
+                if (o->isReference) {
+                    asampl *= (contamination.probRefGivenHet / 0.5);
                 } else {
-                    prodSample += log(asampl*scale);
+                    asampl *= ((1 - contamination.probRefGivenHet) / 0.5);
                 }
             }
+
+            // distribute observation support across haplotypes
+            if (!isInGenotype) {
+                prodQout += log(1-o->qual);
+                countOut += o->scale;
+            } else {
+                prodSample += log(asampl*o->scale);
+            }
         }
     }
 
@@ -149,9 +359,11 @@ probObservedAllelesGivenGenotype(
             prodQout *= (1 + (countOut - 1) * dependenceFactor) / countOut;
         }
 
+        vector<int> observationCounts = genotype.alleleObservationCounts(sample);
         if (sum(observationCounts) == 0) {
             return prodQout;
         } else {
+            vector<Real> alleleProbs = genotype.alleleProbabilities(observationBias);
             //cerr << "P(obs|" << genotype << ") = " << prodQout + multinomialSamplingProbLn(alleleProbs, observationCounts) << endl << endl << string(80, '@') << endl << endl;
             return prodQout + multinomialSamplingProbLn(alleleProbs, observationCounts);
             //return prodQout + samplingProbLn(alleleProbs, observationCounts);
@@ -160,14 +372,33 @@ probObservedAllelesGivenGenotype(
         if (countOut > 1) {
             prodQout *= (1 + (countOut - 1) * dependenceFactor) / countOut;
         }
-        long double probObsGivenGt = prodQout + prodSample;
+        Real probObsGivenGt = prodQout + prodSample;
         return isinf(probObsGivenGt) ? 0 : probObsGivenGt;
     }
 
 }
 
+Real
+probObservedAllelesGivenGenotype(
+        Sample& sample,
+        Genotype& genotype,
+        double dependenceFactor,
+        bool useMapQ,
+        Bias& observationBias,
+        bool standardGLs,
+        vector<Allele>& genotypeAlleles,
+        Contamination& contaminations,
+        map<string, double>& freqs
+    ) {
+    SampleObservationIndex index;
+    index.build(sample, standardGLs, genotypeAlleles, contaminations);
+    return probObservedAllelesGivenGenotype(sample, index, genotype, dependenceFactor, useMapQ,
+                                            observationBias, standardGLs, genotypeAlleles,
+                                            contaminations, freqs);
+}
+
 
-vector<pair<Genotype*, long double> >
+vector<pair<Genotype*, Real> >
 probObservedAllelesGivenGenotypes(
         Sample& sample,
         vector<Genotype*>& genotypes,
@@ -179,13 +410,18 @@ probObservedAllelesGivenGenotypes(
         Contamination& contaminations,
         map<string, double>& freqs
     ) {
-    vector<pair<Genotype*, long double> > results;
+    vector<pair<Genotype*, Real> > results;
+    if (genotypes.empty()) {
+        return results;
+    }
+    SampleObservationIndex index;
+    index.build(sample, standardGLs, genotypeAlleles, contaminations);
     for (vector<Genotype*>::iterator g = genotypes.begin(); g != genotypes.end(); ++g) {
-        Genotype& genotype = **g;
         results.push_back(
 	    make_pair(*g,
                   probObservedAllelesGivenGenotype(
                       sample,
+                      index,
                       **g,
                       dependenceFactor,
                       useMapQ,
@@ -198,6 +434,45 @@ probObservedAllelesGivenGenotypes(
     return results;
 }
 
+// the likelihoods of each sample's genotypes, which depend on no other sample
+class SampleDataLikelihoodTask : public WorkerTask {
+public:
+    SampleDataLikelihoodTask(Parameters& p,
+                             Bias& b,
+                             vector<Allele>& a,
+                             Contamination& c,
+                             map<string, double>& f)
+        : parameters(p)
+        , observationBias(b)
+        , genotypeAlleles(a)
+        , contaminationEstimates(c)
+        , estimatedAlleleFrequencies(f)
+    { }
+    vector<Sample*> samples;
+    vector<vector<Genotype*> > genotypes;
+    vector<Result*> results;
+    vector<vector<pair<Genotype*, Real> > > probs;
+    void run(int i) {
+        probs[i] = probObservedAllelesGivenGenotypes(*samples[i], genotypes[i],
+                                                     parameters.RDF, parameters.useMappingQuality,
+                                                     observationBias, parameters.standardGLs,
+                                                     genotypeAlleles,
+                                                     contaminationEstimates,
+                                                     estimatedAlleleFrequencies);
+        Result& sampleData = *results[i];
+        for (vector<pair<Genotype*, Real> >::iterator p = probs[i].begin(); p != probs[i].end(); ++p) {
+            sampleData.push_back(SampleDataLikelihood(sampleData.name, samples[i], p->first, p->second, 0));
+        }
+        sortSampleDataLikelihoods(sampleData);
+    }
+private:
+    Parameters& parameters;
+    Bias& observationBias;
+    vector<Allele>& genotypeAlleles;
+    Contamination& contaminationEstimates;
+    map<string, double>& estimatedAlleleFrequencies;
+};
+
 void
 calculateSampleDataLikelihoods(
     Samples& samples,
@@ -212,8 +487,14 @@ calculateSampleDataLikelihoods(
     map<string, double>& estimatedAlleleFrequencies,
     map<string, vector<vector<SampleDataLikelihood> > >& sampleDataLikelihoodsByPopulation,
     map<string, vector<vector<SampleDataLikelihood> > >& variantSampleDataLikelihoodsByPopulation,
-    map<string, vector<vector<SampleDataLikelihood> > >& invariantSampleDataLikelihoodsByPopulation) {
+    map<string, vector<vector<SampleDataLikelihood> > >& invariantSampleDataLikelihoodsByPopulation,
+    WorkerPool& workers) {
+
+    SampleDataLikelihoodTask task(parameters, observationBias, genotypeAlleles,
+                                  contaminationEstimates, estimatedAlleleFrequencies);
 
+    // everything shared between samples is looked up, and genotypes are
+    // indexed, before the samples are run in parallel
     for (vector<string>::iterator n = parser->sampleList.begin(); n != parser->sampleList.end(); ++n) {
         //string sampleName = s->first;
         string& sampleName = *n;
@@ -228,6 +509,7 @@ calculateSampleDataLikelihoods(
         vector<Genotype>& genotypes = genotypesByPloidy[parser->currentSamplePloidy(sampleName)];
         vector<Genotype*> genotypesWithObs;
         for (vector<Genotype>::iterator g = genotypes.begin(); g != genotypes.end(); ++g) {
+            assert(g->indexedFor(genotypeAlleles));
             if (parameters.excludePartiallyObservedGenotypes) {
                 if (g->sampleHasSupportingObservationsForAllAlleles(sample)) {
                     genotypesWithObs.push_back(&*g);
@@ -251,32 +533,34 @@ calculateSampleDataLikelihoods(
             continue;
         }
 
-        vector<pair<Genotype*, long double> > probs
-            = probObservedAllelesGivenGenotypes(sample, genotypesWithObs,
-                                                parameters.RDF, parameters.useMappingQuality,
-                                                observationBias, parameters.standardGLs,
-                                                genotypeAlleles,
-                                                contaminationEstimates,
-                                                estimatedAlleleFrequencies);
-            
+        Result& sampleData = results[sampleName];
+        sampleData.name = sampleName;
+        sampleData.observations = &sample;
+
+        task.samples.push_back(&sample);
+        task.genotypes.push_back(genotypesWithObs);
+        task.results.push_back(&sampleData);
+    }
+
+    task.probs.resize(task.samples.size());
+    workers.run(task.samples.size(), task);
+
+    // gathered in sample order, as if run serially
+    for (int i = 0; i < (int) task.results.size(); ++i) {
+
+        Result& sampleData = *task.results[i];
+        string& sampleName = sampleData.name;
+
 #ifdef VERBOSE_DEBUG
         if (parameters.debug2) {
-            for (vector<pair<Genotype*, long double> >::iterator p = probs.begin(); p != probs.end(); ++p) {
+            vector<pair<Genotype*, Real> >& probs = task.probs[i];
+            for (vector<pair<Genotype*, Real> >::iterator p = probs.begin(); p != probs.end(); ++p) {
                 cerr << parser->currentSequenceName << "," << (long unsigned int) parser->currentPosition + 1 << ","
                      << sampleName << ",likelihood," << *(p->first) << "," << p->second << endl;
             }
         }
 #endif
 
-        Result& sampleData = results[sampleName];
-        sampleData.name = sampleName;
-        sampleData.observations = &sample;
-        for (vector<pair<Genotype*, long double> >::iterator p = probs.begin(); p != probs.end(); ++p) {
-            sampleData.push_back(SampleDataLikelihood(sampleName, &sample, p->first, p->second, 0));
-        }
-
-        sortSampleDataLikelihoods(sampleData);
-
         string& population = parser->samplePopulation[sampleName];
         vector<vector<SampleDataLikelihood> >& sampleDataLikelihoods = sampleDataLikelihoodsByPopulation[population];
         vector<vector<SampleDataLikelihood> >& variantSampleDataLikelihoods = variantSampleDataLikelihoodsByPopulation[population];
@@ -19,10 +19,76 @@
 #include "Contamination.h"
 #include "AlleleParser.h"
 #include "ResultData.h"
+#include "WorkerPool.h"
 
 using namespace std;
 
-long double
+// The part of each of a sample's observations which doesn't depend on the
+// genotype, with the genotype alleles it supports as indexes into the site's
+// genotype alleles.  Built once per sample and shared by all its genotypes.
+class IndexedObservation {
+public:
+    Allele* allele;
+    int alleleIndex;  // of the observed base, -1 if it isn't a genotype allele
+    int supportsBegin;  // range of SampleObservationIndex::supports
+    int supportsEnd;
+    unsigned int supportsMask;  // the same, as bits, for the first 32 alleles
+    bool isReference;
+    double scale;  // shared between the haplotypes a partial observation supports
+    Real qual;  // probability the observation is correct, scaled
+    Real lnWrong;  // log(1 - qual)
+    ContaminationEstimate* contamination;
+};
+
+class SampleObservationIndex {
+public:
+    // for the standard GLs: each of the sample's bases and observations
+    vector<pair<int, vector<Allele*>*> > baseIndexes;
+    // otherwise: every supporting and partial observation, in order
+    vector<IndexedObservation> observations;
+    vector<int> supports;
+    // from the sample's observation table, which must be built over
+    // genotypeAlleles
+    void build(Sample& sample, bool standardGLs, vector<Allele>& genotypeAlleles,
+               Contamination& contaminations);
+
+private:
+    void add(Allele* obs, int alleleIndex, double scale,
+             vector<int>::const_iterator supportsFirst,
+             vector<int>::const_iterator supportsLast,
+             Contamination& contaminations);
+};
+
+// Uses a kernel specialized for the genotype's ploidy and the number of
+// genotype alleles where there is one (ploidy 1 or 2, at most 4 alleles),
+// which gives the same result as the generic one below.
+Real
+probObservedAllelesGivenGenotype(
+        Sample& sample,
+        SampleObservationIndex& index,
+        Genotype& genotype,
+        double dependenceFactor,
+        bool useMapQ,
+        Bias& observationBias,
+        bool standardGLs,
+        vector<Allele>& genotypeAlleles,
+        Contamination& contaminations,
+        map<string, double>& freqs);
+
+Real
+genericProbObservedAllelesGivenGenotype(
+        Sample& sample,
+        SampleObservationIndex& index,
+        Genotype& genotype,
+        double dependenceFactor,
+        bool useMapQ,
+        Bias& observationBias,
+        bool standardGLs,
+        vector<Allele>& genotypeAlleles,
+        Contamination& contaminations,
+        map<string, double>& freqs);
+
+Real
 probObservedAllelesGivenGenotype(
         Sample& sample,
         Genotype& genotype,
@@ -34,7 +100,7 @@ probObservedAllelesGivenGenotype(
         Contamination& contaminations,
         map<string, double>& freqs);
 
-vector<pair<Genotype*, long double> >
+vector<pair<Genotype*, Real> >
 probObservedAllelesGivenGenotypes(
         Sample& sample,
         vector<Genotype*>& genotypes,
@@ -60,6 +126,7 @@ calculateSampleDataLikelihoods(
     map<string, double>& estimatedAlleleFrequencies,
     map<string, vector<vector<SampleDataLikelihood> > >& sampleDataLikelihoodsByPopulation,
     map<string, vector<vector<SampleDataLikelihood> > >& variantSampleDataLikelihoodsByPopulation,
-    map<string, vector<vector<SampleDataLikelihood> > >& invariantSampleDataLikelihoodsByPopulation);
+    map<string, vector<vector<SampleDataLikelihood> > >& invariantSampleDataLikelihoodsByPopulation,
+    WorkerPool& workers);
 
 #endif
@@ -2,7 +2,7 @@
 #include "Utility.h"
 #include "Sum.h"
 
-long double dirichletMaximumLikelihoodRatio(const vector<long double>& probs, const vector<int>& obs, long double s = (long double) 1.0);
-long double dirichlet(const vector<long double>& probs, const vector<int>& obs, long double s = (long double) 1.0);
-long double dirichletMaximumLikelihoodRatioln(const vector<long double>& probs, const vector<int>& obs, long double s = (long double) 1.0);
-long double dirichletln(const vector<long double>& probs, const vector<int>& obs, long double s = (long double) 1.0);
+Real dirichletMaximumLikelihoodRatio(const vector<Real>& probs, const vector<int>& obs, Real s = (Real) 1.0);
+Real dirichlet(const vector<Real>& probs, const vector<int>& obs, Real s = (Real) 1.0);
+Real dirichletMaximumLikelihoodRatioln(const vector<Real>& probs, const vector<int>& obs, Real s = (Real) 1.0);
+Real dirichletln(const vector<Real>& probs, const vector<int>& obs, Real s = (Real) 1.0);
@@ -0,0 +1,135 @@
+#include "Downsampler.h"
+#include <fstream>
+#include <algorithm>
+#include <climits>
+#include "split.h"
+#include "convert.h"
+
+
+// FNV-1a, then mixed so that names differing in their last characters
+// spread over the whole range
+static long long unsigned int nameHash(const string& name) {
+    long long unsigned int h = 14695981039346656037ULL;
+    for (string::const_iterator c = name.begin(); c != name.end(); ++c) {
+        h ^= (unsigned char) *c;
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
+}
+
+// orders held candidates so the one to evict, the highest hash, is on top
+class CandidateHashCmp {
+public:
+    CandidateHashCmp(vector<Downsampler::Candidate>& c) : candidates(c) { }
+    bool operator()(int a, int b) {
+        const Downsampler::Candidate& x = candidates[a];
+        const Downsampler::Candidate& y = candidates[b];
+        return x.hash < y.hash || (x.hash == y.hash && x.order < y.order);
+    }
+private:
+    vector<Downsampler::Candidate>& candidates;
+};
+
+class CandidateOrderCmp {
+public:
+    bool operator()(const Downsampler::Candidate& a, const Downsampler::Candidate& b) {
+        return a.order < b.order;
+    }
+};
+
+bool Downsampler::loadSampleCaps(const string& file) {
+    ifstream in(file.c_str());
+    if (!in.is_open()) {
+        return false;
+    }
+    string line;
+    while (getline(in, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        vector<string> fields = split(line, " \t");
+        int sampleCap;
+        if (fields.size() != 2 || !convert(fields[1], sampleCap) || sampleCap < 0) {
+            return false;
+        }
+        sampleCaps[fields[0]] = sampleCap;
+    }
+    return true;
+}
+
+int Downsampler::cap(const string& sample) {
+    map<string, int>::iterator c = sampleCaps.find(sample);
+    return c == sampleCaps.end() ? defaultCap : c->second;
+}
+
+void Downsampler::start(long int p) {
+    position = p;
+    offered = 0;
+    candidates.clear();
+    for (map<string, Reservoir>::iterator r = reservoirs.begin(); r != reservoirs.end(); ++r) {
+        r->second.slots = -1;
+        r->second.held.clear();
+    }
+}
+
+void Downsampler::offer(const string& sample, const string& readGroup, int alleleEstimate, BAMALIGN& alignment) {
+    Reservoir& reservoir = reservoirs[sample];
+    if (reservoir.slots < 0) {
+        // reads ending by this position no longer count against the cap
+        while (!reservoir.ends.empty() && reservoir.ends.top() <= position) {
+            reservoir.ends.pop();
+        }
+        int sampleCap = cap(sample);
+        reservoir.slots = sampleCap == 0 ? INT_MAX : max(0, sampleCap - (int) reservoir.ends.size());
+    }
+
+    long long unsigned int hash = nameHash(alignment.QNAME);
+    int order = offered++;
+    CandidateHashCmp cmp(candidates);
+    int slot;
+    if ((int) reservoir.held.size() < reservoir.slots) {
+        slot = candidates.size();
+        candidates.push_back(Candidate());
+        reservoir.held.push_back(slot);
+    } else if (!reservoir.held.empty()
+               && hash < candidates[reservoir.held.front()].hash) {
+        // replace the held read with the highest hash
+        pop_heap(reservoir.held.begin(), reservoir.held.end(), cmp);
+        slot = reservoir.held.back();
+        ++dropped;
+    } else {
+        ++dropped;
+        return;
+    }
+    Candidate& candidate = candidates[slot];
+    candidate.alignment = alignment;
+    candidate.sample = sample;
+    candidate.readGroup = readGroup;
+    candidate.alleleEstimate = alleleEstimate;
+    candidate.hash = hash;
+    candidate.order = order;
+    push_heap(reservoir.held.begin(), reservoir.held.end(), cmp);
+}
+
+void Downsampler::take(vector<Candidate>& kept) {
+    kept.swap(candidates);
+    candidates.clear();
+    sort(kept.begin(), kept.end(), CandidateOrderCmp());
+    for (map<string, Reservoir>::iterator r = reservoirs.begin(); r != reservoirs.end(); ++r) {
+        r->second.held.clear();
+    }
+}
+
+void Downsampler::registered(const string& sample, long int end) {
+    reservoirs[sample].ends.push(end);
+}
+
+void Downsampler::clear(void) {
+    reservoirs.clear();
+    candidates.clear();
+}
@@ -0,0 +1,84 @@
+#ifndef _DOWNSAMPLER_H
+#define _DOWNSAMPLER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <queue>
+#include "LeftAlign.h"
+
+using namespace std;
+
+// Caps the number of reads each sample has overlapping any position
+// (--max-coverage), deciding as reads are read in, so that reads over the cap
+// are never decoded into alleles.
+//
+// The reads offered at a position compete for the slots left below their
+// sample's cap by the reads already registered there.  Those with the lowest
+// hash of their name are kept, a bottom-k sample, so the choice doesn't
+// depend on the order of the input files.  Offered reads are held until the
+// position is finished, which bounds memory by the cap rather than by the
+// depth.
+
+class Downsampler {
+
+public:
+
+    Downsampler(void)
+        : defaultCap(0)
+        , dropped(0)
+        , position(0)
+        , offered(0)
+    { }
+
+    int defaultCap;  // 0 for no limit
+    map<string, int> sampleCaps;  // overrides, 0 for no limit
+
+    // --sample-max-coverage, lines of sample name and cap
+    bool loadSampleCaps(const string& file);
+    bool active(void) { return defaultCap > 0 || !sampleCaps.empty(); }
+
+    class Candidate {
+    public:
+        BAMALIGN alignment;
+        string sample;
+        string readGroup;
+        int alleleEstimate;  // from the mismatch pre-pass
+        long long unsigned int hash;
+        int order;  // in which it was offered
+    };
+
+    // starts collecting the reads which begin by position
+    void start(long int position);
+    void offer(const string& sample, const string& readGroup, int alleleEstimate, BAMALIGN& alignment);
+    // the reads kept, in the order they were offered; the rest are discarded
+    void take(vector<Candidate>& kept);
+    // a kept read which was registered, and occupies a slot until its end
+    void registered(const string& sample, long int end);
+    // forget registered reads, e.g. on jumping to a new target
+    void clear(void);
+
+    long unsigned int dropped;
+
+private:
+
+    class Reservoir {
+    public:
+        Reservoir(void) : slots(-1) { }
+        // ends of registered reads, the earliest first
+        priority_queue<long int, vector<long int>, greater<long int> > ends;
+        int slots;  // -1 until the first read is offered at a position
+        // candidates held, a max-heap on their hash
+        vector<int> held;
+    };
+
+    int cap(const string& sample);
+
+    long int position;
+    int offered;
+    map<string, Reservoir> reservoirs;
+    vector<Candidate> candidates;
+
+};
+
+#endif
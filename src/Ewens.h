@@ -6,16 +6,16 @@ using namespace std;
 
 // genotype priors
 
-long double alleleFrequencyProbability(const map<int, int>& alleleFrequencyCounts, long double theta);
-long double alleleFrequencyProbabilityln(const map<int, int>& alleleFrequencyCounts, long double theta);
-long double __alleleFrequencyProbabilityln(const map<int, int>& alleleFrequencyCounts, long double theta);
+Real alleleFrequencyProbability(const map<int, int>& alleleFrequencyCounts, Real theta);
+Real alleleFrequencyProbabilityln(const map<int, int>& alleleFrequencyCounts, Real theta);
+Real __alleleFrequencyProbabilityln(const map<int, int>& alleleFrequencyCounts, Real theta);
 
-class AlleleFrequencyProbabilityCache : public map<map<int, int>, long double> {
+class AlleleFrequencyProbabilityCache : public map<map<int, int>, Real> {
 public:
-    long double alleleFrequencyProbabilityln(const map<int, int>& counts, long double theta) {
-        map<map<int, int>, long double>::iterator p = find(counts);
+    Real alleleFrequencyProbabilityln(const map<int, int>& counts, Real theta) {
+        map<map<int, int>, Real>::iterator p = find(counts);
         if (p == end()) {
-            long double pln = __alleleFrequencyProbabilityln(counts, theta);
+            Real pln = __alleleFrequencyProbabilityln(counts, theta);
             insert(make_pair(counts, pln));
             return pln;
         } else {
@@ -1,6 +1,8 @@
 #include "Genotype.h"
 #include "multichoose.h"
 #include "multipermute.h"
+#include "Profiler.h"
+#include <mutex>
 
 
 vector<Allele*> Genotype::uniqueAlleles(void) {
@@ -65,6 +67,23 @@ int Genotype::alleleCount(Allele& allele) {
     }
 }
 
+void Genotype::indexAlleles(vector<Allele>& siteAlleles) {
+    indexedAlleles = &siteAlleles;
+    indexCounts.resize(siteAlleles.size());
+    for (size_t i = 0; i < siteAlleles.size(); ++i) {
+        indexCounts[i] = alleleCount(siteAlleles[i]);
+    }
+    for (Genotype::iterator e = begin(); e != end(); ++e) {
+        e->index = -1;
+        for (int i = 0; i < (int) siteAlleles.size(); ++i) {
+            if (siteAlleles[i].currentBase == e->allele.currentBase) {
+                e->index = i;
+                break;
+            }
+        }
+    }
+}
+
 // returns true when the genotype is composed of a subset of the alleles
 bool Genotype::matchesAlleles(vector<Allele>& alleles) {
     int p = 0;
@@ -233,24 +252,24 @@ bool Genotype::isHomozygousReference(void) {
 }
 
 // the probability of drawing each allele out of the genotype, ordered by allele
-vector<long double> Genotype::alleleProbabilities(void) {
-    vector<long double> probs;
+vector<Real> Genotype::alleleProbabilities(void) {
+    vector<Real> probs;
     for (vector<GenotypeElement>::const_iterator a = this->begin(); a != this->end(); ++a) {
-        probs.push_back((long double) a->count / (long double) ploidy);
+        probs.push_back((Real) a->count / (Real) ploidy);
     }
     return probs;
 }
 
 // the probability of drawing each allele out of the genotype, ordered by allele, adjusted for reference bias
-vector<long double> Genotype::alleleProbabilities(Bias& observationBias) {
-    vector<long double> probs;
+vector<Real> Genotype::alleleProbabilities(Bias& observationBias) {
+    vector<Real> probs;
     for (vector<GenotypeElement>::const_iterator a = this->begin(); a != this->end(); ++a) {
-	long double bias = 1;
+	Real bias = 1;
 	if (!a->allele.isReference()) {
 	    int alleleLengthDifference = a->allele.alternateSequence.size() - a->allele.referenceLength;
 	    bias = observationBias.bias(alleleLengthDifference);
 	}
-        probs.push_back(((long double) a->count / (long double) ploidy) * bias);
+        probs.push_back(((Real) a->count / (Real) ploidy) * bias);
     }
     normalizeSumToOne(probs);
     return probs;
@@ -351,15 +370,116 @@ bool operator<(Genotype& a, Genotype& b) {
     return false; // if the two are equal, then we return false per C++ convention
 }
 
+Genotype::Genotype(const GenotypeTemplate& genotype, vector<Allele>& siteAlleles,
+                   const vector<int>& order, bool ordered)
+    : indexedAlleles(&siteAlleles) {
+    for (vector<int>::const_iterator i = order.begin(); i != order.end(); ++i) {
+        int count = genotype.alleleCounts[*i];
+        if (count > 0) {
+            Allele& allele = siteAlleles[*i];
+            this->push_back(GenotypeElement(allele, count, *i));
+            alleleCounts[allele.currentBase] = count;
+            alleles.insert(alleles.end(), count, allele);
+        }
+    }
+    indexCounts = genotype.alleleCounts;
+    ploidy = getPloidy();
+    homozygous = isHomozygous();
+    permutationsln = 0;
+
+    if (!homozygous) {
+        // the template's sum of count factorials is in index order, which
+        // only gives the same rounding as ours for two terms or the same order
+        if (ordered || genotype.elements <= 2) {
+            permutationsln = genotype.permutationsln;
+        } else {
+            permutationsln = multinomialCoefficientLn(ploidy, counts());
+        }
+    }
+}
+
+static map<pair<int, int>, vector<GenotypeTemplate> > genotypeTemplateCache;
+static mutex genotypeTemplateMutex;
+
+const vector<GenotypeTemplate>& genotypeTemplates(int alleleCount, int ploidy) {
+    lock_guard<mutex> lock(genotypeTemplateMutex);
+    pair<int, int> key = make_pair(alleleCount, ploidy);
+    map<pair<int, int>, vector<GenotypeTemplate> >::iterator cached = genotypeTemplateCache.find(key);
+    if (cached != genotypeTemplateCache.end()) {
+        return cached->second;
+    }
+    vector<GenotypeTemplate>& templates = genotypeTemplateCache[key];
+    vector<int> indexes;
+    for (int i = 0; i < alleleCount; ++i) {
+        indexes.push_back(i);
+    }
+    vector<vector<int> > combinations = multichoose(ploidy, indexes);
+    for (vector<vector<int> >::iterator combo = combinations.begin(); combo != combinations.end(); ++combo) {
+        GenotypeTemplate genotype;
+        genotype.alleleCounts.resize(alleleCount, 0);
+        for (vector<int>::iterator i = combo->begin(); i != combo->end(); ++i) {
+            ++genotype.alleleCounts[*i];
+        }
+        vector<int> counts;
+        for (vector<int>::iterator c = genotype.alleleCounts.begin(); c != genotype.alleleCounts.end(); ++c) {
+            if (*c > 0) {
+                counts.push_back(*c);
+            }
+        }
+        genotype.elements = counts.size();
+        genotype.permutationsln = multinomialCoefficientLn(ploidy, counts);
+        templates.push_back(genotype);
+    }
+    return templates;
+}
+
+static bool alleleIndexLess(const pair<string, int>& a, const pair<string, int>& b) {
+    return a.first < b.first;
+}
+
 vector<Genotype> allPossibleGenotypes(int ploidy, vector<Allele>& potentialAlleles) {
     vector<Genotype> genotypes;
-    vector<vector<Allele> > alleleCombinations = multichoose(ploidy, potentialAlleles);
-    for (vector<vector<Allele> >::iterator combo = alleleCombinations.begin(); combo != alleleCombinations.end(); ++combo) {
-        genotypes.push_back(Genotype(*combo));
-    }
+    allPossibleGenotypes(ploidy, potentialAlleles, genotypes);
     return genotypes;
 }
 
+void allPossibleGenotypes(int ploidy, vector<Allele>& potentialAlleles, vector<Genotype>& genotypes) {
+    genotypes.clear();
+
+    // the order Genotype(vector<Allele>&) sorts alleles in
+    vector<pair<string, int> > sorted;
+    for (int i = 0; i < (int) potentialAlleles.size(); ++i) {
+        sorted.push_back(make_pair(potentialAlleles[i].currentBase, i));
+    }
+    sort(sorted.begin(), sorted.end(), alleleIndexLess);
+    vector<int> order;
+    bool ordered = true;
+    bool distinct = !sorted.empty();
+    for (int i = 0; i < (int) sorted.size(); ++i) {
+        order.push_back(sorted[i].second);
+        ordered = ordered && sorted[i].second == i;
+        if (i > 0 && sorted[i].first == sorted[i - 1].first) {
+            distinct = false;
+        }
+    }
+
+    if (!distinct) {
+        // equal alleles are grouped together, which no template does
+        vector<vector<Allele> > alleleCombinations = multichoose(ploidy, potentialAlleles);
+        for (vector<vector<Allele> >::iterator combo = alleleCombinations.begin(); combo != alleleCombinations.end(); ++combo) {
+            genotypes.push_back(Genotype(*combo));
+            genotypes.back().indexAlleles(potentialAlleles);
+        }
+        return;
+    }
+
+    const vector<GenotypeTemplate>& templates = genotypeTemplates(potentialAlleles.size(), ploidy);
+    genotypes.reserve(templates.size());
+    for (vector<GenotypeTemplate>::const_iterator t = templates.begin(); t != templates.end(); ++t) {
+        genotypes.push_back(Genotype(*t, potentialAlleles, order, ordered));
+    }
+}
+
 
 int GenotypeCombo::numberOfAlleles(void) {
     int count = 0;
@@ -389,11 +509,11 @@ void GenotypeCombo::init(bool useObsExpectations) {
 
             if (useObsExpectations) {
                 // observational frequencies for binomial priors
-                Sample::const_iterator as = sample.find(alleleBase);
-                if (as != sample.end()) {
-                    vector<Allele*> alleles = as->second;
+                const vector<Allele*>* observations = sdl.genotype->elementObservations(sample, *a);
+                if (observations) {
+                    const vector<Allele*>& alleles = *observations;
                     alleleCounter.observations += alleles.size();
-                    for (vector<Allele*>::iterator o = alleles.begin(); o != alleles.end(); ++o) {
+                    for (vector<Allele*>::const_iterator o = alleles.begin(); o != alleles.end(); ++o) {
                         const Allele& allele = **o;
                         if (allele.basesLeft >= allele.basesRight) {
                             ++alleleCounter.placedLeft;
@@ -451,15 +571,15 @@ int GenotypeCombo::alleleCount(const string& allele) {
     }
 }
 
-long double GenotypeCombo::alleleFrequency(Allele& allele) {
-    return alleleCount(allele) / (long double) numberOfAlleles();
+Real GenotypeCombo::alleleFrequency(Allele& allele) {
+    return alleleCount(allele) / (Real) numberOfAlleles();
 }
 
-long double GenotypeCombo::alleleFrequency(const string& allele) {
-    return alleleCount(allele) / (long double) numberOfAlleles();
+Real GenotypeCombo::alleleFrequency(const string& allele) {
+    return alleleCount(allele) / (Real) numberOfAlleles();
 }
 
-long double GenotypeCombo::genotypeFrequency(Genotype* genotype) {
+Real GenotypeCombo::genotypeFrequency(Genotype* genotype) {
     map<Genotype*, int>::iterator g = genotypeCounts.find(genotype);
     if (g == genotypeCounts.end()) {
         return 0;
@@ -502,9 +622,9 @@ void GenotypeCombo::updateCachedCounts(
         AlleleCounter& alleleCounter = alleleCounters[base];
         alleleCounter.frequency -= ge.count;
         if (useObsExpectations) {
-            Sample::iterator s = sample->find(base);
-            if (s != sample->end()) {
-                const vector<Allele*>& alleles = s->second;
+            const vector<Allele*>* observations = oldGenotype->elementObservations(*sample, ge);
+            if (observations) {
+                const vector<Allele*>& alleles = *observations;
                 alleleCounter.observations -= alleles.size();
                 int forward_strand = 0;
                 int reverse_strand = 0;
@@ -552,9 +672,9 @@ void GenotypeCombo::updateCachedCounts(
         AlleleCounter& alleleCounter = alleleCounters[base];
         alleleCounter.frequency += ge.count;
         if (useObsExpectations) {
-            Sample::iterator s = sample->find(base);
-            if (s != sample->end()) {
-                const vector<Allele*>& alleles = s->second;
+            const vector<Allele*>* observations = newGenotype->elementObservations(*sample, ge);
+            if (observations) {
+                const vector<Allele*>& alleles = *observations;
                 alleleCounter.observations += alleles.size();
                 int forward_strand = 0;
                 int reverse_strand = 0;
@@ -671,9 +791,9 @@ int GenotypeCombo::ploidy(void) {
     return copies;
 }
 
-vector<long double> GenotypeCombo::alleleProbs(void) {
-    vector<long double> probs;
-    long double copies = ploidy();
+vector<Real> GenotypeCombo::alleleProbs(void) {
+    vector<Real> probs;
+    Real copies = ploidy();
     for (map<string, AlleleCounter>::iterator a = alleleCounters.begin(); a != alleleCounters.end(); ++a) {
         const AlleleCounter& allele = a->second;
         probs.push_back(allele.frequency / copies);
@@ -777,14 +897,14 @@ void
 dataLikelihoodMaxGenotypeCombo(
     GenotypeCombo& combo,
     SampleDataLikelihoods& sampleDataLikelihoods,
-    long double theta,
+    Real theta,
     bool pooled,
     bool ewensPriors,
     bool permute,
     bool hwePriors,
     bool binomialObsPriors,
     bool alleleBalancePriors,
-    long double diffusionPriorScalar) {
+    Real diffusionPriorScalar) {
 
     for (SampleDataLikelihoods::iterator s = sampleDataLikelihoods.begin();
             s != sampleDataLikelihoods.end(); ++s) {
@@ -812,14 +932,14 @@ makeComboByDatalLikelihoodRank(
     SampleDataLikelihoods& variantSampleDataLikelihoods,
     SampleDataLikelihoods& invariantSampleDataLikelihoods,
     map<string, int>& priorACs,
-    long double theta,
+    Real theta,
     bool pooled,
     bool ewensPriors,
     bool permute,
     bool hwePriors,
     bool binomialObsPriors,
     bool alleleBalancePriors,
-    long double diffusionPriorScalar) {
+    Real diffusionPriorScalar) {
 
     // generate the best genotype combination according to data
     // likelihoods
@@ -864,14 +984,14 @@ allLocalGenotypeCombinations(
     SampleDataLikelihoods& sampleDataLikelihoods,
     Samples& samples,
     map<string, int>& priorACs,
-    long double theta,
+    Real theta,
     bool pooled,
     bool ewensPriors,
     bool permute,
     bool hwePriors,
     bool binomialObsPriors,
     bool alleleBalancePriors,
-    long double diffusionPriorScalar,
+    Real diffusionPriorScalar,
     bool keepCombos) {
 
     // make the data likelihood maximum if needed
@@ -924,7 +1044,7 @@ allLocalGenotypeCombinations(
             // replace genotype with new genotype
             combo.at(sampleOffset) = &*dl;
             // find data likelihood difference from ComboKing
-            long double diff = oldsdl.prob - newsdl.prob;
+            Real diff = oldsdl.prob - newsdl.prob;
             // adjust combination total data likelihood
             combo.probObsGivenGenotypes -= diff;
             combo.calculatePosteriorProbability(theta,
@@ -964,14 +1084,14 @@ bandedGenotypeCombinations(
     Samples& samples,
     map<string, int>& priorACs,
     int bandwidth, int banddepth,
-    long double theta,
+    Real theta,
     bool pooled,
     bool ewensPriors,
     bool permute,
     bool hwePriors,
     bool binomialObsPriors,
     bool alleleBalancePriors,
-    long double diffusionPriorScalar,
+    Real diffusionPriorScalar,
     bool keepCombos) {
 
     // get the number of samples that vary
@@ -1067,7 +1187,7 @@ bandedGenotypeCombinations(
                     // replace genotype with new genotype
                     oldsdl_ptr = newsdl;
                     // find data likelihood difference from ComboKing
-                    long double diff = oldsdl.prob - newsdl->prob;
+                    Real diff = oldsdl.prob - newsdl->prob;
                     // adjust combination total data likelihood
                     combo.probObsGivenGenotypes -= diff;
                 }
@@ -1109,14 +1229,14 @@ convergentGenotypeComboSearch(
     vector<Allele>& genotypeAlleles,
     map<string, int>& priorACs,
     int bandwidth, int banddepth,
-    long double theta,
+    Real theta,
     bool pooled,
     bool ewensPriors,
     bool permute,
     bool hwePriors,
     bool binomialObsPriors,
     bool alleleBalancePriors,
-    long double diffusionPriorScalar,
+    Real diffusionPriorScalar,
     int maxiterations,
     int& totaliterations,
     bool addHomozygousCombos) {
@@ -1274,14 +1394,14 @@ void addAllHomozygousCombos(
     SampleDataLikelihoods& invariantSampleDataLikelihoods,
     Samples& samples,
     vector<Allele>& genotypeAlleles,
-    long double theta,
+    Real theta,
     bool pooled,
     bool ewensPriors,
     bool permute,
     bool hwePriors,
     bool binomialObsPriors,
     bool alleleBalancePriors,
-    long double diffusionPriorScalar) {
+    Real diffusionPriorScalar) {
 
     // determine which homozygous combos we already have
 
@@ -1388,12 +1508,12 @@ void addAllHomozygousCombos(
 }
 
 // conditional probability of the genotype combination given the represented allele frequencies
-long double GenotypeCombo::probabilityGivenAlleleFrequencyln(bool permute) {
+Real GenotypeCombo::probabilityGivenAlleleFrequencyln(bool permute) {
 
     //return -multinomialCoefficientLn(numberOfAlleles(), counts());
 
     int n = numberOfAlleles();
-    long double lnhetscalar = 0;
+    Real lnhetscalar = 0;
 
     if (permute) {
         // scale by the product of permutations of heterozygotes
@@ -1404,8 +1524,8 @@ long double GenotypeCombo::probabilityGivenAlleleFrequencyln(bool permute) {
 
 }
 
-long double GenotypeCombo::hweComboProb(void) {
-    long double comboHweProb = 0;
+Real GenotypeCombo::hweComboProb(void) {
+    Real comboHweProb = 0;
     for (map<Genotype*, int>::iterator gc = genotypeCounts.begin(); gc != genotypeCounts.end(); ++gc) {
         Genotype* genotype = gc->first;
         comboHweProb += hweProbGenotypeFrequencyln(genotype);
@@ -1414,21 +1534,21 @@ long double GenotypeCombo::hweComboProb(void) {
 }
 
 // probability of the combo under HWE
-long double GenotypeCombo::hweExpectedFrequencyln(Genotype* genotype) {
+Real GenotypeCombo::hweExpectedFrequencyln(Genotype* genotype) {
 
     int ploidy = genotype->ploidy;
 
     vector<int> genotypeAlleleCounts;
-    vector<long double> alleleFrequencies;
+    vector<Real> alleleFrequencies;
     for (map<string, AlleleCounter>::iterator a = alleleCounters.begin(); a != alleleCounters.end(); ++a) {
         genotypeAlleleCounts.push_back(genotype->alleleCount(a->first));
-        alleleFrequencies.push_back((long double) a->second.frequency / (long double) numberOfAlleles());
+        alleleFrequencies.push_back((Real) a->second.frequency / (Real) numberOfAlleles());
     }
 
-    long double HWECoefficientln = multinomialCoefficientLn(ploidy, genotypeAlleleCounts);
+    Real HWECoefficientln = multinomialCoefficientLn(ploidy, genotypeAlleleCounts);
 
     vector<int>::iterator c = genotypeAlleleCounts.begin();
-    vector<long double>::iterator f = alleleFrequencies.begin();
+    vector<Real>::iterator f = alleleFrequencies.begin();
     for (; c != genotypeAlleleCounts.end(); ++c, ++f) {
          HWECoefficientln += powln(log(*f), *c);
     }
@@ -1439,7 +1559,7 @@ long double GenotypeCombo::hweExpectedFrequencyln(Genotype* genotype) {
 
 // probability that the genotype count in the combo is what it is given the
 // counts of the other alleles
-long double GenotypeCombo::hweProbGenotypeFrequencyln(Genotype* genotype) {
+Real GenotypeCombo::hweProbGenotypeFrequencyln(Genotype* genotype) {
 
     //cout << endl << *genotype << endl;
 
@@ -1471,10 +1591,10 @@ long double GenotypeCombo::hweProbGenotypeFrequencyln(Genotype* genotype) {
         }
     }
 
-    long double arrangementsOfAllelesInSample = multinomialCoefficientLn(popTotalAlleles, popAlleleCounts);
+    Real arrangementsOfAllelesInSample = multinomialCoefficientLn(popTotalAlleles, popAlleleCounts);
     //cout << "arrangementsOfAllelesInSample = " << exp(arrangementsOfAllelesInSample) << endl;
 
-    long double arrangementsWithExactlyCountGenotypesGivenAF =
+    Real arrangementsWithExactlyCountGenotypesGivenAF =
         multinomialCoefficientLn(genotype->ploidy, thisGenotypeAlleleCounts)
         + multinomialCoefficientLn(popTotalGenotypes, popGenotypeCounts);
     /*
@@ -1493,18 +1613,45 @@ long double GenotypeCombo::hweProbGenotypeFrequencyln(Genotype* genotype) {
 }
 
 
+// multinomialSamplingProbLn(alleleProbs(), observationCounts()), with the
+// counts on the stack
+template <int N>
+static Real observationCountsProbLn(GenotypeCombo& combo) {
+    Real probs[N];
+    int obs[N];
+    Real copies = combo.ploidy();
+    int i = 0;
+    for (map<string, AlleleCounter>::iterator a = combo.alleleCounters.begin(); a != combo.alleleCounters.end(); ++a, ++i) {
+        probs[i] = a->second.frequency / copies;
+        obs[i] = a->second.observations;
+    }
+    return multinomialSamplingProbLn<N>(probs, obs);
+}
+
+static Real observationCountsProbLn(GenotypeCombo& combo) {
+    switch (combo.alleleCounters.size()) {
+    case 1: return observationCountsProbLn<1>(combo);
+    case 2: return observationCountsProbLn<2>(combo);
+    case 3: return observationCountsProbLn<3>(combo);
+    case 4: return observationCountsProbLn<4>(combo);
+    default: return multinomialSamplingProbLn(combo.alleleProbs(), combo.observationCounts());
+    }
+}
+
 // core calculation of genotype combination likelihoods
 //
 void
 GenotypeCombo::calculatePosteriorProbability(
-        long double theta,
+        Real theta,
         bool pooled,
         bool ewensPriors,
         bool permute,
         bool hwePriors,
         bool binomialObsPriors,
         bool alleleBalancePriors,
-        long double diffusionPriorScalar) {
+        Real diffusionPriorScalar) {
+
+    profiler.countCombo();
 
     posteriorProb = 0;
     priorProb = 0;
@@ -1566,7 +1713,7 @@ GenotypeCombo::calculatePosteriorProbability(
     // ok... now do the same move for the observation counts
     // --- this should capture "Allele Balance"
     if (alleleBalancePriors) {
-        priorProbObservations += multinomialSamplingProbLn(alleleProbs(), observationCounts());
+        priorProbObservations += observationCountsProbLn(*this);
     }
 
     // with larger population samples, the effect of
@@ -1629,14 +1776,14 @@ void orderedGenotypeCombo(
     GenotypeCombo& combo,
     GenotypeCombo& orderedCombo,
     SampleDataLikelihoods& sampleDataLikelihoods,
-    long double theta,
+    Real theta,
     bool pooled,
     bool ewensPriors,
     bool permute,
     bool hwePriors,
     bool binomialObsPriors,
     bool alleleBalancePriors,
-    long double diffusionPriorScalar) {
+    Real diffusionPriorScalar) {
 
     GenotypeComboMap bestComboMap;
 
@@ -1692,11 +1839,25 @@ int Genotype::containedAlleleTypes(void) {
 }
 
 
+int Genotype::elementObservationCount(Sample& sample, const GenotypeElement& element) {
+    if (element.index != -1 && sample.indexedFor(indexedAlleles)) {
+        return sample.observationCount(element.index);
+    }
+    return sample.observationCount(element.allele.currentBase);
+}
+
+const vector<Allele*>* Genotype::elementObservations(const Sample& sample, const GenotypeElement& element) {
+    if (element.index != -1 && sample.indexedFor(indexedAlleles)) {
+        return sample.observations(element.index);
+    }
+    Sample::const_iterator s = sample.find(element.allele.currentBase);
+    return (s != sample.end()) ? &s->second : NULL;
+}
+
 vector<int> Genotype::alleleObservationCounts(Sample& sample) {
     vector<int> counts;
     for (Genotype::iterator i = begin(); i != end(); ++i) {
-        Allele& b = i->allele;
-        counts.push_back(sample.observationCount(b));
+        counts.push_back(elementObservationCount(sample, *i));
     }
     return counts;
 }
@@ -1704,16 +1865,22 @@ vector<int> Genotype::alleleObservationCounts(Sample& sample) {
 int Genotype::alleleObservationCount(Sample& sample) {
     int count = 0;
     for (Genotype::iterator i = begin(); i != end(); ++i) {
-        Allele& b = i->allele;
-        count += sample.observationCount(b);
+        count += elementObservationCount(sample, *i);
     }
     return count;
 }
 
 bool Genotype::sampleHasSupportingObservations(Sample& sample) {
+    if (sample.indexedFor(indexedAlleles)) {
+        for (size_t i = 0; i < indexCounts.size(); ++i) {
+            if (indexCounts[i] > 0 && sample.observationCount(i) != 0) {
+                return true;
+            }
+        }
+        return false;
+    }
     for (Genotype::iterator i = begin(); i != end(); ++i) {
-        Allele& b = i->allele;
-        if (sample.observationCount(b) != 0) {
+        if (elementObservationCount(sample, *i) != 0) {
             return true;
         }
     }
@@ -1721,6 +1888,14 @@ bool Genotype::sampleHasSupportingObservations(Sample& sample) {
 }
 
 bool Genotype::sampleHasSupportingObservationsForAllAlleles(Sample& sample) {
+    if (sample.indexedFor(indexedAlleles)) {
+        for (size_t i = 0; i < indexCounts.size(); ++i) {
+            if (indexCounts[i] > 0 && sample.observationCount(i) == 0) {
+                return false;
+            }
+        }
+        return true;
+    }
     vector<int> counts = alleleObservationCounts(sample);
     for (vector<int>::iterator c = counts.begin(); c != counts.end(); ++c) {
         if (*c == 0) {
@@ -1746,6 +1921,25 @@ map<int, vector<Genotype> > getGenotypesByPloidy(vector<int>& ploidies, vector<A
 
 }
 
+void getGenotypesByPloidy(vector<int>& ploidies, vector<Allele>& genotypeAlleles,
+                          map<int, vector<Genotype> >& genotypesByPloidy) {
+
+    set<int> wanted(ploidies.begin(), ploidies.end());
+    map<int, vector<Genotype> >::iterator g = genotypesByPloidy.begin();
+    while (g != genotypesByPloidy.end()) {
+        if (wanted.count(g->first)) {
+            ++g;
+        } else {
+            genotypesByPloidy.erase(g++);
+        }
+    }
+
+    for (set<int>::iterator p = wanted.begin(); p != wanted.end(); ++p) {
+        allPossibleGenotypes(*p, genotypeAlleles, genotypesByPloidy[*p]);
+    }
+
+}
+
 vector<Genotype*> Genotype::nullMatchingGenotypes(vector<Genotype>& gts) {
     vector<Genotype*> results;
     // assert that this genotype has null alleles
@@ -26,6 +26,19 @@
 using namespace std;
 
 
+// The genotypes of a given ploidy over any n alleles, as a count of each
+// allele index, in the order multichoose generates them.  They depend only on
+// n and the ploidy, so they are built once and bound to the alleles of each
+// site instead of being regenerated from the alleles.
+class GenotypeTemplate {
+public:
+    vector<int> alleleCounts;  // by allele index
+    int elements;  // number of distinct alleles
+    Real permutationsln;  // with counts in allele index order
+};
+
+const vector<GenotypeTemplate>& genotypeTemplates(int alleleCount, int ploidy);
+
 // each genotype is a vetor of GenotypeElements, each is a count of alleles
 class GenotypeElement {
 
@@ -34,7 +47,8 @@ class GenotypeElement {
 public:
     Allele allele;
     int count;
-    GenotypeElement(const Allele& a, int c) : allele(a), count(c) { }
+    int index;  // of the allele among the site's alleles, -1 until indexed
+    GenotypeElement(const Allele& a, int c, int i = -1) : allele(a), count(c), index(i) { }
 
 };
 
@@ -51,9 +65,14 @@ public:
     vector<Allele> alleles;
     map<string, int> alleleCounts;
     bool homozygous;
-    long double permutationsln;  // aka, multinomialCoefficientLn(ploidy, counts())
-
-    Genotype(vector<Allele>& ungroupedAlleles) {
+    Real permutationsln;  // aka, multinomialCoefficientLn(ploidy, counts())
+    // alleleCount() of each of the site's genotype alleles, by index, so the
+    // likelihood kernels can look counts up without string comparisons
+    vector<int> indexCounts;
+    // the alleles indexCounts was built over, NULL until indexed
+    const vector<Allele>* indexedAlleles;
+
+    Genotype(vector<Allele>& ungroupedAlleles) : indexedAlleles(NULL) {
         alleles = ungroupedAlleles;
         sort(alleles.begin(), alleles.end());
         vector<vector<Allele> > groups = groupAlleles_copy(alleles);
@@ -71,6 +90,22 @@ public:
 
     }
 
+    // binds a template to the site's alleles, order being the allele indexes
+    // sorted as the Allele constructor above would sort them
+    Genotype(const GenotypeTemplate& genotype, vector<Allele>& siteAlleles,
+             const vector<int>& order, bool ordered);
+
+    // sets indexCounts and the elements' indexes for the alleles this
+    // genotype was built from; done by allPossibleGenotypes, before the
+    // genotypes are shared between threads
+    void indexAlleles(vector<Allele>& siteAlleles);
+    bool indexedFor(vector<Allele>& siteAlleles) {
+        return indexedAlleles == &siteAlleles && indexCounts.size() == siteAlleles.size();
+    }
+    int alleleCount(int index) { return indexCounts[index]; }
+    bool containsAllele(int index) { return indexCounts[index] > 0; }
+    double alleleSamplingProb(int index) { return (double) indexCounts[index] / (double) ploidy; }
+
     vector<Allele*> uniqueAlleles(void);
     int getPloidy(void);
     int alleleCount(const string& base);
@@ -83,8 +118,8 @@ public:
     vector<string> alternateBases(string& refbase);
     vector<int> counts(void);
     // the probability of drawing each allele out of the genotype, ordered by allele
-    vector<long double> alleleProbabilities(void);
-    vector<long double> alleleProbabilities(Bias& observationBias);
+    vector<Real> alleleProbabilities(void);
+    vector<Real> alleleProbabilities(Bias& observationBias);
     double alleleSamplingProb(const string& base);
     double alleleSamplingProb(Allele& allele);
     string str(void) const;
@@ -99,6 +134,10 @@ public:
     int containedAlleleTypes(void);
     vector<int> alleleObservationCounts(Sample& sample);
     int alleleObservationCount(Sample& sample);
+    // an element's observations in the sample, by index where the sample's
+    // observations are indexed over the same alleles; NULL if there are none
+    int elementObservationCount(Sample& sample, const GenotypeElement& element);
+    const vector<Allele*>* elementObservations(const Sample& sample, const GenotypeElement& element);
     bool sampleHasSupportingObservations(Sample& sample);
     bool sampleHasSupportingObservationsForAllAlleles(Sample& sample);
     bool hasNullAllele(void);
@@ -111,17 +150,18 @@ string IUPAC(Genotype& g);
 string IUPAC2GenotypeStr(string iupac);
 
 vector<Genotype> allPossibleGenotypes(int ploidy, vector<Allele>& potentialAlleles);
+void allPossibleGenotypes(int ploidy, vector<Allele>& potentialAlleles, vector<Genotype>& genotypes);
 
 class SampleDataLikelihood {
 public:
     string name;
     Genotype* genotype;
-    long double prob;
-    long double marginal;
+    Real prob;
+    Real marginal;
     Sample* sample;
     bool hasObservations;
     int rank; // the rank of this data likelihood relative to others for the sample, 0 is best
-    SampleDataLikelihood(string n, Sample* s, Genotype* g, long double p, int r)
+    SampleDataLikelihood(string n, Sample* s, Genotype* g, Real p, int r)
         : name(n)
         , sample(s)
         , genotype(g)
@@ -169,9 +209,9 @@ public:
     // GenotypeCombo::prob is equal to the sum of probs in the combo.  We
     // factor it out so that we can construct the probabilities efficiently as
     // we generate the genotype combinations
-    long double probObsGivenGenotypes;  // aka data likelihood
+    Real probObsGivenGenotypes;  // aka data likelihood
 
-    long double permutationsln;  // the number of perutations of unphased genotypes in the combo
+    Real permutationsln;  // the number of perutations of unphased genotypes in the combo
 
     // these *must* be generated at construction time
     // for efficiency they can be updated as each genotype combo is generated
@@ -201,13 +241,13 @@ public:
     void appendIndependentCombo(GenotypeCombo& other);
 
     int numberOfAlleles(void);
-    vector<long double> alleleProbs(void);  // scales counts() by the total number of alleles
+    vector<Real> alleleProbs(void);  // scales counts() by the total number of alleles
     int ploidy(void); // the number of copies of the locus in this combination
     int alleleCount(Allele& allele);
     int alleleCount(const string& allele);
-    long double alleleFrequency(Allele& allele);
-    long double alleleFrequency(const string& allele);
-    long double genotypeFrequency(Genotype* genotype);
+    Real alleleFrequency(Allele& allele);
+    Real alleleFrequency(const string& allele);
+    Real genotypeFrequency(Genotype* genotype);
     void updateCachedCounts(Sample* sample, Genotype* oldGenotype, Genotype* newGenotype, bool useObsExpectations);
     map<string, int> countAlleles(void);
     map<int, int> countFrequencies(void);
@@ -221,32 +261,32 @@ public:
 
     // posterior
 
-    long double posteriorProb; // p(genotype combo) * p(observations | genotype combo)
+    Real posteriorProb; // p(genotype combo) * p(observations | genotype combo)
 
     // priors
 
-    long double priorProb; // p(genotype combo) = p(genotype combo | allele frequency) * p(allele frequency) * p(observations)
-    long double priorProbG_Af; // p(genotype combo | allele frequency)
-    long double priorProbAf; // p(allele frequency)
-    long double priorProbObservations; // p(observations)
-    long double priorProbGenotypesGivenHWE;
+    Real priorProb; // p(genotype combo) = p(genotype combo | allele frequency) * p(allele frequency) * p(observations)
+    Real priorProbG_Af; // p(genotype combo | allele frequency)
+    Real priorProbAf; // p(allele frequency)
+    Real priorProbObservations; // p(observations)
+    Real priorProbGenotypesGivenHWE;
 
     //GenotypeCombo* combo,
     void calculatePosteriorProbability(
-        long double theta,
+        Real theta,
         bool pooled,
         bool ewensPriors,
         bool permute,
         bool hwePriors,
         bool obsBinomialPriors,
         bool alleleBalancePriors,
-        long double diffusionPriorScalarln);
+        Real diffusionPriorScalarln);
 
-    long double probabilityGivenAlleleFrequencyln(bool permute);
+    Real probabilityGivenAlleleFrequencyln(bool permute);
 
-    long double hweExpectedFrequencyln(Genotype* genotype);
-    long double hweProbGenotypeFrequencyln(Genotype* genotype);
-    long double hweComboProb(void);
+    Real hweExpectedFrequencyln(Genotype* genotype);
+    Real hweProbGenotypeFrequencyln(Genotype* genotype);
+    Real hweComboProb(void);
 
 };
 
@@ -324,14 +364,14 @@ orderedGenotypeCombo(
     GenotypeCombo& combo,
     GenotypeCombo& orderedCombo,
     SampleDataLikelihoods& sampleDataLikelihoods,
-    long double theta,
+    Real theta,
     bool pooled,
     bool ewensPriors,
     bool permute,
     bool hwePriors,
     bool binomialObsPriors,
     bool alleleBalancePriors,
-    long double diffusionPriorScalar);
+    Real diffusionPriorScalar);
 
 void
 makeComboByDatalLikelihoodRank(
@@ -340,27 +380,27 @@ makeComboByDatalLikelihoodRank(
     SampleDataLikelihoods& variantSampleDataLikelihoods,
     SampleDataLikelihoods& invariantSampleDataLikelihoods,
     map<string, int>& priorACs,
-    long double theta,
+    Real theta,
     bool pooled,
     bool ewensPriors,
     bool permute,
     bool hwePriors,
     bool binomialObsPriors,
     bool alleleBalancePriors,
-    long double diffusionPriorScalar);
+    Real diffusionPriorScalar);
 
 void
 dataLikelihoodMaxGenotypeCombo(
     GenotypeCombo& combo,
     SampleDataLikelihoods& sampleDataLikelihoods,
-    long double theta,
+    Real theta,
     bool pooled,
     bool ewensPriors,
     bool permute,
     bool hwePriors,
     bool binomialObsPriors,
     bool alleleBalancePriors,
-    long double diffusionPriorScalar);
+    Real diffusionPriorScalar);
 
 bool
 bandedGenotypeCombinations(
@@ -371,14 +411,15 @@ bandedGenotypeCombinations(
     Samples& samples,
     map<string, int>& priorACs,
     int bandwidth, int banddepth,
-    long double theta,
+    Real theta,
     bool pooled,
     bool ewensPriors,
     bool permute,
     bool hwePriors,
     bool binomialObsPriors,
     bool alleleBalancePriors,
-    long double diffusionPriorScalar);
+    Real diffusionPriorScalar,
+    bool keepCombos);
 
 void
 allLocalGenotypeCombinations(
@@ -387,14 +428,14 @@ allLocalGenotypeCombinations(
     SampleDataLikelihoods& sampleDataLikelihoods,
     Samples& samples,
     map<string, int>& priorACs,
-    long double theta,
+    Real theta,
     bool pooled,
     bool ewensPriors,
     bool permute,
     bool hwePriors,
     bool binomialObsPriors,
     bool alleleBalancePriors,
-    long double diffusionPriorScalar,
+    Real diffusionPriorScalar,
     bool keepCombos);
 
 void
@@ -408,14 +449,14 @@ convergentGenotypeComboSearch(
     vector<Allele>& genotypeAlleles,
     map<string, int>& priorACs,
     int bandwidth, int banddepth,
-    long double theta,
+    Real theta,
     bool pooled,
     bool ewensPriors,
     bool permute,
     bool hwePriors,
     bool binomialObsPriors,
     bool alleleBalancePriors,
-    long double diffusionPriorScalar,
+    Real diffusionPriorScalar,
     int maxiterations,
     int& totaliterations,
     bool addHomozygousCombos);
@@ -428,14 +469,14 @@ addAllHomozygousCombos(
     SampleDataLikelihoods& invariantSampleDataLikelihoods,
     Samples& samples,
     vector<Allele>& genotypeAlleles,
-    long double theta,
+    Real theta,
     bool pooled,
     bool ewensPriors,
     bool permute,
     bool hwePriors,
     bool binomialObsPriors,
     bool alleleBalancePriors,
-    long double diffusionPriorScalar);
+    Real diffusionPriorScalar);
 
 
 vector<pair<Allele, int> > alternateAlleles(GenotypeCombo& combo, string referenceBase);
@@ -446,6 +487,9 @@ ostream& operator<<(ostream& out, list<GenotypeCombo>& combo);
 ostream& operator<<(ostream& out, GenotypeCombo& g);
 
 map<int, vector<Genotype> > getGenotypesByPloidy(vector<int>& ploidies, vector<Allele>& genotypeAlleles);
+// refills genotypesByPloidy, reusing the storage of ploidies it already has
+void getGenotypesByPloidy(vector<int>& ploidies, vector<Allele>& genotypeAlleles,
+                          map<int, vector<Genotype> >& genotypesByPloidy);
 
 void combinePopulationCombos(list<GenotypeCombo>& genotypeCombos,
                              map<string, list<GenotypeCombo> >& genotypeCombosByPopulation);
@@ -415,3 +415,285 @@ int countMismatches(BAMALIGN& alignment, string referenceSequence) {
     }
 
 }
+
+// the in-place engine
+
+static bool sameBases(const char* a, const char* b, int length) {
+    for (int i = 0; i < length; ++i) {
+        if (a[i] != b[i]) return false;
+    }
+    return true;
+}
+
+static bool homopolymer(const char* sequence, int length) {
+    for (int i = 1; i < length; ++i) {
+        if (sequence[i] != sequence[0]) return false;
+    }
+    return true;
+}
+
+static const char* indelSequence(const LeftAlignIndel& indel, const char* reference, const char* read) {
+    return indel.insertion ? read + indel.readPosition : reference + indel.position;
+}
+
+// One step of leftAlign over the cigar in workspace.cigar, leaving the result
+// in workspace.realigned.  Returns 1 if the cigar changed, 0 if not, and -1
+// if the cigar runs off the read or reference, where leftAlign would have
+// worked on truncated sequences.
+static int leftAlignStep(BAMALIGN& alignment,
+                         const char* reference,
+                         int referenceLength,
+                         LeftAlignWorkspace& workspace) {
+
+    const char* read = workspace.read.data();
+    int readLength = workspace.read.size();
+    vector<LeftAlignOp>& cigar = workspace.cigar;
+    vector<LeftAlignIndel>& indels = workspace.indels;
+    indels.clear();
+
+    int rp = 0;  // read position, 0-based relative to read
+    int sp = 0;  // sequence position
+    int softBegin = 0;
+    int softEnd = 0;
+
+    for (vector<LeftAlignOp>::iterator c = cigar.begin(); c != cigar.end(); ++c) {
+        int l = c->length;
+        char t = c->type;
+        if (t == 'M' || t == 'X' || t == '=') {
+            sp += l;
+            rp += l;
+        } else if (t == 'D' || t == 'N') {
+            if (sp + l > referenceLength) return -1;
+            indels.push_back(LeftAlignIndel(false, t == 'N', l, sp, rp));
+            sp += l;
+        } else if (t == 'I') {
+            if (rp + l > readLength) return -1;
+            indels.push_back(LeftAlignIndel(true, false, l, sp, rp));
+            rp += l;
+        } else if (t == 'S') {
+            if (rp == 0) {
+                softBegin = l;
+            } else {
+                softEnd = l;
+            }
+            rp += l;
+        }
+    }
+    if (sp > referenceLength || rp > readLength) return -1;
+
+    int alignedLength = sp;
+
+    if (indels.empty()) { return 0; }
+
+    // shift each indel left, by its repeat unit and then by exchanging flanking bases
+    vector<LeftAlignIndel>::iterator previous = indels.begin();
+    for (vector<LeftAlignIndel>::iterator id = indels.begin(); id != indels.end(); ++id) {
+
+        LeftAlignIndel& indel = *id;
+        bool first = id == indels.begin();
+        int i = 1;
+        while (i <= indel.length) {
+            int steppos = indel.position - i;
+            int readsteppos = indel.readPosition - i;
+            while (steppos >= 0 && readsteppos >= 0
+                   && !indel.splice
+                   && steppos + indel.length <= referenceLength
+                   && readsteppos + indel.length <= readLength
+                   && sameBases(indelSequence(indel, reference, read), reference + steppos, indel.length)
+                   && sameBases(indelSequence(indel, reference, read), read + readsteppos, indel.length)
+                   && (first
+                       || (previous->insertion && steppos >= previous->position)
+                       || (!previous->insertion && steppos >= previous->position + previous->length))) {
+                indel.position -= i;
+                indel.readPosition -= i;
+                steppos = indel.position - i;
+                readsteppos = indel.readPosition - i;
+            }
+            do {
+                ++i;
+            } while (i <= indel.length && indel.length % i != 0);
+        }
+
+        int steppos = indel.position - 1;
+        int readsteppos = indel.readPosition - 1;
+        while (steppos >= 0 && readsteppos >= 0
+               && read[readsteppos] == reference[steppos]
+               && read[readsteppos] == indelSequence(indel, reference, read)[indel.length - 1]
+               && (first
+                   || (previous->insertion && indel.position - 1 >= previous->position)
+                   || (!previous->insertion && indel.position - 1 >= previous->position + previous->length))) {
+            indel.position -= 1;
+            indel.readPosition -= 1;
+            steppos = indel.position - 1;
+            readsteppos = indel.readPosition - 1;
+        }
+        previous = id;
+    }
+
+    // bring together floating homopolymer indels
+    //
+    // leftAlign also tries to right-merge tandem repeats, but as it only
+    // scans rightwards from the indel it never finds a position left of it,
+    // so that never changes anything and is left out here
+    if (indels.size() > 1) {
+        previous = indels.begin();
+        for (vector<LeftAlignIndel>::iterator id = (indels.begin() + 1); id != indels.end(); ++id) {
+            LeftAlignIndel& indel = *id;
+            int prev_end_ref = previous->insertion ? previous->position : previous->position + previous->length;
+            int prev_end_read = !previous->insertion ? previous->readPosition : previous->readPosition + previous->length;
+            if (!previous->splice && !indel.splice &&
+                previous->insertion == indel.insertion
+                    && ((previous->insertion
+                        && (previous->position < indel.position
+                        && previous->readPosition + previous->readPosition < indel.readPosition))
+                        ||
+                        (!previous->insertion
+                        && (previous->position + previous->length < indel.position)
+                        && (previous->readPosition < indel.readPosition)
+                        ))) {
+                const char* previousSequence = indelSequence(*previous, reference, read);
+                if (homopolymer(previousSequence, previous->length)) {
+                    int between = indel.position - prev_end_ref;
+                    int readBetween = min(between, readLength - prev_end_read);
+                    if (previousSequence[0] == reference[prev_end_ref]
+                        && homopolymer(reference + prev_end_ref, between)
+                        && readBetween > 0
+                        && homopolymer(read + prev_end_read, readBetween)) {
+                        previous->position = indel.insertion ? indel.position : indel.position - previous->length;
+                    }
+                }
+            }
+            previous = id;
+        }
+    }
+
+    // merge indels which now abut, and rebuild the cigar
+    vector<LeftAlignOp>& newCigar = workspace.realigned;
+    newCigar.clear();
+
+    if (softBegin) {
+        newCigar.push_back(LeftAlignOp('S', softBegin));
+    }
+
+    vector<LeftAlignIndel>::iterator id = indels.begin();
+    LeftAlignIndel last = *id++;
+    if (last.position > 0) {
+        newCigar.push_back(LeftAlignOp('M', last.position));
+    }
+    newCigar.push_back(LeftAlignOp(last.insertion ? 'I' : (last.splice ? 'N' : 'D'), last.length));
+    int lastend = last.insertion ? last.position : (last.position + last.length);
+
+    for (; id != indels.end(); ++id) {
+        LeftAlignIndel& indel = *id;
+        if (indel.position < lastend) {
+            cerr << "impossibility?: indel realigned left of another indel" << endl << alignment.QNAME
+                << " " << alignment.POSITION << endl << alignment.QUERYBASES << endl;
+            exit(1);
+        } else if (indel.position == lastend && indel.insertion == last.insertion) {
+            newCigar.back().length += indel.length;
+        } else {
+            newCigar.push_back(LeftAlignOp('M', indel.position - lastend));
+            newCigar.push_back(LeftAlignOp(indel.insertion ? 'I' : (indel.splice ? 'N' : 'D'), indel.length));
+        }
+        last = indel;
+        lastend = last.insertion ? last.position : (last.position + last.length);
+    }
+
+    if (lastend < alignedLength) {
+        newCigar.push_back(LeftAlignOp('M', alignedLength - lastend));
+    }
+
+    if (softEnd) {
+        newCigar.push_back(LeftAlignOp('S', softEnd));
+    }
+
+    return newCigar == cigar ? 0 : 1;
+
+}
+
+// load the read and cigar into the workspace
+static void loadAlignment(BAMALIGN& alignment, LeftAlignWorkspace& workspace) {
+    workspace.original.clear();
+#ifdef HAVE_BAMTOOLS
+    workspace.read.assign(alignment.QueryBases);
+    for (vector<CigarOp>::const_iterator c = alignment.CigarData.begin(); c != alignment.CigarData.end(); ++c) {
+        workspace.original.push_back(LeftAlignOp(c->Type, c->Length));
+    }
+#else
+    const bam1_t* b = alignment.raw();
+    const uint8_t* seq = bam_get_seq(b);
+    workspace.read.resize(b->core.l_qseq);
+    for (int i = 0; i < b->core.l_qseq; ++i) {
+        workspace.read[i] = seq_nt16_str[bam_seqi(seq, i)];
+    }
+    const uint32_t* cigar = bam_get_cigar(b);
+    for (int i = 0; i < b->core.n_cigar; ++i) {
+        workspace.original.push_back(LeftAlignOp(bam_cigar_opchr(cigar[i]), bam_cigar_oplen(cigar[i])));
+    }
+#endif
+    workspace.cigar = workspace.original;
+}
+
+static void storeCigar(BAMALIGN& alignment, const vector<LeftAlignOp>& ops) {
+#ifdef HAVE_BAMTOOLS
+    alignment.CigarData.clear();
+    for (vector<LeftAlignOp>::const_iterator o = ops.begin(); o != ops.end(); ++o) {
+        alignment.CigarData.push_back(CigarOp(o->type, o->length));
+    }
+#else
+    bam1_t* b = alignment.raw();
+    if (b->core.n_cigar == ops.size()) {
+        // the reference span is unchanged, so we can overwrite the cigar where it is
+        uint32_t* cigar = bam_get_cigar(b);
+        for (int i = 0; i < ops.size(); ++i) {
+            int op = strchr(BAM_CIGAR_STR, ops[i].type) - BAM_CIGAR_STR;
+            cigar[i] = bam_cigar_gen(ops[i].length, op);
+        }
+    } else {
+        SeqLib::Cigar cigar;
+        for (vector<LeftAlignOp>::const_iterator o = ops.begin(); o != ops.end(); ++o) {
+            cigar.add(SeqLib::CigarField(o->type, o->length));
+        }
+        alignment.SetCigar(cigar);
+    }
+#endif
+}
+
+bool stablyLeftAlign(BAMALIGN& alignment,
+                     const char* referenceSequence,
+                     int referenceLength,
+                     LeftAlignWorkspace& workspace,
+                     int maxiterations,
+                     bool debug) {
+
+#ifdef VERBOSE_DEBUG
+    // the string version reports each step
+    if (debug) {
+        return stablyLeftAlign(alignment, string(referenceSequence, referenceLength), maxiterations, debug);
+    }
+#endif
+
+    loadAlignment(alignment, workspace);
+
+    int changed = leftAlignStep(alignment, referenceSequence, referenceLength, workspace);
+    if (changed < 0) {
+        return stablyLeftAlign(alignment, string(referenceSequence, referenceLength), maxiterations, debug);
+    } else if (changed == 0) {
+        return true;
+    }
+
+    do {
+        workspace.cigar.swap(workspace.realigned);
+        changed = leftAlignStep(alignment, referenceSequence, referenceLength, workspace);
+    } while (changed > 0 && --maxiterations > 0);
+
+    if (changed > 0) {
+        workspace.cigar.swap(workspace.realigned);
+    }
+    if (!(workspace.cigar == workspace.original)) {
+        storeCigar(alignment, workspace.cigar);
+    }
+
+    return maxiterations > 0;
+
+}
@@ -85,7 +85,7 @@ using namespace BamTools;
 #define GETREFNUM Header().NumSequences()
 #define ENDPOSITION PositionEnd()
 #define CIGAR SeqLib::Cigar
-#define BAMREADER SeqLib::BamReader
+#define BAMREADER BamMergeReader
 #define BAMSINGLEREADER SeqLib::BamReader
 #define GETCIGAR GetCigar()
 #define GETREFID(name) Header().Name2ID(name)
@@ -98,6 +98,7 @@ using namespace BamTools;
 #define GETHEADERTEXT HeaderConcat()
 #include "SeqLib/BamReader.h"
 #include "SeqLib/BamWriter.h"
+#include "BamMergeReader.h"
 #define STDIN "-"
 #define WRITEALIGNMENT(writer, alignment) writer.WriteRecord(alignment)
 #endif
@@ -120,4 +121,52 @@ bool leftAlign(BAMALIGN& alignment, string& referenceSequence, bool debug = fals
 bool stablyLeftAlign(BAMALIGN& alignment, string referenceSequence, int maxiterations = 20, bool debug = false);
 int countMismatches(BAMALIGN& alignment, string referenceSequence);
 
+// In-place left-alignment.
+//
+// Gives the same cigars as stablyLeftAlign, but compares indels against the
+// read and reference where they lie instead of building gapped copies of
+// both, and works on cigar operations rather than strings.  The alignment is
+// only touched if its cigar changes.  All buffers live in the workspace, so
+// reusing one workspace across alignments avoids allocating per read.
+
+class LeftAlignOp {
+public:
+    char type;
+    int length;
+    LeftAlignOp(char t, int l) : type(t), length(l) { }
+    bool operator==(const LeftAlignOp& other) const {
+        return type == other.type && length == other.length;
+    }
+};
+
+// as FBIndelAllele, but without a copy of the sequence: deletions always lie
+// over their sequence in the reference, and insertions in the read
+class LeftAlignIndel {
+public:
+    bool insertion;
+    bool splice;
+    int length;
+    int position;
+    int readPosition;
+    LeftAlignIndel(bool i, bool n, int l, int p, int rp)
+        : insertion(i), splice(n), length(l), position(p), readPosition(rp) { }
+};
+
+class LeftAlignWorkspace {
+public:
+    string read;  // read bases
+    vector<LeftAlignOp> original;
+    vector<LeftAlignOp> cigar;
+    vector<LeftAlignOp> realigned;
+    vector<LeftAlignIndel> indels;
+};
+
+// referenceSequence points at the reference base under the alignment start
+bool stablyLeftAlign(BAMALIGN& alignment,
+                     const char* referenceSequence,
+                     int referenceLength,
+                     LeftAlignWorkspace& workspace,
+                     int maxiterations = 20,
+                     bool debug = false);
+
 #endif
@@ -4,10 +4,25 @@
 #include "Utility.h"
 #include <vector>
 
-long double multinomialSamplingProb(const vector<long double>& probs, const vector<int>& obs);
-long double multinomialSamplingProbLn(const vector<long double>& probs, const vector<int>& obs);
-long double multinomialCoefficientLn(int n, const vector<int>& counts);
+Real multinomialSamplingProb(const vector<Real>& probs, const vector<int>& obs);
+Real multinomialSamplingProbLn(const vector<Real>& probs, const vector<int>& obs);
+Real multinomialCoefficientLn(int n, const vector<int>& counts);
 
-long double samplingProbLn(const vector<long double>& probs, const vector<int>& obs);
+Real samplingProbLn(const vector<Real>& probs, const vector<int>& obs);
+
+// multinomialSamplingProbLn over N categories held in arrays, for the common
+// small cases; gives the same result, summing in the same order
+template <int N>
+Real multinomialSamplingProbLn(const Real* probs, const int* obs) {
+    Real factorials = 0;
+    Real probsPowObs = 0;
+    int total = 0;
+    for (int i = 0; i < N; ++i) {
+        factorials += factorialln(obs[i]);
+        probsPowObs += powln(log(probs[i]), obs[i]);
+        total += obs[i];
+    }
+    return factorialln(total) - factorials + probsPowObs;
+}
 
 #endif
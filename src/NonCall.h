@@ -23,7 +23,7 @@ public:
         , nCount(0)
 
     { }
-    NonCall(int rc, long double rq, int ac, long double aq, int mdp)
+    NonCall(int rc, Real rq, int ac, Real aq, int mdp)
         : refCount(rc)
         , reflnQ(rq)
         , altCount(ac)
@@ -34,8 +34,8 @@ public:
     int altCount;
     int minDepth;
     int nCount  ; 
-    long double reflnQ;
-    long double altlnQ;
+    Real reflnQ;
+    Real altlnQ;
 };
 
 class NonCalls : public map<string, map<long, map<string, NonCall> > > {
@@ -0,0 +1,21 @@
+#ifndef __NUMERIC_H
+#define __NUMERIC_H
+
+// The floating point types of the likelihood calculations: Real for
+// probabilities, likelihoods and the priors and posteriors built from them,
+// QualityReal for the qualities held by each observation.
+//
+// Both are long double unless built with FAST_GL (make fastgl), which uses
+// double for the calculations and float for the observations, halving the
+// memory they take and letting the compiler vectorize over them.  The calls
+// move slightly; test/gl_concordance.sh measures by how much.
+
+#ifdef FAST_GL
+typedef double Real;
+typedef float QualityReal;
+#else
+typedef long double Real;
+typedef long double QualityReal;
+#endif
+
+#endif
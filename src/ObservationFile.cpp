@@ -0,0 +1,543 @@
+#include "ObservationFile.h"
+#include "fastlz.h"
+#include <string.h>
+
+
+// encoding helpers
+
+void putVarint(string& b, unsigned long long v) {
+    while (v >= 0x80) {
+        b += (char) (v | 0x80);
+        v >>= 7;
+    }
+    b += (char) v;
+}
+
+void putSigned(string& b, long long v) {
+    putVarint(b, ((unsigned long long) v << 1) ^ (unsigned long long) (v >> 63));
+}
+
+void putDouble(string& b, double d) {
+    char c[sizeof(double)];
+    memcpy(c, &d, sizeof(double));
+    b.append(c, sizeof(double));
+}
+
+// as the sum of two doubles, which holds an x87 long double exactly
+void putLongDouble(string& b, long double d) {
+    double hi = d;
+    double lo = isfinite(hi) ? (double) (d - hi) : 0;
+    putDouble(b, hi);
+    putDouble(b, lo);
+}
+
+void corrupt(const string& path) {
+    cerr << "ERROR(freebayes): observation file " << path << " is corrupt" << endl;
+    exit(1);
+}
+
+unsigned long long getVarint(const string& b, size_t& c, const string& path) {
+    unsigned long long v = 0;
+    int shift = 0;
+    while (true) {
+        if (c >= b.size() || shift > 63) corrupt(path);
+        unsigned char byte = b[c++];
+        v |= (unsigned long long) (byte & 0x7f) << shift;
+        if (!(byte & 0x80)) break;
+        shift += 7;
+    }
+    return v;
+}
+
+long long getSigned(const string& b, size_t& c, const string& path) {
+    unsigned long long v = getVarint(b, c, path);
+    return (long long) (v >> 1) ^ -(long long) (v & 1);
+}
+
+double getDouble(const string& b, size_t& c, const string& path) {
+    if (c + sizeof(double) > b.size()) corrupt(path);
+    double d;
+    memcpy(&d, b.data() + c, sizeof(double));
+    c += sizeof(double);
+    return d;
+}
+
+long double getLongDouble(const string& b, size_t& c, const string& path) {
+    long double hi = getDouble(b, c, path);
+    return hi + getDouble(b, c, path);
+}
+
+template <typename T>
+void writeRaw(ofstream& out, T value) {
+    out.write((const char*) &value, sizeof(T));
+}
+
+template <typename T>
+bool readRaw(ifstream& in, T& value) {
+    return in.read((char*) &value, sizeof(T)).good();
+}
+
+// the header and index are small, and read with the block helpers
+bool readBytes(ifstream& in, string& b, size_t length) {
+    b.resize(length);
+    return length == 0 || in.read(&b[0], length).good();
+}
+
+
+bool ObservationWriter::open(const string& p, const vector<pair<string, long int> >& sequences) {
+    path = p;
+    out.open(path.c_str(), ios::out | ios::binary);
+    if (!out.is_open()) {
+        return false;
+    }
+    string header;
+    putVarint(header, sequences.size());
+    for (vector<pair<string, long int> >::const_iterator s = sequences.begin(); s != sequences.end(); ++s) {
+        putVarint(header, s->first.size());
+        header.append(s->first);
+        putVarint(header, s->second);
+    }
+    out.write(OBSERVATION_FILE_MAGIC, OBSERVATION_FILE_MAGIC_LENGTH);
+    writeRaw(out, (long long) header.size());
+    out.write(header.data(), header.size());
+    return out.good();
+}
+
+bool ObservationWriter::startRegion(int refid, long int left) {
+    if (refid == regionRefID) {
+        if (left < regionLeft) {
+            return false;
+        }
+    } else {
+        if (finishedRefIDs.count(refid)) {
+            return false;
+        }
+        if (regionRefID != -1) {
+            finishedRefIDs.insert(regionRefID);
+        }
+    }
+    regionRefID = refid;
+    regionLeft = left;
+    if (refid == frontierRefID) {
+        repeatedNames = frontierNames;
+    } else {
+        repeatedNames.clear();
+    }
+    return true;
+}
+
+void ObservationWriter::writeString(const string& s) {
+    map<string, int>::iterator i = strings.find(s);
+    if (i == strings.end()) {
+        i = strings.insert(make_pair(s, (int) strings.size())).first;
+        stringOrder.push_back(&i->first);
+    }
+    putVarint(record, i->second);
+}
+
+void ObservationWriter::writeAllele(Allele& allele, RegisteredAlignment& ra) {
+    putVarint(record, allele.type);
+    writeString(allele.referenceName);
+    writeString(allele.referenceSequence);
+    writeString(allele.alternateSequence);
+    writeString(allele.sequencingTechnology);
+    putSigned(record, allele.position - (long int) ra.start);
+    putVarint(record, allele.length);
+    putVarint(record, allele.referenceLength);
+    putSigned(record, allele.repeatRightBoundary);
+    putSigned(record, allele.basesLeft);
+    putSigned(record, allele.basesRight);
+    putVarint(record, allele.strand);
+    writeString(allele.sampleID);
+    writeString(allele.readGroupID);
+    writeString(allele.readID);
+    putVarint(record, allele.baseQualities.size());
+    for (vector<short>::iterator q = allele.baseQualities.begin(); q != allele.baseQualities.end(); ++q) {
+        putSigned(record, *q);
+    }
+    putLongDouble(record, allele.quality);
+    putLongDouble(record, allele.lnquality);
+    writeString(allele.currentBase);
+    putSigned(record, allele.mapQuality);
+    putLongDouble(record, allele.lnmapQuality);
+    putDouble(record, allele.readMismatchRate);
+    putDouble(record, allele.readIndelRate);
+    putDouble(record, allele.readSNPRate);
+    putVarint(record, allele.isProperPair
+              | allele.isPaired << 1
+              | allele.isMateMapped << 2
+              | allele.genotypeAllele << 3
+              | allele.processed << 4);
+    writeString(allele.cigar);
+    putSigned(record, allele.alignmentStart - (long int) ra.start);
+    putSigned(record, allele.alignmentEnd - (long int) ra.end);
+}
+
+void ObservationWriter::write(RegisteredAlignment& ra) {
+
+    long int start = ra.start;
+
+    // drop alignments registered again for an overlapping target
+    if (ra.refid == frontierRefID) {
+        if (start < frontierStart) {
+            ++duplicates;
+            return;
+        } else if (start == frontierStart) {
+            multiset<string>::iterator n = repeatedNames.find(ra.name);
+            if (n != repeatedNames.end()) {
+                repeatedNames.erase(n);
+                ++duplicates;
+                return;
+            }
+        }
+    }
+    if (ra.refid != frontierRefID || start > frontierStart) {
+        frontierRefID = ra.refid;
+        frontierStart = start;
+        frontierNames.clear();
+        repeatedNames.clear();
+    }
+    frontierNames.insert(ra.name);
+
+    if (blockCount > 0 && ra.refid != blockRefID) {
+        flush();
+    }
+    if (blockCount == 0) {
+        blockRefID = ra.refid;
+        blockFirstStart = start;
+        blockMaxEnd = ra.end;
+        lastStart = start;
+    }
+
+    record.clear();
+    putVarint(record, start - lastStart);
+    putVarint(record, ra.end - ra.start);
+    writeString(ra.name);
+    writeString(ra.readgroup);
+    putVarint(record, ra.mismatches);
+    putVarint(record, ra.snpCount);
+    putVarint(record, ra.indelCount);
+    putVarint(record, ra.alleleTypes);
+    putVarint(record, ra.alleles.size());
+    for (AlignmentAlleles::iterator a = ra.alleles.begin(); a != ra.alleles.end(); ++a) {
+        writeAllele(*a, ra);
+    }
+    putVarint(block, record.size());
+    block.append(record);
+
+    blockMaxEnd = max(blockMaxEnd, (long int) ra.end);
+    lastStart = start;
+    ++blockCount;
+    ++written;
+
+    if (block.size() >= OBSERVATION_BLOCK_SIZE) {
+        flush();
+    }
+
+}
+
+bool ObservationWriter::flush(void) {
+    if (blockCount == 0) {
+        return true;
+    }
+    string data;
+    putVarint(data, stringOrder.size());
+    for (vector<const string*>::iterator s = stringOrder.begin(); s != stringOrder.end(); ++s) {
+        putVarint(data, (*s)->size());
+        data.append(**s);
+    }
+    data.append(block);
+
+    // stored as is if it doesn't compress
+    string compressed(max((size_t) 66, data.size() + data.size() / 20 + 1), '\0');
+    int compressedSize = data.size() < 16 ? data.size() : fastlz_compress(data.data(), data.size(), &compressed[0]);
+    if (compressedSize >= (int) data.size()) {
+        compressed = data;
+        compressedSize = data.size();
+    }
+
+    ObservationBlockIndex entry;
+    entry.refid = blockRefID;
+    entry.firstStart = blockFirstStart;
+    entry.maxEnd = blockMaxEnd;
+    entry.offset = out.tellp();
+    index.push_back(entry);
+
+    writeRaw(out, (int) blockRefID);
+    writeRaw(out, (long long) blockFirstStart);
+    writeRaw(out, (long long) blockMaxEnd);
+    writeRaw(out, (int) blockCount);
+    writeRaw(out, (int) data.size());
+    writeRaw(out, (int) compressedSize);
+    out.write(compressed.data(), compressedSize);
+
+    block.clear();
+    strings.clear();
+    stringOrder.clear();
+    blockCount = 0;
+    return out.good();
+}
+
+bool ObservationWriter::close(void) {
+    if (!out.is_open()) {
+        return true;
+    }
+    bool ok = flush();
+    long long indexOffset = out.tellp();
+    writeRaw(out, (long long) index.size());
+    for (vector<ObservationBlockIndex>::iterator i = index.begin(); i != index.end(); ++i) {
+        writeRaw(out, (int) i->refid);
+        writeRaw(out, (long long) i->firstStart);
+        writeRaw(out, (long long) i->maxEnd);
+        writeRaw(out, (long long) i->offset);
+    }
+    writeRaw(out, indexOffset);
+    out.write(OBSERVATION_FILE_MAGIC, OBSERVATION_FILE_MAGIC_LENGTH);
+    ok = ok && out.good();
+    out.close();
+    return ok;
+}
+
+
+// orders blocks by sequence, then by their first start
+class BlockStartLess {
+public:
+    bool operator()(const ObservationBlockIndex& a, const ObservationBlockIndex& b) const {
+        return a.refid < b.refid || (a.refid == b.refid && a.firstStart < b.firstStart);
+    }
+};
+
+// orders blocks by sequence, then by their running maxEnd
+class BlockEndLess {
+public:
+    bool operator()(const ObservationBlockIndex& a, const ObservationBlockIndex& b) const {
+        return a.refid < b.refid || (a.refid == b.refid && a.runningMaxEnd < b.runningMaxEnd);
+    }
+};
+
+bool ObservationReader::open(const string& p) {
+    path = p;
+    in.open(path.c_str(), ios::in | ios::binary);
+    if (!in.is_open()) {
+        return false;
+    }
+
+    string magic;
+    long long headerSize;
+    string header;
+    if (!readBytes(in, magic, OBSERVATION_FILE_MAGIC_LENGTH)
+        || magic != string(OBSERVATION_FILE_MAGIC, OBSERVATION_FILE_MAGIC_LENGTH)
+        || !readRaw(in, headerSize)
+        || !readBytes(in, header, headerSize)) {
+        cerr << "ERROR(freebayes): " << path << " is not a freebayes observation file" << endl;
+        exit(1);
+    }
+    size_t c = 0;
+    size_t n = getVarint(header, c, path);
+    for (size_t i = 0; i < n; ++i) {
+        size_t length = getVarint(header, c, path);
+        if (c + length > header.size()) corrupt(path);
+        string name = header.substr(c, length);
+        c += length;
+        fileSequences.push_back(make_pair(name, (long int) getVarint(header, c, path)));
+    }
+
+    // the index is found through the trailer, which is missing if the run
+    // writing the file didn't finish
+    long long indexOffset;
+    long long blocks;
+    in.seekg(-(long long) (sizeof(long long) + OBSERVATION_FILE_MAGIC_LENGTH), ios::end);
+    if (!readRaw(in, indexOffset)
+        || !readBytes(in, magic, OBSERVATION_FILE_MAGIC_LENGTH)
+        || magic != string(OBSERVATION_FILE_MAGIC, OBSERVATION_FILE_MAGIC_LENGTH)) {
+        cerr << "ERROR(freebayes): observation file " << path << " is incomplete" << endl;
+        exit(1);
+    }
+    in.seekg(indexOffset);
+    if (!readRaw(in, blocks)) corrupt(path);
+    index.resize(blocks);
+    for (vector<ObservationBlockIndex>::iterator i = index.begin(); i != index.end(); ++i) {
+        int refid;
+        long long firstStart, maxEnd, offset;
+        if (!readRaw(in, refid) || !readRaw(in, firstStart) || !readRaw(in, maxEnd) || !readRaw(in, offset)) {
+            corrupt(path);
+        }
+        i->refid = refid;
+        i->firstStart = firstStart;
+        i->maxEnd = maxEnd;
+        i->offset = offset;
+    }
+    // blocks are written in order within each sequence, but the sequences
+    // come in the order of the targets
+    stable_sort(index.begin(), index.end(), BlockStartLess());
+    for (size_t i = 0; i < index.size(); ++i) {
+        index[i].runningMaxEnd = index[i].maxEnd;
+        if (i > 0 && index[i - 1].refid == index[i].refid) {
+            index[i].runningMaxEnd = max(index[i].maxEnd, index[i - 1].runningMaxEnd);
+        }
+    }
+    return true;
+}
+
+bool ObservationReader::checkSequences(const vector<pair<string, long int> >& sequences) {
+    return sequences == fileSequences;
+}
+
+void ObservationReader::setRegion(int refid, long int left, long int right) {
+    hasRegion = true;
+    regionRefID = refid;
+    regionLeft = left;
+    regionRight = right;
+    // the first block which may hold an alignment overlapping the region,
+    // the first of the sequence's blocks whose running maxEnd is past left
+    ObservationBlockIndex key;
+    key.refid = refid;
+    key.runningMaxEnd = left;
+    vector<ObservationBlockIndex>::iterator b
+        = upper_bound(index.begin(), index.end(), key, BlockEndLess());
+    nextBlock = (b != index.end() && b->refid == refid) ? b - index.begin() : index.size();
+    remaining = 0;
+    peeked = false;
+}
+
+bool ObservationReader::loadBlock(size_t i) {
+    ProfileTimer timer(PROFILE_READ_DECODE);
+    int refid, count, size, compressedSize;
+    long long firstStart, maxEnd;
+    string compressed;
+    in.clear();
+    in.seekg(index[i].offset);
+    if (!readRaw(in, refid) || !readRaw(in, firstStart) || !readRaw(in, maxEnd)
+        || !readRaw(in, count) || !readRaw(in, size) || !readRaw(in, compressedSize)
+        || !readBytes(in, compressed, compressedSize)) {
+        corrupt(path);
+    }
+    if (compressedSize == size) {
+        block.swap(compressed);
+    } else {
+        block.resize(size);
+        if (fastlz_decompress(compressed.data(), compressedSize, &block[0], size) != size) {
+            corrupt(path);
+        }
+    }
+    cursor = 0;
+    strings.resize(getVarint(block, cursor, path));
+    for (vector<string>::iterator s = strings.begin(); s != strings.end(); ++s) {
+        size_t length = getVarint(block, cursor, path);
+        if (cursor + length > block.size()) corrupt(path);
+        s->assign(block, cursor, length);
+        cursor += length;
+    }
+    currentRefID = refid;
+    remaining = count;
+    lastStart = firstStart;
+    return true;
+}
+
+bool ObservationReader::peek(void) {
+    while (!peeked) {
+        if (remaining == 0) {
+            if (nextBlock >= index.size()
+                || (hasRegion && index[nextBlock].refid != regionRefID)) {
+                return false;
+            }
+            loadBlock(nextBlock++);
+            continue;
+        }
+        size_t length = getVarint(block, cursor, path);
+        recordEnd = cursor + length;
+        if (recordEnd > block.size()) corrupt(path);
+        nextStart = lastStart + getVarint(block, cursor, path);
+        nextEnd = nextStart + getVarint(block, cursor, path);
+        recordCursor = cursor;
+        if (hasRegion && nextStart > regionRight) {
+            // alignments are sorted by start, so we're done with the region
+            remaining = 0;
+            nextBlock = index.size();
+            return false;
+        }
+        if (hasRegion && nextEnd <= regionLeft) {
+            cursor = recordEnd;
+            lastStart = nextStart;
+            --remaining;
+            continue;
+        }
+        peeked = true;
+    }
+    return true;
+}
+
+const string& ObservationReader::readString(void) {
+    size_t i = getVarint(block, cursor, path);
+    if (i >= strings.size()) corrupt(path);
+    return strings[i];
+}
+
+void ObservationReader::readAllele(Allele& allele, RegisteredAlignment& ra) {
+    allele.type = (AlleleType) getVarint(block, cursor, path);
+    allele.referenceName = readString();
+    allele.referenceSequence = readString();
+    allele.alternateSequence = readString();
+    allele.sequencingTechnology = readString();
+    allele.position = ra.start + getSigned(block, cursor, path);
+    allele.length = getVarint(block, cursor, path);
+    allele.referenceLength = getVarint(block, cursor, path);
+    allele.repeatRightBoundary = getSigned(block, cursor, path);
+    allele.basesLeft = getSigned(block, cursor, path);
+    allele.basesRight = getSigned(block, cursor, path);
+    allele.strand = (AlleleStrand) getVarint(block, cursor, path);
+    allele.sampleID = readString();
+    allele.readGroupID = readString();
+    allele.readID = readString();
+    allele.baseQualities.resize(getVarint(block, cursor, path));
+    for (vector<short>::iterator q = allele.baseQualities.begin(); q != allele.baseQualities.end(); ++q) {
+        *q = getSigned(block, cursor, path);
+    }
+    allele.quality = getLongDouble(block, cursor, path);
+    allele.lnquality = getLongDouble(block, cursor, path);
+    allele.currentBase = readString();
+    allele.mapQuality = getSigned(block, cursor, path);
+    allele.lnmapQuality = getLongDouble(block, cursor, path);
+    allele.readMismatchRate = getDouble(block, cursor, path);
+    allele.readIndelRate = getDouble(block, cursor, path);
+    allele.readSNPRate = getDouble(block, cursor, path);
+    int flags = getVarint(block, cursor, path);
+    allele.isProperPair = flags & 1;
+    allele.isPaired = flags & 2;
+    allele.isMateMapped = flags & 4;
+    allele.genotypeAllele = flags & 8;
+    allele.processed = flags & 16;
+    allele.cigar = readString();
+    allele.alignmentStart = ra.start + getSigned(block, cursor, path);
+    allele.alignmentEnd = ra.end + getSigned(block, cursor, path);
+}
+
+void ObservationReader::read(RegisteredAlignment& ra, long int* currentPosition, char* currentReferenceBase) {
+    // as decoding a read from a BAM file
+    ProfileTimer timer(PROFILE_READ_DECODE);
+    cursor = recordCursor;
+    ra.start = nextStart;
+    ra.end = nextEnd;
+    ra.refid = currentRefID;
+    ra.name = readString();
+    ra.readgroup = readString();
+    ra.mismatches = getVarint(block, cursor, path);
+    ra.snpCount = getVarint(block, cursor, path);
+    ra.indelCount = getVarint(block, cursor, path);
+    ra.alleleTypes = getVarint(block, cursor, path);
+    size_t alleles = getVarint(block, cursor, path);
+    ra.alleles.clear();
+    ra.alleles.reserve(alleles);
+    for (size_t i = 0; i < alleles; ++i) {
+        ra.alleles.push_back(Allele(ALLELE_REFERENCE, "", 0, 0, ""));
+        Allele& allele = ra.alleles.back();
+        readAllele(allele, ra);
+        allele.currentReferencePosition = currentPosition;
+        allele.currentReferenceBase = currentReferenceBase;
+        allele.alignmentAlleles = &ra.alleles;
+    }
+    if (cursor != recordEnd) corrupt(path);
+    lastStart = nextStart;
+    --remaining;
+    peeked = false;
+}
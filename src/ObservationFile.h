@@ -0,0 +1,176 @@
+#ifndef _OBSERVATION_FILE_H
+#define _OBSERVATION_FILE_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <utility>
+#include "AlleleParser.h"
+
+using namespace std;
+
+// Stores the alignments registered by AlleleParser, after read filtering,
+// left alignment and decomposition into alleles, so that the same data can
+// be genotyped again (with other priors, ploidies or allele thresholds)
+// without decoding the BAM files or rebuilding each read's alleles.
+//
+// The file holds the reference sequences of the BAM header, so we can check
+// it is read with the same refids, then blocks of alignments in position
+// order, then an index of the blocks:
+//
+//     "FBOBS" version
+//     number of sequences, (name, length) ...
+//     block: refid, first start, max end, count, size, compressed size, data
+//     ...
+//     index: number of blocks, (refid, first start, max end, offset) ...
+//     offset of the index, "FBOBS" version
+//
+// Block data is FastLZ-compressed.  Integers are varints and strings are
+// written once per block and then referred to by number, so each block can
+// be decoded on its own after seeking to it through the index.
+
+#define OBSERVATION_FILE_MAGIC "FBOBS\x01"
+#define OBSERVATION_FILE_MAGIC_LENGTH 6
+// uncompressed size at which a block is written out
+#define OBSERVATION_BLOCK_SIZE 0x100000
+
+class ObservationBlockIndex {
+public:
+    int refid;
+    long int firstStart;
+    long int maxEnd;
+    long long offset;
+    // on reading, the greatest maxEnd of this and the earlier blocks of the
+    // sequence, which is ordered, so a region's first block is found by
+    // binary search
+    long int runningMaxEnd;
+};
+
+class ObservationWriter {
+
+public:
+
+    ObservationWriter(void)
+        : written(0)
+        , duplicates(0)
+        , blockCount(0)
+        , frontierRefID(-1)
+        , frontierStart(-1)
+        , regionRefID(-1)
+        , regionLeft(-1)
+    { }
+
+    bool open(const string& path, const vector<pair<string, long int> >& sequences);
+    // the alignments of a new target follow; those already written when
+    // processing overlapping targets are dropped
+    bool startRegion(int refid, long int left);
+    void write(RegisteredAlignment& ra);
+    // writes the last block and the index
+    bool close(void);
+
+    long unsigned int written;
+    long unsigned int duplicates;
+
+private:
+
+    ofstream out;
+    string path;
+    vector<ObservationBlockIndex> index;
+
+    // the block being built, its strings are written ahead of the records
+    string block;
+    map<string, int> strings;
+    vector<const string*> stringOrder;
+    string record;
+    int blockRefID;
+    long int blockFirstStart;
+    long int blockMaxEnd;
+    long int lastStart;
+    int blockCount;
+
+    // the last alignment written, and the names of those written at its
+    // start, which a following overlapping target registers again
+    int frontierRefID;
+    long int frontierStart;
+    multiset<string> frontierNames;
+    multiset<string> repeatedNames;
+    // targets must come in order within each sequence
+    set<int> finishedRefIDs;
+    int regionRefID;
+    long int regionLeft;
+
+    void writeString(const string& s);
+    void writeAllele(Allele& allele, RegisteredAlignment& ra);
+    bool flush(void);
+
+};
+
+class ObservationReader {
+
+public:
+
+    ObservationReader(void)
+        : hasRegion(false)
+        , nextBlock(0)
+        , cursor(0)
+        , currentRefID(-1)
+        , remaining(0)
+        , peeked(false)
+    { }
+
+    bool open(const string& path);
+    // false if the file was written against other reference sequences
+    bool checkSequences(const vector<pair<string, long int> >& sequences);
+
+    // restricts reading to alignments overlapping left..right (0-based,
+    // inclusive), like a region query on an indexed BAM
+    void setRegion(int refid, long int left, long int right);
+
+    // true if there is another alignment, whose refid, start and end are then
+    // available without reading it
+    bool peek(void);
+    int refid(void) { return currentRefID; }
+    long int start(void) { return nextStart; }
+    long int end(void) { return nextEnd; }
+
+    // reads the peeked alignment into ra; its alleles are pointed at the
+    // parser's current position and reference base
+    void read(RegisteredAlignment& ra, long int* currentPosition, char* currentReferenceBase);
+
+private:
+
+    ifstream in;
+    string path;
+    vector<pair<string, long int> > fileSequences;
+    vector<ObservationBlockIndex> index;
+
+    bool hasRegion;
+    int regionRefID;
+    long int regionLeft;
+    long int regionRight;
+
+    // the decoded block
+    size_t nextBlock;
+    string block;
+    size_t cursor;
+    vector<string> strings;
+    int currentRefID;
+    int remaining;
+    long int lastStart;
+    // the header of the next alignment, read by peek
+    bool peeked;
+    size_t recordCursor;
+    size_t recordEnd;
+    long int nextStart;
+    long int nextEnd;
+
+    bool loadBlock(size_t i);
+    const string& readString(void);
+    void readAllele(Allele& allele, RegisteredAlignment& ra);
+
+};
+
+#endif
@@ -104,6 +104,31 @@ void Parameters::usage(char** argv) {
         << "   -L --bam-list FILE" << endl
         << "                   A file containing a list of BAM files to be analyzed." << endl
         << "   -c --stdin      Read BAM input on stdin." << endl
+        << "   --read-ahead N  Decode alignments on a separate thread, buffering up to N" << endl
+        << "                   reads ahead of the caller.  Duplicates and reads below" << endl
+        << "                   --min-mapping-quality are dropped on that thread.  16384" << endl
+        << "                   is a reasonable size.  default: 0 (decode on the main thread)" << endl
+        << "   --max-open-files N" << endl
+        << "                   Hold no more than N alignment files open at once.  Files are" << endl
+        << "                   opened when the merge first reaches them and closed when" << endl
+        << "                   exhausted.  At the limit, the least recently read file is" << endl
+        << "                   closed and later reopened via its index.  0 uses the process" << endl
+        << "                   limit on open files.  default: 0" << endl
+        << "   --header-cache FILE" << endl
+        << "                   Keep the headers of the input BAMs in FILE.  Later runs over" << endl
+        << "                   unchanged files (same resolved path, inode, size and mtime)" << endl
+        << "                   read them from there instead of opening every file at" << endl
+        << "                   startup.  FILE may be shared by concurrent jobs." << endl
+        << "   --dump-observations FILE" << endl
+        << "                   Write the alignments used in the analysis to FILE, after read" << endl
+        << "                   filtering, left alignment and their decomposition into" << endl
+        << "                   alleles.  Targets must be sorted within each sequence." << endl
+        << "   --from-observations FILE" << endl
+        << "                   Read alignments from FILE, written by --dump-observations," << endl
+        << "                   instead of the BAM files, which are then only read for their" << endl
+        << "                   headers.  Read filters, --max-coverage and" << endl
+        << "                   --left-align-indels apply when the file is written, allele" << endl
+        << "                   selection, priors and genotyping options on each run." << endl
         << "   -f --fasta-reference FILE" << endl
         << "                   Use FILE as the reference sequence for analysis." << endl
         << "                   An index file (FILE.fai) will be created if none exists." << endl
@@ -134,11 +159,23 @@ void Parameters::usage(char** argv) {
         << endl
         << "output:" << endl
         << endl
-        << "   -v --vcf FILE   Output VCF-format results to FILE. (default: stdout)" << endl
+        << "   -v --vcf FILE   Output VCF-format results to FILE, bgzip-compressed if FILE" << endl
+        << "                   ends in .gz. (default: stdout)" << endl
         << "   --gvcf" << endl
         << "                   Write gVCF output, which indicates coverage in uncalled regions." << endl
         << "   --gvcf-chunk NUM" << endl
         << "                   When writing gVCF output emit a record for every NUM bases." << endl
+        << "   --checkpoint FILE" << endl
+        << "                   Periodically record in FILE where the run can be resumed" << endl
+        << "                   from, at positions with no overlapping alignments.  The" << endl
+        << "                   output must be written with --vcf.  Not available with" << endl
+        << "                   --stdin, or when dumping or replaying observations." << endl
+        << "   --checkpoint-interval N" << endl
+        << "                   Write a checkpoint at most every N seconds.  default: 600" << endl
+        << "   --resume        Continue the run recorded in the --checkpoint file, which" << endl
+        << "                   must have been started with the same arguments, appending" << endl
+        << "                   to its output.  Runs from the start if there is no" << endl
+        << "                   checkpoint yet." << endl
         << "   -@ --variant-input VCF" << endl
         << "                   Use variants reported in VCF file as input to the algorithm." << endl
         << "                   Variants in this file will included in the output even if" << endl
@@ -277,7 +314,15 @@ void Parameters::usage(char** argv) {
         << "   --min-coverage N" << endl
         << "                   Require at least this coverage to process a site. default: 0" << endl
         << "   --max-coverage N" << endl
-        << "                   Do not process sites with greater than this coverage. default: no limit" << endl
+        << "                   Downsample each sample to at most N reads overlapping any" << endl
+        << "                   position.  Reads over the limit are dropped as they are read," << endl
+        << "                   keeping those with the lowest hash of their name, so the" << endl
+        << "                   choice doesn't depend on the order of the input files." << endl
+        << "                   default: no limit" << endl
+        << "   --sample-max-coverage FILE" << endl
+        << "                   Per-sample limits for --max-coverage, overriding it for the" << endl
+        << "                   listed samples.  FILE has lines of sample name and limit," << endl
+        << "                   where 0 is no limit." << endl
         << endl
         << "population priors:" << endl
         << endl
@@ -348,11 +393,21 @@ void Parameters::usage(char** argv) {
         << "   -= --genotype-qualities" << endl
         << "                   Calculate the marginal probability of genotypes and report as GQ in" << endl
         << "                   each sample field in the VCF output." << endl
+        << "   --threads N     Calculate the data likelihoods of samples, and search the" << endl
+        << "                   genotype combinations of populations (--populations), on" << endl
+        << "                   N threads.  Output doesn't depend on N.  default: 1" << endl
         << endl
         << "debugging:" << endl
         << endl
         << "   -d --debug      Print debugging output." << endl
         << "   -dd             Print more verbose debugging output (requires \"make DEBUG\")" << endl
+        << "   --profile FILE  Write time spent in each phase of calling, per-contig totals," << endl
+        << "                   and percentiles of the time taken per site to FILE as JSON." << endl
+        << "   --trace-slow-sites MS FILE" << endl
+        << "                   Write a line to FILE for each site taking longer than MS" << endl
+        << "                   milliseconds, from the end of the previous site, giving its" << endl
+        << "                   coverage, alleles, haplotype length, genotypes per ploidy," << endl
+        << "                   genotype combos scored, iterations, and time in each phase." << endl
         << endl
         << endl
         << "author:   Erik Garrison <erik.garrison@bc.edu>, Marth Lab, Boston College, 2010-2014" << endl
@@ -386,8 +441,16 @@ Parameters::Parameters(int argc, char** argv) {
     cnvFile = "";
     output = "vcf";               // -v --vcf
     outputFile = "";
+    readAhead = 0;             // --read-ahead
+    maxOpenFiles = 0;          // --max-open-files
+    headerCacheFile = "";      // --header-cache
+    observationsOutput = "";   // --dump-observations
+    observationsInput = "";    // --from-observations
     gVCFout = false;
     gVCFchunk = 0;
+    checkpointFile = "";       // --checkpoint
+    checkpointInterval = 600;  // --checkpoint-interval
+    resume = false;            // --resume
     alleleObservationBiasFile = "";
 
     // operation parameters
@@ -424,6 +487,7 @@ Parameters::Parameters(int argc, char** argv) {
     reportGenotypeLikelihoodMax = false;
     genotypingMaxIterations = 1000;
     genotypingMaxBandDepth = 7;
+    threads = 1;                 // --threads
     minPairedAltCount = 0;
     minAltMeanMapQ = 0;
     limitGL = 0;
@@ -462,9 +526,13 @@ Parameters::Parameters(int argc, char** argv) {
     //minAltQSumTotal = 0;
     minCoverage = 0;
     maxCoverage = 0;
+    sampleMaxCoverageFile = "";
     debuglevel = 0;
     debug = false;
     debug2 = false;
+    profileFile = "";            // --profile
+    traceSlowSitesMs = 0;        // --trace-slow-sites
+    traceSlowSitesFile = "";
 
     showReferenceRepeats = false;
 
@@ -477,6 +545,11 @@ Parameters::Parameters(int argc, char** argv) {
             {"bam", required_argument, 0, 'b'},
             {"bam-list", required_argument, 0, 'L'},
             {"stdin", no_argument, 0, 'c'},
+            {"read-ahead", required_argument, 0, '<'},
+            {"max-open-files", required_argument, 0, '>'},
+            {"header-cache", required_argument, 0, '~'},
+            {"dump-observations", required_argument, 0, '|'},
+            {"from-observations", required_argument, 0, ']'},
             {"fasta-reference", required_argument, 0, 'f'},
             {"targets", required_argument, 0, 't'},
             {"region", required_argument, 0, 'r'},
@@ -486,6 +559,9 @@ Parameters::Parameters(int argc, char** argv) {
             {"vcf", required_argument, 0, 'v'},
             {"gvcf", no_argument, 0, '8'},
             {"gvcf-chunk", required_argument, 0, '&'},
+            {"checkpoint", required_argument, 0, '.'},
+            {"checkpoint-interval", required_argument, 0, ';'},
+            {"resume", no_argument, 0, '`'},
             {"use-duplicate-reads", no_argument, 0, '4'},
             {"no-partial-observations", no_argument, 0, '['},
             {"use-best-n-alleles", required_argument, 0, 'n'},
@@ -534,6 +610,7 @@ Parameters::Parameters(int argc, char** argv) {
             {"min-alternate-qsum", required_argument, 0, '3'},
             {"min-coverage", required_argument, 0, '!'},
             {"max-coverage", required_argument, 0, '+'},
+            {"sample-max-coverage", required_argument, 0, '*'},
             {"genotype-qualities", no_argument, 0, '='},
             {"variant-input", required_argument, 0, '@'},
             {"only-use-input-alleles", no_argument, 0, 'l'},
@@ -543,6 +620,7 @@ Parameters::Parameters(int argc, char** argv) {
             {"site-selection-max-iterations", required_argument, 0, 'M'},
             {"genotyping-max-iterations", required_argument, 0, 'B'},
             {"genotyping-max-banddepth", required_argument, 0, '7'},
+            {"threads", required_argument, 0, '"'},
             {"haplotype-basis-alleles", required_argument, 0, '9'},
             {"report-genotype-likelihood-max", no_argument, 0, '5'},
             {"report-all-haplotype-alleles", no_argument, 0, '6'},
@@ -552,6 +630,8 @@ Parameters::Parameters(int argc, char** argv) {
             {"contamination-estimates", required_argument, 0, ','},
             {"report-monomorphic", no_argument, 0, '6'},
             {"debug", no_argument, 0, 'd'},
+            {"profile", required_argument, 0, '{'},
+            {"trace-slow-sites", required_argument, 0, '}'},
             {0, 0, 0, 0}
 
         };
@@ -559,7 +639,7 @@ Parameters::Parameters(int argc, char** argv) {
     while (true) {
 
         int option_index = 0;
-        c = getopt_long(argc, argv, "hcO4ZKjH[0diN5a)Ik=wl6#uVXJY:b:G:M:x:@:A:f:t:r:s:v:n:B:p:m:q:R:Q:U:$:e:T:P:D:^:S:W:F:C:&:L:8z:1:3:E:7:2:9:%:_:,:(:!:+:",
+        c = getopt_long(argc, argv, "hcO4ZKjH[0diN5a)Ik=wl6#uVXJY:b:G:M:x:@:A:f:t:r:s:v:n:B:p:m:q:R:Q:U:$:e:T:P:D:^:S:W:F:C:&:L:8z:1:3:E:7:2:9:%:_:,:(:!:+:<:>:~:{:}:|:]:.:;:`*:\":",
                         long_options, &option_index);
 
         if (c == -1) // end of options
@@ -579,6 +659,37 @@ Parameters::Parameters(int argc, char** argv) {
             bams.push_back("stdin");
             break;
 
+            // --read-ahead
+        case '<':
+            if (!convert(optarg, readAhead)) {
+                cerr << "could not parse read-ahead" << endl;
+                exit(1);
+            }
+            break;
+
+            // --max-open-files
+        case '>':
+            if (!convert(optarg, maxOpenFiles)) {
+                cerr << "could not parse max-open-files" << endl;
+                exit(1);
+            }
+            break;
+
+            // --header-cache
+        case '~':
+            headerCacheFile = optarg;
+            break;
+
+            // --dump-observations
+        case '|':
+            observationsOutput = optarg;
+            break;
+
+            // --from-observations
+        case ']':
+            observationsInput = optarg;
+            break;
+
             // -f --fasta-reference
         case 'f':
             fasta = optarg;
@@ -639,6 +750,24 @@ Parameters::Parameters(int argc, char** argv) {
             gVCFchunk = atoi(optarg);
             break;
 
+            // --checkpoint
+        case '.':
+            checkpointFile = optarg;
+            break;
+
+            // --checkpoint-interval
+        case ';':
+            if (!convert(optarg, checkpointInterval)) {
+                cerr << "could not parse checkpoint-interval" << endl;
+                exit(1);
+            }
+            break;
+
+            // --resume
+        case '`':
+            resume = true;
+            break;
+
             // -4 --use-duplicate-reads
         case '4':
             useDuplicateReads = true;
@@ -676,6 +805,11 @@ Parameters::Parameters(int argc, char** argv) {
             }
             break;
 
+            // --sample-max-coverage
+        case '*':
+            sampleMaxCoverageFile = optarg;
+            break;
+
             // -n --use-best-n-alleles
         case 'n':
             if (!convert(optarg, useBestNAlleles)) {
@@ -983,6 +1117,14 @@ Parameters::Parameters(int argc, char** argv) {
             calculateMarginals = true;
             break;
 
+            // --threads
+        case '"':
+            if (!convert(optarg, threads) || threads < 1) {
+                cerr << "could not parse threads" << endl;
+                exit(1);
+            }
+            break;
+
         case '@':
             variantPriorsFile = optarg;
             break;
@@ -1036,6 +1178,20 @@ Parameters::Parameters(int argc, char** argv) {
             ++debuglevel;
             break;
 
+            // --profile
+        case '{':
+            profileFile = optarg;
+            break;
+
+            // --trace-slow-sites MS FILE
+        case '}':
+            if (!convert(optarg, traceSlowSitesMs) || optind >= argc) {
+                cerr << "usage: --trace-slow-sites MS FILE" << endl;
+                exit(1);
+            }
+            traceSlowSitesFile = argv[optind++];
+            break;
+
     case '#':
         
         // --version
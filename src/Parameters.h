@@ -35,8 +35,16 @@ public:
     //string log;
     string output;               // -v --vcf
     string outputFile;
+    int readAhead;               // --read-ahead
+    int maxOpenFiles;            // --max-open-files
+    string headerCacheFile;      // --header-cache
+    string observationsOutput;   // --dump-observations
+    string observationsInput;    // --from-observations
     bool gVCFout;    // -l --gvcf
     int gVCFchunk;
+    string checkpointFile;       // --checkpoint
+    int checkpointInterval;      // --checkpoint-interval
+    bool resume;                 // --resume
     string variantPriorsFile;
     string haplotypeVariantFile;
     bool reportAllHaplotypeAlleles;
@@ -79,6 +87,7 @@ public:
     bool reportGenotypeLikelihoodMax;
     int genotypingMaxIterations;
     int genotypingMaxBandDepth;
+    int threads;                 // --threads
     bool excludePartiallyObservedGenotypes;
     bool excludeUnobservedGenotypes;
     float genotypeVariantThreshold;
@@ -121,9 +130,13 @@ public:
     int minAltTotal;             // -G --min-alternate-total
     int minCoverage;             // -! --min-coverage
     int maxCoverage;             // -+ --max-coverage
+    string sampleMaxCoverageFile;  // --sample-max-coverage
     int debuglevel;              // -d --debug increments
     bool debug; // set if debuglevel >=1
     bool debug2; // set if debuglevel >=2
+    string profileFile;          // --profile
+    double traceSlowSitesMs;     // --trace-slow-sites MS FILE
+    string traceSlowSitesFile;
 
     bool showReferenceRepeats;
 
@@ -0,0 +1,316 @@
+#include "Profiler.h"
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <sys/resource.h>
+
+
+Profiler profiler;
+
+static const char* phaseNames[PROFILE_PHASES] = {
+    "read_decode",
+    "register_alignment",
+    "update_alignment_queue",
+    "get_next_alleles",
+    "build_haplotype_alleles",
+    "data_likelihoods",
+    "combo_search",
+    "marginals",
+    "vcf_format",
+    "output_write"
+};
+
+const char* profilePhaseName(ProfilePhase phase) {
+    return phaseNames[phase];
+}
+
+LatencyHistogram::LatencyHistogram(void)
+    : count(0)
+    , max(0)
+    , total(0)
+    , buckets(PROFILE_HISTOGRAM_BUCKETS, 0)
+{ }
+
+// bucket b covers [2^e + s*2^e/8, 2^e + (s+1)*2^e/8) for e = b/8, s = b%8,
+// with the values below 8 given a bucket each
+static int histogramBucket(long unsigned int ns) {
+    if (ns < PROFILE_HISTOGRAM_SUBBUCKETS) {
+        return ns;
+    }
+    int e = 63 - __builtin_clzl(ns);
+    int s = (ns >> (e - 3)) & (PROFILE_HISTOGRAM_SUBBUCKETS - 1);
+    return e * PROFILE_HISTOGRAM_SUBBUCKETS + s;
+}
+
+static long unsigned int histogramBucketEnd(int b) {
+    if (b < PROFILE_HISTOGRAM_SUBBUCKETS) {
+        return b + 1;
+    }
+    int e = b / PROFILE_HISTOGRAM_SUBBUCKETS;
+    int s = b % PROFILE_HISTOGRAM_SUBBUCKETS;
+    long unsigned int step = 1UL << (e - 3);
+    return (1UL << e) + (s + 1) * step;
+}
+
+void LatencyHistogram::add(long unsigned int ns) {
+    ++buckets[histogramBucket(ns)];
+    ++count;
+    total += ns;
+    if (ns > max) {
+        max = ns;
+    }
+}
+
+long unsigned int LatencyHistogram::quantile(double q) const {
+    if (count == 0) {
+        return 0;
+    }
+    long unsigned int rank = (long unsigned int) (q * count);
+    if (rank >= count) {
+        rank = count - 1;
+    }
+    long unsigned int seen = 0;
+    for (int b = 0; b < PROFILE_HISTOGRAM_BUCKETS; ++b) {
+        seen += buckets[b];
+        if (seen > rank) {
+            // never report more than the largest value seen
+            return min(histogramBucketEnd(b), max);
+        }
+    }
+    return max;
+}
+
+Profiler::Profiler(void)
+    : enabled(false)
+    , tracing(false)
+    , startTime(0)
+    , contig(&totals)
+    , combosScored(0)
+    , haplotypeIterations(0)
+    , maxSiteHaplotypeIterations(0)
+    , arenaPeakBytes(0)
+    , arenaChunks(0)
+    , arenaAllocations(0)
+    , arenaNanoseconds(0)
+    , lastSiteEnd(0)
+    , phasesAtLastSiteEnd(PROFILE_PHASES, 0)
+    , combosAtLastSiteEnd(0)
+    , haplotypeIterationsAtLastSiteEnd(0)
+    , siteSpan(0)
+    , sitePhases(PROFILE_PHASES, 0)
+    , siteCombos(0)
+    , siteHaplotypeIterations(0)
+    , traceThreshold(0)
+{ }
+
+void Profiler::recordArena(long unsigned int peakBytes, long unsigned int chunks,
+                           long unsigned int allocations, long unsigned int ns) {
+    arenaPeakBytes = peakBytes;
+    arenaChunks = chunks;
+    arenaAllocations = allocations;
+    arenaNanoseconds = ns;
+}
+
+void Profiler::enable(void) {
+    if (!enabled) {
+        enabled = true;
+        startTime = now();
+        lastSiteEnd = startTime;
+    }
+}
+
+void Profiler::setContig(const string& name) {
+    if (name == contigName && contig != &totals) {
+        return;
+    }
+    contigName = name;
+    map<string, PhaseTotals>::iterator c = contigs.find(name);
+    if (c == contigs.end()) {
+        contigOrder.push_back(name);
+        c = contigs.insert(make_pair(name, PhaseTotals())).first;
+    }
+    contig = &c->second;
+}
+
+void Profiler::addSite(long unsigned int ns) {
+    long unsigned int end = now();
+    siteSpan = end - lastSiteEnd;
+    lastSiteEnd = end;
+    for (int p = 0; p < PROFILE_PHASES; ++p) {
+        sitePhases[p] = totals.nanoseconds[p] - phasesAtLastSiteEnd[p];
+        phasesAtLastSiteEnd[p] = totals.nanoseconds[p];
+    }
+    long unsigned int combos = combosScored.load(memory_order_relaxed);
+    siteCombos = combos - combosAtLastSiteEnd;
+    combosAtLastSiteEnd = combos;
+    siteHaplotypeIterations = haplotypeIterations - haplotypeIterationsAtLastSiteEnd;
+    haplotypeIterationsAtLastSiteEnd = haplotypeIterations;
+    if (siteHaplotypeIterations > maxSiteHaplotypeIterations) {
+        maxSiteHaplotypeIterations = siteHaplotypeIterations;
+    }
+
+    siteLatencies.add(ns);
+    ++totals.sites;
+    totals.siteNanoseconds += ns;
+    if (contig != &totals) {
+        ++contig->sites;
+        contig->siteNanoseconds += ns;
+        if (ns > contig->maxSiteNanoseconds) {
+            contig->maxSiteNanoseconds = ns;
+        }
+    }
+}
+
+static string jsonEscape(const string& s) {
+    stringstream out;
+    for (string::const_iterator c = s.begin(); c != s.end(); ++c) {
+        if (*c == '"' || *c == '\\') {
+            out << '\\' << *c;
+        } else if ((unsigned char) *c < 0x20) {
+            out << "\\u" << hex << setw(4) << setfill('0') << (int) *c << dec << setfill(' ');
+        } else {
+            out << *c;
+        }
+    }
+    return out.str();
+}
+
+static double seconds(long unsigned int ns) {
+    return ns / 1e9;
+}
+
+static double microseconds(long unsigned int ns) {
+    return ns / 1e3;
+}
+
+static void writePhases(ostream& out, const PhaseTotals& t, const string& indent) {
+    out << indent << "\"phases\": {" << endl;
+    for (int p = 0; p < PROFILE_PHASES; ++p) {
+        out << indent << "  \"" << phaseNames[p] << "\": {"
+            << "\"seconds\": " << seconds(t.nanoseconds[p]) << ", "
+            << "\"calls\": " << t.calls[p] << "}"
+            << (p + 1 < PROFILE_PHASES ? "," : "") << endl;
+    }
+    out << indent << "}";
+}
+
+bool Profiler::write(const string& filename) {
+
+    ofstream out(filename.c_str());
+    if (!out) {
+        return false;
+    }
+    out << setprecision(9);
+
+    out << "{" << endl
+        << "  \"note\": \"phase times are inclusive: get_next_alleles and build_haplotype_alleles "
+        << "each contain their share of update_alignment_queue, which contains read_decode and "
+        << "register_alignment; read_decode is time waiting on the "
+        << "decode thread when --read-ahead is used; alignment_arena_seconds is the time "
+        << "taking and releasing arena chunks, within register_alignment and get_next_alleles\"," << endl
+        << "  \"wall_seconds\": " << seconds(now() - startTime) << "," << endl
+        << "  \"sites\": " << totals.sites << "," << endl
+        << "  \"site_seconds\": " << seconds(totals.siteNanoseconds) << "," << endl;
+    writePhases(out, totals, "  ");
+    out << "," << endl;
+
+    out << "  \"site_latency_us\": {"
+        << "\"mean\": " << (siteLatencies.count ? siteLatencies.total / siteLatencies.count / 1e3 : 0) << ", "
+        << "\"p50\": " << microseconds(siteLatencies.quantile(0.5)) << ", "
+        << "\"p90\": " << microseconds(siteLatencies.quantile(0.9)) << ", "
+        << "\"p99\": " << microseconds(siteLatencies.quantile(0.99)) << ", "
+        << "\"p999\": " << microseconds(siteLatencies.quantile(0.999)) << ", "
+        << "\"max\": " << microseconds(siteLatencies.max) << "}," << endl;
+
+    out << "  \"haplotype_iterations\": {"
+        << "\"total\": " << haplotypeIterations << ", "
+        << "\"mean_per_site\": " << (totals.sites ? (double) haplotypeIterations / totals.sites : 0) << ", "
+        << "\"max_per_site\": " << maxSiteHaplotypeIterations << "}," << endl;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    out << "  \"memory\": {"
+        << "\"peak_rss_kb\": " << usage.ru_maxrss << ", "
+        << "\"alignment_arena_peak_bytes\": " << arenaPeakBytes << ", "
+        << "\"alignment_arena_chunks\": " << arenaChunks << ", "
+        << "\"alignment_arena_allocations\": " << arenaAllocations << ", "
+        << "\"alignment_arena_seconds\": " << seconds(arenaNanoseconds) << "}," << endl;
+
+    out << "  \"contigs\": {" << endl;
+    for (vector<string>::iterator c = contigOrder.begin(); c != contigOrder.end(); ++c) {
+        PhaseTotals& t = contigs[*c];
+        out << "    \"" << jsonEscape(*c) << "\": {" << endl
+            << "      \"sites\": " << t.sites << "," << endl
+            << "      \"site_seconds\": " << seconds(t.siteNanoseconds) << "," << endl
+            << "      \"max_site_latency_us\": " << microseconds(t.maxSiteNanoseconds) << "," << endl;
+        writePhases(out, t, "      ");
+        out << endl << "    }" << (c + 1 != contigOrder.end() ? "," : "") << endl;
+    }
+    out << "  }" << endl
+        << "}" << endl;
+
+    return out.good();
+
+}
+
+bool Profiler::traceSlowSites(const string& filename, double ms) {
+    traceFile.open(filename.c_str());
+    if (!traceFile) {
+        return false;
+    }
+    tracing = true;
+    traceThreshold = (long unsigned int) (ms * 1e6);
+    enable();
+    traceFile << "#sequence\tposition\tms\tcoverage\talleles\thaplotype_length"
+              << "\tgenotypes_by_ploidy\tcombos\titerations\thaplotype_iterations";
+    for (int p = 0; p < PROFILE_PHASES; ++p) {
+        traceFile << "\t" << phaseNames[p] << "_ms";
+    }
+    traceFile << endl;
+    return true;
+}
+
+void Profiler::traceSite(const SiteShape& shape) {
+    if (siteSpan < traceThreshold) {
+        return;
+    }
+    traceFile << shape.sequence
+              << "\t" << shape.position + 1
+              << "\t" << siteSpan / 1e6
+              << "\t" << shape.coverage
+              << "\t" << shape.alleles
+              << "\t" << shape.haplotypeLength
+              << "\t";
+    if (shape.genotypesByPloidy.empty()) {
+        traceFile << ".";
+    }
+    for (map<int, int>::const_iterator g = shape.genotypesByPloidy.begin(); g != shape.genotypesByPloidy.end(); ++g) {
+        if (g != shape.genotypesByPloidy.begin()) {
+            traceFile << ",";
+        }
+        traceFile << g->first << ":" << g->second;
+    }
+    traceFile << "\t" << siteCombos
+              << "\t" << shape.iterations
+              << "\t" << siteHaplotypeIterations;
+    for (int p = 0; p < PROFILE_PHASES; ++p) {
+        traceFile << "\t" << sitePhases[p] / 1e6;
+    }
+    // flushed so a stalled or killed job still leaves its slow sites behind
+    traceFile << endl;
+}
+
+SiteShape::SiteShape(void)
+    : position(-1)
+    , coverage(0)
+    , alleles(0)
+    , haplotypeLength(0)
+    , iterations(0)
+{ }
+
+SiteShape::~SiteShape(void) {
+    if (profiler.tracing) {
+        profiler.traceSite(*this);
+    }
+}
@@ -0,0 +1,206 @@
+#ifndef _PROFILER_H
+#define _PROFILER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <atomic>
+#include <fstream>
+
+using namespace std;
+
+// Phase timers and per-site latencies for the calling pipeline, enabled by
+// --profile.  When disabled a timer costs one branch.
+//
+// Phases nest: getNextAlleles and buildHaplotypeAlleles both include
+// updateAlignmentQueue, which includes read decode and registerAlignment.  With a decode thread (--read-ahead),
+// read decode is the time spent waiting for it.  All timing is done on the
+// calling thread.
+//
+// The same timers feed the slow-site trace (--trace-slow-sites), which
+// writes the shape and phase times of every site taking longer than a
+// threshold, measured from the end of the previous site.
+
+enum ProfilePhase {
+    PROFILE_READ_DECODE = 0,
+    PROFILE_REGISTER_ALIGNMENT,
+    PROFILE_UPDATE_ALIGNMENT_QUEUE,
+    PROFILE_GET_NEXT_ALLELES,
+    PROFILE_HAPLOTYPE_ALLELES,
+    PROFILE_DATA_LIKELIHOODS,
+    PROFILE_COMBO_SEARCH,
+    PROFILE_MARGINALS,
+    PROFILE_VCF_FORMAT,
+    PROFILE_OUTPUT_WRITE,
+    PROFILE_PHASES
+};
+
+// log-scale histogram of nanosecond latencies, 8 buckets per power of two
+#define PROFILE_HISTOGRAM_SUBBUCKETS 8
+#define PROFILE_HISTOGRAM_BUCKETS (64 * PROFILE_HISTOGRAM_SUBBUCKETS)
+
+class LatencyHistogram {
+public:
+    LatencyHistogram(void);
+    void add(long unsigned int ns);
+    // upper bound of the bucket holding the q quantile, within 1/8 of the value
+    long unsigned int quantile(double q) const;
+    long unsigned int count;
+    long unsigned int max;
+    long double total;
+private:
+    vector<long unsigned int> buckets;
+};
+
+class PhaseTotals {
+public:
+    PhaseTotals(void) : nanoseconds(PROFILE_PHASES, 0), calls(PROFILE_PHASES, 0), sites(0), siteNanoseconds(0), maxSiteNanoseconds(0) { }
+    vector<long unsigned int> nanoseconds;
+    vector<long unsigned int> calls;
+    long unsigned int sites;
+    long unsigned int siteNanoseconds;
+    long unsigned int maxSiteNanoseconds;
+};
+
+// what we know about a site, filled in as the main loop gets to it
+class SiteShape {
+public:
+    SiteShape(void);
+    // traces the site if it was slow, so every exit from the loop body is seen
+    ~SiteShape(void);
+    string sequence;
+    long int position;
+    int coverage;
+    int alleles;
+    int haplotypeLength;
+    map<int, int> genotypesByPloidy;
+    int iterations;
+};
+
+class Profiler {
+
+public:
+
+    Profiler(void);
+
+    bool enabled;
+    void enable(void);
+
+    static long unsigned int now(void) {
+        return chrono::duration_cast<chrono::nanoseconds>(
+            chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void add(ProfilePhase phase, long unsigned int ns) {
+        totals.nanoseconds[phase] += ns;
+        ++totals.calls[phase];
+        if (contig != &totals) {
+            contig->nanoseconds[phase] += ns;
+            ++contig->calls[phase];
+        }
+    }
+
+    // genotype combos scored, counted only while enabled
+    void countCombo(void) {
+        if (enabled) {
+            combosScored.fetch_add(1, memory_order_relaxed);
+        }
+    }
+
+    // passes of the haplotype window growth in buildHaplotypeAlleles
+    void countHaplotypeIteration(void) {
+        if (enabled) {
+            ++haplotypeIterations;
+        }
+    }
+
+    // the peak footprint of the alignment arena and the time spent in it,
+    // written with the peak RSS
+    void recordArena(long unsigned int peakBytes, long unsigned int chunks,
+                     long unsigned int allocations, long unsigned int ns);
+
+    // the sequence subsequent sites and phases are attributed to
+    void setContig(const string& name);
+    void addSite(long unsigned int ns);
+
+    // false if the file can't be written
+    bool write(const string& filename);
+
+    // trace sites slower than ms to filename, false if it can't be opened
+    bool traceSlowSites(const string& filename, double ms);
+    bool tracing;
+    void traceSite(const SiteShape& shape);
+
+private:
+
+    long unsigned int startTime;
+    PhaseTotals totals;
+    LatencyHistogram siteLatencies;
+    map<string, PhaseTotals> contigs;
+    vector<string> contigOrder;  // as first seen
+    string contigName;
+    PhaseTotals* contig;
+
+    atomic<long unsigned int> combosScored;
+    long unsigned int haplotypeIterations;
+    long unsigned int maxSiteHaplotypeIterations;
+
+    long unsigned int arenaPeakBytes;
+    long unsigned int arenaChunks;
+    long unsigned int arenaAllocations;
+    long unsigned int arenaNanoseconds;
+
+    // phase times and combos since the previous site, for the trace
+    long unsigned int lastSiteEnd;
+    vector<long unsigned int> phasesAtLastSiteEnd;
+    long unsigned int combosAtLastSiteEnd;
+    long unsigned int haplotypeIterationsAtLastSiteEnd;
+    long unsigned int siteSpan;
+    vector<long unsigned int> sitePhases;
+    long unsigned int siteCombos;
+    long unsigned int siteHaplotypeIterations;
+
+    long unsigned int traceThreshold;
+    ofstream traceFile;
+
+};
+
+extern Profiler profiler;
+
+const char* profilePhaseName(ProfilePhase phase);
+
+// times the enclosing scope into a phase
+class ProfileTimer {
+public:
+    ProfileTimer(ProfilePhase p) : phase(p), start(profiler.enabled ? Profiler::now() : 0) { }
+    ~ProfileTimer(void) {
+        if (profiler.enabled) {
+            profiler.add(phase, Profiler::now() - start);
+        }
+    }
+private:
+    ProfilePhase phase;
+    long unsigned int start;
+};
+
+// times the enclosing scope as the processing of one site
+class ProfileSite {
+public:
+    ProfileSite(const string& contig) : start(0) {
+        if (profiler.enabled) {
+            profiler.setContig(contig);
+            start = Profiler::now();
+        }
+    }
+    ~ProfileSite(void) {
+        if (profiler.enabled) {
+            profiler.addSite(Profiler::now() - start);
+        }
+    }
+    long unsigned int elapsed(void) const { return Profiler::now() - start; }
+private:
+    long unsigned int start;
+};
+
+#endif
@@ -0,0 +1,133 @@
+#include "QualityBatch.h"
+#include "Utility.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+static Real phredLnTable[PHRED_TABLE_SIZE];
+static Real phredCorrectTable[PHRED_TABLE_SIZE];
+
+// fills the tables at startup, from the same functions they stand in for
+class PhredTables {
+public:
+    PhredTables(void) {
+        for (int q = 0; q < PHRED_TABLE_SIZE; ++q) {
+            phredLnTable[q] = phred2ln(q);
+            phredCorrectTable[q] = 1 - phred2float(q);
+        }
+    }
+};
+
+static PhredTables phredTables;
+
+Real phred2lnTabulated(int qual) {
+    if (qual >= 0 && qual < PHRED_TABLE_SIZE) {
+        return phredLnTable[qual];
+    } else {
+        return phred2ln(qual);
+    }
+}
+
+Real phred2correctTabulated(int qual) {
+    if (qual >= 0 && qual < PHRED_TABLE_SIZE) {
+        return phredCorrectTable[qual];
+    } else {
+        return 1 - phred2float(qual);
+    }
+}
+
+long int qualitySum(const char* quals, size_t n) {
+    long int sum = 0;
+    size_t i = 0;
+#ifdef __SSE2__
+    // sum of absolute differences against zero gives the sum of each 8 bytes
+    __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (quals + i));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(v, zero));
+    }
+    long long lanes[2];
+    _mm_storeu_si128((__m128i*) lanes, acc);
+    sum += lanes[0] + lanes[1] - 33 * (long int) i;
+#endif
+    for (; i < n; ++i) {
+        sum += qualityChar2ShortInt(quals[i]);
+    }
+    return sum;
+}
+
+short qualityMin(const char* quals, size_t n) {
+    if (n == 0) {
+        return 0;
+    }
+    unsigned char m = 0xff;
+    size_t i = 0;
+#ifdef __SSE2__
+    if (n >= 16) {
+        __m128i acc = _mm_set1_epi8((char) 0xff);
+        for (; i + 16 <= n; i += 16) {
+            acc = _mm_min_epu8(acc, _mm_loadu_si128((const __m128i*) (quals + i)));
+        }
+        // fold the 16 lanes down to one
+        acc = _mm_min_epu8(acc, _mm_srli_si128(acc, 8));
+        acc = _mm_min_epu8(acc, _mm_srli_si128(acc, 4));
+        acc = _mm_min_epu8(acc, _mm_srli_si128(acc, 2));
+        acc = _mm_min_epu8(acc, _mm_srli_si128(acc, 1));
+        m = (unsigned char) _mm_cvtsi128_si32(acc);
+    }
+#endif
+    for (; i < n; ++i) {
+        m = min(m, (unsigned char) quals[i]);
+    }
+    return qualityChar2ShortInt(m);
+}
+
+void qualityDecode(const char* quals, size_t n, short* out) {
+    size_t i = 0;
+#ifdef __SSE2__
+    __m128i zero = _mm_setzero_si128();
+    __m128i offset = _mm_set1_epi16(33);
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (quals + i));
+        _mm_storeu_si128((__m128i*) (out + i),
+                         _mm_sub_epi16(_mm_unpacklo_epi8(v, zero), offset));
+        _mm_storeu_si128((__m128i*) (out + i + 8),
+                         _mm_sub_epi16(_mm_unpackhi_epi8(v, zero), offset));
+    }
+#endif
+    for (; i < n; ++i) {
+        out[i] = qualityChar2ShortInt(quals[i]);
+    }
+}
+
+void qualityCap(char* quals, size_t n, short cap) {
+    if (cap < 0 || cap >= PHRED_TABLE_SIZE) {
+        return; // nothing printable is above the cap
+    }
+    char qualcap = qualityInt2Char(cap);
+    size_t i = 0;
+#ifdef __SSE2__
+    __m128i capv = _mm_set1_epi8(qualcap);
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (quals + i));
+        _mm_storeu_si128((__m128i*) (quals + i), _mm_min_epu8(v, capv));
+    }
+#endif
+    for (; i < n; ++i) {
+        if (quals[i] > qualcap) {
+            quals[i] = qualcap;
+        }
+    }
+}
+
+Real qualityJointError(const char* quals, size_t n) {
+    Real jq = 1;
+    // product of probability we don't have a true event for each element
+    for (size_t i = 0; i < n; ++i) {
+        jq *= phred2correctTabulated(qualityChar2ShortInt(quals[i]));
+    }
+    // and then invert it again to get probability of an event
+    return 1 - jq;
+}
@@ -0,0 +1,33 @@
+#ifndef _QUALITY_BATCH_H
+#define _QUALITY_BATCH_H
+
+#include <stddef.h>
+#include "Numeric.h"
+
+// Whole-string operations on phred+33 base quality strings.
+//
+// The per-base helpers in Utility (qualityChar2ShortInt, phred2ln, ...) are
+// called once per base for every allele we build.  These work on the raw
+// quality buffer of a read instead, with SSE2 reductions where available,
+// and give exactly the same results as the per-base loops they replace.
+
+// quality chars are printable ascii, '!' (0) through '~' (93)
+#define PHRED_TABLE_SIZE 94
+
+// phred2ln(q) and the probability that a base of quality q is correct,
+// 1 - phred2float(q), tabulated for 0 <= q < PHRED_TABLE_SIZE
+Real phred2lnTabulated(int qual);
+Real phred2correctTabulated(int qual);
+
+// sum of the phred values of n quality chars
+long int qualitySum(const char* quals, size_t n);
+// minimum phred value of n quality chars, 0 for an empty string
+short qualityMin(const char* quals, size_t n);
+// phred values of n quality chars written to out
+void qualityDecode(const char* quals, size_t n, short* out);
+// lower every quality above cap to cap
+void qualityCap(char* quals, size_t n, short cap);
+// probability that at least one of the bases is an error
+Real qualityJointError(const char* quals, size_t n);
+
+#endif
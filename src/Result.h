@@ -18,7 +18,7 @@ public:
 
     void sortDataLikelihoods(void);
 
-    //pair<Genotype*, long double> bestMarginalGenotype(void);
+    //pair<Genotype*, Real> bestMarginalGenotype(void);
 
 };
 
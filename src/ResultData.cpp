@@ -8,8 +8,8 @@ using namespace std;
 vcflib::Variant& Results::vcf(
     vcflib::Variant& var, // variant to update
     BigFloat pHom,
-    long double bestComboOddsRatio,
-    //long double alleleSamplingProb,
+    Real bestComboOddsRatio,
+    //Real alleleSamplingProb,
     Samples& samples,
     string refbase,
     vector<Allele>& altAllelesIncludingNulls,
@@ -63,7 +63,7 @@ vcflib::Variant& Results::vcf(
     var.filter = ".";
 
     // note that we set QUAL to 0 at loci with no data
-    var.quality = max((long double) 0, nan2zero(big2phred(pHom)));
+    var.quality = max((Real) 0, nan2zero(big2phred(pHom)));
     if (coverage == 0) {
         var.quality = 0;
     }
@@ -91,10 +91,10 @@ vcflib::Variant& Results::vcf(
     unsigned int refEndRight = 0;
     unsigned int refmqsum = 0;
     unsigned int refProperPairs = 0;
-    long double refReadMismatchSum = 0;
-    long double refReadSNPSum = 0;
-    long double refReadIndelSum = 0;
-    long double refReadSoftClipSum = 0;
+    Real refReadMismatchSum = 0;
+    Real refReadSNPSum = 0;
+    Real refReadIndelSum = 0;
+    Real refReadSoftClipSum = 0;
     unsigned int refObsCount = 0;
     map<string, int> refObsBySequencingTechnology;
 
@@ -134,9 +134,9 @@ vcflib::Variant& Results::vcf(
         }
     }
 
-    long double refReadMismatchRate = (refObsCount == 0 ? 0 : refReadMismatchSum / (long double) refObsCount);
-    long double refReadSNPRate = (refObsCount == 0 ? 0 : refReadSNPSum / (long double) refObsCount);
-    long double refReadIndelRate = (refObsCount == 0 ? 0 : refReadIndelSum / (long double) refObsCount);
+    Real refReadMismatchRate = (refObsCount == 0 ? 0 : refReadMismatchSum / (Real) refObsCount);
+    Real refReadSNPRate = (refObsCount == 0 ? 0 : refReadSNPSum / (Real) refObsCount);
+    Real refReadIndelRate = (refObsCount == 0 ? 0 : refReadIndelSum / (Real) refObsCount);
 
     //var.info["XRM"].push_back(convert(refReadMismatchRate));
     //var.info["XRS"].push_back(convert(refReadSNPRate));
@@ -249,9 +249,9 @@ vcflib::Variant& Results::vcf(
         unsigned int altEndRight = 0;
         unsigned int altmqsum = 0;
         unsigned int altproperPairs = 0;
-        long double altReadMismatchSum = 0;
-        long double altReadSNPSum = 0;
-        long double altReadIndelSum = 0;
+        Real altReadMismatchSum = 0;
+        Real altReadSNPSum = 0;
+        Real altReadIndelSum = 0;
         unsigned int altObsCount = 0;
         map<string, int> altObsBySequencingTechnology;
 
@@ -294,9 +294,9 @@ vcflib::Variant& Results::vcf(
             }
         }
 
-        long double altReadMismatchRate = (altObsCount == 0 ? 0 : altReadMismatchSum / altObsCount);
-        long double altReadSNPRate = (altObsCount == 0 ? 0 : altReadSNPSum / altObsCount);
-        long double altReadIndelRate = (altObsCount == 0 ? 0 : altReadIndelSum / altObsCount);
+        Real altReadMismatchRate = (altObsCount == 0 ? 0 : altReadMismatchSum / altObsCount);
+        Real altReadSNPRate = (altObsCount == 0 ? 0 : altReadSNPSum / altObsCount);
+        Real altReadIndelRate = (altObsCount == 0 ? 0 : altReadIndelSum / altObsCount);
 
         //var.info["XAM"].push_back(convert(altReadMismatchRate));
         //var.info["XAS"].push_back(convert(altReadSNPRate));
@@ -602,11 +602,11 @@ vcflib::Variant& Results::vcf(
                     }
 
                     // normalize GLs to 0 max using division by max
-                    long double minGL = 0;
+                    Real minGL = 0;
                     for (map<int, double>::iterator g = genotypeLikelihoods.begin(); g != genotypeLikelihoods.end(); ++g) {
                         if (g->second < minGL) minGL = g->second;
                     }
-                    long double maxGL = minGL;
+                    Real maxGL = minGL;
                     for (map<int, double>::iterator g = genotypeLikelihoods.begin(); g != genotypeLikelihoods.end(); ++g) {
                         if (g->second > maxGL) maxGL = g->second;
                     }
@@ -617,7 +617,7 @@ vcflib::Variant& Results::vcf(
                         }
                     } else {
                         for (map<int, double>::iterator g = genotypeLikelihoods.begin(); g != genotypeLikelihoods.end(); ++g) {
-                            genotypeLikelihoodsOutput[g->first] = convert( max((long double) + parameters.limitGL, (g->second-maxGL)) );
+                            genotypeLikelihoodsOutput[g->first] = convert( max((Real) + parameters.limitGL, (g->second-maxGL)) );
                         }
                     }
 
@@ -702,7 +702,7 @@ vcflib::Variant& Results::gvcf(
         const string& sampleName = *s;
         const NonCall& nc = perSample[sampleName];
         map<string, vector<string> >& sampleOutput = var.samples[sampleName];
-        long double qual = nc.reflnQ - nc.altlnQ;
+        Real qual = nc.reflnQ - nc.altlnQ;
         sampleOutput["GQ"].push_back(convert(ln2phred(qual)));
 
 
@@ -18,8 +18,8 @@ using namespace std;
 // for sorting data likelihoods
 class DataLikelihoodCompare {
 public:
-    bool operator()(const pair<Genotype*, long double>& a,
-            const pair<Genotype*, long double>& b) {
+    bool operator()(const pair<Genotype*, Real>& a,
+            const pair<Genotype*, Real>& b) {
         return a.second > b.second;
     }
 };
@@ -44,8 +44,8 @@ public:
     vcflib::Variant& vcf(
         vcflib::Variant& var, // variant to update
         BigFloat pHom,
-        long double bestComboOddsRatio,
-        //long double alleleSamplingProb,
+        Real bestComboOddsRatio,
+        //Real alleleSamplingProb,
         Samples& samples,
         string refbase,
         vector<Allele>& altAlleles,
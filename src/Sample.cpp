@@ -1,10 +1,282 @@
 #include "Sample.h"
 
 
+// orders groups by base, for searching them by base
+class GroupLess {
+public:
+    bool operator()(const Sample::Group& g, const string& base) const {
+        return g.first < base;
+    }
+};
+
+// orders the indexes of alleles by the alleles' bases
+class AlleleBaseLess {
+public:
+    AlleleBaseLess(const vector<Allele>& a) : alleles(a) { }
+    bool operator()(int a, int b) const {
+        return alleles[a].currentBase < alleles[b].currentBase;
+    }
+    bool operator()(int a, const string& base) const {
+        return alleles[a].currentBase < base;
+    }
+private:
+    const vector<Allele>& alleles;
+};
+
+void AlleleObservationTable::build(Sample& sample, vector<Allele>& siteAlleles,
+                                   const vector<int>& byBase,
+                                   const vector<pair<int, int> >& supportRanges) {
+    alleles = &siteAlleles;
+    allelesByBase = byBase;
+    int n = siteAlleles.size();
+    groups.assign(n, -1);
+    groupAlleles.assign(sample.size(), -1);
+    counts.assign(n, 0);
+    qualSums.assign(n, 0);
+    entries.clear();
+
+    // walk the groups and the alleles together in base order; the only
+    // place their bases are compared
+    Sample::iterator g = sample.begin();
+    int k = 0;
+    while (g != sample.end() || k < n) {
+        int c = (g == sample.end()) ? 1
+            : (k == n) ? -1
+            : g->first.compare(siteAlleles[byBase[k]].currentBase);
+        BaseEntry entry;
+        entry.group = (c <= 0) ? g - sample.begin() : -1;
+        entry.first = k;
+        if (c >= 0) {
+            const string& base = siteAlleles[byBase[k]].currentBase;
+            do {
+                ++k;
+            } while (k < n && siteAlleles[byBase[k]].currentBase == base);
+        }
+        entry.last = k;
+        entries.push_back(entry);
+        if (entry.group != -1) {
+            vector<Allele*>& obs = g->second;
+            int qsum = 0;
+            for (vector<Allele*>::iterator a = obs.begin(); a != obs.end(); ++a) {
+                qsum += (*a)->quality;
+            }
+            for (int i = entry.first; i < entry.last; ++i) {
+                groups[byBase[i]] = entry.group;
+                counts[byBase[i]] = obs.size();
+                qualSums[byBase[i]] = qsum;
+            }
+            if (entry.first < entry.last) {
+                // stably sorted, so the lowest index of the base
+                groupAlleles[entry.group] = byBase[entry.first];
+            }
+            ++g;
+        }
+    }
+
+    // the rows of partial support, by counting the partials of each allele;
+    // supported allele j is the alleles allelesByBase[supportRanges[j])
+    int partialCount = sample.partials.size();
+    partialOffsets.assign(n + 1, 0);
+    for (int p = 0; p < partialCount; ++p) {
+        for (int s = sample.partialSupportOffsets[p]; s < sample.partialSupportOffsets[p + 1]; ++s) {
+            const pair<int, int>& range = supportRanges[sample.partialSupport[s]];
+            for (int k = range.first; k < range.second; ++k) {
+                ++partialOffsets[byBase[k] + 1];
+            }
+        }
+    }
+    for (int i = 0; i < n; ++i) {
+        partialOffsets[i + 1] += partialOffsets[i];
+    }
+    partials.resize(partialOffsets[n]);
+    partialCounts.assign(n, 0);
+    partialQualSums.assign(n, 0);
+    rowEnds.assign(partialOffsets.begin(), partialOffsets.end() - 1);
+    partialBaseAlleles.resize(partialCount);
+    partialAlleleOffsets.resize(partialCount + 1);
+    partialAlleleOffsets[0] = 0;
+    partialAlleles.clear();
+    for (int p = 0; p < partialCount; ++p) {
+        Allele& partial = *sample.partials[p];
+        int supportBegin = sample.partialSupportOffsets[p];
+        int supportEnd = sample.partialSupportOffsets[p + 1];
+        double supported = supportEnd - supportBegin;
+        // the alleles the partial is compared against: those with its own
+        // base, found by binary search, and those it supports
+        vector<int>::const_iterator b = lower_bound(byBase.begin(), byBase.end(),
+                                                    partial.currentBase, AlleleBaseLess(siteAlleles));
+        vector<int>::const_iterator e = b;
+        while (e != byBase.end() && siteAlleles[*e].currentBase == partial.currentBase) {
+            ++e;
+        }
+        partialBaseAlleles[p] = (b != e) ? *b : -1;
+        size_t start = partialAlleles.size();
+        partialAlleles.insert(partialAlleles.end(), b, e);
+        for (int s = supportBegin; s < supportEnd; ++s) {
+            const pair<int, int>& range = supportRanges[sample.partialSupport[s]];
+            for (int k = range.first; k < range.second; ++k) {
+                int i = byBase[k];
+                partials[rowEnds[i]++] = p;
+                partialCounts[i] += (double) 1 / supported;
+                partialQualSums[i] += (double) partial.quality / supported;
+                partialAlleles.push_back(i);
+            }
+        }
+        sort(partialAlleles.begin() + start, partialAlleles.end());
+        partialAlleles.erase(unique(partialAlleles.begin() + start, partialAlleles.end()), partialAlleles.end());
+        partialAlleleOffsets[p + 1] = partialAlleles.size();
+    }
+}
+
+// compares the first seq.size() characters of s against seq, with a shorter s
+// ordered before every string that begins with seq
+template <typename Iterator>
+int comparePrefix(const string& s, Iterator seq, Iterator seqEnd) {
+    string::const_iterator c = s.begin();
+    for ( ; seq != seqEnd; ++seq, ++c) {
+        if (c == s.end() || *c < *seq) return -1;
+        if (*c > *seq) return 1;
+    }
+    return 0;
+}
+
+template <typename Iterator>
+void sequencesWithPrefix(vector<pair<string, int> >& sorted, Iterator seq, Iterator seqEnd, vector<int>& hits) {
+    // binary search for the first sequence not ordered before seq
+    vector<pair<string, int> >::iterator first = sorted.begin();
+    size_t count = sorted.size();
+    while (count > 0) {
+        size_t half = count / 2;
+        if (comparePrefix(first[half].first, seq, seqEnd) < 0) {
+            first += half + 1;
+            count -= half + 1;
+        } else {
+            count = half;
+        }
+    }
+    for ( ; first != sorted.end() && comparePrefix(first->first, seq, seqEnd) == 0; ++first) {
+        hits.push_back(first->second);
+    }
+}
+
+void HaplotypeSequenceIndex::build(vector<Allele>& alleles) {
+    forward.resize(alleles.size());
+    reversed.resize(alleles.size());
+    minLength = alleles.empty() ? 0 : alleles.front().alternateSequence.size();
+    maxLength = 0;
+    for (int i = 0; i < (int) alleles.size(); ++i) {
+        const string& seq = alleles[i].alternateSequence;
+        forward[i].first = seq;
+        forward[i].second = i;
+        reversed[i].first.assign(seq.rbegin(), seq.rend());
+        reversed[i].second = i;
+        minLength = min(minLength, seq.size());
+        maxLength = max(maxLength, seq.size());
+    }
+    sort(forward.begin(), forward.end());
+    sort(reversed.begin(), reversed.end());
+}
+
+void HaplotypeSequenceIndex::withPrefix(const string& seq, vector<int>& hits) {
+    sequencesWithPrefix(forward, seq.begin(), seq.end(), hits);
+}
+
+void HaplotypeSequenceIndex::withSuffix(const string& seq, vector<int>& hits) {
+    sequencesWithPrefix(reversed, seq.rbegin(), seq.rend(), hits);
+}
+
+void Samples::indexObservations(vector<Allele>& alleles) {
+    allelesByBase.resize(alleles.size());
+    for (int i = 0; i < (int) alleles.size(); ++i) {
+        allelesByBase[i] = i;
+    }
+    stable_sort(allelesByBase.begin(), allelesByBase.end(), AlleleBaseLess(alleles));
+    // the partial support was recorded against the alleles given to
+    // assignPartialSupport; find the alleles with the same bases here
+    supportRanges.resize(supportedBases.size());
+    for (int j = 0; j < (int) supportedBases.size(); ++j) {
+        vector<int>::iterator b = std::lower_bound(allelesByBase.begin(), allelesByBase.end(),
+                                                   supportedBases[j], AlleleBaseLess(alleles));
+        vector<int>::iterator e = b;
+        while (e != allelesByBase.end() && alleles[*e].currentBase == supportedBases[j]) {
+            ++e;
+        }
+        supportRanges[j] = make_pair(b - allelesByBase.begin(), e - allelesByBase.begin());
+    }
+    for (Samples::iterator s = begin(); s != end(); ++s) {
+        s->second.observationTable.build(s->second, alleles, allelesByBase, supportRanges);
+        s->second.observationsIndexed = true;
+    }
+}
+
+Sample::iterator Sample::find(const string& base) {
+    iterator g = lower_bound(begin(), end(), base, GroupLess());
+    return (g != end() && g->first == base) ? g : end();
+}
+
+Sample::const_iterator Sample::find(const string& base) const {
+    const_iterator g = lower_bound(begin(), end(), base, GroupLess());
+    return (g != end() && g->first == base) ? g : end();
+}
+
+vector<Allele*>& Sample::operator[](const string& base) {
+    observationsIndexed = false;
+    iterator g = lower_bound(begin(), end(), base, GroupLess());
+    if (g != end() && g->first == base) {
+        return g->second;
+    }
+    // the first spare group, storage and all, is moved into place
+    size_t i = g - begin();
+    if (groupCount == groups.size()) {
+        groups.push_back(Group());
+    }
+    groups[groupCount].first = base;
+    groups[groupCount].second.clear();
+    rotate(groups.begin() + i, groups.begin() + groupCount, groups.begin() + groupCount + 1);
+    ++groupCount;
+    return groups[i].second;
+}
+
+void Sample::erase(const string& base) {
+    iterator g = find(base);
+    if (g != end()) {
+        g->second.clear();
+        rotate(g, g + 1, end());
+        --groupCount;
+        observationsIndexed = false;
+    }
+}
+
+void Sample::clear(void) {
+    for (iterator g = begin(); g != end(); ++g) {
+        g->second.clear();
+    }
+    groupCount = 0;
+    observationsIndexed = false;
+}
+
+int Sample::alleleIndex(const Allele& allele) const {
+    if (!observationsIndexed || observationTable.alleles->empty()) {
+        return -1;
+    }
+    const vector<Allele>& alleles = *observationTable.alleles;
+    less<const Allele*> before;
+    if (before(&allele, &alleles.front()) || before(&alleles.back(), &allele)) {
+        return -1;
+    }
+    return &allele - &alleles.front();
+}
+
+const vector<Allele*>* Sample::observations(int allele) const {
+    int g = observationTable.groups[allele];
+    return (g == -1) ? NULL : &groups[g].second;
+}
+
 // sample tracking and allele sorting
 // the number of observations for this allele
 int Sample::observationCount(Allele& allele) {
-    return observationCount(allele.currentBase);
+    int i = alleleIndex(allele);
+    return (i != -1) ? observationTable.observationCount(i) : observationCount(allele.currentBase);
 }
 
 int Sample::observationCountInclPartials(void) {
@@ -12,11 +284,12 @@ int Sample::observationCountInclPartials(void) {
 }
 
 double Sample::observationCountInclPartials(Allele& allele) {
-    return observationCountInclPartials(allele.currentBase);
+    return observationCount(allele) + partialObservationCount(allele);
 }
 
 double Sample::partialObservationCount(Allele& allele) {
-    return partialObservationCount(allele.currentBase);
+    int i = alleleIndex(allele);
+    return (i != -1) ? observationTable.partialObservationCount(i) : partialObservationCount(allele.currentBase);
 }
 
 // the number of observations for this base
@@ -29,16 +302,17 @@ int Sample::observationCount(const string& base) {
 }
 
 int Sample::partialObservationCount(void) {
-    return reversePartials.size();
+    return partials.size();
 }
 
 double Sample::partialObservationCount(const string& base) {
     double scaledPartialCount = 0;
-    map<string, vector<Allele*> >::iterator g = partialSupport.find(base);
-    if (g != partialSupport.end()) {
-        vector<Allele*>& supportingObs = g->second;
-        for (vector<Allele*>::iterator a = supportingObs.begin(); a != supportingObs.end(); ++a) {
-            scaledPartialCount += (double) 1 / (double) reversePartials[*a].size();
+    if (observationsIndexed) {
+        const vector<Allele>& alleles = *observationTable.alleles;
+        for (int i = 0; i < (int) alleles.size(); ++i) {
+            if (alleles[i].currentBase == base) {
+                scaledPartialCount += observationTable.partialObservationCount(i);
+            }
         }
     }
     return scaledPartialCount;
@@ -58,7 +332,8 @@ int Sample::observationCount(void) {
 }
 
 int Sample::qualSum(Allele& allele) {
-    return qualSum(allele.currentBase);
+    int i = alleleIndex(allele);
+    return (i != -1) ? observationTable.qualSum(i) : qualSum(allele.currentBase);
 }
 
 int Sample::qualSum(const string& base) {
@@ -74,16 +349,18 @@ int Sample::qualSum(const string& base) {
 }
 
 double Sample::partialQualSum(Allele& allele) {
-    return partialQualSum(allele.currentBase);
+    int i = alleleIndex(allele);
+    return (i != -1) ? observationTable.partialQualSum(i) : partialQualSum(allele.currentBase);
 }
 
 double Sample::partialQualSum(const string& base) {
-    Sample::iterator g = partialSupport.find(base);
     double qsum = 0;
-    if (g != partialSupport.end()) {
-        vector<Allele*>& alleles = g->second;
-        for (vector<Allele*>::iterator a = alleles.begin(); a != alleles.end(); ++a) {
-            qsum += (double) (*a)->quality / (double) reversePartials[*a].size();
+    if (observationsIndexed) {
+        const vector<Allele>& alleles = *observationTable.alleles;
+        for (int i = 0; i < (int) alleles.size(); ++i) {
+            if (alleles[i].currentBase == base) {
+                qsum += observationTable.partialQualSum(i);
+            }
         }
     }
     return qsum;
@@ -166,7 +443,7 @@ double Samples::partialQualSum(const string& base) {
 }
 
 map<string, double> Samples::estimatedAlleleFrequencies(void) {
-    map<string, long double> qualsums;
+    map<string, Real> qualsums;
     for (Samples::iterator s = begin(); s != end(); ++s) {
         Sample& sample = s->second;
         for (Sample::iterator o = sample.begin(); o != sample.end(); ++o) {
@@ -174,12 +451,12 @@ map<string, double> Samples::estimatedAlleleFrequencies(void) {
             qualsums[base] += sample.qualSum(base);
         }
     }
-    long double total = 0;
-    for (map<string, long double>::iterator q = qualsums.begin(); q != qualsums.end(); ++q) {
+    Real total = 0;
+    for (map<string, Real>::iterator q = qualsums.begin(); q != qualsums.end(); ++q) {
         total += q->second;
     }
     map<string, double> freqs;
-    for (map<string, long double>::iterator q = qualsums.begin(); q != qualsums.end(); ++q) {
+    for (map<string, Real>::iterator q = qualsums.begin(); q != qualsums.end(); ++q) {
         freqs[q->first] = q->second / total;
         //cerr << "estimated frequency " << q->first << " " << freqs[q->first] << endl;
     }
@@ -189,25 +466,22 @@ map<string, double> Samples::estimatedAlleleFrequencies(void) {
 // puts alleles into the right bins if they have changed their base (as
 // occurs in the case of reference alleles)
 void Sample::sortReferenceAlleles(void) {
+    // collected first, as adding groups moves the others
+    vector<Allele*> moved;
     for (Sample::iterator g = begin(); g != end(); ++g) {
         const string& groupBase = g->first;
         vector<Allele*>& alleles = g->second;
         for (vector<Allele*>::iterator a = alleles.begin(); a != alleles.end(); ++a) {
-            const string& base = (*a)->currentBase;
-            if (base != groupBase) {
-                Sample::iterator g = find(base);
-                if (g != end()) {
-                    g->second.push_back(*a);
-                } else {
-                    vector<Allele*> alleles;
-                    alleles.push_back(*a);
-                    insert(begin(), make_pair(base, alleles));
-                }
+            if ((*a)->currentBase != groupBase) {
+                moved.push_back(*a);
                 *a = NULL;
             }
         }
         alleles.erase(remove(alleles.begin(), alleles.end(), (Allele*)NULL), alleles.end());
     }
+    for (vector<Allele*>::iterator a = moved.begin(); a != moved.end(); ++a) {
+        (*this)[(*a)->currentBase].push_back(*a);
+    }
 }
 
 StrandBaseCounts
@@ -260,7 +534,7 @@ string Sample::tojson(void) {
     stringstream out;
     out << "[";
     bool first = true;
-    for (map<string, vector<Allele*> >::iterator g = this->begin(); g != this->end(); ++g) {
+    for (Sample::iterator g = begin(); g != end(); ++g) {
         vector<Allele*>& alleles = g->second;
         for (vector<Allele*>::iterator a = alleles.begin(); a != alleles.end(); ++a) {
             if (!first) { out << ","; } else { first = false; }
@@ -352,6 +626,23 @@ ostream& operator<<(ostream& out, Sample& sample) {
 }
 
 
+// the sequence a partial observation is compared against an allele of the
+// given length with; partials spanning the whole haplotype window are
+// extended with the rest of the read when the allele is long enough
+enum PartialSequence { PARTIAL_ALTERNATE = 0, PARTIAL_READ5P, PARTIAL_READ3P };
+
+PartialSequence partialSequenceFor(size_t alleleLength, bool spansWindow,
+                                   size_t withLeft, size_t withRight) {
+    if (spansWindow) {
+        if (withLeft <= alleleLength) {
+            return PARTIAL_READ5P;
+        } else if (withRight <= alleleLength) {
+            return PARTIAL_READ3P;
+        }
+    }
+    return PARTIAL_ALTERNATE;
+}
+
 void Samples::assignPartialSupport(vector<Allele>& alleles,
                                    vector<Allele*>& partialObservations,
                                    map<string, vector<Allele*> >& partialObservationGroups,
@@ -361,84 +652,115 @@ void Samples::assignPartialSupport(vector<Allele>& alleles,
 
     // clean up results of any previous calls to this function
     clearPartialObservations();
+    supportedBases.resize(alleles.size());
+    for (int a = 0; a < (int) alleles.size(); ++a) {
+        supportedBases[a] = alleles[a].currentBase;
+    }
 
-    for (vector<Allele>::iterator a = alleles.begin(); a != alleles.end(); ++a) {
-        Allele& allele = *a;
-        //string& base = allele.currentBase;
-        // hacks here
-        string& aseq = allele.alternateSequence;
-        //cerr << "alternate, seeking partial support " << aseq << endl
-        //     << "allele: " << allele << endl;
-        // construct pseudo-sequence
-        for (vector<Allele*>::iterator p = partialObservations.begin(); p != partialObservations.end(); ++p) {
-            Allele& partial = **p;
-            string pseq = partial.alternateSequence;
-            bool same = false;
-            // if the partial could support the alternate if we consider "reference-matching"
-            // sequence beyond the haplotype window, add it to the comparison
-            if (partial.position == haplotypeStart && partial.referenceLength == haplotypeLength) {
-                if (pseq.size() + partial.basesLeft <= aseq.size()) {
-                    pseq = partial.read5p();
-                } else if (pseq.size() + partial.basesRight <= aseq.size()) {
-                    pseq = partial.read3p();
+    haplotypeIndex.build(alleles);
+    partialsByAllele.resize(alleles.size());
+    for (vector<vector<int> >::iterator g = partialsByAllele.begin(); g != partialsByAllele.end(); ++g) {
+        g->clear();
+    }
+
+    vector<int> hits;
+    vector<char> supports(alleles.size());
+    string extended;
+
+    for (int i = 0; i < (int) partialObservations.size(); ++i) {
+        Allele& partial = *partialObservations[i];
+        size_t withLeft = partial.alternateSequence.size() + partial.basesLeft;
+        size_t withRight = partial.alternateSequence.size() + partial.basesRight;
+        // if the partial could support the alternate if we consider "reference-matching"
+        // sequence beyond the haplotype window, add it to the comparison
+        bool spansWindow = partial.position == haplotypeStart
+            && partial.referenceLength == haplotypeLength;
+        fill(supports.begin(), supports.end(), 0);
+        bool supportsAny = false;
+
+        for (int k = PARTIAL_ALTERNATE; k <= PARTIAL_READ3P; ++k) {
+            PartialSequence kind = (PartialSequence) k;
+            // skip sequences which no allele length would select
+            if (kind == PARTIAL_ALTERNATE) {
+                if (spansWindow && withLeft <= haplotypeIndex.minLength
+                    && withRight <= haplotypeIndex.minLength) continue;
+            } else if (!spansWindow) {
+                continue;
+            } else if (kind == PARTIAL_READ5P) {
+                if (withLeft > haplotypeIndex.maxLength) continue;
+            } else if (withRight > haplotypeIndex.maxLength
+                       || withLeft <= haplotypeIndex.minLength) {
+                continue;
+            }
+            const string* pseq = &partial.alternateSequence;
+            if (kind == PARTIAL_READ5P) {
+                extended = partial.read5p();
+                pseq = &extended;
+            } else if (kind == PARTIAL_READ3P) {
+                extended = partial.read3p();
+                pseq = &extended;
+            }
+            if (pseq->empty()) {
+                continue;
+            }
+            // the prefix case needs room for the rest of the read to the right, the suffix case to the left
+            for (int end = 0; end < 2; ++end) {
+                hits.clear();
+                if (end == 0) {
+                    haplotypeIndex.withPrefix(*pseq, hits);
+                } else {
+                    haplotypeIndex.withSuffix(*pseq, hits);
+                }
+                for (vector<int>::iterator h = hits.begin(); h != hits.end(); ++h) {
+                    size_t alleleLength = alleles[*h].alternateSequence.size();
+                    if ((end == 0 ? withRight : withLeft) <= alleleLength
+                        && partialSequenceFor(alleleLength, spansWindow, withLeft, withRight) == kind) {
+                        supports[*h] = 1;
+                        supportsAny = true;
+                    }
                 }
             }
-            // otherwise, we should be fine to go with the seqs
-            // basically, this is the partial reference coordinate-matching case
-            //cerr << partial << " bp l/r " << partial.basesLeft << "/" << partial.basesRight
-            //     << " szes , " << pseq.size() << " vs " << aseq.size() << endl;
-            if (!pseq.empty()
-                && aseq.size() >= pseq.size()
-                && ((partial.alternateSequence.size() + partial.basesRight <= aseq.size()
-                     && (aseq.substr(0, pseq.size()) == pseq))
-                    || (partial.alternateSequence.size() + partial.basesLeft <= aseq.size() 
-                        && (aseq.substr(aseq.size()-pseq.size()) == pseq)))) {
-                // dAY's du saem
-                partialObservationGroups[allele.currentBase].push_back(*p);
-                partialObservationSupport[*p].insert(&*a);
-                //cerr << "partial support of " << *a << " by " << *p << endl;
-                same = true;
+        }
+
+        if (!supportsAny) {
+            continue;
+        }
+        set<Allele*>& supported = partialObservationSupport[partialObservations[i]];
+        for (int a = 0; a < (int) alleles.size(); ++a) {
+            if (supports[a]) {
+                partialsByAllele[a].push_back(i);
+                supported.insert(&alleles[a]);
             }
         }
-    }
 
-    for (vector<Allele*>::iterator p = partialObservations.begin(); p != partialObservations.end(); ++p) {
-        // get the sample
-        Allele& partial = **p;
+        // record the support in the partial's sample
         Samples::iterator siter = find(partial.sampleID);
         if (siter == end()) {
             continue;
         }
         Sample& sample = siter->second;
-        map<Allele*, set<Allele*> >::iterator sup = partialObservationSupport.find(*p);
-        if (sup != partialObservationSupport.end()) {
-            set<Allele*>& supported = sup->second;
-            for (set<Allele*>::iterator s = supported.begin(); s != supported.end(); ++s) {
-                sample.partialSupport[(*s)->currentBase].push_back(*p);
-                sample.supportedAlleles.insert((*s)->currentBase);
-            }
-            if (!supported.empty()) {
-                sample.reversePartials[*p] = supported;
+        sample.partials.push_back(partialObservations[i]);
+        for (int a = 0; a < (int) alleles.size(); ++a) {
+            if (supports[a]) {
+                sample.partialSupport.push_back(a);
             }
         }
-        //sample.partialObservations.push_back(*p);
+        sample.partialSupportOffsets.push_back(sample.partialSupport.size());
+        sample.observationsIndexed = false;
     }
 
-}
-
-bool Sample::observationSupports(Allele* obs, Allele* allele) {
-    if (obs->currentBase == allele->currentBase) {
-        return true;
-    } else {
-        map<Allele*, set<Allele*> >::iterator p = reversePartials.find(obs);
-        if (p != reversePartials.end()) {
-            set<Allele*>& supports = p->second;
-            if (supports.find(allele) != supports.end()) {
-                return true;
-            }
+    // groups are filled allele by allele
+    for (int a = 0; a < (int) alleles.size(); ++a) {
+        vector<int>& supporting = partialsByAllele[a];
+        if (supporting.empty()) {
+            continue;
+        }
+        vector<Allele*>& group = partialObservationGroups[alleles[a].currentBase];
+        for (vector<int>::iterator p = supporting.begin(); p != supporting.end(); ++p) {
+            group.push_back(partialObservations[*p]);
         }
-        return false;
     }
+
 }
 
 void Samples::clearFullObservations(void) {
@@ -448,25 +770,15 @@ void Samples::clearFullObservations(void) {
 }
 
 void Samples::clearPartialObservations(void) {
+    supportedBases.clear();
     for (Samples::iterator s = begin(); s != end(); ++s) {
         s->second.clearPartialObservations();
     }
 }
 
 void Sample::clearPartialObservations(void) {
-    supportedAlleles.clear();
-    for (Sample::iterator a = begin(); a != end(); ++a)
-        supportedAlleles.insert(a->first);
+    observationsIndexed = false;
+    partials.clear();
     partialSupport.clear();
-    reversePartials.clear();
-}
-
-void Sample::setSupportedAlleles(void) {
-    for (Sample::iterator a = begin(); a != end(); ++a)
-        supportedAlleles.insert(a->first);
-}
-
-void Samples::setSupportedAlleles(void) {
-    for (Samples::iterator s = begin(); s != end(); ++s)
-        s->second.setSupportedAlleles();
+    partialSupportOffsets.assign(1, 0);
 }
@@ -33,38 +33,160 @@ StrandBaseCounts(int fr,
 
 };
 
+class Sample;
+
+// A sample's observations indexed by the site's genotype alleles, built once
+// the alleles are known.  The alleles are mapped onto the sample's groups of
+// observations, and partial support is kept as a sparse matrix, a row of
+// partial observations per allele, each weighted by its share of the support
+// of the partial observation.  Counts and quality sums are computed once when
+// the table is built, and looked up by allele index.  Each Sample holds its
+// own, reused across sites.
+class AlleleObservationTable {
+public:
+    // the site's alleles the table was built over, NULL until built
+    const vector<Allele>* alleles;
+    // the sample's group holding the observations of each allele, -1 if none
+    vector<int> groups;
+    // the first allele with the base of each group, -1 if none
+    vector<int> groupAlleles;
+    vector<int> counts;
+    vector<int> qualSums;
+    // the partial observations supporting allele i are the sample's partials
+    // numbered partials[partialOffsets[i] .. partialOffsets[i+1]), ascending
+    vector<int> partialOffsets;
+    vector<int> partials;
+    vector<double> partialCounts;
+    vector<double> partialQualSums;
+    // for each of the sample's partial observations, the first allele with
+    // its base, -1 if none, and the alleles it is compared against: those
+    // with its base and those it supports, ascending, in
+    // partialAlleles[partialAlleleOffsets[p] .. partialAlleleOffsets[p+1])
+    vector<int> partialBaseAlleles;
+    vector<int> partialAlleleOffsets;
+    vector<int> partialAlleles;
+
+    // the indexes of the site's alleles, stably sorted by base
+    vector<int> allelesByBase;
+    // the sample's bases and the alleles with each, in base order, as a
+    // group (-1 if the sample has no observations of the base) and the
+    // alleles allelesByBase[first .. last)
+    class BaseEntry {
+    public:
+        int group;
+        int first;
+        int last;
+    };
+    vector<BaseEntry> entries;
+
+    AlleleObservationTable(void) : alleles(NULL) { }
+    // byBase is the indexes of the alleles, stably sorted by base, and the
+    // sample's partials support the alleles byBase[supportRanges[j]) for
+    // each supported allele j
+    void build(Sample& sample, vector<Allele>& alleles,
+               const vector<int>& byBase,
+               const vector<pair<int, int> >& supportRanges);
+    int observationCount(int allele) const { return counts[allele]; }
+    int qualSum(int allele) const { return qualSums[allele]; }
+    double partialObservationCount(int allele) const { return partialCounts[allele]; }
+    double partialQualSum(int allele) const { return partialQualSums[allele]; }
+
+private:
+    vector<int> rowEnds;  // scratch for filling the rows of partials
+};
+
+// The candidate haplotype sequences sorted forward and reversed, so the
+// alleles which begin or end with a partial observation's sequence are found
+// by binary search instead of by comparing against every allele.
+class HaplotypeSequenceIndex {
+public:
+    size_t minLength;
+    size_t maxLength;
+
+    void build(vector<Allele>& alleles);
+    // append the indexes of the alleles starting (ending) with seq to hits
+    void withPrefix(const string& seq, vector<int>& hits);
+    void withSuffix(const string& seq, vector<int>& hits);
+
+private:
+    vector<pair<string, int> > forward;
+    vector<pair<string, int> > reversed;
+};
+
 // sample tracking and allele sorting
-class Sample : public map<string, vector<Allele*> > {
+//
+// A sample's observations at a site, grouped by base.  The groups are kept in
+// base order in vectors which last as long as the sample, so gathering the
+// observations of each site reuses their storage instead of allocating map
+// nodes; iterating gives (base, observations) pairs, as a map would.
+class Sample {
 
     friend ostream& operator<<(ostream& out, Sample& sample);
 
 public:
 
-    // includes both fully and partially-supported observations after adding partial obs
-    set<string> supportedAlleles;
-    void setSupportedAlleles(void);
-
-    // partial support for alleles, such as for observations that partially overlap the calling window
-    map<string, vector<Allele*> > partialSupport;
-
-    // for fast scaling of qualities for partial supports
-    map<Allele*, set<Allele*> > reversePartials;
+    typedef pair<string, vector<Allele*> > Group;
+    typedef vector<Group>::iterator iterator;
+    typedef vector<Group>::const_iterator const_iterator;
+
+    Sample(void)
+        : observationsIndexed(false)
+        , partialSupportOffsets(1, 0)
+        , groupCount(0)
+        { }
+
+    iterator begin(void) { return groups.begin(); }
+    iterator end(void) { return groups.begin() + groupCount; }
+    const_iterator begin(void) const { return groups.begin(); }
+    const_iterator end(void) const { return groups.begin() + groupCount; }
+    size_t size(void) const { return groupCount; }
+    bool empty(void) const { return groupCount == 0; }
+    iterator find(const string& base);
+    const_iterator find(const string& base) const;
+    // the observations of base, added as an empty group if there are none
+    vector<Allele*>& operator[](const string& base);
+    void erase(const string& base);
+    // empties the groups, keeping their storage
+    void clear(void);
+
+    // built by Samples::indexObservations once the site's alleles are known,
+    // and disregarded once the observations change
+    AlleleObservationTable observationTable;
+    bool observationsIndexed;
+    // if the table was built over the given alleles
+    bool indexedFor(const vector<Allele>* alleles) const {
+        return observationsIndexed && observationTable.alleles == alleles;
+    }
+    // the index of one of the site's alleles by its address, -1 if the
+    // allele isn't one of those the table was built over
+    int alleleIndex(const Allele& allele) const;
+
+    // partial support, such as for observations that partially overlap the
+    // calling window: partial observation p supports the alleles
+    // partialSupport[partialSupportOffsets[p] .. partialSupportOffsets[p+1]),
+    // by index into those given to Samples::assignPartialSupport
+    vector<Allele*> partials;
+    vector<int> partialSupportOffsets;
+    vector<int> partialSupport;
 
     // clear the above
     void clearPartialObservations(void);
 
-    // set of partial observations (keys of the above map) cached for faster GL calculation
-    //vector<Allele*> partialObservations;
-
-    // if the observation (partial or otherwise) supports the allele
-    bool observationSupports(Allele* obs, Allele* allele);
-
     // the number of observations for this allele
     int observationCount(Allele& allele);
     double observationCountInclPartials(Allele& allele);
     double partialObservationCount(Allele& allele);
 
-    // the number of observations for this base
+    // by the index of one of the alleles the table was built over
+    int observationCount(int allele) const { return observationTable.observationCount(allele); }
+    int qualSum(int allele) const { return observationTable.qualSum(allele); }
+    double partialObservationCount(int allele) const { return observationTable.partialObservationCount(allele); }
+    double partialQualSum(int allele) const { return observationTable.partialQualSum(allele); }
+    // NULL if there are none
+    const vector<Allele*>* observations(int allele) const;
+
+    // the number of observations for this base; partial support is only
+    // counted once the table is built
     int observationCount(const string& base);
     double observationCountInclPartials(const string& base);
     double partialObservationCount(const string& base);
@@ -91,10 +213,17 @@ public:
 
     string tojson(void);
 
+private:
+
+    vector<Group> groups;  // the first groupCount in use, in base order
+    size_t groupCount;
+
 };
 
 class Samples : public map<string, Sample> {
 public:
+    // builds each sample's observation table over the site's genotype alleles
+    void indexObservations(vector<Allele>& alleles);
     map<string, double> estimatedAlleleFrequencies(void);
     void assignPartialSupport(vector<Allele>& alleles,
                               vector<Allele*>& partialObservations,
@@ -121,7 +250,16 @@ public:
 
     void clearFullObservations(void);
     void clearPartialObservations(void);
-    void setSupportedAlleles(void);
+
+private:
+    HaplotypeSequenceIndex haplotypeIndex;
+    vector<vector<int> > partialsByAllele;
+    vector<int> allelesByBase;
+    // the bases of the alleles given to assignPartialSupport, which the
+    // samples' partial support refers to, and the alleles with each base
+    // once indexed
+    vector<string> supportedBases;
+    vector<pair<int, int> > supportRanges;
 };
 
 int countAlleles(Samples& samples);
@@ -0,0 +1,81 @@
+#include "SiteWorkspace.h"
+#ifdef VERBOSE_DEBUG
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static atomic<long unsigned int> heapAllocationCount(0);
+
+void* operator new(size_t size) {
+    ++heapAllocationCount;
+    void* p = malloc(size ? size : 1);
+    if (!p) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+long unsigned int heapAllocations(void) {
+    return heapAllocationCount;
+}
+#else
+long unsigned int heapAllocations(void) {
+    return 0;
+}
+#endif
+
+
+SiteWorkspace::SiteWorkspace(void)
+    : allocationsAtClear(0)
+{ }
+
+static void clearLikelihoods(map<string, SampleDataLikelihoods>& likelihoodsByPopulation) {
+    for (map<string, SampleDataLikelihoods>::iterator p = likelihoodsByPopulation.begin();
+         p != likelihoodsByPopulation.end(); ++p) {
+        p->second.clear();
+    }
+}
+
+static void dropEmpty(map<string, SampleDataLikelihoods>& likelihoodsByPopulation) {
+    map<string, SampleDataLikelihoods>::iterator p = likelihoodsByPopulation.begin();
+    while (p != likelihoodsByPopulation.end()) {
+        if (p->second.empty()) {
+            likelihoodsByPopulation.erase(p++);
+        } else {
+            ++p;
+        }
+    }
+}
+
+void SiteWorkspace::clear(void) {
+    // sample results are looked up by name only for samples in the best
+    // combo, which are always set again at the site
+    for (Results::iterator r = results.begin(); r != results.end(); ++r) {
+        r->second.clear();
+    }
+    alleleGroups.clear();
+    partialObservationGroups.clear();
+    partialObservationSupport.clear();
+    // genotypesByPloidy is refilled in place by getGenotypesByPloidy
+    clearLikelihoods(sampleDataLikelihoodsByPopulation);
+    clearLikelihoods(variantSampleDataLikelihoodsByPopulation);
+    clearLikelihoods(invariantSampleDataLikelihoodsByPopulation);
+    genotypeCombosByPopulation.clear();
+    glMaxCombos.clear();
+    genotypeCombos.clear();
+    comboProbs.clear();
+    sampleListPlusRef.clear();
+    allocationsAtClear = heapAllocations();
+}
+
+void SiteWorkspace::dropEmptyPopulations(void) {
+    dropEmpty(sampleDataLikelihoodsByPopulation);
+}
+
+long unsigned int SiteWorkspace::siteAllocations(void) {
+    return heapAllocations() - allocationsAtClear;
+}
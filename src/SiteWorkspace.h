@@ -0,0 +1,59 @@
+#ifndef __SITE_WORKSPACE_H
+#define __SITE_WORKSPACE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <list>
+#include <set>
+#include "Allele.h"
+#include "Genotype.h"
+#include "ResultData.h"
+
+using namespace std;
+
+// The containers the main loop fills at each site, kept from one site to the
+// next.  clear() empties them without giving back their storage where what
+// they hold allows it: vectors keep their capacity, and per-sample results
+// and per-population likelihoods keep their entries, since the same samples
+// and populations come up at nearly every site.  Maps whose keys vary by site
+// (allele bases, genotype combos) are emptied outright.
+class SiteWorkspace {
+
+public:
+
+    SiteWorkspace(void);
+
+    Results results;
+    map<string, vector<Allele*> > alleleGroups;
+    map<string, vector<Allele*> > partialObservationGroups;
+    map<Allele*, set<Allele*> > partialObservationSupport;
+    map<int, vector<Genotype> > genotypesByPloidy;
+    map<string, SampleDataLikelihoods> sampleDataLikelihoodsByPopulation;
+    map<string, SampleDataLikelihoods> variantSampleDataLikelihoodsByPopulation;
+    map<string, SampleDataLikelihoods> invariantSampleDataLikelihoodsByPopulation;
+    map<string, list<GenotypeCombo> > genotypeCombosByPopulation;
+    map<string, list<GenotypeCombo> > glMaxCombos;
+    list<GenotypeCombo> genotypeCombos;
+    vector<Real> comboProbs;
+    vector<string> sampleListPlusRef;
+
+    void clear(void);
+    // removes populations which have no samples at this site from
+    // sampleDataLikelihoodsByPopulation, as if it had been built from scratch
+    void dropEmptyPopulations(void);
+
+    // heap allocations by this process since the last clear(), only
+    // counted in debug (VERBOSE_DEBUG) builds
+    long unsigned int siteAllocations(void);
+
+private:
+
+    long unsigned int allocationsAtClear;
+
+};
+
+// total heap allocations so far, 0 unless built with VERBOSE_DEBUG
+long unsigned int heapAllocations(void);
+
+#endif
@@ -3,6 +3,8 @@
 #include "Utility.h"
 #include "Sum.h"
 #include "Product.h"
+#include "QualityBatch.h"
+#include <limits>
 
 #define PHRED_MAX 50000.0 // max Phred seems to be about 43015 (?), could be an underflow bug...
 
@@ -12,11 +14,11 @@ short qualityChar2ShortInt(char c) {
     return static_cast<short>(c) - 33;
 }
 
-long double qualityChar2LongDouble(char c) {
-    return static_cast<long double>(c) - 33;
+Real qualityChar2LongDouble(char c) {
+    return static_cast<Real>(c) - 33;
 }
 
-long double lnqualityChar2ShortInt(char c) {
+Real lnqualityChar2ShortInt(char c) {
     return log(static_cast<short>(c) - 33);
 }
 
@@ -24,41 +26,41 @@ char qualityInt2Char(short i) {
     return static_cast<char>(i + 33);
 }
 
-long double ln2log10(long double prob) {
+Real ln2log10(Real prob) {
     return M_LOG10E * prob;
 }
 
-long double log102ln(long double prob) {
+Real log102ln(Real prob) {
     return M_LN10 * prob;
 }
 
-long double phred2ln(int qual) {
+Real phred2ln(int qual) {
     return M_LN10 * qual * -.1;
 }
 
-long double ln2phred(long double prob) {
+Real ln2phred(Real prob) {
     return -10 * M_LOG10E * prob;
 }
 
-long double phred2float(int qual) {
+Real phred2float(int qual) {
     return pow(10, qual * -.1);
 }
 
-long double float2phred(long double prob) {
+Real float2phred(Real prob) {
     if (prob == 1)
         return PHRED_MAX;  // guards against "-0"
-    long double p = -10 * (long double) log10(prob);
+    Real p = -10 * (Real) log10(prob);
     if (p < 0 || p > PHRED_MAX) // int overflow guard
         return PHRED_MAX;
     else
         return p;
 }
 
-long double big2phred(const BigFloat& prob) {
-    return -10 * (long double) (ttmath::Log(prob, (BigFloat)10)).ToDouble();
+Real big2phred(const BigFloat& prob) {
+    return -10 * (Real) (ttmath::Log(prob, (BigFloat)10)).ToDouble();
 }
 
-long double nan2zero(long double x) {
+Real nan2zero(Real x) {
     if (x != x) {
         return 0;
     } else {
@@ -66,18 +68,18 @@ long double nan2zero(long double x) {
     }
 }
 
-long double powln(long double m, int n) {
+Real powln(Real m, int n) {
     return m * n;
 }
 
 // the probability that we have a completely true vector of qualities
-long double jointQuality(const std::vector<short>& quals) {
-    std::vector<long double> probs;
+Real jointQuality(const std::vector<short>& quals) {
+    std::vector<Real> probs;
     for (int i = 0; i<quals.size(); ++i) {
         probs.push_back(phred2float(quals[i]));
     }
     // product of probability we don't have a true event for each element
-    long double prod = 1 - probs.front();
+    Real prod = 1 - probs.front();
     for (int i = 1; i<probs.size(); ++i) {
         prod *= 1 - probs.at(i);
     }
@@ -85,40 +87,30 @@ long double jointQuality(const std::vector<short>& quals) {
     return 1 - prod;
 }
 
-long double jointQuality(const std::string& qualstr) {
-
-    long double jq = 1;
-    // product of probability we don't have a true event for each element
-    for (string::const_iterator q = qualstr.begin(); q != qualstr.end(); ++q) {
-        jq *= 1 - phred2float(qualityChar2ShortInt(*q));
-    }
-
-    // and then invert it again to get probability of an event
-    return 1 - jq;
-
+Real jointQuality(const std::string& qualstr) {
+    return qualityJointError(qualstr.data(), qualstr.size());
 }
 
 std::vector<short> qualities(const std::string& qualstr) {
-
-    std::vector<short> quals;
-    for (int i=0; i<qualstr.size(); i++)
-        quals.push_back(qualityChar2ShortInt(qualstr.at(i)));
-
+    std::vector<short> quals(qualstr.size());
+    qualityDecode(qualstr.data(), qualstr.size(), quals.data());
     return quals;
-
 }
 
-long double sumQuality(const std::string& qualstr) {
-    long double qual = 0;
-    for (string::const_iterator q = qualstr.begin(); q != qualstr.end(); ++q)
-        qual += qualityChar2LongDouble(*q);
-    return qual;
+Real sumQuality(const std::string& qualstr) {
+    return qualitySum(qualstr.data(), qualstr.size());
 }
 
-long double minQuality(const std::string& qualstr) {
-    long double qual = 0;
+Real minQuality(const std::string& qualstr) {
+    // a 0 is replaced by the next quality, so only use the plain minimum when
+    // there are no 0s
+    short m = qualityMin(qualstr.data(), qualstr.size());
+    if (m > 0) {
+        return m;
+    }
+    Real qual = 0;
     for (string::const_iterator q = qualstr.begin(); q != qualstr.end(); ++q) {
-        long double nq = qualityChar2LongDouble(*q);
+        Real nq = qualityChar2LongDouble(*q);
         if (qual == 0) {
             qual = nq;
         } else if (nq < qual) {
@@ -137,15 +129,13 @@ short minQuality(const std::vector<short>& qualities) {
 }
 
 // crudely averages quality scores in phred space
-long double averageQuality(const std::string& qualstr) {
-    long double qual = 0; //(long double) *max_element(quals.begin(), quals.end());
-    for (string::const_iterator q = qualstr.begin(); q != qualstr.end(); ++q)
-        qual += qualityChar2LongDouble(*q);
+Real averageQuality(const std::string& qualstr) {
+    Real qual = qualitySum(qualstr.data(), qualstr.size());
     return qual / qualstr.size();
 }
 
-long double averageQuality(const vector<short>& qualities) {
-    long double qual = 0;
+Real averageQuality(const vector<short>& qualities) {
+    Real qual = 0;
     for (vector<short>::const_iterator q = qualities.begin(); q != qualities.end(); ++q) {
         qual += *q;
     }
@@ -198,48 +188,49 @@ int binomialCoefficient(int n, int k) {
 }
 
 // k successes in n trials with prob of success p
-long double binomialProb(int k, int n, long double p) {
+Real binomialProb(int k, int n, Real p) {
     return factorial(n) / (factorial(k) * factorial(n - k)) * pow(p, k) * pow(1 - p, n - k);
 }
 
-long double __binomialProbln(int k, int n, long double p) {
+Real __binomialProbln(int k, int n, Real p) {
     return factorialln(n) - (factorialln(k) + factorialln(n - k)) + powln(log(p), k) + powln(log(1 - p), n - k);
 }
 
-long double binomialCoefficientLn(int k, int n) {
+Real binomialCoefficientLn(int k, int n) {
     return factorialln(n) - (factorialln(k) + factorialln(n - k));
 }
 
-BinomialCache binomialCache;
+// one per thread, so the --threads workers needn't lock it
+thread_local BinomialCache binomialCache;
 
-long double binomialProbln(int k, int n, long double p) {
+Real binomialProbln(int k, int n, Real p) {
     return binomialCache.binomialProbln(k, n, p);
 }
 
 /*
-long double probability(int k, int n, long double p) {
+Real probability(int k, int n, Real p) {
     int n = n - k;
     int m = k;
-    long double q = 1 - p;
-    long double temp = lgammal(m + n + 1.0);
+    Real q = 1 - p;
+    Real temp = lgammal(m + n + 1.0);
     temp -= lgammal(n + 1.0) + lgammal(m + 1.0);
     temp += m*log(p) + n*log(q);
     return temp;
 }
 */
 
-long double poissonpln(int observed, int expected) {
+Real poissonpln(int observed, int expected) {
     return ((log(expected) * observed) - expected) - factorialln(observed);
 }
 
-long double poissonp(int observed, int expected) {
+Real poissonp(int observed, int expected) {
     return (double) pow((double) expected, (double) observed) * (double) pow(M_E, (double) -expected) / factorial(observed);
 }
 
 
 // given the expected number of events is the max of a and b
 // what is the probability that we might observe less than the observed?
-long double poissonPvalLn(int a, int b) {
+Real poissonPvalLn(int a, int b) {
 
     int expected, observed;
     if (a > b) {
@@ -248,7 +239,7 @@ long double poissonPvalLn(int a, int b) {
         expected = b; observed = a;
     }
 
-    vector<long double> probs;
+    vector<Real> probs;
     for (int i = 0; i < observed; ++i) {
         probs.push_back(poissonpln(i, expected));
     }
@@ -258,38 +249,38 @@ long double poissonPvalLn(int a, int b) {
 }
 
 
-long double gammaln(
-    long double x
+Real gammaln(
+    Real x
     ) {
 
-    long double cofactors[] = { 76.18009173, 
+    Real cofactors[] = { 76.18009173, 
                                 -86.50532033,
                                 24.01409822,
                                 -1.231739516,
                                 0.120858003E-2,
                                 -0.536382E-5 };    
 
-    long double x1 = x - 1.0;
-    long double tmp = x1 + 5.5;
+    Real x1 = x - 1.0;
+    Real tmp = x1 + 5.5;
     tmp -= (x1 + 0.5) * log(tmp);
-    long double ser = 1.0;
+    Real ser = 1.0;
     for (int j=0; j<=5; j++) {
         x1 += 1.0;
         ser += cofactors[j]/x1;
     }
-    long double y =  (-1.0 * tmp + log(2.50662827465 * ser));
+    Real y =  (-1.0 * tmp + log(2.50662827465 * ser));
 
     return y;
 }
 
-long double factorial(
+Real factorial(
     int n
     ) {
     if (n < 0) {
-        return (long double)0.0;
+        return (Real)0.0;
     }
     else if (n == 0) {
-        return (long double)1.0;
+        return (Real)1.0;
     }
     else {
         return exp(gammaln(n + 1.0));
@@ -299,49 +290,49 @@ long double factorial(
 FactorialCache factorialCache;
 
 /*
-long double factorialln(int n) {
+Real factorialln(int n) {
     return factorialCache.factorialln(n);
 }
 */
 
-long double __factorialln(
+Real __factorialln(
     int n
     ) {
     if (n < 0) {
-        return (long double)-1.0;
+        return (Real)-1.0;
     }
     else if (n == 0) {
-        return (long double)0.0;
+        return (Real)0.0;
     }
     else {
         return gammaln(n + 1.0);
     }
 }
 
-long double cofactor(
+Real cofactor(
     int n, 
     int i
     ) {
     if ((n < 0) || (i < 0) || (n < i)) {
-        return (long double)0.0;
+        return (Real)0.0;
     }
     else if (n == i) {
-        return (long double)1.0;
+        return (Real)1.0;
     }
     else {
         return exp(gammaln(n + 1.0) - gammaln(i + 1.0) - gammaln(n-i + 1.0));
     }
 }
 
-long double cofactorln(
+Real cofactorln(
     int n, 
     int i
     ) {
     if ((n < 0) || (i < 0) || (n < i)) {
-        return (long double)-1.0;
+        return (Real)-1.0;
     }
     else if (n == i) {
-        return (long double)0.0;
+        return (Real)0.0;
     }
     else {
         return gammaln(n + 1.0) - gammaln(i + 1.0) - gammaln(n-i + 1.0);
@@ -349,15 +340,16 @@ long double cofactorln(
 }
 
 // prevent underflows by returning exp(LDBL_MIN_EXP) if exponentiation will produce an underflow
-long double safe_exp(long double ln) {
-    if (ln < LDBL_MIN_EXP) {  // -16381
-        return LDBL_MIN;      // 3.3621e-4932
+// (the double limits with FAST_GL)
+Real safe_exp(Real ln) {
+    if (ln < numeric_limits<Real>::min_exponent) {  // -16381
+        return numeric_limits<Real>::min();         // 3.3621e-4932
     } else {
         return exp(ln);
     }
 }
 
-BigFloat big_exp(long double ln) {
+BigFloat big_exp(Real ln) {
     BigFloat x, result;
     x.FromDouble(ln);
     result = ttmath::Exp(x);
@@ -365,29 +357,29 @@ BigFloat big_exp(long double ln) {
 }
 
 // 'safe' log summation for probabilities
-long double logsumexp_probs(const vector<long double>& lnv) {
-    vector<long double>::const_iterator i = lnv.begin();
-    long double maxN = *i;
+Real logsumexp_probs(const vector<Real>& lnv) {
+    vector<Real>::const_iterator i = lnv.begin();
+    Real maxN = *i;
     ++i;
     for (; i != lnv.end(); ++i) {
         if (*i > maxN)
             maxN = *i;
     }
     BigFloat sum = 0;
-    for (vector<long double>::const_iterator i = lnv.begin(); i != lnv.end(); ++i) {
+    for (vector<Real>::const_iterator i = lnv.begin(); i != lnv.end(); ++i) {
         sum += big_exp(*i - maxN);
     }
     BigFloat maxNb; maxNb.FromDouble(maxN);
     BigFloat bigResult = maxNb + ttmath::Ln(sum);
-    long double result;
+    Real result;
     return bigResult.ToDouble();
 }
 
 // unsafe, kept for potential future use
-long double logsumexp(const vector<long double>& lnv) {
-    long double maxAbs, minN, maxN, c;
-    vector<long double>::const_iterator i = lnv.begin();
-    long double n = *i;
+Real logsumexp(const vector<Real>& lnv) {
+    Real maxAbs, minN, maxN, c;
+    vector<Real>::const_iterator i = lnv.begin();
+    Real n = *i;
     maxAbs = n; maxN = n; minN = n;
     ++i;
     for (; i != lnv.end(); ++i) {
@@ -404,36 +396,36 @@ long double logsumexp(const vector<long double>& lnv) {
     } else {
         c = maxN;
     }
-    long double sum = 0;
-    for (vector<long double>::const_iterator i = lnv.begin(); i != lnv.end(); ++i) {
+    Real sum = 0;
+    for (vector<Real>::const_iterator i = lnv.begin(); i != lnv.end(); ++i) {
         sum += exp(*i - c);
     }
     return c + log(sum);
 }
 
-long double betaln(const vector<long double>& alphas) {
-    vector<long double> gammalnAlphas;
+Real betaln(const vector<Real>& alphas) {
+    vector<Real> gammalnAlphas;
     gammalnAlphas.resize(alphas.size());
     transform(alphas.begin(), alphas.end(), gammalnAlphas.begin(), gammaln);
     return sum(gammalnAlphas) - gammaln(sum(alphas));
 }
 
-long double beta(const vector<long double>& alphas) {
+Real beta(const vector<Real>& alphas) {
     return exp(betaln(alphas));
 }
 
-long double hoeffding(double successes, double trials, double prob) {
+Real hoeffding(double successes, double trials, double prob) {
     return 0.5 * exp(-2 * pow(trials * prob - successes, 2) / trials);
 }
 
-long double hoeffdingln(double successes, double trials, double prob) {
+Real hoeffdingln(double successes, double trials, double prob) {
     return log(0.5) + (-2 * pow(trials * prob - successes, 2) / trials);
 }
 
 // the sum of the harmonic series 1, n
-long double harmonicSum(int n) {
-    long double r = 0;
-    long double i = 1;
+Real harmonicSum(int n) {
+    Real r = 0;
+    Real i = 1;
     while (i <= n) {
         r += 1 / i;
         ++i;
@@ -557,19 +549,19 @@ string dateStr(void) {
 
 }
 
-long double string2float(const string& s) {
-    long double r;
+Real string2float(const string& s) {
+    Real r;
     convert(s, r);
     return r;
 }
 
-long double log10string2ln(const string& s) {
-    long double r;
+Real log10string2ln(const string& s) {
+    Real r;
     convert(s, r);
     return log102ln(r);
 }
 
-long double safedivide(long double a, long double b) {
+Real safedivide(Real a, Real b) {
     if (b == 0) {
         if (a == 0) {
             return 1;
@@ -684,12 +676,12 @@ std::string operator*(std::string const &s, size_t n)
 }
 
 // normalize vector sum to 1
-void normalizeSumToOne(vector<long double>& v) {
-    long double sum = 0;
-    for (vector<long double>::iterator i = v.begin(); i != v.end(); ++i) {
+void normalizeSumToOne(vector<Real>& v) {
+    Real sum = 0;
+    for (vector<Real>::iterator i = v.begin(); i != v.end(); ++i) {
         sum += *i;
     }
-    for (vector<long double>::iterator i = v.begin(); i != v.end(); ++i) {
+    for (vector<Real>::iterator i = v.begin(); i != v.end(); ++i) {
         *i /= sum;
     }
 }
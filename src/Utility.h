@@ -15,37 +15,38 @@
 #include <map>
 #include <time.h>
 #include "convert.h"
+#include "Numeric.h"
 #include "ttmath.h"
 
 using namespace std;
 
 typedef ttmath::Big<TTMATH_BITS(256), TTMATH_BITS(64)> BigFloat;
 
-long double factorial(int);
+Real factorial(int);
 short qualityChar2ShortInt(char c);
-long double qualityChar2LongDouble(char c);
-long double lnqualityChar2ShortInt(char c);
+Real qualityChar2LongDouble(char c);
+Real lnqualityChar2ShortInt(char c);
 char qualityInt2Char(short i);
-//long double phred2float(int qual);
-long double phred2ln(int qual);
-long double ln2phred(long double prob);
-long double ln2log10(long double prob);
-long double log102ln(long double prob);
-long double phred2float(int qual);
-long double float2phred(long double prob);
-long double big2phred(const BigFloat& prob);
-long double nan2zero(long double x);
-long double powln(long double m, int n);
+//Real phred2float(int qual);
+Real phred2ln(int qual);
+Real ln2phred(Real prob);
+Real ln2log10(Real prob);
+Real log102ln(Real prob);
+Real phred2float(int qual);
+Real float2phred(Real prob);
+Real big2phred(const BigFloat& prob);
+Real nan2zero(Real x);
+Real powln(Real m, int n);
 // here 'joint' means 'probability that we have a vector entirely composed of true bases'
-long double jointQuality(const std::vector<short>& quals);
-long double jointQuality(const std::string& qualstr);
+Real jointQuality(const std::vector<short>& quals);
+Real jointQuality(const std::string& qualstr);
 std::vector<short> qualities(const std::string& qualstr);
 // 
-long double sumQuality(const std::string& qualstr);
-long double minQuality(const std::string& qualstr);
+Real sumQuality(const std::string& qualstr);
+Real minQuality(const std::string& qualstr);
 short minQuality(const std::vector<short>& qualities);
-long double averageQuality(const std::string& qualstr);
-long double averageQuality(const std::vector<short>& qualities);
+Real averageQuality(const std::string& qualstr);
+Real averageQuality(const std::vector<short>& qualities);
 //unsigned int factorial(int n);
 bool stringInVector(string item, vector<string> items);
 int upper(int c); // helper to below, wraps toupper
@@ -54,31 +55,31 @@ bool allATGC(string& s);
 string strip(string const& str, char const* separators = " \t");
 
 int binomialCoefficient(int n, int k);
-long double binomialCoefficientLn(int k, int n);
-long double binomialProb(int k, int n, long double p);
-long double __binomialProbln(int k, int n, long double p);
-long double binomialProbln(int k, int n, long double p);
+Real binomialCoefficientLn(int k, int n);
+Real binomialProb(int k, int n, Real p);
+Real __binomialProbln(int k, int n, Real p);
+Real binomialProbln(int k, int n, Real p);
 
-long double poissonpln(int observed, int expected);
-long double poissonp(int observed, int expected);
-long double poissonPvalLn(int a, int b);
+Real poissonpln(int observed, int expected);
+Real poissonp(int observed, int expected);
+Real poissonPvalLn(int a, int b);
 
-long double gammaln( long double x);
-long double factorial( int n);
+Real gammaln( Real x);
+Real factorial( int n);
 double factorialln( int n);
-long double __factorialln( int n);
+Real __factorialln( int n);
 
 #define MAX_FACTORIAL_CACHE_SIZE 100000
 
-class FactorialCache : public map<int, long double> {
+class FactorialCache : public map<int, Real> {
 public:
-    long double factorialln(int n) {
-        map<int, long double>::iterator f = find(n);
+    Real factorialln(int n) {
+        map<int, Real>::iterator f = find(n);
         if (f == end()) {
             if (size() > MAX_FACTORIAL_CACHE_SIZE) {
                 clear();
             }
-            long double fln = __factorialln(n);
+            Real fln = __factorialln(n);
             insert(make_pair(n, fln));
             return fln;
         } else {
@@ -89,17 +90,17 @@ public:
 
 #define MAX_BINOMIAL_CACHE_SIZE 100000
 
-class BinomialCache : public map<long double, map<pair<int, int>, long double> > {
+class BinomialCache : public map<Real, map<pair<int, int>, Real> > {
 public:
-    long double binomialProbln(int k, int n, long double p) {
-        map<pair<int, int>, long double>& t = (*this)[p];
+    Real binomialProbln(int k, int n, Real p) {
+        map<pair<int, int>, Real>& t = (*this)[p];
         pair<int, int> kn = make_pair(k, n);
-        map<pair<int, int>, long double>::iterator f = t.find(kn);
+        map<pair<int, int>, Real>::iterator f = t.find(kn);
         if (f == t.end()) {
             if (t.size() > MAX_BINOMIAL_CACHE_SIZE) {
                 t.clear();
             }
-            long double bln = __binomialProbln(k, n, p);
+            Real bln = __binomialProbln(k, n, p);
             t.insert(make_pair(kn, bln));
             return bln;
         } else {
@@ -108,33 +109,33 @@ public:
     }
 };
 
-long double cofactor( int n, int i);
-long double cofactorln( int n, int i);
+Real cofactor( int n, int i);
+Real cofactorln( int n, int i);
 
-long double harmonicSum(int n);
+Real harmonicSum(int n);
 
-long double safedivide(long double a, long double b);
+Real safedivide(Real a, Real b);
 
-long double safe_exp(long double ln);
+Real safe_exp(Real ln);
 
-BigFloat big_exp(long double ln);
+BigFloat big_exp(Real ln);
 
-long double logsumexp_probs(const vector<long double>& lnv);
-long double logsumexp(const vector<long double>& lnv);
+Real logsumexp_probs(const vector<Real>& lnv);
+Real logsumexp(const vector<Real>& lnv);
 
-long double betaln(const vector<long double>& alphas);
-long double beta(const vector<long double>& alphas);
+Real betaln(const vector<Real>& alphas);
+Real beta(const vector<Real>& alphas);
 
-long double hoeffding(double successes, double trials, double prob);
-long double hoeffdingln(double successes, double trials, double prob);
+Real hoeffding(double successes, double trials, double prob);
+Real hoeffdingln(double successes, double trials, double prob);
 
 int levenshteinDistance(const std::string source, const std::string target);
 bool isTransition(string& ref, string& alt);
 
 string dateStr(void);
 
-long double string2float(const string& s);
-long double log10string2ln(const string& s);
+Real string2float(const string& s);
+Real log10string2ln(const string& s);
 
 string mergeCigar(const string& c1, const string& c2);
 vector<pair<int, string> > splitCigar(const string& cigarStr);
@@ -145,7 +146,7 @@ bool isEmptyCigarElement(const pair<int, string>& elem);
 
 std::string operator*(std::string const &s, size_t n);
 
-void normalizeSumToOne(vector<long double>&);
+void normalizeSumToOne(vector<Real>&);
 
 void addLinesFromFile(vector<string>& v, const string& f);
 
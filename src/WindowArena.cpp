@@ -0,0 +1,120 @@
+#include "WindowArena.h"
+#include "Profiler.h"
+#include <cstdlib>
+#include <climits>
+#include <algorithm>
+
+
+// every allocation is aligned for any type, as operator new is
+static const size_t arenaAlignment = alignof(max_align_t);
+
+// released chunks are kept for reuse up to the number in use, or this many,
+// so a window which moves along at a steady depth stops going to the heap
+static const size_t minSpareChunks = 4;
+
+WindowArena::WindowArena(size_t size)
+    : bytes(0)
+    , peakBytes(0)
+    , chunksAllocated(0)
+    , allocations(0)
+    , nanoseconds(0)
+    , chunkSize(size)
+{ }
+
+WindowArena::~WindowArena(void) {
+    clear();
+    for (vector<Chunk>::iterator c = spares.begin(); c != spares.end(); ++c) {
+        free(c->data);
+    }
+}
+
+// times the enclosing scope into the arena's total, while profiling
+class ArenaTimer {
+public:
+    ArenaTimer(long unsigned int& t) : total(t), start(profiler.enabled ? Profiler::now() : 0) { }
+    ~ArenaTimer(void) {
+        if (profiler.enabled) {
+            total += Profiler::now() - start;
+        }
+    }
+private:
+    long unsigned int& total;
+    long unsigned int start;
+};
+
+WindowArena::Chunk WindowArena::newChunk(size_t size) {
+    ArenaTimer timer(nanoseconds);
+    Chunk chunk;
+    if (size == chunkSize && !spares.empty()) {
+        chunk = spares.back();
+        spares.pop_back();
+    } else {
+        chunk.data = static_cast<char*>(malloc(size));
+        if (!chunk.data) {
+            throw bad_alloc();
+        }
+        chunk.size = size;
+        ++chunksAllocated;
+    }
+    chunk.used = 0;
+    chunk.lastEnd = LONG_MIN;
+    bytes += chunk.size;
+    if (bytes > peakBytes) {
+        peakBytes = bytes;
+    }
+    return chunk;
+}
+
+void WindowArena::retire(Chunk& chunk) {
+    bytes -= chunk.size;
+    if (chunk.size == chunkSize && spares.size() < max(minSpareChunks, chunks.size())) {
+        spares.push_back(chunk);
+    } else {
+        free(chunk.data);
+    }
+}
+
+void* WindowArena::allocate(size_t n, long int end) {
+    ++allocations;
+    n = (n + arenaAlignment - 1) & ~(arenaAlignment - 1);
+    if (n > chunkSize / 4) {
+        // large requests get a chunk to themselves, placed behind the one
+        // being filled
+        Chunk chunk = newChunk(n);
+        chunk.used = n;
+        chunk.lastEnd = end;
+        chunks.insert(chunks.empty() ? chunks.end() : chunks.end() - 1, chunk);
+        return chunk.data;
+    }
+    if (chunks.empty() || chunks.back().used + n > chunks.back().size) {
+        chunks.push_back(newChunk(chunkSize));
+    }
+    Chunk& chunk = chunks.back();
+    void* p = chunk.data + chunk.used;
+    chunk.used += n;
+    if (end > chunk.lastEnd) {
+        chunk.lastEnd = end;
+    }
+    return p;
+}
+
+void WindowArena::release(long int position) {
+    ArenaTimer timer(nanoseconds);
+    vector<Chunk>::iterator kept = chunks.begin();
+    for (vector<Chunk>::iterator c = chunks.begin(); c != chunks.end(); ++c) {
+        if (c->lastEnd < position) {
+            retire(*c);
+        } else {
+            *kept++ = *c;
+        }
+    }
+    chunks.erase(kept, chunks.end());
+}
+
+void WindowArena::clear(void) {
+    ArenaTimer timer(nanoseconds);
+    for (vector<Chunk>::iterator c = chunks.begin(); c != chunks.end(); ++c) {
+        retire(*c);
+    }
+    chunks.clear();
+}
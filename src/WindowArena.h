@@ -0,0 +1,120 @@
+#ifndef _WINDOW_ARENA_H
+#define _WINDOW_ARENA_H
+
+#include <cstddef>
+#include <vector>
+#include <new>
+
+using namespace std;
+
+// Storage for the alleles decomposed from each read, handed out by bumping a
+// pointer through large chunks and given back a chunk at a time, rather than
+// one object at a time.
+//
+// Each allocation is tagged with the end position of its read, and a chunk
+// remembers the furthest end it holds.  Once the parser has dropped the reads
+// ending before a position, release(position) frees every chunk holding only
+// those.  Reads arrive sorted by start, so the chunks fall out of the window
+// roughly in the order they were filled.
+
+class WindowArena {
+
+public:
+
+    WindowArena(size_t chunkSize = 1 << 20);
+    ~WindowArena(void);
+
+    void* allocate(size_t bytes, long int end);
+    // frees the chunks holding only allocations for reads ending before position
+    void release(long int position);
+    // frees everything, once no read is registered
+    void clear(void);
+
+    long unsigned int bytes;      // in live chunks
+    long unsigned int peakBytes;
+    long unsigned int chunksAllocated;  // from the heap, reused spares excepted
+    long unsigned int allocations;
+    // spent taking chunks from the heap or the spares, and in release and
+    // clear, while profiling; the pointer bumps between are too short to time
+    long unsigned int nanoseconds;
+
+private:
+
+    class Chunk {
+    public:
+        char* data;
+        size_t size;
+        size_t used;
+        long int lastEnd;
+    };
+
+    Chunk newChunk(size_t size);
+    void retire(Chunk& chunk);
+
+    size_t chunkSize;
+    vector<Chunk> chunks;  // live, the one being filled last
+    vector<Chunk> spares;  // standard sized chunks kept for reuse
+
+    // not copyable, the chunks are owned
+    WindowArena(const WindowArena&);
+    WindowArena& operator=(const WindowArena&);
+
+};
+
+// Allocates from an arena on behalf of a read ending at end, or from the heap
+// without an arena.  Deallocation is a no-op in the arena, where the memory
+// goes when its chunk is released.
+template <class T>
+class WindowAllocator {
+
+public:
+
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template <class U>
+    struct rebind {
+        typedef WindowAllocator<U> other;
+    };
+
+    WindowAllocator(void) : arena(NULL), end(0) { }
+    WindowAllocator(WindowArena* a, long int e) : arena(a), end(e) { }
+    template <class U>
+    WindowAllocator(const WindowAllocator<U>& other) : arena(other.arena), end(other.end) { }
+
+    T* allocate(size_t n) {
+        if (arena) {
+            return static_cast<T*>(arena->allocate(n * sizeof(T), end));
+        }
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t n) {
+        if (!arena) {
+            ::operator delete(p);
+        }
+    }
+
+    size_t max_size(void) const { return size_t(-1) / sizeof(T); }
+
+    WindowArena* arena;
+    long int end;
+
+};
+
+template <class T, class U>
+bool operator==(const WindowAllocator<T>& a, const WindowAllocator<U>& b) {
+    return a.arena == b.arena;
+}
+
+template <class T, class U>
+bool operator!=(const WindowAllocator<T>& a, const WindowAllocator<U>& b) {
+    return a.arena != b.arena;
+}
+
+#endif
@@ -0,0 +1,98 @@
+#include "WorkerPool.h"
+
+
+WorkerPool::WorkerPool(int threads)
+    : runs(0)
+    , spread(0)
+    , task(NULL)
+    , taskSize(0)
+    , nextIndex(0)
+    , finished(0)
+    , busy(0)
+    , generation(0)
+    , stopping(false)
+{
+    for (int i = 1; i < threads; ++i) {
+        workers.push_back(thread(&WorkerPool::work, this));
+    }
+}
+
+WorkerPool::~WorkerPool(void) {
+    {
+        lock_guard<mutex> lock(poolMutex);
+        stopping = true;
+    }
+    taskReady.notify_all();
+    for (vector<thread>::iterator t = workers.begin(); t != workers.end(); ++t) {
+        t->join();
+    }
+}
+
+void WorkerPool::run(int n, WorkerTask& t) {
+    if (n == 0) {
+        return;
+    }
+    ++runs;
+    if (workers.empty() || n <= 1) {
+        for (int i = 0; i < n; ++i) {
+            t.run(i);
+        }
+        return;
+    }
+    ++spread;
+    {
+        lock_guard<mutex> lock(poolMutex);
+        task = &t;
+        taskSize = n;
+        nextIndex = 0;
+        finished = 0;
+        ++generation;
+    }
+    taskReady.notify_all();
+    int done = drain();
+    unique_lock<mutex> lock(poolMutex);
+    finished += done;
+    // wait for stragglers too, so none can take an index of the next task
+    while (finished != taskSize || busy != 0) {
+        taskDone.wait(lock);
+    }
+    task = NULL;
+}
+
+int WorkerPool::drain(void) {
+    int done = 0;
+    int i;
+    while ((i = nextIndex.fetch_add(1)) < taskSize) {
+        task->run(i);
+        ++done;
+    }
+    return done;
+}
+
+void WorkerPool::work(void) {
+    long unsigned int seen = 0;
+    while (true) {
+        {
+            unique_lock<mutex> lock(poolMutex);
+            while (!stopping && generation == seen) {
+                taskReady.wait(lock);
+            }
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+            if (task == NULL) {
+                // woke after the task was finished
+                continue;
+            }
+            ++busy;
+        }
+        int done = drain();
+        {
+            lock_guard<mutex> lock(poolMutex);
+            finished += done;
+            --busy;
+        }
+        taskDone.notify_one();
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef _WORKER_POOL_H
+#define _WORKER_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+using namespace std;
+
+// A fixed set of threads, started once and shared by every site, over which
+// the independent parts of a site's calculation are spread (--threads).
+//
+// A task is a parallel for: run(n, task) calls task.run(i) once for each i
+// in [0, n) and returns when all have finished.  The calling thread takes
+// part, so a pool of one thread runs everything inline.  Tasks write their
+// results into slots indexed by i, so the output doesn't depend on which
+// thread ran what or in which order.
+
+class WorkerTask {
+public:
+    virtual ~WorkerTask(void) { }
+    virtual void run(int i) = 0;
+};
+
+class WorkerPool {
+
+public:
+
+    // threads includes the caller
+    WorkerPool(int threads);
+    ~WorkerPool(void);
+
+    int size(void) { return workers.size() + 1; }
+
+    void run(int n, WorkerTask& task);
+
+    long unsigned int runs;
+    long unsigned int spread;  // runs shared with the workers, not run inline
+
+private:
+
+    void work(void);
+    // runs indexes of the current task until none remain, returning how many
+    int drain(void);
+
+    vector<thread> workers;
+
+    mutex poolMutex;
+    condition_variable taskReady;  // signalled by the caller
+    condition_variable taskDone;   // signalled by the workers
+    WorkerTask* task;  // NULL between runs
+    int taskSize;
+    atomic<int> nextIndex;
+    int finished;  // indexes run of the current task
+    int busy;      // workers draining the current task
+    long unsigned int generation;  // of the current task
+    bool stopping;
+
+};
+
+#endif
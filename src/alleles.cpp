@@ -31,16 +31,6 @@
 
 using namespace std; 
 
-// Allele object recycling:
-//
-// We use the Allele freelist for performance reasons.  When an Allele object
-// is destroyed, it is pushed onto this freelist.  When a new Allele object is
-// created, new first checks if we have a free Allele object on the freelist.
-// Because we are dynamically linked, we have to declare the freelist here,
-// although it exists as a static member of the Allele class.
-//
-AlleleFreeList Allele::_freeList;
-
 int main (int argc, char *argv[]) {
 
     AlleleParser* parser = new AlleleParser(argc, argv);
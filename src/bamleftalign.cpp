@@ -9,10 +9,19 @@
 #include <algorithm>
 #include <map>
 #include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <chrono>
 
 #include "Fasta.h"
 
 #include "LeftAlign.h"
+#ifndef HAVE_BAMTOOLS
+#include "htslib/sam.h"
+#endif
 
 #ifdef VERBOSE_DEBUG
 #define DEBUG(msg) \
@@ -34,7 +43,372 @@ void printUsage(char** argv) {
          << "      -d --debug             Print debugging information about realignment process" << endl
          << "      -s --suppress-output   Don't write BAM output stream (for debugging)" << endl
          << "      -m --max-iterations N  Iterate the left-realignment no more than this many times" << endl
-         << "      -c --compressed        Write compressed BAM on stdout, default is uncompressed" << endl;
+         << "      -c --compressed        Write compressed BAM on stdout, default is uncompressed" << endl
+         << "      -t --threads N         Realign on N threads, in a pipeline with separate decode and" << endl
+         << "                             write threads.  Output order is unchanged.  (default 1, serial)" << endl
+         << "      -z --compression-threads N" << endl
+         << "                             Compress the output BAM on N threads when -t > 1 (default: -t)" << endl
+         << "      -b --batch-size N      Alignments per unit of work in the pipeline (default 1024)" << endl
+         << "      -S --stage-stats       Report the throughput of each pipeline stage on stderr" << endl
+         << "      -D --compare-engines   Realign each alignment with both the in-place engine and the" << endl
+         << "                             original string-based one, report any differences and exit" << endl
+         << "                             non-zero if there were any (serial only)" << endl;
+}
+
+// Contigs are read from the FASTA once and shared by all the realignment
+// threads.  Input is usually sorted, so only the few most recently requested
+// contigs are kept; a batch still using an evicted contig holds on to it until
+// it's done.
+class ReferenceCache {
+
+public:
+
+    ReferenceCache(FastaReference& r, map<int, string>& names, int keep)
+        : loads(0)
+        , reference(r)
+        , referenceIDToName(names)
+        , maxContigs(keep)
+    { }
+
+    shared_ptr<const string> get(int refid) {
+        lock_guard<mutex> lock(cacheMutex);
+        for (deque<pair<int, shared_ptr<const string> > >::iterator c = contigs.begin(); c != contigs.end(); ++c) {
+            if (c->first == refid) {
+                return c->second;
+            }
+        }
+        ++loads;
+        shared_ptr<const string> contig(new string(reference.getSequence(referenceIDToName[refid])));
+        contigs.push_front(make_pair(refid, contig));
+        if (contigs.size() > maxContigs) {
+            contigs.pop_back();
+        }
+        return contig;
+    }
+
+    int loads;
+
+private:
+
+    FastaReference& reference;
+    map<int, string>& referenceIDToName;
+    int maxContigs;
+    deque<pair<int, shared_ptr<const string> > > contigs;  // most recently loaded first
+    mutex cacheMutex;
+
+};
+
+string cigarString(BAMALIGN& alignment) {
+    stringstream cigar;
+    CIGAR c = alignment.GETCIGAR;
+    for (CIGAR::const_iterator o = c.begin(); o != c.end(); ++o) {
+        cigar << o->CIGLEN << o->CIGTYPE;
+    }
+    return cigar.str();
+}
+
+// Realigns with both the in-place engine and the original string-based
+// stablyLeftAlign, and reports any difference between them.
+bool compareLeftAlignEngines(BAMALIGN& alignment, string& referenceSequence, int maxiterations, LeftAlignWorkspace& workspace) {
+#ifdef HAVE_BAMTOOLS
+    BAMALIGN original = alignment;
+#else
+    BAMALIGN original;
+    original.assign(bam_dup1(alignment.raw()));
+#endif
+    string cigarBefore = cigarString(alignment);
+    bool stable = stablyLeftAlign(original, referenceSequence, maxiterations);
+    bool stableInPlace = stablyLeftAlign(alignment, referenceSequence.data(), referenceSequence.size(),
+                                         workspace, maxiterations);
+    if (stable != stableInPlace || cigarString(original) != cigarString(alignment)) {
+        cerr << "left-alignment engines differ for " << alignment.QNAME << " at " << alignment.POSITION
+             << ": " << cigarBefore << " became " << cigarString(original) << (stable ? "" : " (unstable)")
+             << " in stablyLeftAlign, and " << cigarString(alignment) << (stableInPlace ? "" : " (unstable)")
+             << " in place" << endl;
+        return false;
+    }
+    return true;
+}
+
+class AlignmentBatch {
+public:
+    long int id;  // position in the input
+    vector<BAMALIGN> alignments;
+    // unstable realignments, reported by the writer so they stay in input order
+    vector<string> warnings;
+};
+
+// time spent working and waiting on the other stages, and alignments handled
+class StageCounter {
+public:
+    long unsigned int alignments;
+    double busy;
+    double waiting;
+    StageCounter(void) : alignments(0), busy(0), waiting(0) { }
+    void add(const StageCounter& other) {
+        alignments += other.alignments;
+        busy += other.busy;
+        waiting += other.waiting;
+    }
+};
+
+double secondsSince(chrono::steady_clock::time_point& start) {
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    double elapsed = chrono::duration<double>(now - start).count();
+    start = now;
+    return elapsed;
+}
+
+// Decodes batches of alignments on one thread, realigns them on
+// realignThreads threads, and writes them back out in input order on the
+// calling thread.  No more than maxBatches are in memory at once.
+class LeftAlignPipeline {
+
+public:
+
+    LeftAlignPipeline(BAMSINGLEREADER& r,
+                      ReferenceCache& ref,
+                      map<int, string>& names,
+                      int threads,
+                      int batchAlignments,
+                      int maxiter,
+                      bool dbg)
+        : reader(r)
+        , referenceCache(ref)
+        , referenceIDToName(names)
+        , realignThreads(threads)
+        , batchSize(batchAlignments)
+        , maxiterations(maxiter)
+        , debug(dbg)
+        , maxBatches(4 * threads)
+        , inFlight(0)
+        , decoded(0)
+        , decodeFinished(false)
+    { }
+
+    // calls write(alignment) for every alignment, in input order
+    template <class Writer>
+    void run(Writer& write) {
+
+        thread decoder(&LeftAlignPipeline::decode, this);
+        vector<thread> realigners;
+        vector<StageCounter> realignCounters(realignThreads);
+        for (int i = 0; i < realignThreads; ++i) {
+            realigners.push_back(thread(&LeftAlignPipeline::realign, this, &realignCounters[i]));
+        }
+
+        chrono::steady_clock::time_point clock = chrono::steady_clock::now();
+        long int next = 0;
+        while (true) {
+            AlignmentBatch* batch = NULL;
+            {
+                unique_lock<mutex> lock(pipelineMutex);
+                while (!(decodeFinished && next == decoded) && completed.find(next) == completed.end()) {
+                    batchRealigned.wait(lock);
+                }
+                if (decodeFinished && next == decoded) {
+                    break;
+                }
+                batch = completed[next];
+                completed.erase(next);
+            }
+            writeCounter.waiting += secondsSince(clock);
+            for (vector<string>::iterator w = batch->warnings.begin(); w != batch->warnings.end(); ++w) {
+                cerr << *w;
+            }
+            for (vector<BAMALIGN>::iterator a = batch->alignments.begin(); a != batch->alignments.end(); ++a) {
+                write(*a);
+            }
+            writeCounter.alignments += batch->alignments.size();
+            delete batch;
+            ++next;
+            {
+                lock_guard<mutex> lock(pipelineMutex);
+                --inFlight;
+            }
+            batchWritten.notify_one();
+            writeCounter.busy += secondsSince(clock);
+        }
+
+        // wake the realigners so they see we're done
+        batchDecoded.notify_all();
+        decoder.join();
+        for (vector<thread>::iterator t = realigners.begin(); t != realigners.end(); ++t) {
+            t->join();
+        }
+        for (vector<StageCounter>::iterator c = realignCounters.begin(); c != realignCounters.end(); ++c) {
+            realignCounter.add(*c);
+        }
+
+    }
+
+    StageCounter decodeCounter;
+    StageCounter realignCounter;  // summed over realignment threads
+    StageCounter writeCounter;
+
+private:
+
+    void decode(void) {
+        chrono::steady_clock::time_point clock = chrono::steady_clock::now();
+        bool more = true;
+        while (more) {
+            {
+                // wait for the writer to make room
+                unique_lock<mutex> lock(pipelineMutex);
+                while (inFlight >= maxBatches) {
+                    batchWritten.wait(lock);
+                }
+            }
+            decodeCounter.waiting += secondsSince(clock);
+            AlignmentBatch* batch = new AlignmentBatch;
+            batch->alignments.resize(batchSize);
+            int n = 0;
+            while (n < batchSize && (more = GETNEXT(reader, batch->alignments[n]))) {
+                ++n;
+            }
+            batch->alignments.resize(n);
+            decodeCounter.alignments += n;
+            decodeCounter.busy += secondsSince(clock);
+            {
+                lock_guard<mutex> lock(pipelineMutex);
+                if (n > 0) {
+                    batch->id = decoded++;
+                    work.push_back(batch);
+                    ++inFlight;
+                } else {
+                    delete batch;
+                }
+                if (!more) {
+                    decodeFinished = true;
+                }
+            }
+            batchDecoded.notify_one();
+            if (!more) {
+                // the writer may be waiting on an empty final batch
+                batchRealigned.notify_one();
+            }
+        }
+        batchDecoded.notify_all();
+    }
+
+    void realign(StageCounter* counter) {
+        chrono::steady_clock::time_point clock = chrono::steady_clock::now();
+        LeftAlignWorkspace workspace;
+        while (true) {
+            AlignmentBatch* batch = NULL;
+            {
+                unique_lock<mutex> lock(pipelineMutex);
+                while (work.empty() && !decodeFinished) {
+                    batchDecoded.wait(lock);
+                }
+                if (work.empty()) {
+                    break;
+                }
+                batch = work.front();
+                work.pop_front();
+            }
+            counter->waiting += secondsSince(clock);
+            realignBatch(*batch, workspace);
+            counter->alignments += batch->alignments.size();
+            counter->busy += secondsSince(clock);
+            {
+                lock_guard<mutex> lock(pipelineMutex);
+                completed[batch->id] = batch;
+            }
+            batchRealigned.notify_one();
+        }
+    }
+
+    void realignBatch(AlignmentBatch& batch, LeftAlignWorkspace& workspace) {
+        shared_ptr<const string> contig;
+        int contigID = -1;
+        for (vector<BAMALIGN>::iterator a = batch.alignments.begin(); a != batch.alignments.end(); ++a) {
+            BAMALIGN& alignment = *a;
+            // skip unmapped alignments, as they cannot be left-realigned without CIGAR data
+            if (!alignment.ISMAPPED) {
+                continue;
+            }
+            int endpos = alignment.ENDPOSITION;
+            int length = endpos - alignment.POSITION + 1;
+            if (alignment.POSITION >= 0 && length > 0) {
+                if (alignment.REFID != contigID) {
+                    contigID = alignment.REFID;
+                    contig = referenceCache.get(contigID);
+                }
+                // as FastaReference::getSubSequence, clipped to the end of the contig
+                int start = min((int) contig->size(), alignment.POSITION);
+                if (!stablyLeftAlign(alignment,
+                                     contig->data() + start,
+                                     min(length, (int) contig->size() - start),
+                                     workspace, maxiterations, debug)) {
+                    stringstream warning;
+                    warning << "unstable realignment of " << alignment.QNAME
+                            << " at " << referenceIDToName[alignment.REFID] << ":" << alignment.POSITION << endl
+                            << alignment.QUERYBASES << endl;
+                    batch.warnings.push_back(warning.str());
+                }
+            }
+        }
+    }
+
+    BAMSINGLEREADER& reader;
+    ReferenceCache& referenceCache;
+    map<int, string>& referenceIDToName;
+    int realignThreads;
+    int batchSize;
+    int maxiterations;
+    bool debug;
+
+    // guards everything below
+    mutex pipelineMutex;
+    condition_variable batchDecoded;
+    condition_variable batchRealigned;
+    condition_variable batchWritten;
+    int maxBatches;
+    int inFlight;  // decoded but not yet written
+    long int decoded;
+    bool decodeFinished;
+    deque<AlignmentBatch*> work;
+    map<long int, AlignmentBatch*> completed;
+
+};
+
+// writes pipeline output; with SeqLib we go through htslib directly so that
+// BGZF compression can use its own threads
+class PipelineWriter {
+public:
+#ifdef HAVE_BAMTOOLS
+    BamWriter* writer;
+    PipelineWriter(BamWriter* w) : writer(w) { }
+    void operator()(BAMALIGN& alignment) {
+        if (writer) writer->SaveAlignment(alignment);
+    }
+#else
+    htsFile* out;
+    bam_hdr_t* header;
+    PipelineWriter(htsFile* o, bam_hdr_t* h) : out(o), header(h) { }
+    void operator()(BAMALIGN& alignment) {
+        if (out && sam_write1(out, header, alignment.raw()) < 0) {
+            cerr << "could not write to stdout" << endl;
+            exit(1);
+        }
+    }
+#endif
+};
+
+void printStageStats(LeftAlignPipeline& pipeline, ReferenceCache& referenceCache, double elapsed, int threads) {
+    StageCounter* stages[] = { &pipeline.decodeCounter, &pipeline.realignCounter, &pipeline.writeCounter };
+    const char* names[] = { "decode", "realign", "write" };
+    int stageThreads[] = { 1, threads, 1 };
+    cerr << "stage\tthreads\talignments\tbusy_seconds\twaiting_seconds\talignments_per_busy_thread_second" << endl;
+    for (int i = 0; i < 3; ++i) {
+        StageCounter& s = *stages[i];
+        cerr << names[i] << "\t" << stageThreads[i] << "\t" << s.alignments << "\t"
+             << s.busy << "\t" << s.waiting << "\t"
+             << (s.busy > 0 ? s.alignments / s.busy : 0) << endl;
+    }
+    cerr << "reference contigs loaded: " << referenceCache.loads << endl
+         << "wall seconds: " << elapsed << endl;
 }
 
 int main(int argc, char** argv) {
@@ -48,6 +422,11 @@ int main(int argc, char** argv) {
     bool isuncompressed = true;
 
     int maxiterations = 50;
+    int threads = 1;
+    int compressionThreads = 0;  // 0 to use the number of realignment threads
+    int batchSize = 1024;
+    bool stageStats = false;
+    bool compareEngines = false;
     
     if (argc < 2) {
         printUsage(argv);
@@ -63,12 +442,17 @@ int main(int argc, char** argv) {
             {"max-iterations", required_argument, 0, 'm'},
             {"suppress-output", no_argument, 0, 's'},
             {"compressed", no_argument, 0, 'c'},
+            {"threads", required_argument, 0, 't'},
+            {"compression-threads", required_argument, 0, 'z'},
+            {"batch-size", required_argument, 0, 'b'},
+            {"stage-stats", no_argument, 0, 'S'},
+            {"compare-engines", no_argument, 0, 'D'},
             {0, 0, 0, 0}
         };
 
         int option_index = 0;
 
-        c = getopt_long (argc, argv, "hdcsf:m:",
+        c = getopt_long (argc, argv, "hdcsSDf:m:t:z:b:",
                          long_options, &option_index);
 
         /* Detect the end of the options. */
@@ -98,6 +482,38 @@ int main(int argc, char** argv) {
                 isuncompressed = false;
                 break;
 
+            case 't':
+                threads = atoi(optarg);
+                if (threads < 1) {
+                    cerr << "could not parse --threads" << endl;
+                    exit(1);
+                }
+                break;
+
+            case 'z':
+                compressionThreads = atoi(optarg);
+                if (compressionThreads < 1) {
+                    cerr << "could not parse --compression-threads" << endl;
+                    exit(1);
+                }
+                break;
+
+            case 'b':
+                batchSize = atoi(optarg);
+                if (batchSize < 1) {
+                    cerr << "could not parse --batch-size" << endl;
+                    exit(1);
+                }
+                break;
+
+            case 'S':
+                stageStats = true;
+                break;
+
+            case 'D':
+                compareEngines = true;
+                break;
+
             case 'h':
                 printUsage(argv);
                 exit(0);
@@ -119,6 +535,10 @@ int main(int argc, char** argv) {
         exit(1);
     }
 
+    if (compareEngines) {
+        threads = 1;
+    }
+
 
     BAMSINGLEREADER reader;
     if (!reader.Open(STDIN)) {
@@ -148,11 +568,23 @@ int main(int argc, char** argv) {
     }
     writer.SetHeader(hdr);
 
-    if (!suppress_output && !writer.Open("-")) {
-        cerr << "could not open stdout for writing" << endl;
-        exit(1);
+    htsFile* pipelineOut = NULL;
+    if (threads > 1) {
+        if (!suppress_output) {
+            pipelineOut = hts_open("-", "wb");
+            if (!pipelineOut || sam_hdr_write(pipelineOut, hdr.get_()) < 0) {
+                cerr << "could not open stdout for writing" << endl;
+                exit(1);
+            }
+            hts_set_threads(pipelineOut, compressionThreads ? compressionThreads : threads);
+        }
+    } else {
+        if (!suppress_output && !writer.Open("-")) {
+            cerr << "could not open stdout for writing" << endl;
+            exit(1);
+        }
+        writer.WriteHeader();
     }
-    writer.WriteHeader();
 #endif
 
     // store the names of all the reference sequences in the BAM file
@@ -164,7 +596,37 @@ int main(int argc, char** argv) {
         ++i;
     }
 
+    if (threads > 1) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        ReferenceCache referenceCache(reference, referenceIDToName, 2);
+        LeftAlignPipeline pipeline(reader, referenceCache, referenceIDToName,
+                                   threads, batchSize, maxiterations, debug);
+#ifdef HAVE_BAMTOOLS
+        PipelineWriter pipelineWriter(suppress_output ? NULL : &writer);
+#else
+        PipelineWriter pipelineWriter(pipelineOut, hdr.get_());
+#endif
+        pipeline.run(pipelineWriter);
+        reader.Close();
+        if (!suppress_output) {
+#ifdef HAVE_BAMTOOLS
+            writer.Close();
+#else
+            if (hts_close(pipelineOut) < 0) {
+                cerr << "could not close stdout" << endl;
+                exit(1);
+            }
+#endif
+        }
+        if (stageStats) {
+            printStageStats(pipeline, referenceCache, secondsSince(start), threads);
+        }
+        return 0;
+    }
+
     BAMALIGN alignment;
+    LeftAlignWorkspace workspace;
+    long unsigned int engineDifferences = 0;
 
     while (GETNEXT(reader, alignment)) {
       
@@ -181,12 +643,17 @@ int main(int argc, char** argv) {
                 int endpos = alignment.ENDPOSITION;
                 int length = endpos - alignment.POSITION + 1;
                 if (alignment.POSITION >= 0 && length > 0) {
-                    if (!stablyLeftAlign(alignment,
-                                reference.getSubSequence(
-                                    referenceIDToName[alignment.REFID],
-                                    alignment.POSITION,
-                                    length),
-                                maxiterations, debug)) {
+                    string referenceSequence = reference.getSubSequence(
+                        referenceIDToName[alignment.REFID],
+                        alignment.POSITION,
+                        length);
+                    if (compareEngines) {
+                        if (!compareLeftAlignEngines(alignment, referenceSequence, maxiterations, workspace)) {
+                            ++engineDifferences;
+                        }
+                    } else if (!stablyLeftAlign(alignment,
+                                                referenceSequence.data(), referenceSequence.size(),
+                                                workspace, maxiterations, debug)) {
                         cerr << "unstable realignment of " << alignment.QNAME
                              << " at " << referenceIDToName[alignment.REFID] << ":" << alignment.POSITION << endl
                              << alignment.QUERYBASES << endl;
@@ -207,5 +674,10 @@ int main(int argc, char** argv) {
     if (!suppress_output)
         writer.Close();
 
+    if (engineDifferences > 0) {
+        cerr << engineDifferences << " alignments realigned differently by the two engines" << endl;
+        return 1;
+    }
+
     return 0;
 }
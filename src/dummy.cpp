@@ -30,8 +30,6 @@
 
 using namespace std; 
 
-AlleleFreeList Allele::_freeList;
-
 int main (int argc, char *argv[]) {
 
     AlleleParser* parser = new AlleleParser(argc, argv);
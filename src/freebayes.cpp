@@ -42,6 +42,9 @@
 #include "Bias.h"
 #include "Contamination.h"
 #include "NonCall.h"
+#include "SiteWorkspace.h"
+#include "Profiler.h"
+#include "WorkerPool.h"
 
 
 // local helper debugging macros to improve code readability
@@ -71,6 +74,96 @@ using namespace std;
 // run the main function for each region in an omp parallel for loop
 // only do this if the --parallel flag is set > 1
 
+// searches the genotype combos of each population, which are independent
+class PopulationComboSearch : public WorkerTask {
+public:
+    PopulationComboSearch(Parameters& p,
+                          Samples& s,
+                          vector<Allele>& a,
+                          map<string, int>& ac,
+                          Real t,
+                          int maxIterations,
+                          int bandwidth,
+                          int banddepth)
+        : parameters(p)
+        , samples(s)
+        , genotypeAlleles(a)
+        , inputAlleleCounts(ac)
+        , theta(t)
+        , itermax(maxIterations)
+        , adjustedBandwidth(bandwidth)
+        , adjustedBanddepth(banddepth)
+    { }
+    // by population
+    vector<SampleDataLikelihoods*> sampleDataLikelihoods;
+    vector<list<GenotypeCombo>*> genotypeCombos;
+    vector<list<GenotypeCombo>*> glMaxCombos;  // NULL unless reporting the GL max
+    vector<int> iterations;
+    void run(int i) {
+        SampleDataLikelihoods& likelihoods = *sampleDataLikelihoods[i];
+
+        GenotypeCombo nullCombo;
+        SampleDataLikelihoods nullSampleDataLikelihoods;
+
+        // this is the genotype-likelihood maximum
+        if (glMaxCombos[i]) {
+            GenotypeCombo comboKing;
+            vector<int> initialPosition;
+            initialPosition.assign(likelihoods.size(), 0);
+            SampleDataLikelihoods nullDataLikelihoods; // dummy variable
+            makeComboByDatalLikelihoodRank(comboKing,
+                                           initialPosition,
+                                           likelihoods,
+                                           nullDataLikelihoods,
+                                           inputAlleleCounts,
+                                           theta,
+                                           parameters.pooledDiscrete,
+                                           parameters.ewensPriors,
+                                           parameters.permute,
+                                           parameters.hwePriors,
+                                           parameters.obsBinomialPriors,
+                                           parameters.alleleBalancePriors,
+                                           parameters.diffusionPriorScalar);
+
+            glMaxCombos[i]->push_back(comboKing);
+        }
+
+        // search much longer for convergence
+        convergentGenotypeComboSearch(
+            *genotypeCombos[i],
+            nullCombo,
+            likelihoods, // vary everything
+            likelihoods,
+            nullSampleDataLikelihoods,
+            samples,
+            genotypeAlleles,
+            inputAlleleCounts,
+            adjustedBandwidth,
+            adjustedBanddepth,
+            theta,
+            parameters.pooledDiscrete,
+            parameters.ewensPriors,
+            parameters.permute,
+            parameters.hwePriors,
+            parameters.obsBinomialPriors,
+            parameters.alleleBalancePriors,
+            parameters.diffusionPriorScalar,
+            itermax,
+            iterations[i],
+            true); // add homozygous combos
+            // ^^ combo results are sorted by default
+    }
+private:
+    Parameters& parameters;
+    Samples& samples;
+    vector<Allele>& genotypeAlleles;
+    map<string, int>& inputAlleleCounts;
+    Real theta;
+    int itermax;
+    int adjustedBandwidth;
+    int adjustedBanddepth;
+};
+
 // freebayes main
 int main (int argc, char *argv[]) {
 
@@ -83,9 +176,27 @@ int main (int argc, char *argv[]) {
 
     Samples samples;
     NonCalls nonCalls;
+    if (parser->resuming) {
+        nonCalls = parser->resumeFrom.nonCalls;
+    }
+    time_t lastCheckpoint = time(NULL);
 
     ostream& out = *(parser->output);
 
+    if (!parameters.profileFile.empty()) {
+        profiler.enable();
+    }
+    if (!parameters.traceSlowSitesFile.empty()
+        && !profiler.traceSlowSites(parameters.traceSlowSitesFile, parameters.traceSlowSitesMs)) {
+        ERROR("could not open " << parameters.traceSlowSitesFile << " for writing");
+        exit(1);
+    }
+    // phases are charged to the sequence being processed, which the parser
+    // may have loaded already
+    if (profiler.enabled && !parser->currentSequenceName.empty()) {
+        profiler.setContig(parser->currentSequenceName);
+    }
+
     Bias observationBias;
     if (!parameters.alleleObservationBiasFile.empty()) {
         observationBias.open(parameters.alleleObservationBiasFile);
@@ -118,29 +229,53 @@ int main (int argc, char *argv[]) {
         allowedAlleleTypes |= ALLELE_COMPLEX;
     }
 
-    // output VCF header
-    if (parameters.output == "vcf") {
+    // output VCF header, unless we're appending to a resumed run
+    if (parameters.output == "vcf" && !parser->resuming) {
         out << parser->variantCallFile.header << endl;
     }
 
-    if (0 < parameters.maxCoverage) {
-        srand(13);
-    }
-
     Allele nullAllele = genotypeAllele(ALLELE_NULL, "N", 1, "1N");
 
     unsigned long total_sites = 0;
     unsigned long processed_sites = 0;
 
+    // samples' data likelihoods and populations' combo searches are spread
+    // over these
+    WorkerPool workers(parameters.threads);
+
+    // per-site containers, reused from site to site
+    SiteWorkspace site;
+    Results& results = site.results;
+    map<string, vector<Allele*> >& alleleGroups = site.alleleGroups;
+    map<string, vector<Allele*> >& partialObservationGroups = site.partialObservationGroups;
+    map<Allele*, set<Allele*> >& partialObservationSupport = site.partialObservationSupport;
+    map<int, vector<Genotype> >& genotypesByPloidy = site.genotypesByPloidy;
+    map<string, vector<vector<SampleDataLikelihood> > >& sampleDataLikelihoodsByPopulation = site.sampleDataLikelihoodsByPopulation;
+    map<string, list<GenotypeCombo> >& genotypeCombosByPopulation = site.genotypeCombosByPopulation;
+    map<string, list<GenotypeCombo> >& glMaxCombos = site.glMaxCombos;
+    list<GenotypeCombo>& genotypeCombos = site.genotypeCombos;
+    vector<Real>& comboProbs = site.comboProbs;
+#ifdef VERBOSE_DEBUG
+    long unsigned int siteAllocations = 0;
+#endif
+
     while (parser->getNextAlleles(samples, allowedAlleleTypes)) {
 
+        // shape is declared first so it is traced after the site is timed
+        SiteShape shape;
+        ProfileSite profileSite(parser->currentSequenceName);
+        shape.sequence = parser->currentSequenceName;
+        shape.position = parser->currentPosition;
+        shape.haplotypeLength = parser->lastHaplotypeLength;
+
         ++total_sites;
 
         DEBUG2("at start of main loop");
 
+        site.clear();
+
         // did we switch chromosomes or exceed our gVCF chunk size?
         // if so, we may need to output a gVCF record
-        Results results;
         if (parameters.gVCFout && !nonCalls.empty() &&
             ( nonCalls.begin()->first != parser->currentSequenceName
               || (parameters.gVCFchunk &&
@@ -151,6 +286,13 @@ int main (int argc, char *argv[]) {
             nonCalls.clear();
         }
 
+        // everything before this position has been written or is in nonCalls
+        if (!parameters.checkpointFile.empty()
+            && difftime(time(NULL), lastCheckpoint) >= parameters.checkpointInterval
+            && parser->writeCheckpoint(nonCalls)) {
+            lastCheckpoint = time(NULL);
+        }
+
         // don't process non-ATGC's in the reference
         string cb = parser->currentReferenceBaseString();
         if (cb != "A" && cb != "T" && cb != "C" && cb != "G") {
@@ -159,6 +301,7 @@ int main (int argc, char *argv[]) {
         }
 
         int coverage = countAlleles(samples);
+        shape.coverage = coverage;
 
         DEBUG("position: " << parser->currentSequenceName << ":" << (long unsigned int) parser->currentPosition + 1 << " coverage: " << coverage);
 
@@ -174,63 +317,6 @@ int main (int argc, char *argv[]) {
             } else if (parameters.onlyUseInputAlleles) {
                 DEBUG("no input alleles, but using only input alleles for analysis, skipping position");
                 skip = true;
-            } else if (0 < parameters.maxCoverage) {
-                // go through each sample
-                for (Samples::iterator s = samples.begin(); s != samples.end(); ++s) {
-                    string sampleName = s->first;
-                    Sample& sample = s->second;
-                    // get the coverage for this sample
-                    int sampleCoverage = 0;
-                    for (Sample::iterator sg = sample.begin(); sg != sample.end(); ++sg) {
-                        sampleCoverage += sg->second.size();
-                    }
-                    if (sampleCoverage <= parameters.maxCoverage) {
-                        continue;
-                    }
-
-                    DEBUG("coverage " << sampleCoverage << " for sample " << sampleName << " was > " << parameters.maxCoverage << ", so we will remove " << (sampleCoverage - parameters.maxCoverage) << " genotypes");
-                    vector<string> genotypesToErase;
-                    do {
-                        double probRemove = (sampleCoverage - parameters.maxCoverage) / (double)sampleCoverage;
-                        vector<string> genotypesToErase;
-                        // iterate through the genotypes
-                        for (Sample::iterator sg = sample.begin(); sg != sample.end(); ++sg) {
-                            vector<Allele*> allelesToKeep;
-                            // iterate through each allele
-                            for (int alleleIndex = 0; alleleIndex < sg->second.size(); alleleIndex++) {
-                                // only if we have more alleles to remove
-                                if (parameters.maxCoverage < sampleCoverage) {
-                                    double r = rand() / (double)RAND_MAX;
-                                    if (r < probRemove) { // skip over this allele
-                                        sampleCoverage--;
-                                        continue;
-                                    }
-                                }
-                                // keep it
-                                allelesToKeep.push_back(sg->second[alleleIndex]);
-                            }
-                            // re-assign the alleles to this genotype
-                            if (allelesToKeep.size() < sg->second.size()) {
-                                sg->second.assign(allelesToKeep.begin(), allelesToKeep.end());
-                            }
-                            // if no more alleles for this genotype, remove it later
-                            if (sg->second.empty()) {
-                                genotypesToErase.push_back(sg->first);
-                            }
-                        }
-                        // remove empty genotypes
-                        for (vector<string>::iterator gt = genotypesToErase.begin(); gt != genotypesToErase.end(); ++gt) {
-                            sample.erase(*gt);
-                        }
-                    } while (parameters.maxCoverage < sampleCoverage);
-                    sampleCoverage = 0;
-                    for (Sample::iterator sg = sample.begin(); sg != sample.end(); ++sg) {
-                        sampleCoverage += sg->second.size();
-                    }
-                    DEBUG("coverage for sample " << sampleName << " is now " << sampleCoverage);
-                }
-                // update coverage
-                coverage = countAlleles(samples);
             }
 
             DEBUG2("coverage " << parser->currentSequenceName << ":" << parser->currentPosition << " == " << coverage);
@@ -265,7 +351,7 @@ int main (int argc, char *argv[]) {
         }
 
         // to ensure proper ordering of output stream
-        vector<string> sampleListPlusRef;
+        vector<string>& sampleListPlusRef = site.sampleListPlusRef;
 
         for (vector<string>::iterator s = parser->sampleList.begin(); s != parser->sampleList.end(); ++s) {
             sampleListPlusRef.push_back(*s);
@@ -275,7 +361,6 @@ int main (int argc, char *argv[]) {
         }
 
         // establish genotype alleles using input filters
-        map<string, vector<Allele*> > alleleGroups;
         groupAlleles(samples, alleleGroups);
         DEBUG2("grouped alleles by equivalence");
 
@@ -288,9 +373,6 @@ int main (int argc, char *argv[]) {
             genotypeAlleles = alleleUnion(genotypeAlleles, refAlleleVector);
         }
 
-        map<string, vector<Allele*> > partialObservationGroups;
-        map<Allele*, set<Allele*> > partialObservationSupport;
-
         // build haplotype alleles matching the current longest allele (often will do nothing)
         // this will adjust genotypeAlleles if changes are made
         DEBUG("building haplotype alleles, currently there are " << genotypeAlleles.size() << " genotype alleles");
@@ -318,9 +400,12 @@ int main (int argc, char *argv[]) {
 
         // re-calculate coverage, as this could change now that we've built haplotype alleles
         coverage = countAlleles(samples);
+        shape.coverage = coverage;
+        shape.alleles = genotypeAlleles.size();
+        shape.haplotypeLength = parser->lastHaplotypeLength;
 
         // estimate theta using the haplotype length
-        long double theta = parameters.TH * parser->lastHaplotypeLength;
+        Real theta = parameters.TH * parser->lastHaplotypeLength;
 
         // if we have only one viable allele, we don't have evidence for variation at this site
         if (!parser->hasInputVariantAllelesAtCurrentPosition() && !parameters.reportMonomorphic && genotypeAlleles.size() <= 1 && genotypeAlleles.front().isReference()) {
@@ -338,11 +423,14 @@ int main (int argc, char *argv[]) {
 
         ++processed_sites;
 
+        // group each sample's observations by genotype allele
+        samples.indexObservations(genotypeAlleles);
+
         // generate possible genotypes
 
         // for each possible ploidy in the dataset, generate all possible genotypes
         vector<int> ploidies = parser->currentPloidies(samples);
-        map<int, vector<Genotype> > genotypesByPloidy = getGenotypesByPloidy(ploidies, genotypeAlleles);
+        getGenotypesByPloidy(ploidies, genotypeAlleles, genotypesByPloidy);
         int numCopiesOfLocus = parser->copiesOfLocus(samples);
 
 
@@ -369,28 +457,34 @@ int main (int argc, char *argv[]) {
         //cerr << "estimated minor count " << estimatedMinorAllelesAtLocus << endl;
 
 
-        map<string, vector<vector<SampleDataLikelihood> > > sampleDataLikelihoodsByPopulation;
-        map<string, vector<vector<SampleDataLikelihood> > > variantSampleDataLikelihoodsByPopulation;
-        map<string, vector<vector<SampleDataLikelihood> > > invariantSampleDataLikelihoodsByPopulation;
-
         map<string, int> inputAlleleCounts;
         int inputLikelihoodCount = 0;
 
         DEBUG2("calculating data likelihoods");
-        calculateSampleDataLikelihoods(
-            samples,
-            results,
-            parser,
-            genotypesByPloidy,
-            parameters,
-            usingNull,
-            observationBias,
-            genotypeAlleles,
-            contaminationEstimates,
-            estimatedAlleleFrequencies,
-            sampleDataLikelihoodsByPopulation,
-            variantSampleDataLikelihoodsByPopulation,
-            invariantSampleDataLikelihoodsByPopulation);
+        {
+            ProfileTimer timer(PROFILE_DATA_LIKELIHOODS);
+            calculateSampleDataLikelihoods(
+                samples,
+                results,
+                parser,
+                genotypesByPloidy,
+                parameters,
+                usingNull,
+                observationBias,
+                genotypeAlleles,
+                contaminationEstimates,
+                estimatedAlleleFrequencies,
+                sampleDataLikelihoodsByPopulation,
+                site.variantSampleDataLikelihoodsByPopulation,
+                site.invariantSampleDataLikelihoodsByPopulation,
+                workers);
+        }
+        site.dropEmptyPopulations();
+        if (profiler.tracing) {
+            for (map<int, vector<Genotype> >::iterator g = genotypesByPloidy.begin(); g != genotypesByPloidy.end(); ++g) {
+                shape.genotypesByPloidy[g->first] = g->second.size();
+            }
+        }
 
         DEBUG2("finished calculating data likelihoods");
 
@@ -427,7 +521,7 @@ int main (int argc, char *argv[]) {
         BigFloat pVar = 1.0;
         BigFloat pHom = 0.0;
 
-        long double bestComboOddsRatio = 0;
+        Real bestComboOddsRatio = 0;
 
         bool bestOverallComboIsHet = false;
         GenotypeCombo bestCombo; // = NULL;
@@ -442,17 +536,10 @@ int main (int argc, char *argv[]) {
         // all sample/genotype combinations
 
         //SampleDataLikelihoods marginalLikelihoods = sampleDataLikelihoods;  // heavyweight copy...
-        map<string, list<GenotypeCombo> > genotypeCombosByPopulation;
         int genotypingTotalIterations = 0; // tally total iterations required to reach convergence
-        map<string, list<GenotypeCombo> > glMaxCombos;
 
-        for (map<string, SampleDataLikelihoods>::iterator p = sampleDataLikelihoodsByPopulation.begin(); p != sampleDataLikelihoodsByPopulation.end(); ++p) {
-
-            const string& population = p->first;
-            SampleDataLikelihoods& sampleDataLikelihoods = p->second;
-            list<GenotypeCombo>& populationGenotypeCombos = genotypeCombosByPopulation[population];
-
-            DEBUG2("genqerating banded genotype combinations from " << sampleDataLikelihoods.size() << " sample genotypes in population " << population);
+        {
+            ProfileTimer timer(PROFILE_COMBO_SEARCH);
 
             // cap the number of iterations at 2 x the number of alternate alleles
             // max it at parameters.genotypingMaxIterations iterations, min at 10
@@ -472,58 +559,29 @@ int main (int argc, char *argv[]) {
                 adjustedBanddepth = parameters.genotypingMaxBandDepth;
             }
 
-            GenotypeCombo nullCombo;
-            SampleDataLikelihoods nullSampleDataLikelihoods;
-
-            // this is the genotype-likelihood maximum
-            if (parameters.reportGenotypeLikelihoodMax) {
-                GenotypeCombo comboKing;
-                vector<int> initialPosition;
-                initialPosition.assign(sampleDataLikelihoods.size(), 0);
-                SampleDataLikelihoods nullDataLikelihoods; // dummy variable
-                makeComboByDatalLikelihoodRank(comboKing,
-                                               initialPosition,
-                                               sampleDataLikelihoods,
-                                               nullDataLikelihoods,
-                                               inputAlleleCounts,
-                                               theta,
-                                               parameters.pooledDiscrete,
-                                               parameters.ewensPriors,
-                                               parameters.permute,
-                                               parameters.hwePriors,
-                                               parameters.obsBinomialPriors,
-                                               parameters.alleleBalancePriors,
-                                               parameters.diffusionPriorScalar);
-
-                glMaxCombos[population].push_back(comboKing);
+            // the populations are searched independently, so they are spread
+            // over the workers; the combo lists are created here, as the maps
+            // holding them can't be modified from the workers
+            PopulationComboSearch search(parameters, samples, genotypeAlleles, inputAlleleCounts,
+                                         theta, itermax, adjustedBandwidth, adjustedBanddepth);
+            for (map<string, SampleDataLikelihoods>::iterator p = sampleDataLikelihoodsByPopulation.begin(); p != sampleDataLikelihoodsByPopulation.end(); ++p) {
+                const string& population = p->first;
+                DEBUG2("genqerating banded genotype combinations from " << p->second.size() << " sample genotypes in population " << population);
+                search.sampleDataLikelihoods.push_back(&p->second);
+                search.genotypeCombos.push_back(&genotypeCombosByPopulation[population]);
+                search.glMaxCombos.push_back(parameters.reportGenotypeLikelihoodMax ? &glMaxCombos[population] : NULL);
             }
+            search.iterations.resize(search.sampleDataLikelihoods.size(), 0);
+            workers.run(search.sampleDataLikelihoods.size(), search);
 
-            // search much longer for convergence
-            convergentGenotypeComboSearch(
-                populationGenotypeCombos,
-                nullCombo,
-                sampleDataLikelihoods, // vary everything
-                sampleDataLikelihoods,
-                nullSampleDataLikelihoods,
-                samples,
-                genotypeAlleles,
-                inputAlleleCounts,
-                adjustedBandwidth,
-                adjustedBanddepth,
-                theta,
-                parameters.pooledDiscrete,
-                parameters.ewensPriors,
-                parameters.permute,
-                parameters.hwePriors,
-                parameters.obsBinomialPriors,
-                parameters.alleleBalancePriors,
-                parameters.diffusionPriorScalar,
-                itermax,
-                genotypingTotalIterations,
-                true); // add homozygous combos
-                // ^^ combo results are sorted by default
+            // as the serial search left it, the iterations of the last population
+            if (!search.iterations.empty()) {
+                genotypingTotalIterations = search.iterations.back();
+            }
         }
 
+        shape.iterations = genotypingTotalIterations;
+
         // generate the GL max combo
         GenotypeCombo glMax;
         if (parameters.reportGenotypeLikelihoodMax) {
@@ -533,16 +591,14 @@ int main (int argc, char *argv[]) {
         }
 
         // accumulate combos from independently-calculated populations into the list of combos
-        list<GenotypeCombo> genotypeCombos; // build new combos into this list
         combinePopulationCombos(genotypeCombos, genotypeCombosByPopulation);
         // TODO factor out the following blocks as they are repeated from above
 
         // re-get posterior normalizer
-        vector<long double> comboProbs;
         for (list<GenotypeCombo>::iterator gc = genotypeCombos.begin(); gc != genotypeCombos.end(); ++gc) {
             comboProbs.push_back(gc->posteriorProb);
         }
-        long double posteriorNormalizer = logsumexp_probs(comboProbs);
+        Real posteriorNormalizer = logsumexp_probs(comboProbs);
 
         // recalculate posterior normalizer
         pVar = 1.0;
@@ -565,6 +621,7 @@ int main (int argc, char *argv[]) {
         }
 
         if (parameters.calculateMarginals) {
+            ProfileTimer timer(PROFILE_MARGINALS);
             // make a combined, all-populations sample data likelihoods vector to accumulate marginals
             SampleDataLikelihoods allSampleDataLikelihoods;
             for (map<string, SampleDataLikelihoods>::iterator p = sampleDataLikelihoodsByPopulation.begin(); p != sampleDataLikelihoodsByPopulation.end(); ++p) {
@@ -667,31 +724,40 @@ int main (int argc, char *argv[]) {
 
             vcflib::Variant var(parser->variantCallFile);
 
-            out << results.vcf(
-                var,
-                pHom,
-                bestComboOddsRatio,
-                samples,
-                referenceBase,
-                alts,
-                repeats,
-                genotypingTotalIterations,
-                parser->sampleList,
-                coverage,
-                bestCombo,
-                alleleGroups,
-                partialObservationGroups,
-                partialObservationSupport,
-                genotypesByPloidy,
-                parser->sequencingTechnologies,
-                parser)
-                << endl;
+            {
+                ProfileTimer timer(PROFILE_VCF_FORMAT);
+                results.vcf(
+                    var,
+                    pHom,
+                    bestComboOddsRatio,
+                    samples,
+                    referenceBase,
+                    alts,
+                    repeats,
+                    genotypingTotalIterations,
+                    parser->sampleList,
+                    coverage,
+                    bestCombo,
+                    alleleGroups,
+                    partialObservationGroups,
+                    partialObservationSupport,
+                    genotypesByPloidy,
+                    parser->sequencingTechnologies,
+                    parser);
+            }
+
+            ProfileTimer timer(PROFILE_OUTPUT_WRITE);
+            out << var << endl;
 
         } else if (parameters.gVCFout) {
             // record statistics for gVCF output
             nonCalls.record(parser->currentSequenceName, parser->currentPosition, samples);
         }
         DEBUG2("finished position");
+#ifdef VERBOSE_DEBUG
+        DEBUG2("heap allocations at this site: " << site.siteAllocations());
+        siteAllocations += site.siteAllocations();
+#endif
 
     }
 
@@ -706,6 +772,46 @@ int main (int argc, char *argv[]) {
     DEBUG("total sites: " << total_sites << endl
           << "processed sites: " << processed_sites << endl
           << "ratio: " << (float) processed_sites / (float) total_sites);
+#ifdef VERBOSE_DEBUG
+    DEBUG("heap allocations per processed site: " << (processed_sites ? siteAllocations / processed_sites : 0));
+#endif
+
+    ReadFilterCounts& filtered = parser->readFilterCounts;
+    DEBUG("reads filtered by --read-max-mismatch-fraction: " << filtered.mismatchFraction << endl
+          << "reads filtered by --read-mismatch-limit: " << filtered.mismatchCount << endl
+          << "reads filtered by --read-snp-limit: " << filtered.snpCount << endl
+          << "reads filtered by --read-indel-limit: " << filtered.indelCount << endl
+          << "reads yielding no alleles: " << filtered.noAlleles << endl
+          << "reads dropped by --max-coverage: " << parser->downsampler.dropped);
+
+    DEBUG("parallel tasks spread over " << workers.size() << " threads: " << workers.spread
+          << " of " << workers.runs);
+
+    // the decoding thread uses the reader until it is stopped
+    if (parser->alignmentPrefetcher) {
+        AlignmentPrefetcher* prefetcher = parser->alignmentPrefetcher;
+        prefetcher->stop();
+        DEBUG("duplicate reads dropped while decoding: " << prefetcher->filteredDuplicates << endl
+              << "low mapping quality reads dropped while decoding: " << prefetcher->filteredMappingQuality << endl
+              << "off-target reads dropped while decoding: " << prefetcher->filteredOutsideRegion);
+    }
+
+#ifndef HAVE_BAMTOOLS
+    BamMergeReader& reader = parser->bamMultiReader;
+    DEBUG("peak open alignment files: " << reader.peakOpenFiles << endl
+          << "alignment files opened: " << reader.opens << endl
+          << "alignment files reopened after eviction: " << reader.reopens << endl
+          << "alignment file seeks: " << reader.seeks << endl
+          << "alignment files left out of regions they have nothing in: " << reader.skips << endl
+          << "peak alignment decode buffer memory: " << reader.peakBufferedBytes() << " bytes");
+#endif
+
+    WindowArena& arena = parser->alignmentArena;
+    profiler.recordArena(arena.peakBytes, arena.chunksAllocated, arena.allocations, arena.nanoseconds);
+    if (!parameters.profileFile.empty() && !profiler.write(parameters.profileFile)) {
+        ERROR("could not write profile to " << parameters.profileFile);
+        exit(1);
+    }
 
     delete parser;
 
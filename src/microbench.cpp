@@ -0,0 +1,767 @@
+// microbench.cpp
+// times the hot paths of variant calling on synthetic sites and reads
+//
+// usage: microbench [options] -- [freebayes options]
+//
+// The freebayes options (at least -f and an alignment file) set up an
+// AlleleParser, which is advanced to its first site.  The synthetic site is
+// placed there, and the synthetic reads are drawn from its reference.
+//
+// Each benchmark is run for a doubling number of iterations until a run
+// takes at least --min-time seconds, and the time per iteration of that run
+// is reported.
+//
+// With --arena-check N, runs N reads of the randomized alignment arena
+// workload instead, checking that no live read is overwritten; best built
+// with make sanitize, so ASan sees any use of a freed chunk.
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <list>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include "AlleleParser.h"
+#include "DataLikelihood.h"
+#include "Marginals.h"
+#include "ResultData.h"
+#include "Genotype.h"
+#include "LeftAlign.h"
+#include "Bias.h"
+#include "Contamination.h"
+#include "version_git.h"
+
+using namespace std;
+
+class BenchConfig {
+public:
+    int depth;       // observations per sample, and reads per benchmark
+    int ploidy;
+    int alleles;     // genotype alleles at the site, including the reference
+    int samples;
+    int readLength;
+    double minTime;  // seconds
+    string filter;   // only run benchmarks whose name contains this
+    bool json;
+    long int arenaCheck;  // reads of the arena workload to check, 0 to benchmark
+    BenchConfig(void)
+        : depth(50)
+        , ploidy(2)
+        , alleles(2)
+        , samples(1)
+        , readLength(150)
+        , minTime(0.5)
+        , json(false)
+        , arenaCheck(0)
+    { }
+};
+
+class BenchState {
+public:
+    long int iterations;
+    chrono::steady_clock::time_point start;
+    // call after any per-run setup, so it isn't timed
+    void resetTimer(void) { start = chrono::steady_clock::now(); }
+};
+
+typedef void (*BenchFunction)(BenchState& state);
+
+// accumulates results so the timed loops can't be optimized away
+Real sink = 0;
+
+// a site with synthetic observations, placed at the parser's current position
+class SyntheticSite {
+public:
+
+    AlleleParser* parser;
+    Parameters& parameters;
+    Bias observationBias;
+    Contamination contaminationEstimates;
+
+    vector<string> sampleNames;
+    vector<Allele> genotypeAlleles;
+    vector<Allele*> observations;
+    Samples samples;
+    map<string, double> estimatedAlleleFrequencies;
+    map<int, vector<Genotype> > genotypesByPloidy;
+    map<string, vector<Allele*> > alleleGroups;
+    map<string, vector<Allele*> > partialObservationGroups;
+    map<Allele*, set<Allele*> > partialObservationSupport;
+    map<string, int> inputAlleleCounts;
+
+    Results results;
+    SampleDataLikelihoods sampleDataLikelihoods;
+    SampleDataLikelihoods invariantSampleDataLikelihoods;
+    GenotypeCombo comboKing;
+    list<GenotypeCombo> genotypeCombos;
+    GenotypeCombo bestCombo;
+    BigFloat pHom;
+    Real bestComboOddsRatio;
+    int genotypingTotalIterations;
+    string referenceBase;
+    vector<Allele> alts;
+    Real theta;
+    int coverage;
+
+    SyntheticSite(AlleleParser* p, BenchConfig& config);
+    ~SyntheticSite(void);
+
+};
+
+SyntheticSite::SyntheticSite(AlleleParser* p, BenchConfig& config)
+    : parser(p)
+    , parameters(p->parameters)
+    , contaminationEstimates(0.5 + p->parameters.probContamination, p->parameters.probContamination)
+    , pHom(0.0)
+    , bestComboOddsRatio(0)
+    , genotypingTotalIterations(0)
+{
+
+    srand(config.depth * 1000 + config.alleles * 100 + config.ploidy * 10 + config.samples);
+
+    // a single-base site
+    parser->lastHaplotypeLength = 1;
+    referenceBase = parser->currentReferenceHaplotype();
+    long int position = parser->currentPosition;
+    theta = parameters.TH * parser->lastHaplotypeLength;
+
+    genotypeAlleles.push_back(genotypeAllele(ALLELE_REFERENCE, referenceBase, 1, "1M", 1, position));
+    string snps = "ACGT";
+    for (string::iterator b = snps.begin(); b != snps.end() && (int) genotypeAlleles.size() < config.alleles; ++b) {
+        if (string(1, *b) != referenceBase) {
+            genotypeAlleles.push_back(genotypeAllele(ALLELE_SNP, string(1, *b), 1, "1X", 1, position));
+        }
+    }
+    // beyond the three SNPs, insertions of increasing length
+    for (int i = 1; (int) genotypeAlleles.size() < config.alleles; ++i) {
+        string sequence = referenceBase + string(i, 'A');
+        genotypeAlleles.push_back(genotypeAllele(ALLELE_INSERTION, sequence, sequence.size(),
+                                                 "1M" + convert(i) + "I", 1, position));
+    }
+    for (vector<Allele>::iterator a = genotypeAlleles.begin(); a != genotypeAlleles.end(); ++a) {
+        if (!a->isReference()) {
+            alts.push_back(*a);
+        }
+    }
+
+    // each sample carries a random genotype, mostly reference, and its
+    // observations are drawn from that genotype with a 1% error rate
+    for (int s = 0; s < config.samples; ++s) {
+        string sampleName = "sample" + convert(s);
+        sampleNames.push_back(sampleName);
+        vector<int> genotype;
+        for (int i = 0; i < config.ploidy; ++i) {
+            genotype.push_back((rand() % 2) ? 0 : rand() % genotypeAlleles.size());
+        }
+        Sample& sample = samples[sampleName];
+        for (int o = 0; o < config.depth; ++o) {
+            int i = (rand() % 100 == 0) ? rand() % genotypeAlleles.size() : genotype[rand() % genotype.size()];
+            Allele* observation = new Allele(genotypeAllele(genotypeAlleles[i]));
+            observation->genotypeAllele = false;
+            observation->sampleID = sampleName;
+            observation->readID = sampleName + ":" + convert(o);
+            observation->strand = (rand() % 2) ? STRAND_FORWARD : STRAND_REVERSE;
+            observation->quality = 20 + rand() % 21;
+            observation->lnquality = phred2ln(observation->quality);
+            observation->mapQuality = 60;
+            observation->lnmapQuality = phred2ln(60);
+            observation->basesLeft = rand() % config.readLength;
+            observation->basesRight = config.readLength - observation->basesLeft - 1;
+            observations.push_back(observation);
+            sample[observation->currentBase].push_back(observation);
+        }
+    }
+    coverage = countAlleles(samples);
+    samples.indexObservations(genotypeAlleles);
+    groupAlleles(samples, alleleGroups);
+    estimatedAlleleFrequencies = samples.estimatedAlleleFrequencies();
+
+    genotypesByPloidy[config.ploidy] = allPossibleGenotypes(config.ploidy, genotypeAlleles);
+    vector<Genotype>& genotypes = genotypesByPloidy[config.ploidy];
+
+    // as calculateSampleDataLikelihoods, for our own samples
+    for (vector<string>::iterator n = sampleNames.begin(); n != sampleNames.end(); ++n) {
+        Sample& sample = samples[*n];
+        vector<Genotype*> genotypePointers;
+        for (vector<Genotype>::iterator g = genotypes.begin(); g != genotypes.end(); ++g) {
+            genotypePointers.push_back(&*g);
+        }
+        vector<pair<Genotype*, Real> > probs
+            = probObservedAllelesGivenGenotypes(sample, genotypePointers,
+                                                parameters.RDF, parameters.useMappingQuality,
+                                                observationBias, parameters.standardGLs,
+                                                genotypeAlleles,
+                                                contaminationEstimates,
+                                                estimatedAlleleFrequencies);
+        Result& sampleData = results[*n];
+        sampleData.name = *n;
+        sampleData.observations = &sample;
+        for (vector<pair<Genotype*, Real> >::iterator p = probs.begin(); p != probs.end(); ++p) {
+            sampleData.push_back(SampleDataLikelihood(*n, &sample, p->first, p->second, 0));
+        }
+        sortSampleDataLikelihoods(sampleData);
+        sampleDataLikelihoods.push_back(sampleData);
+    }
+
+    dataLikelihoodMaxGenotypeCombo(comboKing, sampleDataLikelihoods, theta,
+                                   parameters.pooledDiscrete, parameters.ewensPriors,
+                                   parameters.permute, parameters.hwePriors,
+                                   parameters.obsBinomialPriors, parameters.alleleBalancePriors,
+                                   parameters.diffusionPriorScalar);
+
+    // as the main loop, for a single population
+    GenotypeCombo nullCombo;
+    SampleDataLikelihoods nullSampleDataLikelihoods;
+    convergentGenotypeComboSearch(
+        genotypeCombos,
+        nullCombo,
+        sampleDataLikelihoods,
+        sampleDataLikelihoods,
+        nullSampleDataLikelihoods,
+        samples,
+        genotypeAlleles,
+        inputAlleleCounts,
+        0, 0,
+        theta,
+        parameters.pooledDiscrete,
+        parameters.ewensPriors,
+        parameters.permute,
+        parameters.hwePriors,
+        parameters.obsBinomialPriors,
+        parameters.alleleBalancePriors,
+        parameters.diffusionPriorScalar,
+        parameters.genotypingMaxIterations,
+        genotypingTotalIterations,
+        true);
+
+    vector<Real> comboProbs;
+    for (list<GenotypeCombo>::iterator gc = genotypeCombos.begin(); gc != genotypeCombos.end(); ++gc) {
+        comboProbs.push_back(gc->posteriorProb);
+    }
+    Real posteriorNormalizer = logsumexp_probs(comboProbs);
+    for (list<GenotypeCombo>::iterator gc = genotypeCombos.begin(); gc != genotypeCombos.end(); ++gc) {
+        if (gc->isHomozygous() && gc->alleles().front() == referenceBase) {
+            pHom += big_exp(gc->posteriorProb - posteriorNormalizer);
+        }
+    }
+    bestCombo = genotypeCombos.front();
+    if (genotypeCombos.size() > 1) {
+        bestComboOddsRatio = genotypeCombos.front().posteriorProb - (++genotypeCombos.begin())->posteriorProb;
+    }
+
+    if (parameters.calculateMarginals) {
+        marginalGenotypeLikelihoods(genotypeCombos, sampleDataLikelihoods);
+        results.update(sampleDataLikelihoods);
+    }
+
+}
+
+SyntheticSite::~SyntheticSite(void) {
+    for (vector<Allele*>::iterator o = observations.begin(); o != observations.end(); ++o) {
+        delete *o;
+    }
+}
+
+// reads drawn from the reference around the current position, with 1%
+// mismatches and an indel in one read in ten
+class SyntheticReads {
+public:
+    vector<BAMALIGN> reads;
+    vector<CIGAR> cigars;
+    SyntheticReads(AlleleParser* parser, BenchConfig& config);
+};
+
+SyntheticReads::SyntheticReads(AlleleParser* parser, BenchConfig& config) {
+
+    srand(config.depth * 1000 + config.readLength);
+
+    const string& reference = parser->currentSequence;
+    long int span = 4 * config.readLength;
+    long int first = max((long int) 0, min((long int) parser->currentPosition - span / 2,
+                                           (long int) reference.size() - span - 2 * config.readLength));
+    string bases = "ACGT";
+
+    for (int r = 0; r < config.depth; ++r) {
+        long int start = first + rand() % span;
+        CIGAR cigar;
+        string sequence;
+        int refLength = config.readLength;
+        if (rand() % 10 == 0) {
+            int left = config.readLength / 4 + rand() % (config.readLength / 2);
+            int length = 1 + rand() % 5;
+            if (rand() % 2) {
+                // insertion
+                sequence = reference.substr(start, left) + string(length, bases[rand() % 4])
+                    + reference.substr(start + left, config.readLength - left - length);
+                cigar.ADDCIGAR(CIGOP('M', left));
+                cigar.ADDCIGAR(CIGOP('I', length));
+                cigar.ADDCIGAR(CIGOP('M', config.readLength - left - length));
+                refLength = config.readLength - length;
+            } else {
+                // deletion
+                sequence = reference.substr(start, left)
+                    + reference.substr(start + left + length, config.readLength - left);
+                cigar.ADDCIGAR(CIGOP('M', left));
+                cigar.ADDCIGAR(CIGOP('D', length));
+                cigar.ADDCIGAR(CIGOP('M', config.readLength - left));
+                refLength = config.readLength + length;
+            }
+        } else {
+            sequence = reference.substr(start, config.readLength);
+            cigar.ADDCIGAR(CIGOP('M', config.readLength));
+        }
+        for (string::iterator b = sequence.begin(); b != sequence.end(); ++b) {
+            if (rand() % 100 == 0) {
+                *b = bases[rand() % 4];
+            }
+        }
+        SeqLib::GenomicRegion region(0, start, start + refLength);
+        BAMALIGN read("read" + convert(r), sequence, &region, cigar);
+        string qualities;
+        for (int i = 0; i < config.readLength; ++i) {
+            qualities += qualityInt2Char(20 + rand() % 21);
+        }
+        read.SetQualities(qualities, 33);
+        reads.push_back(read);
+        cigars.push_back(cigar);
+    }
+
+}
+
+// a randomized stand-in for the parser's use of the alignment arena, or of
+// the heap without one.  Reads start in order, their alleles grow as
+// registerAlignment pushes them, and they are erased once they end before the
+// position, or as soon as they are registered as if filtered; the arena is
+// then released a little behind the position.  One read in largeReads is
+// large enough for a chunk of its own, and the position sometimes jumps past
+// the whole window, so that every chunk, the one being filled included, is
+// released at once.  Each read is filled with its number, checked as it is
+// erased.
+class ArenaWorkload {
+public:
+    typedef vector<long int, WindowAllocator<long int> > Read;
+    ArenaWorkload(WindowArena* a, size_t chunkSize, int largeReads);
+    // registers one read and erases those done with, returns the number of
+    // erased reads found overwritten
+    long int step(void);
+    // erases every read, as above
+    long int finish(void);
+private:
+    WindowArena* arena;
+    size_t largeRead;  // elements, over a quarter of a chunk
+    int largeReads;    // one read in this many is large, none if 0
+    long int position;
+    long int reads;
+    list<pair<long int, Read> > window;  // by read number
+    long int erase(list<pair<long int, Read> >::iterator r);
+};
+
+ArenaWorkload::ArenaWorkload(WindowArena* a, size_t chunkSize, int l)
+    : arena(a)
+    , largeRead(chunkSize / 4 / sizeof(long int) + 1)
+    , largeReads(l)
+    , position(0)
+    , reads(0)
+{ }
+
+long int ArenaWorkload::erase(list<pair<long int, Read> >::iterator r) {
+    long int overwritten = 0;
+    for (Read::iterator e = r->second.begin(); e != r->second.end(); ++e) {
+        if (*e != r->first) {
+            overwritten = 1;
+            break;
+        }
+    }
+    window.erase(r);
+    return overwritten;
+}
+
+long int ArenaWorkload::step(void) {
+    position += (rand() % 1000 == 0) ? 1000 : rand() % 3;
+    long int end = position + 50 + rand() % 150;
+    window.push_back(make_pair(reads, Read(WindowAllocator<long int>(arena, end))));
+    Read& read = window.back().second;
+    if (largeReads && rand() % largeReads == 0) {
+        // in one allocation
+        read.reserve(largeRead);
+        read.assign(largeRead, reads);
+    } else {
+        for (int i = 1 + rand() % 30; i > 0; --i) {
+            read.push_back(reads);
+        }
+    }
+    ++reads;
+
+    long int overwritten = 0;
+    if (rand() % 20 == 0) {
+        overwritten += erase(--window.end());
+    }
+    for (list<pair<long int, Read> >::iterator r = window.begin(); r != window.end(); ) {
+        if (r->second.get_allocator().end < position) {
+            overwritten += erase(r++);
+        } else {
+            ++r;
+        }
+    }
+    if (arena) {
+        arena->release(position - rand() % 20);
+    }
+    return overwritten;
+}
+
+long int ArenaWorkload::finish(void) {
+    long int overwritten = 0;
+    while (!window.empty()) {
+        overwritten += erase(window.begin());
+    }
+    if (arena) {
+        arena->clear();
+    }
+    return overwritten;
+}
+
+// the reads which take chunks of their own overflow those of this size
+static const size_t checkedArenaChunkSize = 1 << 14;
+
+// returns the number of reads overwritten over the workload, plus one if the
+// arena has bytes left at the end
+long int checkArena(long int reads) {
+    WindowArena arena(checkedArenaChunkSize);
+    ArenaWorkload workload(&arena, checkedArenaChunkSize, 500);
+    srand(reads);
+    long int overwritten = 0;
+    for (long int i = 0; i < reads; ++i) {
+        overwritten += workload.step();
+    }
+    overwritten += workload.finish();
+    return overwritten + (arena.bytes != 0);
+}
+
+// globals set up in main for the benchmarks
+BenchConfig config;
+AlleleParser* parser = NULL;
+SyntheticSite* site = NULL;
+SyntheticReads* syntheticReads = NULL;
+
+// one genotype per iteration, over all the genotypes of the first sample
+void benchProbObservedAllelesGivenGenotype(BenchState& state) {
+    Sample& sample = site->samples[site->sampleNames.front()];
+    vector<Genotype>& genotypes = site->genotypesByPloidy[config.ploidy];
+    SampleObservationIndex index;
+    index.build(sample, site->parameters.standardGLs, site->genotypeAlleles, site->contaminationEstimates);
+    state.resetTimer();
+    for (long int i = 0; i < state.iterations; ++i) {
+        sink += probObservedAllelesGivenGenotype(
+            sample, index, genotypes[i % genotypes.size()],
+            site->parameters.RDF, site->parameters.useMappingQuality,
+            site->observationBias, site->parameters.standardGLs,
+            site->genotypeAlleles, site->contaminationEstimates,
+            site->estimatedAlleleFrequencies);
+    }
+}
+
+// as above, without the kernels specialized for small ploidies and allele counts
+void benchGenericProbObservedAllelesGivenGenotype(BenchState& state) {
+    Sample& sample = site->samples[site->sampleNames.front()];
+    vector<Genotype>& genotypes = site->genotypesByPloidy[config.ploidy];
+    SampleObservationIndex index;
+    index.build(sample, site->parameters.standardGLs, site->genotypeAlleles, site->contaminationEstimates);
+    state.resetTimer();
+    for (long int i = 0; i < state.iterations; ++i) {
+        sink += genericProbObservedAllelesGivenGenotype(
+            sample, index, genotypes[i % genotypes.size()],
+            site->parameters.RDF, site->parameters.useMappingQuality,
+            site->observationBias, site->parameters.standardGLs,
+            site->genotypeAlleles, site->contaminationEstimates,
+            site->estimatedAlleleFrequencies);
+    }
+}
+
+// one banded search around the data likelihood maximum per iteration
+void benchBandedGenotypeCombinations(BenchState& state) {
+    Parameters& parameters = site->parameters;
+    list<GenotypeCombo> combos;
+    state.resetTimer();
+    for (long int i = 0; i < state.iterations; ++i) {
+        combos.clear();
+        bandedGenotypeCombinations(combos, site->comboKing,
+                                   site->sampleDataLikelihoods, site->invariantSampleDataLikelihoods,
+                                   site->samples, site->inputAlleleCounts,
+                                   2, parameters.genotypingMaxBandDepth,
+                                   site->theta,
+                                   parameters.pooledDiscrete,
+                                   parameters.ewensPriors,
+                                   parameters.permute,
+                                   parameters.hwePriors,
+                                   parameters.obsBinomialPriors,
+                                   parameters.alleleBalancePriors,
+                                   parameters.diffusionPriorScalar,
+                                   false);
+        sink += combos.front().posteriorProb;
+    }
+}
+
+// one normalization over as many terms as there are sample genotypes
+void benchLogsumexpProbs(BenchState& state) {
+    vector<Real> probs;
+    int n = max(2, config.samples * (int) site->genotypesByPloidy[config.ploidy].size());
+    for (int i = 0; i < n; ++i) {
+        probs.push_back(-(Real) (rand() % 100000) / 100);
+    }
+    state.resetTimer();
+    for (long int i = 0; i < state.iterations; ++i) {
+        sink += logsumexp_probs(probs);
+    }
+}
+
+// one position per iteration, on a sequence of short tandem repeats
+void benchRepeatCounts(BenchState& state) {
+    string sequence;
+    string bases = "ACGT";
+    while (sequence.size() < 1000) {
+        string unit;
+        int unitLength = 1 + rand() % 4;
+        for (int i = 0; i < unitLength; ++i) {
+            unit += bases[rand() % 4];
+        }
+        int copies = 1 + rand() % 8;
+        for (int i = 0; i < copies; ++i) {
+            sequence += unit;
+        }
+    }
+    state.resetTimer();
+    for (long int i = 0; i < state.iterations; ++i) {
+        sink += parser->repeatCounts(12 + i % (sequence.size() - 24), sequence, 12).size();
+    }
+}
+
+// one read per iteration, the arena emptied after each pass over the reads
+// as if they had all left the window
+void benchRegisterAlignment(BenchState& state) {
+    vector<BAMALIGN>& reads = syntheticReads->reads;
+    string sampleName = parser->sampleList.empty() ? "unknown" : parser->sampleList.front();
+    string sequencingTech;
+    WindowArena arena;
+    state.resetTimer();
+    for (long int i = 0; i < state.iterations; ++i) {
+        BAMALIGN& read = reads[i % reads.size()];
+        {
+            RegisteredAlignment ra(read, &arena);
+            parser->registerAlignment(read, ra, sampleName, sequencingTech);
+            sink += ra.alleles.size();
+        }
+        if ((i + 1) % reads.size() == 0) {
+            arena.clear();
+        }
+    }
+}
+
+// one read of the arena workload per iteration, without the large reads,
+// which the parser doesn't make
+void benchWindowArena(BenchState& state) {
+    WindowArena arena;
+    ArenaWorkload workload(&arena, 1 << 20, 0);
+    srand(1);
+    state.resetTimer();
+    for (long int i = 0; i < state.iterations; ++i) {
+        sink += workload.step();
+    }
+}
+
+// as above, the reads' alleles on the heap as they were before the arena
+void benchWindowArenaHeap(BenchState& state) {
+    ArenaWorkload workload(NULL, 1 << 20, 0);
+    srand(1);
+    state.resetTimer();
+    for (long int i = 0; i < state.iterations; ++i) {
+        sink += workload.step();
+    }
+}
+
+// one read per iteration, including restoring its original cigar
+void benchLeftAlign(BenchState& state) {
+    vector<BAMALIGN>& reads = syntheticReads->reads;
+    vector<CIGAR>& cigars = syntheticReads->cigars;
+    const string& reference = parser->currentSequence;
+    LeftAlignWorkspace workspace;
+    state.resetTimer();
+    for (long int i = 0; i < state.iterations; ++i) {
+        int r = i % reads.size();
+        BAMALIGN& read = reads[r];
+        read.SetCigar(cigars[r]);
+        sink += stablyLeftAlign(read, reference.data() + read.POSITION,
+                                reference.size() - read.POSITION, workspace);
+    }
+}
+
+// one VCF record per iteration
+void benchResultsVcf(BenchState& state) {
+    map<string, int> repeats;
+    state.resetTimer();
+    for (long int i = 0; i < state.iterations; ++i) {
+        vcflib::Variant var(parser->variantCallFile);
+        site->results.vcf(
+            var,
+            site->pHom,
+            site->bestComboOddsRatio,
+            site->samples,
+            site->referenceBase,
+            site->alts,
+            repeats,
+            site->genotypingTotalIterations,
+            site->sampleNames,
+            site->coverage,
+            site->bestCombo,
+            site->alleleGroups,
+            site->partialObservationGroups,
+            site->partialObservationSupport,
+            site->genotypesByPloidy,
+            parser->sequencingTechnologies,
+            parser);
+        sink += var.alt.size();
+    }
+}
+
+double seconds(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+void run(const string& name, BenchFunction function) {
+
+    if (!config.filter.empty() && name.find(config.filter) == string::npos) {
+        return;
+    }
+
+    BenchState state;
+    double elapsed = 0;
+    for (state.iterations = 1; ; state.iterations *= 2) {
+        function(state);
+        elapsed = seconds(state.start);
+        if (elapsed >= config.minTime || state.iterations >= (1L << 40)) {
+            break;
+        }
+    }
+    double ns = elapsed / state.iterations * 1e9;
+
+    if (config.json) {
+        cout << "{\"benchmark\": \"" << name << "\", "
+             << "\"version\": \"" << VERSION_GIT << "\", "
+             << "\"depth\": " << config.depth << ", "
+             << "\"ploidy\": " << config.ploidy << ", "
+             << "\"alleles\": " << config.alleles << ", "
+             << "\"samples\": " << config.samples << ", "
+             << "\"read_length\": " << config.readLength << ", "
+             << "\"iterations\": " << state.iterations << ", "
+             << "\"ns_per_iteration\": " << fixed << setprecision(1) << ns << "}" << endl;
+    } else {
+        cout << setw(44) << left << name << right
+             << setw(14) << state.iterations
+             << setw(16) << fixed << setprecision(1) << ns << endl;
+    }
+
+}
+
+void usage(char** argv) {
+    cerr << "usage: " << argv[0] << " [options] -- [freebayes options]" << endl
+         << endl
+         << "options:" << endl
+         << "   --depth N        observations per sample, and synthetic reads (default 50)" << endl
+         << "   --ploidy N       (default 2)" << endl
+         << "   --alleles N      alleles at the synthetic site, including the reference (default 2)" << endl
+         << "   --samples N      (default 1)" << endl
+         << "   --read-length N  length of the synthetic reads (default 150)" << endl
+         << "   --min-time S     run each benchmark for at least S seconds (default 0.5)" << endl
+         << "   --filter NAME    only run the benchmarks whose name contains NAME" << endl
+         << "   --json           write one JSON object per benchmark" << endl
+         << "   --arena-check N  check N reads of the randomized alignment arena workload," << endl
+         << "                    writing the number overwritten; no freebayes options" << endl
+         << endl
+         << "The freebayes options must give a reference and alignments; the synthetic" << endl
+         << "site is placed at the first site they yield." << endl;
+}
+
+int main(int argc, char** argv) {
+
+    int i = 1;
+    for (; i < argc && string(argv[i]) != "--"; ++i) {
+        string option = argv[i];
+        if (option == "--json") {
+            config.json = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage(argv);
+            return 1;
+        }
+        string value = argv[++i];
+        if ((option == "--depth" && convert(value, config.depth))
+            || (option == "--ploidy" && convert(value, config.ploidy))
+            || (option == "--alleles" && convert(value, config.alleles))
+            || (option == "--samples" && convert(value, config.samples))
+            || (option == "--read-length" && convert(value, config.readLength))
+            || (option == "--min-time" && convert(value, config.minTime))
+            || (option == "--arena-check" && convert(value, config.arenaCheck))) {
+            continue;
+        } else if (option == "--filter") {
+            config.filter = value;
+        } else {
+            usage(argv);
+            return 1;
+        }
+    }
+    if (config.arenaCheck > 0) {
+        long int overwritten = checkArena(config.arenaCheck);
+        cout << overwritten << endl;
+        return overwritten != 0;
+    }
+    if (i >= argc || config.depth < 1 || config.ploidy < 1 || config.alleles < 1
+        || config.samples < 1 || config.readLength < 10) {
+        usage(argv);
+        return 1;
+    }
+
+    // the parser gets our program name followed by the freebayes options
+    vector<char*> parserArgs;
+    parserArgs.push_back(argv[0]);
+    for (++i; i < argc; ++i) {
+        parserArgs.push_back(argv[i]);
+    }
+    parserArgs.push_back(NULL);
+    parser = new AlleleParser(parserArgs.size() - 1, &parserArgs[0]);
+
+    Samples samples;
+    if (!parser->getNextAlleles(samples, ALLELE_REFERENCE | ALLELE_SNP)) {
+        cerr << "the freebayes options yield no sites to place the synthetic site at" << endl;
+        return 1;
+    }
+
+    site = new SyntheticSite(parser, config);
+    syntheticReads = new SyntheticReads(parser, config);
+
+    if (!config.json) {
+        cout << setw(44) << left << "benchmark" << right
+             << setw(14) << "iterations"
+             << setw(16) << "ns/iteration" << endl;
+    }
+
+    run("probObservedAllelesGivenGenotype", benchProbObservedAllelesGivenGenotype);
+    run("probObservedAllelesGivenGenotype/generic", benchGenericProbObservedAllelesGivenGenotype);
+    run("bandedGenotypeCombinations", benchBandedGenotypeCombinations);
+    run("logsumexp_probs", benchLogsumexpProbs);
+    run("repeatCounts", benchRepeatCounts);
+    run("registerAlignment", benchRegisterAlignment);
+    run("WindowArena", benchWindowArena);
+    run("WindowArena/heap", benchWindowArenaHeap);
+    run("leftAlign", benchLeftAlign);
+    run("Results::vcf", benchResultsVcf);
+
+    delete syntheticReads;
+    delete site;
+    delete parser;
+
+    return sink == 0;
+
+}
@@ -0,0 +1,186 @@
+// qualitybench.cpp
+// times the per-base quality loops against the batch versions in QualityBatch
+// on synthetic short (150bp) and long (10kb) reads, and checks they agree
+//
+// usage: qualitybench [reads per length]
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <chrono>
+#include "Utility.h"
+#include "QualityBatch.h"
+
+using namespace std;
+
+// the per-base implementations replaced by QualityBatch
+
+long double perBaseSum(const string& qualstr) {
+    long double qual = 0;
+    for (string::const_iterator q = qualstr.begin(); q != qualstr.end(); ++q)
+        qual += qualityChar2LongDouble(*q);
+    return qual;
+}
+
+long double perBaseMin(const string& qualstr) {
+    long double qual = 0;
+    for (string::const_iterator q = qualstr.begin(); q != qualstr.end(); ++q) {
+        long double nq = qualityChar2LongDouble(*q);
+        if (qual == 0) {
+            qual = nq;
+        } else if (nq < qual) {
+            qual = nq;
+        }
+    }
+    return qual;
+}
+
+long double perBaseJoint(const string& qualstr) {
+    long double jq = 1;
+    for (string::const_iterator q = qualstr.begin(); q != qualstr.end(); ++q) {
+        jq *= 1 - phred2float(qualityChar2ShortInt(*q));
+    }
+    return 1 - jq;
+}
+
+void perBaseDecode(const string& qualstr, vector<short>& quals) {
+    quals.resize(qualstr.size());
+    transform(qualstr.begin(), qualstr.end(), quals.begin(), qualityChar2ShortInt);
+}
+
+void perBaseCap(string& qualstr, int cap) {
+    char qualcap = qualityInt2Char(cap);
+    for (string::iterator c = qualstr.begin(); c != qualstr.end(); ++c) {
+        if (qualityChar2ShortInt(*c) > cap) {
+            *c = qualcap;
+        }
+    }
+}
+
+// Illumina-like qualities, mostly high with a tail of low ones
+vector<string> makeReads(int count, int length) {
+    vector<string> reads;
+    for (int i = 0; i < count; ++i) {
+        string qualstr(length, ' ');
+        for (int j = 0; j < length; ++j) {
+            int r = rand() % 100;
+            qualstr[j] = qualityInt2Char(r < 5 ? 2 + rand() % 10 : 25 + rand() % 17);
+        }
+        reads.push_back(qualstr);
+    }
+    return reads;
+}
+
+double elapsed(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// accumulates results so the timed loops can't be optimized away
+long double sink = 0;
+
+void report(const string& name, int length, double perBase, double batch, int reads) {
+    cout << setw(8) << length
+         << setw(10) << name
+         << setw(14) << fixed << setprecision(1) << perBase / reads * 1e9
+         << setw(14) << batch / reads * 1e9
+         << setw(10) << setprecision(2) << perBase / batch << "x" << endl;
+}
+
+int bench(int length, int count) {
+
+    srand(length);
+    vector<string> reads = makeReads(count, length);
+    vector<short> quals(length);
+    int failures = 0;
+
+    // agreement first
+    for (vector<string>::iterator r = reads.begin(); r != reads.end(); ++r) {
+        string capped = *r;
+        string batchCapped = *r;
+        perBaseCap(capped, 30);
+        qualityCap(&batchCapped[0], batchCapped.size(), 30);
+        vector<short> batchQuals(r->size());
+        perBaseDecode(*r, quals);
+        qualityDecode(r->data(), r->size(), &batchQuals[0]);
+        if (perBaseSum(*r) != sumQuality(*r)
+            || perBaseMin(*r) != minQuality(*r)
+            || perBaseJoint(*r) != jointQuality(*r)
+            || quals != batchQuals
+            || capped != batchCapped) {
+            ++failures;
+        }
+    }
+
+    chrono::steady_clock::time_point start;
+    double perBase, batch;
+
+    start = chrono::steady_clock::now();
+    for (vector<string>::iterator r = reads.begin(); r != reads.end(); ++r) sink += perBaseSum(*r);
+    perBase = elapsed(start);
+    start = chrono::steady_clock::now();
+    for (vector<string>::iterator r = reads.begin(); r != reads.end(); ++r) sink += qualitySum(r->data(), r->size());
+    batch = elapsed(start);
+    report("sum", length, perBase, batch, count);
+
+    start = chrono::steady_clock::now();
+    for (vector<string>::iterator r = reads.begin(); r != reads.end(); ++r) sink += perBaseMin(*r);
+    perBase = elapsed(start);
+    start = chrono::steady_clock::now();
+    for (vector<string>::iterator r = reads.begin(); r != reads.end(); ++r) sink += qualityMin(r->data(), r->size());
+    batch = elapsed(start);
+    report("min", length, perBase, batch, count);
+
+    start = chrono::steady_clock::now();
+    for (vector<string>::iterator r = reads.begin(); r != reads.end(); ++r) { perBaseDecode(*r, quals); sink += quals.back(); }
+    perBase = elapsed(start);
+    start = chrono::steady_clock::now();
+    for (vector<string>::iterator r = reads.begin(); r != reads.end(); ++r) { qualityDecode(r->data(), r->size(), &quals[0]); sink += quals.back(); }
+    batch = elapsed(start);
+    report("decode", length, perBase, batch, count);
+
+    start = chrono::steady_clock::now();
+    for (vector<string>::iterator r = reads.begin(); r != reads.end(); ++r) { string q = *r; perBaseCap(q, 30); sink += q[0]; }
+    perBase = elapsed(start);
+    start = chrono::steady_clock::now();
+    for (vector<string>::iterator r = reads.begin(); r != reads.end(); ++r) { string q = *r; qualityCap(&q[0], q.size(), 30); sink += q[0]; }
+    batch = elapsed(start);
+    report("cap", length, perBase, batch, count);
+
+    start = chrono::steady_clock::now();
+    for (vector<string>::iterator r = reads.begin(); r != reads.end(); ++r) sink += perBaseJoint(*r);
+    perBase = elapsed(start);
+    start = chrono::steady_clock::now();
+    for (vector<string>::iterator r = reads.begin(); r != reads.end(); ++r) sink += qualityJointError(r->data(), r->size());
+    batch = elapsed(start);
+    report("joint", length, perBase, batch, count);
+
+    return failures;
+
+}
+
+int main(int argc, char** argv) {
+
+    int reads = 20000;
+    if (argc > 1) {
+        reads = atoi(argv[1]);
+    }
+
+    cout << setw(8) << "length"
+         << setw(10) << "op"
+         << setw(14) << "per-base ns"
+         << setw(14) << "batch ns"
+         << setw(11) << "speedup" << endl;
+
+    int failures = bench(150, reads);
+    // same number of bases for the long reads
+    failures += bench(10000, max(1, reads * 150 / 10000));
+
+    if (failures) {
+        cerr << failures << " reads where the batch and per-base results differ" << endl;
+        return 1;
+    }
+    return sink == 0;
+
+}
@@ -0,0 +1,36 @@
+#!/usr/bin/env bash
+#
+# end-to-end throughput: runs freebayes over the tiny test data several times
+# and writes one JSON object with the best (fastest) run's sites per second,
+# and the largest peak RSS of any run
+#
+# usage: ./bench.sh [runs] [freebayes options]
+
+PATH=../bin:$PATH
+
+runs=${1:-5}
+[ $# -gt 0 ] && shift
+bam=tiny/NA12878.chr22.tiny.bam
+profile=$(mktemp)
+trap "rm -f $profile" EXIT
+
+# pulls a top-level number out of the --profile JSON
+function field() {
+    grep -m1 "^  \"$1\":" $profile | sed 's/.*: *\([0-9.e+-]*\).*/\1/'
+}
+
+best_seconds=
+peak_rss_kb=0
+sites=
+for run in $(seq $runs); do
+    freebayes -f tiny/q.fa $bam --profile $profile "$@" >/dev/null || exit 1
+    seconds=$(field wall_seconds)
+    sites=$(field sites)
+    best_seconds=$(awk -v s=$seconds -v b=$best_seconds 'BEGIN { print (b == "" || s < b) ? s : b }')
+    rss=$(grep -m1 '"peak_rss_kb"' $profile | sed 's/.*"peak_rss_kb": *\([0-9]*\).*/\1/')
+    [ "$rss" -gt $peak_rss_kb ] && peak_rss_kb=$rss
+done
+
+version=$(freebayes --version | sed 's/.*: *//')
+
+echo "{\"benchmark\": \"end_to_end\", \"version\": \"$version\", \"bam\": \"$bam\", \"runs\": $runs, \"sites\": $sites, \"seconds\": $best_seconds, \"sites_per_second\": $(awk -v n=$sites -v s=$best_seconds 'BEGIN { printf "%.1f", n / s }'), \"peak_rss_kb\": $peak_rss_kb}"
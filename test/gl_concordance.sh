@@ -0,0 +1,71 @@
+#!/usr/bin/env bash
+#
+# compares the calls of a default (long double) build of freebayes with those
+# of a FAST_GL build over the tiny test data, writing one JSON object with the
+# largest differences in QUAL and in any sample's GL, and the number of
+# genotypes which differ, over the records both report
+#
+# exits nonzero if the builds report different records or genotypes, if a GL
+# differs by more than MAX_GL_DIFFERENCE (default 0.01, above the rounding of
+# the printed values) or a QUAL by more than MAX_QUAL_RELATIVE of its value
+# (default 1e-4); the likelihood kernels themselves agree to within 2e-6
+#
+# usage: ./gl_concordance.sh freebayes-longdouble freebayes-fastgl [freebayes options]
+
+[ $# -lt 2 ] && { sed -n '3,13s/^# \?//p' $0; exit 1; }
+reference=$1
+fast=$2
+shift 2
+bam=tiny/NA12878.chr22.tiny.bam
+a=$(mktemp)
+b=$(mktemp)
+trap "rm -f $a $b" EXIT
+
+$reference -f tiny/q.fa $bam "$@" >$a || exit 1
+$fast -f tiny/q.fa $bam "$@" >$b || exit 1
+
+awk -F'\t' -v bam=$bam \
+    -v maxGLAllowed=${MAX_GL_DIFFERENCE:-0.01} \
+    -v maxQualAllowed=${MAX_QUAL_RELATIVE:-1e-4} '
+# the index of a FORMAT field, 0 if absent
+function formatIndex(format, name,    f, n, i) {
+    n = split(format, f, ":")
+    for (i = 1; i <= n; ++i) if (f[i] == name) return i
+    return 0
+}
+function abs(x) { return x < 0 ? -x : x }
+/^#/ { next }
+{ key = $1 "\t" $2 "\t" $4 "\t" $5 }
+FNR == NR {
+    qual[key] = $6
+    gti = formatIndex($9, "GT"); gli = formatIndex($9, "GL")
+    for (i = 10; i <= NF; ++i) {
+        split($i, s, ":")
+        gt[key, i] = gti ? s[gti] : ""
+        gl[key, i] = gli ? s[gli] : ""
+    }
+    ++onlyReference[key]
+    next
+}
+{
+    if (!(key in qual)) { ++onlyFast; next }
+    delete onlyReference[key]
+    ++records
+    d = abs($6 - qual[key]); if (d > maxQual) maxQual = d
+    if (qual[key] != 0) { d /= abs(qual[key]); if (d > maxQualRelative) maxQualRelative = d }
+    gti = formatIndex($9, "GT"); gli = formatIndex($9, "GL")
+    for (i = 10; i <= NF; ++i) {
+        split($i, s, ":")
+        if (gti && s[gti] != gt[key, i]) ++discordant
+        if (!gli) continue
+        n = split(s[gli], x, ","); split(gl[key, i], y, ",")
+        for (j = 1; j <= n; ++j) {
+            d = abs(x[j] - y[j]); if (d > maxGL) maxGL = d
+        }
+    }
+}
+END {
+    for (k in onlyReference) ++missing
+    printf "{\"benchmark\": \"gl_concordance\", \"bam\": \"%s\", \"records\": %d, \"only_longdouble\": %d, \"only_fastgl\": %d, \"max_qual_difference\": %g, \"max_qual_relative_difference\": %g, \"max_gl_difference\": %g, \"discordant_genotypes\": %d}\n", bam, records, missing, onlyFast, maxQual, maxQualRelative, maxGL, discordant
+    exit (missing || onlyFast || discordant || maxGL > maxGLAllowed || maxQualRelative > maxQualAllowed)
+}' $a $b
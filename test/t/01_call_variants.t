@@ -7,7 +7,7 @@ PATH=../bin:$PATH # for freebayes
 PATH=../scripts:$PATH # for freebayes-parallel
 PATH=../vcflib/bin:$PATH # for vcf binaries used by freebayes-parallel
 
-plan tests 21
+plan tests 52
 
 is $(echo "$(comm -12 <(cat tiny/NA12878.chr22.tiny.giab.vcf | grep -v "^#" | cut -f 2 | sort) <(freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam | grep -v "^#" | cut -f 2 | sort) | wc -l) >= 13" | bc) 1 "variant calling recovers most of the GiAB variants in a test region"
 
@@ -116,3 +116,87 @@ is $(freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam --gvcf --gvcf-chunk 50 |
 samtools view -h tiny/NA12878.chr22.tiny.bam | sed s/NA12878D_HiSeqX_R1.fastq.gz/222.NA12878D_HiSeqX_R1.fastq.gz/ | sed s/SM:1/SM:2/ >x.sam
 is $(freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam x.sam -A <(echo 1 8; echo 2 13) | grep 'AN=21' | wc -l) 19 "the CNV map may be used to specify per-sample copy numbers"
 rm -f x.sam
+
+freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam --dump-observations x.obs >/dev/null
+is $(diff <(freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam | grep -v "^#") <(freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam --from-observations x.obs | grep -v "^#") | wc -l) 0 "replaying dumped observations reproduces the calls"
+is $(diff <(freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam -T 0.01 -p 4 | grep -v "^#") <(freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam -T 0.01 -p 4 --from-observations x.obs | grep -v "^#") | wc -l) 0 "dumped observations may be genotyped with other priors"
+is $(diff <(freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam -t <(printf "q\t0\t5000\nq\t5000\t12356\n") | grep -v "^#") <(freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam -t <(printf "q\t0\t5000\nq\t5000\t12356\n") --from-observations x.obs | grep -v "^#") | wc -l) 0 "dumped observations may be replayed over targets"
+rm -f x.obs
+
+is $(diff <(freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam -p 4 | grep -v "^#") <(freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam -p 4 --threads 4 | grep -v "^#") | wc -l) 0 "calls don't depend on --threads"
+
+# two samples in two populations, so the sample likelihoods and the
+# population searches are both shared with the workers at every site
+samtools view -h tiny/NA12878.chr22.tiny.bam | sed s/NA12878D_HiSeqX_R1.fastq.gz/222.NA12878D_HiSeqX_R1.fastq.gz/ | sed s/SM:1/SM:2/ >x.sam
+printf "1\tpop1\n2\tpop2\n" >x.pops
+is $(freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam x.sam --populations x.pops --threads 4 -d 2>&1 >/dev/null | grep "^parallel tasks spread" | awk '$7 > 0 && $7 == $9' | wc -l) 1 "sites with several samples and populations are spread over the threads"
+is $(diff <(freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam x.sam --populations x.pops | grep -v "^#") <(freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam x.sam --populations x.pops --threads 4 | grep -v "^#") | wc -l) 0 "calls over several samples and populations don't depend on --threads"
+rm -f x.sam x.pops
+
+# --sample-max-coverage caps sample 2 only, each sample's DP read from its own column
+samtools view -h tiny/NA12878.chr22.tiny.bam | sed s/NA12878D_HiSeqX_R1.fastq.gz/222.NA12878D_HiSeqX_R1.fastq.gz/ | sed s/SM:1/SM:2/ >x.sam
+echo "2 5" >x.caps
+freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam x.sam --sample-max-coverage x.caps --no-partial-observations >x.vcf
+freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam x.sam --sample-max-coverage x.caps --no-partial-observations >y.vcf
+sample_dp='/^#CHROM/ { for (i = 10; i <= NF; ++i) c[$i] = i } !/^#/ { n = split($9, f, ":"); for (i = 1; i <= n; ++i) if (f[i] == "DP") k = i; split($c[s], v, ":"); print v[k] }'
+is $(awk -F'\t' -v s=2 "$sample_dp" x.vcf | awk '$1 > 5' | wc -l) 0 "--sample-max-coverage caps the depth of the listed sample"
+is $(echo "$(awk -F'\t' -v s=1 "$sample_dp" x.vcf | awk '$1 > 5' | wc -l) > 0" | bc) 1 "--sample-max-coverage leaves the other samples alone"
+is $(diff <(grep -v "^##" x.vcf) <(grep -v "^##" y.vcf) | wc -l) 0 "downsampling with --sample-max-coverage is deterministic"
+rm -f x.sam x.caps x.vcf y.vcf
+
+# the header cache is filled by the first run and read by the second
+rm -f x.hcache
+freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam --header-cache x.hcache >x.vcf
+freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam --header-cache x.hcache >y.vcf
+is $(freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam --header-cache x.hcache -d 2>&1 >/dev/null | grep -c "BAM header cache x.hcache: 1 hits, 0 misses") 1 "later runs read the BAM header from the cache"
+is $(cmp x.vcf y.vcf >/dev/null && echo same) same "output is the same whether the BAM header comes from the cache or the file"
+rm -f x.hcache x.vcf y.vcf
+
+is $(diff <(freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam | grep -v "^#") <(freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam --read-ahead 64 | grep -v "^#") | wc -l) 0 "calls don't depend on --read-ahead"
+is $(diff <(freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam -t <(printf "q\t0\t5000\nq\t5000\t12356\n") | grep -v "^#") <(freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam -t <(printf "q\t0\t5000\nq\t5000\t12356\n") --read-ahead 64 | grep -v "^#") | wc -l) 0 "calls over targets don't depend on --read-ahead"
+
+is $(freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam --max-coverage 10 --no-partial-observations | grep -v "^#" | grep -o "DP=[0-9]*" | cut -d= -f2 | awk '$1 > 10' | wc -l) 0 "--max-coverage caps the depth of each sample"
+
+freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam --profile x.json >/dev/null
+is $(grep -cE '^  "(wall_seconds|sites|site_seconds|phases|site_latency_us|haplotype_iterations|memory|contigs)":' x.json) 8 "--profile writes the phase, latency, memory and per-contig sections"
+is $(grep '^  "sites":' x.json | tr -dc 0-9) $(grep '^      "sites":' x.json | awk '{ s += $2 } END { print s }') "--profile per-contig site counts add up to the total"
+is $(grep '^    "get_next_alleles":' x.json | sed 's/.*"calls": \([0-9]*\).*/\1/') $(grep '^        "get_next_alleles":' x.json | sed 's/.*"calls": \([0-9]*\).*/\1/' | awk '{ s += $1 } END { print s }') "--profile charges every get_next_alleles call to a contig"
+is $(grep -cE '"alignment_arena_allocations": [1-9][0-9]*, "alignment_arena_seconds": [0-9.e-]+}' x.json) 1 "--profile reports the allocations and time of the alignment arena"
+rm -f x.json
+
+is $(microbench --arena-check 200000) 0 "the alignment arena frees no chunk holding a live read"
+
+freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam --trace-slow-sites 0 x.trace -d 2>x.log >/dev/null
+is $(grep -vc "^#" x.trace) $(grep "^total sites" x.log | cut -d' ' -f3) "--trace-slow-sites 0 traces every site"
+is $(head -1 x.trace | tr '\t' '\n' | grep -cxE '#sequence|position|ms|coverage|alleles|haplotype_length|genotypes_by_ploidy|combos|iterations|haplotype_iterations') 10 "--trace-slow-sites names the shape of each site"
+is $(awk -F'\t' 'NR == 1 { n = NF } NF != n || (NR > 1 && $2 < 1)' x.trace | wc -l) 0 "every trace record has every field"
+rm -f x.trace x.log
+
+# resuming from the last checkpoint of a finished run redoes only its tail
+freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam --gvcf -v x.vcf --checkpoint x.ckpt --checkpoint-interval 0 -d 2>x.log
+cp x.vcf y.vcf
+is $(test -s x.ckpt && echo written) written "a checkpoint is written"
+is $(awk -F'\t' '$1 == "position" && $3 > 0 && $3 < 12356 && $5 > 0' x.ckpt | wc -l) 1 "the checkpoint is taken within the sequence, after some output"
+freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam --gvcf -v x.vcf --checkpoint x.ckpt --checkpoint-interval 0 -d --resume 2>y.log
+is $(cmp x.vcf y.vcf >/dev/null && echo same) same "a resumed run reproduces the output of an uninterrupted one"
+is $(( $(grep "^total sites" y.log | cut -d' ' -f3) < $(grep "^total sites" x.log | cut -d' ' -f3) )) 1 "a resumed run skips the sites before the checkpoint"
+rm -f x.log y.log
+printf "q\t0\t5000\nq\t5000\t12356\n" >x.bed
+freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam -t x.bed -v x.vcf --checkpoint x.ckpt --checkpoint-interval 0
+cp x.vcf y.vcf
+freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam -t x.bed -v x.vcf --checkpoint x.ckpt --checkpoint-interval 0 --resume
+is $(cmp x.vcf y.vcf >/dev/null && echo same) same "a resumed run over targets reproduces the output of an uninterrupted one"
+rm -f x.vcf y.vcf x.ckpt x.bed
+
+# a run killed part way through, here by a file size limit of half its
+# output, is finished by --resume; bgzip-compressed output is cut back to
+# the block the checkpoint ended and comes out as a clean run's would
+freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam --gvcf --gvcf-chunk 1 -v y.vcf
+freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam --gvcf --gvcf-chunk 1 -v y.vcf.gz --checkpoint y.ckpt --checkpoint-interval 0
+is $(zcat y.vcf.gz | cmp - y.vcf >/dev/null && echo same) same "--vcf FILE.gz writes bgzip-compressed output"
+(ulimit -f $(( $(stat -c %s y.vcf.gz) / 2048 )); freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam --gvcf --gvcf-chunk 1 -v x.vcf.gz --checkpoint x.ckpt --checkpoint-interval 0) 2>/dev/null
+is $? 153 "the run is stopped by the file size limit"
+is $(awk -F'\t' '$1 == "position" && $5 > 0' x.ckpt | wc -l) 1 "the stopped run leaves a checkpoint after some output"
+freebayes -f tiny/q.fa tiny/NA12878.chr22.tiny.bam --gvcf --gvcf-chunk 1 -v x.vcf.gz --checkpoint x.ckpt --checkpoint-interval 0 --resume
+is $(cmp x.vcf.gz y.vcf.gz >/dev/null && echo same) same "resuming a stopped run gives the compressed output of an uninterrupted one"
+rm -f x.vcf.gz y.vcf.gz y.vcf x.ckpt y.ckpt
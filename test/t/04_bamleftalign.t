@@ -0,0 +1,19 @@
+#!/usr/bin/env bash
+
+BASH_TAP_ROOT=bash-tap
+source ./bash-tap/bash-tap-bootstrap
+
+PATH=../bin:$PATH # for bamleftalign
+
+plan tests 3
+
+function leftalign() {
+    cat tiny/NA12878.chr22.tiny.bam | bamleftalign -f tiny/q.fa "$@" | samtools view - | md5sum
+}
+
+is "$(leftalign -t 4 -b 16)" "$(leftalign)" "realigning on several threads gives the same alignments, in the same order"
+
+is $(cat tiny/NA12878.chr22.tiny.bam | bamleftalign -f tiny/q.fa -t 2 -S -s 2>&1 >/dev/null | grep -c "^\(decode\|realign\|write\)") 3 "the pipeline reports counters for each stage"
+
+cat tiny/NA12878.chr22.tiny.bam | bamleftalign -f tiny/q.fa -D -s 2>/dev/null
+is $? 0 "the in-place left-alignment engine agrees with the original on every alignment"